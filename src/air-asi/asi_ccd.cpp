@@ -33,9 +33,11 @@ Description:ZWO camera driver
 
 #include "asi_ccd.h"
 #include "../logger.h"
-#include "../opencv.h"
+#include "../discovery.h"
+#include "../metrics.h"
 
-#include <fitsio.h>
+#include <algorithm>
+#include <cmath>
 
 namespace AstroAir
 {
@@ -44,7 +46,7 @@ namespace AstroAir
      * describe: Initialization, for camera constructor
      * 描述：构造函数，用于初始化相机参数
      */
-    ASICCD::ASICCD()
+    ASICCD::ASICCD() : CAMERA("ZWOASI")
     {
 		CamNumber = 0;
 		CamId = 0;
@@ -52,7 +54,8 @@ namespace AstroAir
 		isConnected = false;
 		InVideo = false;
 		InExposure = false;
-		InCooling = false;
+		/*SDK卡死与恢复交给服务器处理*/
+		SDK.SetStallHandler([this](std::string Func,bool Stalled) { DeviceFault(Func,Stalled); });
     }
     
     /*
@@ -70,88 +73,138 @@ namespace AstroAir
 		}
     }
     
+    /*
+     * name: ScanCameras()
+     * describe: Discovery backend,list all connected ASI cameras
+     * 描述：设备扫描后端，列出所有已连接的ASI相机
+     * calls: ASIGetNumOfConnectedCameras()
+     * calls: ASIGetCameraProperty()
+     */
+    static std::vector<DeviceInfo> ScanCameras()
+    {
+		std::vector<DeviceInfo> devices;
+		int number = ASIGetNumOfConnectedCameras();
+		for(int i = 0;i < number;i++)
+		{
+			ASI_CAMERA_INFO info;
+			if(ASIGetCameraProperty(&info, i) != ASI_SUCCESS)
+				continue;
+			DeviceInfo device;
+			device.Brand = "ZWOASI";
+			device.Name = info.Name;
+			device.Index = info.CameraID;
+			device.Id = std::to_string(info.CameraID);
+			device.MaxWidth = info.MaxWidth;
+			device.MaxHeight = info.MaxHeight;
+			device.IsColor = info.IsColorCam == ASI_TRUE;
+			device.IsCooler = info.IsCoolerCam == ASI_TRUE;
+			devices.push_back(device);
+		}
+		return devices;
+    }
+
+    /*驱动加载时注册扫描后端，0x03c3为ZWO的USB厂商ID*/
+    static const bool ScannerRegistered = (DISCOVERY::RegisterBackend("ZWOASI",ScanCameras,0x03c3),true);
+
     /*
      * name: Connect(std::string Device_name)
      * @param Device_name:连接相机名称
      * describe: Connect the camera
      * 描述： 连接相机
-     * calls: ASIGetNumOfConnectedCameras()
-     * calls: ASIGetCameraProperty()
-     * calls: ASIOpenCamera()
-     * calls: ASIInitCamera()
-     * calls: UpdateCameraConfig()
+     * calls: DISCOVERY::Find()
+     * calls: DISCOVERY::ScanNow()
+     * calls: OpenCamera()
      * calls: IDLog()
      * @return true: Camera connected successfully
      * @return false: Failed to connect camera
-     * note: Do not connect the camera repeatedly
+     * note: The camera list comes from the discovery cache,the bus is only scanned when the camera is not in it
      */
     bool ASICCD::Connect(std::string Device_name)
     {
-		/*获取已连接相机数量*/
-		CamNumber = ASIGetNumOfConnectedCameras();
-		if(CamNumber <= 0)
+		DeviceInfo info;
+		if(DISCOVERY::Find("ZWOASI",Device_name,info) == false)
 		{
-			IDLog("ASI camera not found, please check the power supply or make sure the camera is connected.\n");
+			/*缓存中没有该相机，立即扫描一次*/
+			DISCOVERY::ScanNow("ZWOASI");
+			if(DISCOVERY::Find("ZWOASI",Device_name,info) == false)
+			{
+				IDLog("The specified camera was not found. Please check the camera connection\n");
+				return false;
+			}
+		}
+		IDLog("Find %s.\n",Device_name.c_str());
+		if(OpenCamera(info.Index,Device_name) == true)
+			return true;
+		/*缓存可能已过期，重新扫描后再试一次*/
+		DISCOVERY::ScanNow("ZWOASI");
+		if(DISCOVERY::Find("ZWOASI",Device_name,info) == true && info.Index != CamId)
+			return OpenCamera(info.Index,Device_name);
+		return false;
+    }
+
+    /*
+     * name: OpenCamera(int Id,std::string Device_name)
+     * @param Id:相机ID
+     * @param Device_name:相机名称
+     * describe: Open and initialize the camera with the ID
+     * 描述：使用相机ID打开并初始化相机
+     * calls: ASIOpenCamera()
+     * calls: ASIGetCameraPropertyByID()
+     * calls: ASIInitCamera()
+     * calls: LoadControlCaps()
+     * calls: UpdateCameraConfig()
+     * note: The name is checked after opening,because an ID may belong to another camera after replugging
+     */
+    bool ASICCD::OpenCamera(int Id,std::string Device_name)
+    {
+		if(Id < 0 || Id >= MAXDEVICENUM)
+			return false;
+		CamId = Id;
+		/*打开相机*/
+		if((errCode = ASIOpenCamera(CamId)) != ASI_SUCCESS)
+		{
+			IDLog("Unable to turn on the %s,error code is %d.\n",Device_name.c_str(),errCode);
 			return false;
 		}
-		else
+		if((errCode = ASIGetCameraPropertyByID(CamId,&ASICameraInfo)) != ASI_SUCCESS || Device_name != ASICameraInfo.Name)
 		{
-			for(int i = 0;i < CamNumber;i++)
-			{
-				/*获取相机信息*/
-				if((errCode = ASIGetCameraProperty(&ASICameraInfo, i)) != ASI_SUCCESS)
-				{
-					IDLog("Unable to get %s configuration information,the error code is %d,please check program permissions.\n",ASICameraInfo.Name,errCode);
-					return false;
-				}
-				else
-				{
-					if(ASICameraInfo.Name == Device_name)
-					{
-						IDLog("Find %s.\n",ASICameraInfo.Name);
-						CamId = ASICameraInfo.CameraID;
-						CamName[CamId] = ASICameraInfo.Name;
-						/*打开相机*/
-						if((errCode = ASIOpenCamera(CamId)) != ASI_SUCCESS)		
-						{
-							IDLog("Unable to turn on the %s,error code is %d.\n",CamName[CamId],errCode);
-							return false;
-						}
-						else
-						{
-							/*初始化相机*/
-							if((errCode = ASIInitCamera(CamId)) != ASI_SUCCESS)	
-							{
-								IDLog("Unable to initialize connection to camera,the error code is %d.\n",errCode);
-								return false;
-							}
-							else 
-							{
-								isConnected = true;
-								IDLog("Camera turned on successfully\n");
-								/*获取连接相机配置信息，并存入参数*/
-								UpdateCameraConfig();
-								return true;
-							}
-						}
-					}
-					else
-					{
-						IDLog("This is not a designated camera, try to find the next one.\n");
-					}
-				}
-			}
-			IDLog("The specified camera was not found. Please check the camera connection");
+			IDLog("Camera with ID %d is not %s.\n",CamId,Device_name.c_str());
+			ASICloseCamera(CamId);
 			return false;
 		}
-		return false;
+		CamName[CamId] = ASICameraInfo.Name;
+		/*初始化相机*/
+		if((errCode = ASIInitCamera(CamId)) != ASI_SUCCESS)
+		{
+			IDLog("Unable to initialize connection to camera,the error code is %d.\n",errCode);
+			ASICloseCamera(CamId);
+			return false;
+		}
+		isConnected = true;
+		HoldScan(true);
+		IDLog("Camera turned on successfully\n");
+		/*初始化后相机恢复默认设置，重新读取控制项*/
+		LoadControlCaps();
+		/*获取连接相机配置信息，并存入参数*/
+		UpdateCameraConfig();
+		/*按最大分辨率与位深预先分配帧缓冲区*/
+		Frames.Reserve((size_t)iMaxWidth * iMaxHeight * (ASICameraInfo.BitDepth > 8 ? 2 : 1));
+		/*制冷相机交给制冷控制线程采样*/
+		if(isCoolCamera == true)
+			StartCooler();
+		std::lock_guard<std::mutex> lock(stateLock);
+		CamState.Brand = "ZWOASI";
+		CamState.Name = Device_name;
+		CamState.Index = CamId;
+		CamState.Id = std::to_string(CamId);
+		return true;
     }
     
     /*
      * name: Disconnect()
      * describe: Disconnect from camera
      * 描述：与相机断开连接
-     * calls: ASIStopVideoCapture()
+     * calls: StopVideo()
      * calls: ASIStopExposure()
      * calls: SaveConfig()
      * calls: ASICloseCamera()
@@ -160,10 +213,11 @@ namespace AstroAir
      */
     bool ASICCD::Disconnect()
     {
-		/*在关闭相机之前停止所有任务*/
+		StopCooler();
+		/*在关闭相机之前停止所有任务，视频采集线程与录制一起停止*/
 		if(InVideo == true)
 		{
-			if((errCode = ASIStopVideoCapture(CamId)) != ASI_SUCCESS)		//停止视频拍摄
+			if(StopVideo() == false)		//停止视频拍摄
 			{
 				IDLog("Unable to stop video capture,error code is %d,please try again.\n",errCode);
 				return false;
@@ -187,6 +241,9 @@ namespace AstroAir
 			IDLog("Unable to turn off the camera,error code is %d,please try again\n",errCode);
 			return false;
 		}
+		Controls.Clear();
+		isConnected = false;
+		HoldScan(false);
 		IDLog("Disconnect from camera\n");
 		return true;
     }
@@ -211,6 +268,14 @@ namespace AstroAir
 			isGuideCamera = true;
 		/*获取相机格式*/
 		Image_type = ASICameraInfo.SupportedVideoFormat[7];
+		/*原始格式的彩色相机输出拜耳阵列数据*/
+		BayerPattern = "";
+		if(isColorCamera == true && (Image_type == ASI_IMG_RAW8 || Image_type == ASI_IMG_RAW16))
+		{
+			static const char *Patterns[] = {"RGGB","BGGR","GRBG","GBRG"};		//与ASI_BAYER_PATTERN顺序一致
+			if(ASICameraInfo.BayerPattern >= ASI_BAYER_RG && ASICameraInfo.BayerPattern <= ASI_BAYER_GB)
+				BayerPattern = Patterns[ASICameraInfo.BayerPattern];
+		}
 		/*获取相机最大画幅*/
 		iMaxWidth = ASICameraInfo.MaxWidth;
 		iMaxHeight = ASICameraInfo.MaxHeight;
@@ -220,80 +285,41 @@ namespace AstroAir
 		return true;
     }
     
-	bool ASICCD::Cooling(bool SetPoint,bool CoolDown,bool ASync,bool Warmup,bool CoolerOFF)
+	/*
+	 * name: ReadCooler(double &Temperature,double &Power)
+	 * @param Temperature:传感器温度(°C)
+	 * @param Power:制冷功率(%)
+	 * describe: Read the sensor temperature and cooler power
+	 * 描述：读取传感器温度与制冷功率
+	 * note: Called on the cooling thread,the SDK allows reading controls during an exposure
+	 */
+	bool ASICCD::ReadCooler(double &Temperature,double &Power)
 	{
-		return true;
-	}
-	
-    /*
-     * name: SetTemperature(double temperature)
-     * describe: Set camera cooling temperature
-     * 描述：设置相机制冷温度
-     * @param temperature: 目标温度
-     * @return ture: 成功设置温度
-     * @return false：无法设置温度
-     * calls: ActiveCool()
-     * calls: ASISetControlValue()
-     * calls: IDLog()
-     * note: The temperature of the camera is unlimited. Please pay attention to the limit
-     */
-    bool ASICCD::SetTemperature(double temperature)
-    {
-		/*判断输入温度是否合理*/
-		if(temperature < -50 ||temperature > 40)
-		{
-			IDLog("The temperature setting is unreasonable, please reset it.\n");
+		long value = 0;
+		ASI_BOOL isAuto = ASI_FALSE;
+		if(ASIGetControlValue(CamId,ASI_TEMPERATURE,&value,&isAuto) != ASI_SUCCESS)
 			return false;
-		}
-		/*检查是否可以制冷*/
-		if(ActiveCool(true) == false)
-		{
-			IDLog("Unable to start camera cooling, please check the power connection.\n");
-			return false;
-		}
-		/*转化温度参数*/
-		long TargetTemp;
-		if (temperature > 0.5)
-			TargetTemp = static_cast<long>(temperature + 0.49);
-		else if (temperature  < 0.5)
-			TargetTemp = static_cast<long>(temperature - 0.49);
-		else
-			TargetTemp = 0;
-		/*设置相机温度*/
-		if((errCode = ASISetControlValue(CamId,ASI_TEMPERATURE,TargetTemp,ASI_FALSE)) != ASI_SUCCESS)
-		{
-			IDLog("Unable to set camera temperature,error code is %d.\n",errCode);
+		Temperature = value / 10.0;
+		if(ASIGetControlValue(CamId,ASI_COOLER_POWER_PERC,&value,&isAuto) != ASI_SUCCESS)
 			return false;
-		}
-		TemperatureRequest = temperature;
-		IDLog("Camera cooling temperature set successfully.\n");
-		return true;
-    }
-    
-    /*
-     * name: ActiveCool(bool enable)
-     * describe: Start camera cooling
-     * 描述：启动相机制冷
-     * @param enable: 制冷状态
-     * @return ture: 成功开启制冷
-     * @return false：无法开启制冷
-     * calls: ASISetControlValue()
-     * calls: IDLog()
-     */
-    bool ASICCD::ActiveCool(bool enable)
-    {
-		if(isCoolCamera == true)
-		{
-			if((errCode = ASISetControlValue(CamId,ASI_COOLER_ON,enable ? ASI_TRUE : ASI_FALSE,ASI_FALSE)) != ASI_SUCCESS)
-			{
-				IDLog("Unable to turn on refrigeration,error code is %d,please check the power supply.\n",errCode);
-				return false;
-			}
-			InCooling = true;
-			IDLog("Cooling is in progress. Please wait.\n");
-		}
+		Power = value;
 		return true;
-    }
+	}
+
+	/*
+	 * name: WriteCooler(bool Enable,double SetPoint)
+	 * @param Enable:打开或关闭制冷
+	 * @param SetPoint:设定温度(°C)
+	 * describe: Switch the cooler and write the target temperature
+	 * 描述：开关制冷并写入目标温度
+	 * note: ASI_TARGET_TEMP takes whole degrees
+	 */
+	bool ASICCD::WriteCooler(bool Enable,double SetPoint)
+	{
+		if(Enable == true && ASISetControlValue(CamId,ASI_TARGET_TEMP,std::lround(SetPoint),ASI_FALSE) != ASI_SUCCESS)
+			return false;
+		return ASISetControlValue(CamId,ASI_COOLER_ON,Enable ? ASI_TRUE : ASI_FALSE,ASI_FALSE) == ASI_SUCCESS;
+	}
     
     /*
      * name: StartExposure(int exp,int bin,bool IsSave,std::string FitsName,int Gain,int Offset)
@@ -310,14 +336,18 @@ namespace AstroAir
      * calls: IDLog()
      * calls: ASIStartExposure()
      * calls: ASIGetExpStatus()
+     * calls: EXPOSURE::Submit()
+     * note: SDK calls run under the watchdog,a camera that stops responding fails the exposure instead of hanging the server
      */
     bool ASICCD::StartExposure(int exp,int bin,bool IsSave,std::string FitsName,int Gain,int Offset)
     {
 		std::unique_lock<std::mutex> guard(condMutex);
+		/*曝光与下载中的等待都可以被AbortExposure()立即结束*/
+		CaptureScope capture(this);
 		const long blink_duration = exp * 1000000;
 		CamBin = bin;
 		IDLog("Blinking %ld time(s) before exposure\n", blink_duration);
-		if((errCode = ASISetControlValue(CamId, ASI_EXPOSURE, blink_duration, ASI_FALSE)) != ASI_SUCCESS)
+		if(Controls.Apply(ASI_EXPOSURE,blink_duration,[this](double Value) { return (errCode = ASISetControlValue(CamId, ASI_EXPOSURE, (long)Value, ASI_FALSE)) == ASI_SUCCESS; }) == false)
 		{
 			IDLog("Failed to set blink exposure to %ldus, error %d\n", blink_duration, errCode);
 			return false;
@@ -331,7 +361,16 @@ namespace AstroAir
 			}
 			else
 			{
-				if((errCode = ASIStartExposure(CamId, ASI_FALSE)) != ASI_SUCCESS)
+				const int id = CamId;
+				InExposure = true;
+				const int64_t exposureStart = MonotonicNs();
+				if(SDK.Call<ASI_ERROR_CODE>("ASIStartExposure",SDK_TIMEOUT,[id]() { return ASIStartExposure(id, ASI_FALSE); },errCode,capture.Stop) == false)
+				{
+					IDLog("ASIStartExposure is not responding\n");
+					AbortExposure();
+					return false;
+				}
+				if(errCode != ASI_SUCCESS)
 				{
 					IDLog("Failed to start blink exposure, error %d,try it again\n", errCode);
 					AbortExposure();
@@ -339,20 +378,32 @@ namespace AstroAir
 				}
 				else
 				{
-					InExposure = true;
-					do
+					/*曝光期间不占用线程，由曝光引擎在预计结束时查询状态*/
+					auto status = std::make_shared<ASI_EXPOSURE_STATUS>(ASI_EXP_WORKING);
+					bool ok = EXPOSURE::Wait(ASICameraInfo.Name,exp * 1000,[this,id,status](int &Remaining)
+					{
+						ASI_ERROR_CODE ret;
+						if(SDK.Call<ASI_ERROR_CODE>("ASIGetExpStatus",SDK_TIMEOUT,[id,status]() { return ASIGetExpStatus(id, status.get()); },ret) == false || ret != ASI_SUCCESS)
+							return EXPOSURE::EXPOSURE_FAILED;
+						if(*status == ASI_EXP_WORKING)
+							return EXPOSURE::EXPOSURE_WORKING;
+						return *status == ASI_EXP_SUCCESS ? EXPOSURE::EXPOSURE_DONE : EXPOSURE::EXPOSURE_FAILED;
+					},capture.Stop);
+					expStatus = *status;
+					if(capture.Stop.stop_requested())
 					{
-						usleep(10000);
-						errCode = ASIGetExpStatus(CamId, &expStatus);
-						
+						IDLog("Exposure aborted\n");
+						InExposure = false;
+						return false;
 					}
-					while (errCode == ASI_SUCCESS && expStatus == ASI_EXP_WORKING);
-					if (errCode != ASI_SUCCESS)
+					if (ok == false)
 					{
-						IDLog("Blink exposure failed, error %d, status %d\n", errCode, expStatus);
+						IDLog("Blink exposure failed, status %d\n", expStatus);
 						AbortExposure();
 						return false;
 					}
+					/*SDK不报告实际曝光时间，使用设定值*/
+					capture.Exposure(exposureStart,exposureStart + (int64_t)exp * 1000000000);
 					InExposure = false;
                 }
             }
@@ -380,10 +431,10 @@ namespace AstroAir
      * 描述：停止相机曝光
      * @return ture: 成功停止曝光
      * @return false：无法停止曝光
-     * calls: setThreadRequest()
-     * calls: waitUntil()
      * calls: ASIStopExposure()
+     * calls: CancelCapture()
      * calls: IDLog()
+     * note: Returns after the capture thread has left,the exposure engine and the SDK thread are not waited for
      */
     bool ASICCD::AbortExposure()
     {
@@ -393,8 +444,99 @@ namespace AstroAir
 			IDLog("Unable to stop camera exposure,error id is %d,please try again.\n",errCode);
 			return false;
 		}
+		/*正在等待的曝光与下载立即结束*/
+		bool ok = CancelCapture();
 		InExposure = false;
-		return true;
+		return ok;
+    }
+
+    /*
+     * name: StartVideo(int exp,int bin,int Gain,int Offset)
+     * @param exp:单帧曝光时间(毫秒)
+     * @param bin:像素合并模式
+     * @param Gain:相机增益
+     * @param Offset:相机偏置
+     * describe: Start streaming video
+     * 描述：开始视频采集
+     * calls: ASISetControlValue()
+     * calls: SetCameraConfig()
+     * calls: ASIStartVideoCapture()
+     * calls: ASIGetVideoData()
+     * note: ASIGetVideoData runs on the capture thread directly,its own wait time bounds the call
+     */
+    bool ASICCD::StartVideo(int exp,int bin,int Gain,int Offset)
+    {
+		std::unique_lock<std::mutex> guard(condMutex);
+		if(InExposure == true || InVideo == true)
+		{
+			IDLog("Camera is busy,can not start video\n");
+			return false;
+		}
+		if(Controls.Apply(ASI_EXPOSURE,exp * 1000,[this](double Value) { return (errCode = ASISetControlValue(CamId, ASI_EXPOSURE, (long)Value, ASI_FALSE)) == ASI_SUCCESS; }) == false)
+		{
+			IDLog("Failed to set video exposure to %dms, error %d\n", exp, errCode);
+			return false;
+		}
+		if(SetCameraConfig(bin,Gain,Offset) != true)
+		{
+			IDLog("Failed to set camera configure\n");
+			return false;
+		}
+		const int id = CamId;
+		if(SDK.Call<ASI_ERROR_CODE>("ASIStartVideoCapture",SDK_TIMEOUT,[id]() { return ASIStartVideoCapture(id); },errCode) == false || errCode != ASI_SUCCESS)
+		{
+			IDLog("Unable to start video capture,error %d\n",errCode);
+			return false;
+		}
+		const FRAMEHEADER Layout = FrameLayout();
+		/*等待时间取两倍曝光时间加500毫秒，与SDK示例一致*/
+		const int wait = exp * 2 + 500;
+		InVideo = true;
+		bool ok = Video.Start(Layout.Size,[id,Layout,wait,sampleNs = int64_t(0)](unsigned char *Buffer,FRAMEHEADER &Header) mutable
+		{
+			if(ASIGetVideoData(id,Buffer,Layout.Size,wait) != ASI_SUCCESS)
+				return false;
+			Header = Layout;
+			Header.MonotonicNs = MonotonicNs();
+			Header.UtcNs = UtcNs();
+			/*每秒读取一次SDK丢帧数，USB带宽不足时该值持续增长*/
+			if(Header.MonotonicNs - sampleNs >= 1000000000)
+			{
+				int dropped = 0;
+				if(ASIGetDroppedFrames(id,&dropped) == ASI_SUCCESS)
+					METRICS::Set("video.sdk_dropped.ZWOASI",dropped);
+				sampleNs = Header.MonotonicNs;
+			}
+			return true;
+		},[this](const FRAMEHEADER &Header,const unsigned char *Data) { VideoFrame(Header,Data); });
+		if(ok == false)
+		{
+			ASIStopVideoCapture(id);
+			InVideo = false;
+		}
+		return ok;
+    }
+
+    /*
+     * name: StopVideo()
+     * describe: Stop streaming video
+     * 描述：停止视频采集
+     * calls: ASIStopVideoCapture()
+     * calls: ASIGetDroppedFrames()
+     */
+    bool ASICCD::StopVideo()
+    {
+		if(InVideo == false)
+			return true;
+		Video.Stop();
+		StopRecord();
+		int dropped = 0;
+		if(ASIGetDroppedFrames(CamId,&dropped) == ASI_SUCCESS)
+			METRICS::Set("video.sdk_dropped.ZWOASI",dropped);
+		if((errCode = ASIStopVideoCapture(CamId)) != ASI_SUCCESS)
+			IDLog("Unable to stop video capture,error %d\n",errCode);
+		InVideo = false;
+		return errCode == ASI_SUCCESS;
     }
     
     /*
@@ -404,26 +546,160 @@ namespace AstroAir
      * calls: IDLog()
      * calls: ASISetControlValue()
      * calls: ASISetROIFormat()
+     * calls: ASISetStartPos()
+     * note: Called before every exposure,only the values that changed since the last call reach the SDK
      */
     bool ASICCD::SetCameraConfig(long Bin,long Gain,long Offset)
     {
-		if((errCode = ASISetControlValue(CamId, ASI_GAIN, Gain, ASI_FALSE)) != ASI_SUCCESS)
+		if(Controls.Apply(ASI_GAIN,Gain,[this](double Value) { return (errCode = ASISetControlValue(CamId, ASI_GAIN, (long)Value, ASI_FALSE)) == ASI_SUCCESS; }) == false)
 		{
 			IDLog("Unable to set camera gain,error code is %d\n",errCode);
 			return false;
 		}
-		if((errCode = ASISetControlValue(CamId, ASI_BRIGHTNESS, Offset, ASI_FALSE)) != ASI_SUCCESS)
+		if(Controls.Apply(ASI_BRIGHTNESS,Offset,[this](double Value) { return (errCode = ASISetControlValue(CamId, ASI_BRIGHTNESS, (long)Value, ASI_FALSE)) == ASI_SUCCESS; }) == false)
 		{
 			IDLog("Unable to set camera offset,error code is %d\n",errCode);
 			return false;
 		}
-		CamWidth = iMaxWidth/Bin;
-		CamHeight = iMaxHeight/Bin;
-		if((errCode = ASISetROIFormat(CamId, CamWidth , CamHeight , Bin, (ASI_IMG_TYPE)Image_type)) != ASI_SUCCESS)
+		std::unique_lock<std::mutex> lock(stateLock);
+		/*ASI要求画面宽度为8的倍数，高度为2的倍数，子画面超出传感器时截断*/
+		const int fullWidth = iMaxWidth/Bin,fullHeight = iMaxHeight/Bin;
+		int StartX = 0,StartY = 0;
+		CamWidth = fullWidth;
+		CamHeight = fullHeight;
+		if(RoiWidth > 0 && RoiHeight > 0)
 		{
-			IDLog("Unable to set camera offset,error code is %d\n",errCode);
+			StartX = std::clamp(RoiX,0,fullWidth - 8);
+			StartY = std::clamp(RoiY,0,fullHeight - 2);
+			CamWidth = std::max(8,std::min(RoiWidth,fullWidth - StartX) / 8 * 8);
+			CamHeight = std::max(2,std::min(RoiHeight,fullHeight - StartY) / 2 * 2);
+		}
+		lock.unlock();
+		/*画面格式变化可能导致传感器重新初始化，不变时不再设置*/
+		if(Controls.Apply(CONTROL_CACHE_FORMAT,{(double)CamWidth,(double)CamHeight,(double)Bin,(double)Image_type},[this](const std::vector<double> &Values)
+		{
+			if((errCode = ASISetROIFormat(CamId, Values[0], Values[1], Values[2], (ASI_IMG_TYPE)Values[3])) != ASI_SUCCESS)
+				return false;
+			/*设置画面大小后SDK会将子画面居中，需要重新设置起点*/
+			Controls.Invalidate(CONTROL_CACHE_START);
+			return true;
+		}) == false)
+		{
+			IDLog("Unable to set camera frame size,error code is %d\n",errCode);
+			return false;
+		}
+		if(Controls.Apply(CONTROL_CACHE_START,{(double)StartX,(double)StartY},[this](const std::vector<double> &Values) { return (errCode = ASISetStartPos(CamId, Values[0], Values[1])) == ASI_SUCCESS; }) == false)
+		{
+			IDLog("Unable to set subframe start position,error code is %d\n",errCode);
+			return false;
+		}
+		lock.lock();
+		CamState.Bin = Bin;
+		CamState.Gain = Gain;
+		CamState.Offset = Offset;
+		CamState.StartX = StartX;
+		CamState.StartY = StartY;
+		CamState.Width = CamWidth;
+		CamState.Height = CamHeight;
+		return true;
+    }
+
+    /*
+     * name: SetROI(int StartX,int StartY,int Width,int Height)
+     * @param StartX:子画面左上角X坐标(合并后像素)
+     * @param StartY:子画面左上角Y坐标(合并后像素)
+     * @param Width:子画面宽度，为0时拍摄全画面
+     * @param Height:子画面高度，为0时拍摄全画面
+     * describe: Download only a part of the sensor
+     * 描述：只下载传感器的一部分
+     * calls: SetCameraConfig()
+     * note: The width is rounded down to a multiple of 8 and the height to a multiple of 2
+     */
+    bool ASICCD::SetROI(int StartX,int StartY,int Width,int Height)
+    {
+		if(StartX < 0 || StartY < 0 || Width < 0 || Height < 0)
+			return false;
+		DeviceState state;
+		{
+			std::lock_guard<std::mutex> lock(stateLock);
+			RoiX = StartX;
+			RoiY = StartY;
+			RoiWidth = Width;
+			RoiHeight = Height;
+			state = CamState;
+		}
+		/*正在曝光或视频采集时，在下一次设置参数时生效*/
+		if(isConnected == false || InExposure == true || InVideo == true)
+			return true;
+		std::lock_guard<std::mutex> guard(condMutex);
+		return SetCameraConfig(state.Bin > 0 ? state.Bin : 1,state.Gain,state.Offset);
+    }
+
+    /*
+     * name: QuickConnect(const DeviceState &state)
+     * @param state:上次保存的相机状态
+     * describe: Open the camera by the saved ID
+     * 描述：使用保存的相机ID直接打开相机，跳过逐个查询相机信息
+     * calls: ASIGetNumOfConnectedCameras()
+     * calls: OpenCamera()
+     * calls: Connect()
+     * note: If the camera has been replugged its ID may change, then fall back to Connect()
+     */
+    bool ASICCD::QuickConnect(const DeviceState &state)
+    {
+		/*SDK要求打开相机之前至少调用一次*/
+		if((CamNumber = ASIGetNumOfConnectedCameras()) <= 0)
+		{
+			IDLog("ASI camera not found, please check the power supply or make sure the camera is connected.\n");
 			return false;
 		}
+		if(OpenCamera(state.Index,state.Name) == true)
+			return true;
+		IDLog("Unable to open %s by saved ID %d,search it again.\n",state.Name.c_str(),state.Index);
+		return Connect(state.Name);
+    }
+
+    /*
+     * name: RestoreState(const DeviceState &state)
+     * @param state:上次保存的相机状态
+     * describe: Restore bin,gain,offset,subframe and cooling of the camera
+     * 描述：恢复相机像素合并、增益、偏置、子画面与制冷设置
+     * calls: SetCameraConfig()
+     * calls: RestoreCooler()
+     */
+    bool ASICCD::RestoreState(const DeviceState &state)
+    {
+		const int bin = state.Bin > 0 ? state.Bin : 1;
+		{
+			/*快照中总是记录画面大小，只有比全画面小时才是子画面*/
+			std::lock_guard<std::mutex> lock(stateLock);
+			bool subframe = state.Width > 0 && (state.StartX > 0 || state.StartY > 0 || state.Width < iMaxWidth/bin || state.Height < iMaxHeight/bin);
+			RoiX = subframe ? state.StartX : 0;
+			RoiY = subframe ? state.StartY : 0;
+			RoiWidth = subframe ? state.Width : 0;
+			RoiHeight = subframe ? state.Height : 0;
+		}
+		if(SetCameraConfig(bin,state.Gain,state.Offset) != true)
+			return false;
+		CamBin = state.Bin;
+		return RestoreCooler(state);
+    }
+
+    /*
+     * name: GetState(DeviceState &state)
+     * @param state:相机当前状态
+     * describe: Get the current state of the camera
+     * 描述：获取相机当前状态
+     */
+    bool ASICCD::GetState(DeviceState &state)
+    {
+		if(isConnected == false)
+			return false;
+		{
+			std::lock_guard<std::mutex> lock(stateLock);
+			state = CamState;
+		}
+		FillCoolerState(state);
 		return true;
     }
 
@@ -432,26 +708,28 @@ namespace AstroAir
      * describe: Save images
      * 描述：存储图像
      * calls: ASIGetDataAfterExp()
-     * calls: fits_create_file()
-     * calls: fits_create_img()
-     * calls: fits_update_key()
-     * calls: fits_write_img()
-     * calls: fits_close_file()
-     * calls: fits_report_error()
-	 * calls: SaveImage()
-	 * calls: SaveFitsImage()
-	 * calls: clacHistogram()
+     * calls: SubmitFrame()
      */
     bool ASICCD::SaveImage(std::string FitsName)
     {
 		if(InExposure == false && InVideo == false)
 		{	
 			std::unique_lock<std::mutex> guard(ccdBufferLock);
-			long imgSize = CamWidth*CamHeight*(1 + (Image_type==ASI_IMG_RAW16));		//设置图像大小
-			unsigned char * imgBuf = new unsigned char[imgSize];		//图像缓冲区大小
-			long naxis = 2;
+			FRAMEHEADER frame = FrameLayout();
+			long imgSize = frame.Size;		//设置图像大小
+			/*缓冲区由下载任务共同持有，下载超时后SDK仍可安全写入*/
+			FRAMEBUFFER buffer = Frames.Acquire(imgSize);
+			if(buffer == nullptr)
+				return false;
+			const int id = CamId;
+			const int64_t downloadStart = MonotonicNs();
 			/*曝光后获取图像信息*/
-			if ((errCode = ASIGetDataAfterExp(CamId, imgBuf, imgSize)) != ASI_SUCCESS)
+			if(SDK.Call<ASI_ERROR_CODE>("ASIGetDataAfterExp",SDK_DOWNLOAD_TIMEOUT,[id,buffer,imgSize]() { return ASIGetDataAfterExp(id, buffer.get(), imgSize); },errCode,CaptureToken()) == false)
+			{
+				IDLog("Image download timed out or was aborted\n");
+				return false;
+			}
+			if (errCode != ASI_SUCCESS)
 			{
 				/*获取图像失败*/
 				IDLog("ASIGetDataAfterExp error (%d)\n",errCode);
@@ -459,50 +737,72 @@ namespace AstroAir
 			}
 			guard.unlock();
 			IDLog("Download complete.\n");
-			/*将图像写入本地文件*/
-			#if(HAS_FITSIO==ON)
-				char datatype[40];		//相机品牌
-				char keywords[40];		//相机品牌
-				char value[20];		//相机名称
-				char description[40];		//相机描述
-				strcpy(datatype, "TSTRING");
-				strcpy(keywords, "Camera");
-				strcpy(value,CamName[CamId]);
-				strcpy(description,"ZWOASI");
-
-				fitsfile *fptr;		//cFitsIO定义
-				int FitsStatus;		//cFitsio状态
-				long naxes[2] = {CamWidth,CamHeight};
-				long nelements;
-				long fpixel = 1;
-
-				fits_create_file(&fptr, FitsName.c_str(), &FitsStatus);		//创建Fits文件
-				if(Image_type == 1)		//创建Fits图像
-					fits_create_img(fptr, USHORT_IMG, naxis, naxes, &FitsStatus);		//16位
-				else
-					fits_create_img(fptr, BYTE_IMG,   naxis, naxes, &FitsStatus);		//8位或12位
-				if(strcmp(datatype, "TSTRING") == 0)		//写入Fits图像头文件
-				{
-					fits_update_key(fptr, TSTRING, keywords, value, description, &FitsStatus);
-				}
-				if(Image_type == 1)		//将缓存图像写入SD卡
-					fits_write_img(fptr, TUSHORT, fpixel, imgSize, &imgBuf[0], &FitsStatus);		//16位
-				else
-					fits_write_img(fptr, TBYTE, fpixel, imgSize, &imgBuf[0], &FitsStatus);		//8位或12位
-				fits_close_file(fptr, &FitsStatus);		//关闭Fits图像
-				fits_report_error(stderr, FitsStatus);		//如果有错则返回错误信息
-			#endif
-			#if(HAS_OPENCV==ON)
-				OPENCV::SaveImage(imgBuf,FitsName,isColorCamera,CamHeight,CamWidth);
-				OPENCV::clacHistogram(imgBuf,isColorCamera,CamHeight,CamWidth);
-			#endif
-			if(imgBuf)
-				delete[] imgBuf;		//删除图像缓存
+			frame.MonotonicNs = MonotonicNs();
+			frame.UtcNs = UtcNs();
+			RecordDownload(imgSize,downloadStart,frame.MonotonicNs);
+			/*交给流水线保存，缓冲区在所有阶段处理完后归还*/
+			SubmitFrame(frame,buffer,FitsName,CamName[CamId]);
 		}
 		return true;
 	}
-}
 
+	/*
+	 * name: LoadControlCaps()
+	 * describe: Read the range of every writable control once
+	 * 描述：读取所有可写控制项的取值范围
+	 * calls: ASIGetNumOfControls()
+	 * calls: ASIGetControlCaps()
+	 * note: Values out of range are refused by the cache without calling the SDK
+	 */
+	void ASICCD::LoadControlCaps()
+	{
+		Controls.Clear();
+		int count = 0;
+		if((errCode = ASIGetNumOfControls(CamId,&count)) != ASI_SUCCESS)
+		{
+			IDLog("Unable to get controls of the camera,error code is %d\n",errCode);
+			return;
+		}
+		for(int i = 0;i < count;i++)
+		{
+			ASI_CONTROL_CAPS caps;
+			if(ASIGetControlCaps(CamId,i,&caps) != ASI_SUCCESS || caps.IsWritable == ASI_FALSE)
+				continue;
+			Controls.SetRange(caps.ControlType,caps.Name,caps.MinValue,caps.MaxValue,0);
+		}
+	}
 
+	/*
+	 * name: FrameLayout()
+	 * describe: Size and pixel format of a frame in the current image type
+	 * 描述：当前图像格式下的帧大小与像素格式
+	 * note: RGB24 is 8 bit with three interleaved channels,RAW16 is 16 bit mono or bayer
+	 */
+	FRAMEHEADER ASICCD::FrameLayout()
+	{
+		FRAMEHEADER Layout;
+		Layout.Width = CamWidth;
+		Layout.Height = CamHeight;
+		Layout.BitDepth = Image_type == ASI_IMG_RAW16 ? 16 : 8;
+		Layout.Channels = Image_type == ASI_IMG_RGB24 ? 3 : 1;
+		Layout.Size = (uint64_t)CamWidth * CamHeight * Layout.Channels * (Layout.BitDepth / 8);
+		return Layout;
+	}
+}
 
+#ifdef HAS_PLUGIN
+/*插件入口*/
+extern "C"
+{
+	/*SDK在第一次查询相机数量时完成初始化与USB枚举*/
+	bool AirInitSDK()
+	{
+		return ASIGetNumOfConnectedCameras() >= 0;
+	}
 
+	AstroAir::WSSERVER *AirCreateDevice()
+	{
+		return new AstroAir::ASICCD();
+	}
+}
+#endif
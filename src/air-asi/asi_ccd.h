@@ -36,12 +36,17 @@ Description:ZWO camera driver
 #ifndef _ASICCD_H_
 #define _ASICCD_H_
 
-#include "../wsserver.h"
+#include "../camera.h"
+#include "../watchdog.h"
+#include "../exposure.h"
+#include "../video.h"
+#include "../controls.h"
 #include "../libasi/ASICamera2.h"
 
 #include <mutex>
 #include <thread>
 #include <atomic>
+#include <future>
 #include <vector>
 #include <string.h>
 //#include <fitsio.h>
@@ -50,7 +55,7 @@ Description:ZWO camera driver
 
 namespace AstroAir
 {
-	class ASICCD: public WSSERVER
+	class ASICCD: public CAMERA
 	{
 		public:
 			/*构造函数，重置参数*/
@@ -63,24 +68,48 @@ namespace AstroAir
 			virtual bool Disconnect() override;
 			/*更新相机配置信息*/
 			virtual bool UpdateCameraConfig();
-			/*设置相机制冷温度*/
-			virtual bool SetTemperature(double temperature);
 			/*开始曝光*/
 			virtual bool StartExposure(int exp,int bin,bool IsSave,std::string FitsName,int Gain,int Offset) override;
 			/*停止曝光*/
 			virtual bool AbortExposure() override;
+			/*视频采集*/
+			virtual bool StartVideo(int exp,int bin,int Gain,int Offset) override;
+			virtual bool StopVideo() override;
+			/*设置子画面*/
+			virtual bool SetROI(int StartX,int StartY,int Width,int Height) override;
 			/*设置相机参数*/
 			virtual bool SetCameraConfig(long Bin,long Gain,long Offset);
 			/*存储图像*/
 			virtual bool SaveImage(std::string FitsName);
-			/*制冷*/
-			virtual bool Cooling(bool SetPoint,bool CoolDown,bool ASync,bool Warmup,bool CoolerOFF) override;
+			/*使用快照快速连接相机*/
+			virtual bool QuickConnect(const DeviceState &state) override;
+			/*恢复相机设置*/
+			virtual bool RestoreState(const DeviceState &state) override;
+			/*获取相机当前状态*/
+			virtual bool GetState(DeviceState &state) override;
+		protected:
+			/*制冷控制线程读写制冷*/
+			virtual bool ReadCooler(double &Temperature,double &Power) override;
+			virtual bool WriteCooler(bool Enable,double SetPoint) override;
 		private:
-			/*打开制冷*/
-			virtual bool ActiveCool(bool enable);
+			/*使用相机ID打开相机*/
+			bool OpenCamera(int Id,std::string Device_name);
+			/*当前图像格式下的帧信息*/
+			FRAMEHEADER FrameLayout();
+			/*读取各控制项的取值范围*/
+			void LoadControlCaps();
 
 			std::mutex condMutex;
 			std::mutex ccdBufferLock;
+			std::mutex stateLock;
+			/*相机当前状态，用于快照*/
+			DeviceState CamState;
+			/*SDK调用看门狗*/
+			SDKEXECUTOR SDK{"ZWOASI"};
+			/*视频采集线程*/
+			VIDEOCAPTURE Video{"ZWOASI"};
+			/*已写入相机的控制项*/
+			CONTROLCACHE Controls{"ZWOASI"};
 			/*基础参数*/
 			int CamNumber;
 			int CamId;
@@ -88,13 +117,17 @@ namespace AstroAir
 			int CamBin;
 			
 			double ExposureRequest;
-			double TemperatureRequest;
 			/*相机配置参数*/
 			int Image_type = 0;
 			int CamWidth = 0;
 			int CamHeight = 0;
 			int iMaxWidth = 0;		//最大高度
 			int iMaxHeight = 0;		//最大宽度
+			/*子画面，以合并后的像素为单位，宽高为0时拍摄全画面，由stateLock保护*/
+			int RoiX = 0;
+			int RoiY = 0;
+			int RoiWidth = 0;
+			int RoiHeight = 0;
 			bool isCoolCamera = false;
 			bool isColorCamera = false;
 			bool isGuideCamera = false;
@@ -110,7 +143,6 @@ namespace AstroAir
 			std::atomic_bool isConnected;
 			std::atomic_bool InExposure;
 			std::atomic_bool InVideo;
-			std::atomic_bool InCooling;
 			
 			/*ASI相机参数*/
 			ASI_CAMERA_INFO ASICameraInfo;
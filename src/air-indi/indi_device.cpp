@@ -57,4 +57,20 @@ namespace AstroAir
     {
         return true;
     }
-}
\ No newline at end of file
+}
+
+#ifdef HAS_PLUGIN
+/*插件入口*/
+extern "C"
+{
+    bool AirInitSDK()
+    {
+        return true;
+    }
+
+    AstroAir::WSSERVER *AirCreateDevice()
+    {
+        return new AstroAir::INDICCD();
+    }
+}
+#endif
@@ -33,25 +33,76 @@ Description:QHY camera driver
 
 #include "qhy_ccd.h"
 #include "../logger.h"
-#include "../opencv.h"
+#include "../discovery.h"
+#include "../metrics.h"
+#include "../membudget.h"
+#include "../airconfig.h"
 
-#include <fitsio.h>
+#include <algorithm>
+#include <thread>
 
 namespace AstroAir
 {
+	/*SDK初始化状态，所有QHY相机共用*/
+	static std::mutex SDKLock;
+	static bool SDKReady = false;
+
+	/*
+     * name: InitSDK()
+     * describe: Initialize the QHY SDK once
+     * 描述：初始化QHY SDK，已初始化时直接返回
+     * calls: InitQHYCCDResource()
+     * note: The plugin calls this in a background thread as soon as a profile names QHYCCD
+     */
+	bool QHYCCD::InitSDK()
+	{
+		std::lock_guard<std::mutex> guard(SDKLock);
+		if(SDKReady == true)
+			return true;
+		unsigned int ret;
+		if((ret = InitQHYCCDResource()) != QHYCCD_SUCCESS)
+		{
+			IDLog("Unable to initialize SDK settings,error code is %d please check system settings\n",ret);
+			return false;
+		}
+		SDKReady = true;
+		IDLog("Init SDK successfully!\n");
+		return true;
+	}
+
+	/*
+     * name: ReleaseSDK()
+     * describe: Release the QHY SDK
+     * 描述：释放QHY SDK资源
+     * calls: ReleaseQHYCCDResource()
+     */
+	void QHYCCD::ReleaseSDK()
+	{
+		std::lock_guard<std::mutex> guard(SDKLock);
+		if(SDKReady == false)
+			return;
+		unsigned int ret;
+		if ((ret = ReleaseQHYCCDResource()) != QHYCCD_SUCCESS)
+			IDLog("Cannot release SDK resources, error %d.\n", ret);
+		else
+			IDLog("SDK resources released.\n");
+		SDKReady = false;
+	}
+
 	/*
      * name: QHYCCD()
      * describe: Initialization, for camera constructor
      * 描述：构造函数，用于初始化相机参数
      */
-	QHYCCD::QHYCCD()
+	QHYCCD::QHYCCD() : CAMERA("QHYCCD")
 	{
 		CamNumber = 0;
 		CamBin = 0;
 		isConnected = false;
 		InVideo = false;
 		InExposure = false;
-		InCooling = false;
+		/*SDK卡死与恢复交给服务器处理*/
+		SDK.SetStallHandler([this](std::string Func,bool Stalled) { DeviceFault(Func,Stalled); });
 	}
 	
 	/*
@@ -69,115 +120,279 @@ namespace AstroAir
 		}
 	}
 	
+	/*
+     * name: ScanCameras()
+     * describe: Discovery backend,list all connected QHY cameras
+     * 描述：设备扫描后端，列出所有已连接的QHY相机
+     * calls: InitSDK()
+     * calls: ScanQHYCCD()
+     * calls: GetQHYCCDId()
+     * note: The name of a QHY camera is the part of its ID before '-'
+     */
+	static std::vector<DeviceInfo> ScanCameras()
+	{
+		std::vector<DeviceInfo> devices;
+		if(QHYCCD::InitSDK() != true)
+			return devices;
+		int number = ScanQHYCCD();
+		for(int i = 0;i < number;i++)
+		{
+			char id[32] = {0};
+			if(GetQHYCCDId(i, id) != QHYCCD_SUCCESS)
+				continue;
+			DeviceInfo device;
+			device.Brand = "QHYCCD";
+			device.Id = id;
+			device.Index = i;
+			device.Name = device.Id.substr(0,device.Id.find('-'));
+			devices.push_back(device);
+		}
+		return devices;
+	}
+
+	/*驱动加载时注册扫描后端，0x1618为QHY的USB厂商ID*/
+	static const bool ScannerRegistered = (DISCOVERY::RegisterBackend("QHYCCD",ScanCameras,0x1618),true);
+
 	/*
      * name: Connect(std::string Device_name)
      * @param Device_name:连接相机名称
      * describe: Connect the camera
      * 描述： 连接相机
-     * calls: InitQHYCCDResource()
-     * calls: ScanQHYCCD()
-     * calls: GetQHYCCDId()
-     * calls: OpenQHYCCD()
-     * calls: InitQHYCCD()
-     * calls: UpdateCameraConfig()
+     * calls: InitSDK()
+     * calls: DISCOVERY::Find()
+     * calls: DISCOVERY::ScanNow()
+     * calls: OpenCamera()
      * calls: IDLog()
      * @return true: Camera connected successfully
      * @return false: Failed to connect camera
-     * note: Do not connect the camera repeatedly
+     * note: The camera ID comes from the discovery cache,the bus is only scanned when the camera is not in it
      */
 	bool QHYCCD::Connect(std::string Device_name)
 	{
 		/*初始化SDK*/
-		if((retVal = InitQHYCCDResource()) != QHYCCD_SUCCESS)
-		{
-			IDLog("Unable to initialize SDK settings,error code is %d please check system settings\n",retVal);
+		if(InitSDK() != true)
 			return false;
-		}
-		else
+		DeviceInfo info;
+		if(DISCOVERY::Find("QHYCCD",Device_name,info) == false)
 		{
-			IDLog("Init SDK successfully!\n");
-			/*搜索QHY相机数量*/
-			if((CamNumber = ScanQHYCCD()) <= 0)
-			{
-				IDLog("QHY camera not found, please check the power supply or make sure the camera is connected.\n");
-				return false;
-			}
-			else
+			/*缓存中没有该相机，立即扫描一次*/
+			DISCOVERY::ScanNow("QHYCCD");
+			if(DISCOVERY::Find("QHYCCD",Device_name,info) == false)
 			{
-				/*根据相机数量依次搜索*/
-				for(int i = 0;i < CamNumber;i++)
-				{
-					/*获取相机ID*/
-					if((GetQHYCCDId(i, iCamId)) != QHYCCD_SUCCESS)
-					{
-						IDLog("Unable to get camera ID, please check connection\n");
-						return false;
-					}
-					strcpy(CamId,iCamId);
-					char *p = strtok(iCamId,"-");
-					/*判断当前相机是否为指定相机*/
-					if(p == Device_name)
-					{
-						IDLog("Find %s.\n",iCamId);
-						/*打开相机*/
-						if((pCamHandle = OpenQHYCCD(CamId)) == NULL)
-						{
-							IDLog("Unable to turn on the %s.\n",iCamId);
-							return false;
-						}
-						else
-						{
-							retVal = IsQHYCCDControlAvailable(pCamHandle, CAM_SINGLEFRAMEMODE);
-							if (SetQHYCCDStreamMode(pCamHandle, 0) != QHYCCD_SUCCESS)
-							{
-								IDLog("This camera doesn't support single frame shooting\n");
-								return false;
-							}
-							/*初始化相机*/
-							if(InitQHYCCD(pCamHandle) != QHYCCD_SUCCESS)
-							{
-								IDLog("Unable to initialize connection to camera.\n");
-								return false;
-							}
-							else
-							{
-								isConnected = true;
-								IDLog("Camera turned on successfully\n");
-								/*获取连接相机配置信息，并存入参数*/
-								UpdateCameraConfig();
-								return true;
-							}
-						}
-					}
-				}
-				IDLog("The specified camera was not found. Please check the camera connection");
+				IDLog("The specified camera was not found. Please check the camera connection\n");
 				return false;
 			}
 		}
-		return false;
+		if(info.Id.size() >= sizeof(CamId))
+			return false;
+		IDLog("Find %s.\n",info.Id.c_str());
+		strcpy(CamId,info.Id.c_str());
+		strcpy(iCamId,info.Id.c_str());
+		if(OpenCamera() != true)
+			return false;
+		std::lock_guard<std::mutex> lock(stateLock);
+		CamState.Brand = "QHYCCD";
+		CamState.Name = Device_name;
+		CamState.Index = info.Index;
+		CamState.Id = CamId;
+		return true;
 	}
 	
+	/*
+	 * name: LoadUsbTraffic()
+	 * describe: Read the USB traffic setting from config.air
+	 * 描述：读取config.air中的USB传输速度
+	 * note: Lower values give faster downloads but may drop frames on a busy bus,the usb.* metrics show the effect
+	 */
+	int QHYCCD::LoadUsbTraffic()
+	{
+		Json::Value root;
+		if(AIRCONFIG::Load(root) == false)
+			return QHY_USB_TRAFFIC;
+		const Json::Value &qhy = root["camera"]["qhy"];
+		if(qhy.isObject() == false)
+			return QHY_USB_TRAFFIC;
+		return std::max(0,qhy.get("usbtraffic",QHY_USB_TRAFFIC).asInt());
+	}
+
+	/*
+     * name: OpenCamera()
+     * describe: Open the camera with CamId and initialize it
+     * 描述：使用CamId打开相机并初始化
+     * calls: OpenQHYCCD()
+     * calls: SetQHYCCDStreamMode()
+     * calls: InitQHYCCD()
+     * calls: LoadControlCaps()
+     * calls: UpdateCameraConfig()
+     */
+	bool QHYCCD::OpenCamera()
+	{
+		/*打开相机*/
+		if((pCamHandle = OpenQHYCCD(CamId)) == NULL)
+		{
+			IDLog("Unable to turn on the %s.\n",CamId);
+			return false;
+		}
+		retVal = IsQHYCCDControlAvailable(pCamHandle, CAM_SINGLEFRAMEMODE);
+		if (SetQHYCCDStreamMode(pCamHandle, 0) != QHYCCD_SUCCESS)
+		{
+			IDLog("This camera doesn't support single frame shooting\n");
+			return false;
+		}
+		/*初始化相机*/
+		if(InitQHYCCD(pCamHandle) != QHYCCD_SUCCESS)
+		{
+			IDLog("Unable to initialize connection to camera.\n");
+			return false;
+		}
+		isConnected = true;
+		HoldScan(true);
+		IDLog("Camera turned on successfully\n");
+		UsbTraffic = LoadUsbTraffic();
+		METRICS::Set("usb.traffic.QHYCCD",UsbTraffic);
+		/*初始化后相机恢复默认设置，重新读取控制项*/
+		LoadControlCaps();
+		/*获取连接相机配置信息，并存入参数*/
+		UpdateCameraConfig();
+		/*SDK给出最大分辨率与位深下需要的缓冲区大小*/
+		Frames.Reserve(GetQHYCCDMemLength(pCamHandle));
+		/*SDK只在反复写入设定温度时调节制冷*/
+		if(isCoolCamera == true)
+			StartCooler(true);
+		return true;
+	}
+
+	/*
+     * name: QuickConnect(const DeviceState &state)
+     * @param state:上次保存的相机状态
+     * describe: Open the camera by the saved ID
+     * 描述：使用保存的相机ID直接打开相机，跳过逐个获取相机ID
+     * calls: InitSDK()
+     * calls: ScanQHYCCD()
+     * calls: OpenCamera()
+     * calls: Connect()
+     * note: The SDK needs one scan before any camera can be opened
+     */
+	bool QHYCCD::QuickConnect(const DeviceState &state)
+	{
+		if(state.Id.empty() || state.Id.size() >= sizeof(CamId))
+			return Connect(state.Name);
+		if(InitSDK() != true)
+			return false;
+		if((CamNumber = ScanQHYCCD()) <= 0)
+		{
+			IDLog("QHY camera not found, please check the power supply or make sure the camera is connected.\n");
+			return false;
+		}
+		strcpy(CamId,state.Id.c_str());
+		strcpy(iCamId,state.Id.c_str());
+		if(OpenCamera() != true)
+		{
+			IDLog("Unable to open %s by saved ID,search it again.\n",state.Name.c_str());
+			return Connect(state.Name);
+		}
+		std::lock_guard<std::mutex> lock(stateLock);
+		CamState.Brand = "QHYCCD";
+		CamState.Name = state.Name;
+		CamState.Index = state.Index;
+		CamState.Id = CamId;
+		return true;
+	}
+
+	/*
+	 * name: SetROI(int StartX,int StartY,int Width,int Height)
+	 * @param StartX:子画面左上角X坐标(合并后像素)
+	 * @param StartY:子画面左上角Y坐标(合并后像素)
+	 * @param Width:子画面宽度，为0时拍摄全画面
+	 * @param Height:子画面高度，为0时拍摄全画面
+	 * describe: Download only a part of the sensor
+	 * 描述：只下载传感器的一部分
+	 * calls: SetCameraConfig()
+	 * note: Takes effect at the next exposure when the camera is busy
+	 */
+	bool QHYCCD::SetROI(int StartX,int StartY,int Width,int Height)
+	{
+		if(StartX < 0 || StartY < 0 || Width < 0 || Height < 0)
+			return false;
+		DeviceState state;
+		{
+			std::lock_guard<std::mutex> lock(stateLock);
+			RoiX = StartX;
+			RoiY = StartY;
+			RoiWidth = Width;
+			RoiHeight = Height;
+			state = CamState;
+		}
+		/*正在曝光或视频采集时，在下一次设置参数时生效*/
+		if(isConnected == false || InExposure == true || InVideo == true)
+			return true;
+		std::lock_guard<std::mutex> guard(condMutex);
+		return SetCameraConfig(state.Bin > 0 ? state.Bin : 1,state.Gain,state.Offset);
+	}
+
+	/*
+     * name: RestoreState(const DeviceState &state)
+     * @param state:上次保存的相机状态
+     * describe: Restore bin,gain,offset and subframe of the camera
+     * 描述：恢复相机像素合并、增益、偏置与子画面设置
+     * calls: SetCameraConfig()
+     * calls: RestoreCooler()
+     */
+	bool QHYCCD::RestoreState(const DeviceState &state)
+	{
+		const int bin = state.Bin > 0 ? state.Bin : 1;
+		{
+			/*快照中总是记录画面大小，只有比全画面小时才是子画面*/
+			std::lock_guard<std::mutex> lock(stateLock);
+			bool subframe = state.Width > 0 && (state.StartX > 0 || state.StartY > 0 || state.Width < (int)iMaxWidth/bin || state.Height < (int)iMaxHeight/bin);
+			RoiX = subframe ? state.StartX : 0;
+			RoiY = subframe ? state.StartY : 0;
+			RoiWidth = subframe ? state.Width : 0;
+			RoiHeight = subframe ? state.Height : 0;
+		}
+		if(SetCameraConfig(bin,state.Gain,state.Offset) != true)
+			return false;
+		return RestoreCooler(state);
+	}
+
+	/*
+     * name: GetState(DeviceState &state)
+     * @param state:相机当前状态
+     * describe: Get the current state of the camera
+     * 描述：获取相机当前状态
+     */
+	bool QHYCCD::GetState(DeviceState &state)
+	{
+		if(isConnected == false)
+			return false;
+		{
+			std::lock_guard<std::mutex> lock(stateLock);
+			state = CamState;
+		}
+		FillCoolerState(state);
+		return true;
+	}
+
 	/*
      * name: Disconnect()
      * describe: Disconnect from camera
      * 描述：与相机断开连接
-     * calls: StopQHYCCDLive()
+     * calls: StopVideo()
      * calls: CancelQHYCCDExposingAndReadout()
      * calls: SaveConfig()
      * calls: CloseQHYCCD()
+     * calls: ReleaseSDK()
      * calls: IDLog()
      * note: Please stop all work before turning off the camera
      */
 	bool QHYCCD::Disconnect()
 	{
-		/*在关闭相机之前停止所有任务*/
+		StopCooler();
+		/*在关闭相机之前停止所有任务，视频采集线程与录制一起停止*/
 		if(InVideo == true)
 		{
-			if(StopQHYCCDLive(pCamHandle) != QHYCCD_SUCCESS)		//停止视频拍摄
-			{
-				IDLog("Unable to stop video capture, please try again.\n");
-				return false;
-			}
+			/*切换回单帧模式失败不影响关闭相机*/
+			StopVideo();		//停止视频拍摄
 			IDLog("Stop video capture.\n");
 		}
 		if(InExposure == true)
@@ -197,14 +412,10 @@ namespace AstroAir
 			IDLog("Unable to turn off the camera, please try again");
 			return false;
 		}
-		if ((retVal = ReleaseQHYCCDResource()) != QHYCCD_SUCCESS)
-		{
-			printf("Cannot release SDK resources, error %d.\n", retVal);
-		}
-		else
-		{
-			printf("SDK resources released.\n"); 
-		}
+		Controls.Clear();
+		isConnected = false;
+		HoldScan(false);
+		ReleaseSDK();
 		IDLog("Disconnect from camera\n");
 		return true;
     }
@@ -227,6 +438,15 @@ namespace AstroAir
 			isColorCamera = true;
 			channels = 3;
 		}
+		/*单通道的彩色图像为拜耳阵列数据*/
+		switch(retVal)
+		{
+			case BAYER_GB: BayerPattern = "GBRG"; break;
+			case BAYER_GR: BayerPattern = "GRBG"; break;
+			case BAYER_BG: BayerPattern = "BGGR"; break;
+			case BAYER_RG: BayerPattern = "RGGB"; break;
+			default: BayerPattern = ""; break;
+		}
 		if((retVal = IsQHYCCDControlAvailable(pCamHandle, CONTROL_COOLER)) == QHYCCD_SUCCESS)
 			isCoolCamera = true;
 		if((retVal = IsQHYCCDControlAvailable(pCamHandle, CONTROL_ST4PORT)) == QHYCCD_SUCCESS)
@@ -242,6 +462,66 @@ namespace AstroAir
 		return true;
 	}
 
+	/*
+	 * name: ActualExposure(int64_t Requested)
+	 * @param Requested:设定曝光时间(微秒)
+	 * describe: Exposure time the sensor really used
+	 * 描述：传感器实际使用的曝光时间(微秒)
+	 * calls: GetQHYCCDPreciseExposureInfo()
+	 * note: Sensors round the exposure to whole lines,older firmware does not report it and the requested time is used
+	 */
+	int64_t QHYCCD::ActualExposure(int64_t Requested)
+	{
+		/*结果由查询任务共同持有，超时后SDK仍可安全写入*/
+		struct ExposureInfo
+		{
+			uint32_t Pixel,Line,Frame,Clocks,Lines,Actual = 0;
+			uint8_t LongExposure;
+		};
+		auto info = std::make_shared<ExposureInfo>();
+		qhyccd_handle *handle = pCamHandle;
+		unsigned int ret;
+		if(SDK.Call<unsigned int>("GetQHYCCDPreciseExposureInfo",SDK_TIMEOUT,[handle,info]()
+		{
+			return GetQHYCCDPreciseExposureInfo(handle,&info->Pixel,&info->Line,&info->Frame,&info->Clocks,&info->Lines,&info->Actual,&info->LongExposure);
+		},ret) == false || ret != QHYCCD_SUCCESS || info->Actual == 0)
+			return Requested;
+		return info->Actual;
+	}
+
+	/*
+	 * name: ReadCooler(double &Temperature,double &Power)
+	 * @param Temperature:传感器温度(°C)
+	 * @param Power:制冷功率(%)
+	 * describe: Read the sensor temperature and cooler power
+	 * 描述：读取传感器温度与制冷功率
+	 * note: Called on the cooling thread,the PWM is 0 to 255
+	 */
+	bool QHYCCD::ReadCooler(double &Temperature,double &Power)
+	{
+		Temperature = GetQHYCCDParam(pCamHandle,CONTROL_CURTEMP);
+		double pwm = GetQHYCCDParam(pCamHandle,CONTROL_CURPWM);
+		if(Temperature == QHYCCD_ERROR || pwm == QHYCCD_ERROR)
+			return false;
+		Power = pwm / 255.0 * 100;
+		return true;
+	}
+
+	/*
+	 * name: WriteCooler(bool Enable,double SetPoint)
+	 * @param Enable:打开或关闭制冷
+	 * @param SetPoint:设定温度(°C)
+	 * describe: Regulate to the setpoint or switch the cooler off
+	 * 描述：调节到设定温度或关闭制冷
+	 * note: CONTROL_COOLER only regulates while it is written regularly,see StartCooler(true)
+	 */
+	bool QHYCCD::WriteCooler(bool Enable,double SetPoint)
+	{
+		if(Enable == true)
+			return SetQHYCCDParam(pCamHandle,CONTROL_COOLER,SetPoint) == QHYCCD_SUCCESS;
+		return SetQHYCCDParam(pCamHandle,CONTROL_MANULPWM,0) == QHYCCD_SUCCESS;
+	}
+
 	/*
      * name: StartExposure(int exp,int bin,bool IsSave,std::string FitsName,int Gain,int Offset)
      * describe: Start camera exposure
@@ -256,17 +536,22 @@ namespace AstroAir
 	 * calls: SetQHYCCDParam()
 	 * calls: SetCameraConfig()
 	 * calls: ExpQHYCCDSingleFrame()
+	 * calls: GetQHYCCDExposureRemaining()
+	 * calls: EXPOSURE::Submit()
      * calls: IDLog()
      * calls: AnortExposure()
      * calls: SaveImage()
+     * note: SDK calls run under the watchdog,a camera that stops responding fails the exposure instead of hanging the server
      */
 	bool QHYCCD::StartExposure(int exp,int bin,bool IsSave,std::string FitsName,int Gain,int Offset)
 	{
 		std::unique_lock<std::mutex> guard(condMutex);
+		/*曝光与下载中的等待都可以被AbortExposure()立即结束*/
+		CaptureScope capture(this);
 		double blink_duration = exp * 1000000;
 		CamBin = bin;
 		IDLog("Blinking %ld time(s) before exposure\n", blink_duration);
-		if((retVal = IsQHYCCDControlAvailable(pCamHandle,CONTROL_EXPOSURE)) != QHYCCD_SUCCESS || (retVal = SetQHYCCDParam(pCamHandle,CONTROL_EXPOSURE,blink_duration)) != QHYCCD_SUCCESS)
+		if(ApplyParam(CONTROL_EXPOSURE,blink_duration) != true)
 		{
 			IDLog("Failed to set blink exposure to %ldus, error %d\n", blink_duration, retVal);
 			return false;
@@ -281,16 +566,51 @@ namespace AstroAir
 			else
 			{
 				InExposure = true;
-				if((retVal = ExpQHYCCDSingleFrame(pCamHandle)) != QHYCCD_ERROR)
+				qhyccd_handle *handle = pCamHandle;
+				auto start = std::chrono::steady_clock::now();
+				const int64_t exposureStart = MonotonicNs();
+				/*部分型号的单帧曝光会阻塞到曝光结束，停止曝光时不必等它返回*/
+				if(SDK.Call<unsigned int>("ExpQHYCCDSingleFrame",exp * 1000 + SDK_TIMEOUT,[handle]() { return ExpQHYCCDSingleFrame(handle); },retVal,capture.Stop) == false)
 				{
-					usleep(10);
+					if(capture.Stop.stop_requested())
+					{
+						IDLog("Exposure aborted\n");
+						InExposure = false;
+						return false;
+					}
+					IDLog("ExpQHYCCDSingleFrame is not responding\n");
+					AbortExposure();
+					return false;
 				}
-				else
+				if(retVal == QHYCCD_ERROR)
 				{
 					IDLog("Blink exposure failed, error code is %d\n", retVal);
 					AbortExposure();
 					return false;
                 }
+				/*曝光期间不占用线程，由曝光引擎在预计结束时查询剩余时间*/
+				int elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+				bool ok = EXPOSURE::Wait(CamId,std::max(exp * 1000 - elapsed,0),[this,handle](int &Remaining)
+				{
+					unsigned int ret;
+					if(SDK.Call<unsigned int>("GetQHYCCDExposureRemaining",SDK_TIMEOUT,[handle]() { return GetQHYCCDExposureRemaining(handle); },ret) == false || ret == QHYCCD_ERROR)
+						return EXPOSURE::EXPOSURE_FAILED;
+					/*返回100及以下表示曝光结束*/
+					return ret <= 100 ? EXPOSURE::EXPOSURE_DONE : EXPOSURE::EXPOSURE_WORKING;
+				},capture.Stop);
+				if(capture.Stop.stop_requested())
+				{
+					IDLog("Exposure aborted\n");
+					InExposure = false;
+					return false;
+				}
+				if(ok == false)
+				{
+					IDLog("Blink exposure failed\n");
+					AbortExposure();
+					return false;
+				}
+				capture.Exposure(exposureStart,exposureStart + ActualExposure(exp * 1000000) * 1000);
 				InExposure = false;
             }
         }
@@ -318,101 +638,423 @@ namespace AstroAir
      * @return ture: 成功停止曝光
      * @return false：无法停止曝光
      * calls: CancelQHYCCDExposingAndReadout()
+     * calls: CancelCapture()
      * calls: IDLog()
+     * note: Called directly,not on the SDK thread,which may still be blocked in ExpQHYCCDSingleFrame
      */
 	bool QHYCCD::AbortExposure()
 	{
+		/*连拍由采集循环自行停止*/
+		if(InBurst == true)
+		{
+			IDLog("Aborting burst...\n");
+			BurstAbort = true;
+			return true;
+		}
 		IDLog("Aborting camera exposure...\n");
 		if((retVal = CancelQHYCCDExposingAndReadout(pCamHandle)) != QHYCCD_SUCCESS)
 		{
 			IDLog("Unable to stop camera exposure,error id is %d,please try again.\n",retVal);
 			return false;
 		}
+		/*正在等待的曝光与下载立即结束，阻塞中的SDK调用在下一次调用前返回*/
+		bool ok = CancelCapture();
 		InExposure = false;
-		return true;
+		return ok;
+	}
+
+	/*
+     * name: StartVideo(int exp,int bin,int Gain,int Offset)
+     * @param exp:单帧曝光时间(毫秒)
+     * @param bin:像素合并模式
+     * @param Gain:相机增益
+     * @param Offset:相机偏置
+     * describe: Switch the camera to live mode and start streaming
+     * 描述：将相机切换到连续模式并开始视频采集
+     * calls: SetQHYCCDStreamMode()
+     * calls: InitQHYCCD()
+     * calls: BeginQHYCCDLive()
+     * calls: GetQHYCCDLiveFrame()
+     * note: The SDK has no blocking read in live mode,the capture thread polls every VIDEO_POLL_US
+     */
+	bool QHYCCD::StartVideo(int exp,int bin,int Gain,int Offset)
+	{
+		std::unique_lock<std::mutex> guard(condMutex);
+		if(InExposure == true || InVideo == true)
+		{
+			IDLog("Camera is busy,can not start video\n");
+			return false;
+		}
+		qhyccd_handle *handle = pCamHandle;
+		/*切换工作模式后需要重新初始化*/
+		Controls.Invalidate();		//重新初始化后相机恢复默认参数
+		if(SetQHYCCDStreamMode(handle,1) != QHYCCD_SUCCESS ||
+		   SDK.Call<unsigned int>("InitQHYCCD",SDK_TIMEOUT,[handle]() { return InitQHYCCD(handle); },retVal) == false || retVal != QHYCCD_SUCCESS)
+		{
+			IDLog("This camera doesn't support live mode\n");
+			SingleFrameMode();
+			return false;
+		}
+		if(ApplyParam(CONTROL_EXPOSURE,exp * 1000) != true || SetCameraConfig(bin,Gain,Offset) != true)
+		{
+			IDLog("Failed to set camera configure\n");
+			SingleFrameMode();
+			return false;
+		}
+		if(SDK.Call<unsigned int>("BeginQHYCCDLive",SDK_TIMEOUT,[handle]() { return BeginQHYCCDLive(handle); },retVal) == false || retVal != QHYCCD_SUCCESS)
+		{
+			IDLog("Unable to start live mode,error code is %d\n",retVal);
+			SingleFrameMode();
+			return false;
+		}
+		InVideo = true;
+		bool ok = Video.Start(GetQHYCCDMemLength(handle),[handle](unsigned char *Buffer,FRAMEHEADER &Header)
+		{
+			uint32_t w,h,bpp,channels;
+			if(GetQHYCCDLiveFrame(handle,&w,&h,&bpp,&channels,Buffer) != QHYCCD_SUCCESS)
+			{
+				usleep(VIDEO_POLL_US);
+				return false;
+			}
+			Header.Width = w;
+			Header.Height = h;
+			Header.BitDepth = bpp;
+			Header.Channels = channels;
+			Header.Size = (uint64_t)w * h * channels * ((bpp + 7) / 8);
+			Header.MonotonicNs = MonotonicNs();
+			Header.UtcNs = UtcNs();
+			return true;
+		},[this](const FRAMEHEADER &Header,const unsigned char *Data) { VideoFrame(Header,Data); });
+		if(ok == false)
+		{
+			StopQHYCCDLive(handle);
+			InVideo = false;
+			SingleFrameMode();
+		}
+		return ok;
+	}
+
+	/*
+     * name: StopVideo()
+     * describe: Stop streaming and switch back to single frame mode
+     * 描述：停止视频采集并切换回单帧模式
+     * calls: StopQHYCCDLive()
+     * calls: SetQHYCCDStreamMode()
+     * calls: InitQHYCCD()
+     * calls: RestoreState()
+     */
+	bool QHYCCD::StopVideo()
+	{
+		if(InVideo == false)
+			return true;
+		Video.Stop();
+		StopRecord();
+		qhyccd_handle *handle = pCamHandle;
+		StopQHYCCDLive(handle);
+		InVideo = false;
+		return SingleFrameMode();
+	}
+
+	/*
+     * name: SingleFrameMode()
+     * describe: Switch the camera back to single frame mode and restore its settings
+     * 描述：将相机切换回单帧模式并恢复之前的设置
+     * calls: SetQHYCCDStreamMode()
+     * calls: InitQHYCCD()
+     * calls: RestoreState()
+     * note: Every failure after switching to live mode must come here,or the next exposure runs in live mode
+     */
+	bool QHYCCD::SingleFrameMode()
+	{
+		qhyccd_handle *handle = pCamHandle;
+		Controls.Invalidate();		//重新初始化后相机恢复默认参数
+		if(SetQHYCCDStreamMode(handle,0) != QHYCCD_SUCCESS ||
+		   SDK.Call<unsigned int>("InitQHYCCD",SDK_TIMEOUT,[handle]() { return InitQHYCCD(handle); },retVal) == false || retVal != QHYCCD_SUCCESS)
+		{
+			IDLog("Unable to switch the camera back to single frame mode\n");
+			return false;
+		}
+		/*重新初始化后恢复之前的设置*/
+		DeviceState state;
+		{
+			std::lock_guard<std::mutex> lock(stateLock);
+			state = CamState;
+		}
+		return RestoreState(state);
 	}
 	
+	/*
+     * name: StartBurst(int exp,int bin,int Gain,int Offset,int Count,std::string FitsName)
+     * @param exp:单帧曝光时间(毫秒)
+     * @param bin:像素合并模式
+     * @param Gain:相机增益
+     * @param Offset:相机偏置
+     * @param Count:连拍帧数
+     * @param FitsName:保存图像名称
+     * describe: Capture Count frames in burst mode and save them
+     * 描述：使用连拍模式拍摄Count帧并保存
+     * calls: SetQHYCCDStreamMode()
+     * calls: InitQHYCCD()
+     * calls: EnableQHYCCDBurstMode()
+     * calls: SetQHYCCDBurstModeStartEnd()
+     * calls: BeginQHYCCDLive()
+     * calls: SetQHYCCDBurstIDLE()
+     * calls: ReleaseQHYCCDBurstIDLE()
+     * calls: GetQHYCCDLiveFrame()
+     * calls: SingleFrameMode()
+     * calls: SubmitFrame()
+     * note: Every buffer is taken from the pool before the burst is released,so nothing is allocated
+     *       or written while the sensor runs. The frames go to the pipeline after the last one arrived.
+     */
+	bool QHYCCD::StartBurst(int exp,int bin,int Gain,int Offset,int Count,std::string FitsName)
+	{
+		std::unique_lock<std::mutex> guard(condMutex);
+		if(InExposure == true || InVideo == true || InBurst == true)
+		{
+			IDLog("Camera is busy,can not start burst\n");
+			return false;
+		}
+		if(Count <= 0 || Count > BURST_MAX_FRAMES)
+		{
+			IDLog("Burst of %d frames is out of range 1-%d\n",Count,BURST_MAX_FRAMES);
+			return false;
+		}
+		qhyccd_handle *handle = pCamHandle;
+		/*连拍基于连续模式，切换后需要重新初始化*/
+		Controls.Invalidate();		//重新初始化后相机恢复默认参数
+		if(SetQHYCCDStreamMode(handle,1) != QHYCCD_SUCCESS ||
+		   SDK.Call<unsigned int>("InitQHYCCD",SDK_TIMEOUT,[handle]() { return InitQHYCCD(handle); },retVal) == false || retVal != QHYCCD_SUCCESS)
+		{
+			IDLog("This camera doesn't support live mode\n");
+			SingleFrameMode();
+			return false;
+		}
+		InBurst = true;
+		BurstAbort = false;
+		std::vector<FRAMEBUFFER> buffers;
+		std::vector<FRAMEHEADER> headers;
+		bool ok = false;
+		do
+		{
+			if(ApplyParam(CONTROL_EXPOSURE,exp * 1000) != true || SetCameraConfig(bin,Gain,Offset) != true)
+			{
+				IDLog("Failed to set camera configure\n");
+				break;
+			}
+			const size_t frameSize = GetQHYCCDMemLength(handle);
+			const size_t limit = std::min((size_t)BURST_MAX_MEMORY,MEMBUDGET::Limit());
+			if(frameSize * Count > limit)
+			{
+				IDLog("Burst of %d frames needs %zu MB,limit is %zu MB\n",Count,frameSize * Count >> 20,limit >> 20);
+				break;
+			}
+			/*连拍开始前取出全部缓冲区*/
+			Frames.Reserve(frameSize,Count);
+			for(int i = 0;i < Count;i++)
+			{
+				FRAMEBUFFER buffer = Frames.Acquire(frameSize);
+				if(buffer == nullptr)
+					break;
+				buffers.push_back(buffer);
+			}
+			if((int)buffers.size() < Count)
+			{
+				IDLog("Unable to allocate buffers for the burst\n");
+				break;
+			}
+			/*SDK输出编号在起止之间的帧*/
+			if((retVal = EnableQHYCCDBurstMode(handle,true)) != QHYCCD_SUCCESS ||
+			   (retVal = SetQHYCCDBurstModeStartEnd(handle,0,Count + 1)) != QHYCCD_SUCCESS)
+			{
+				IDLog("This camera doesn't support burst mode,error code is %d\n",retVal);
+				break;
+			}
+			ResetQHYCCDFrameCounter(handle);
+			if(SDK.Call<unsigned int>("BeginQHYCCDLive",SDK_TIMEOUT,[handle]() { return BeginQHYCCDLive(handle); },retVal) == false || retVal != QHYCCD_SUCCESS)
+			{
+				IDLog("Unable to start live mode,error code is %d\n",retVal);
+				EnableQHYCCDBurstMode(handle,false);
+				break;
+			}
+			/*相机在空闲状态下等待，释放后连续输出全部帧*/
+			SetQHYCCDBurstIDLE(handle);
+			ReleaseQHYCCDBurstIDLE(handle);
+			auto start = std::chrono::steady_clock::now();
+			const auto timeout = std::chrono::milliseconds(exp * 2 + 1000);		//单帧等待上限
+			while((int)headers.size() < Count && BurstAbort == false)
+			{
+				uint32_t w,h,bpp,chan;
+				auto deadline = std::chrono::steady_clock::now() + timeout;
+				bool got = false;
+				while(BurstAbort == false && std::chrono::steady_clock::now() < deadline)
+				{
+					if(GetQHYCCDLiveFrame(handle,&w,&h,&bpp,&chan,buffers[headers.size()].get()) == QHYCCD_SUCCESS)
+					{
+						got = true;
+						break;
+					}
+					usleep(VIDEO_POLL_US);
+				}
+				if(got == false)
+					break;
+				FRAMEHEADER Header;
+				Header.Width = w;
+				Header.Height = h;
+				Header.BitDepth = bpp;
+				Header.Channels = chan;
+				Header.Size = (uint64_t)w * h * chan * ((bpp + 7) / 8);
+				Header.MonotonicNs = MonotonicNs();
+				Header.UtcNs = UtcNs();
+				headers.push_back(Header);
+			}
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			StopQHYCCDLive(handle);
+			EnableQHYCCDBurstMode(handle,false);
+			METRICS::Add("burst.frames",headers.size());
+			METRICS::Add("burst.dropped",Count - headers.size());
+			if(headers.size() > 1)
+				METRICS::Set("burst.fps",(headers.size() - 1) / elapsed.count());
+			IDLog("Burst got %zu of %d frames in %.3f s\n",headers.size(),Count,elapsed.count());
+			ok = (int)headers.size() == Count;
+		}
+		while(false);
+		SingleFrameMode();
+		Frames.Reserve(GetQHYCCDMemLength(handle));
+		InBurst = false;
+		guard.unlock();
+		/*拍到的帧全部保存，只有最后一帧生成预览*/
+		for(size_t i = 0;i < headers.size();i++)
+			SubmitFrame(headers[i],buffers[i],BurstName(FitsName,i + 1),iCamId,i + 1 == headers.size());
+		return ok;
+	}
+
 	/*
      * name: SetCameraConfig(double Bin,double Gain,double Offset)
      * describe: set camera cinfig
      * 描述：设置相机参数
      * calls: IDLog()
      * calls: IsQHYCCDControlAvailable()
-     * calls: SetQHYCCDStreamMode()
 	 * calls: SetQHYCCDParam()
+	 * calls: SetQHYCCDBinMode()
 	 * calls: SetQHYCCDResolution()
+     * note: Called before every exposure,only the values that changed since the last call reach the SDK
      */
 	bool QHYCCD::SetCameraConfig(double Bin,double Gain,double Offset)
 	{
-		
-		retVal = IsQHYCCDControlAvailable(pCamHandle, CONTROL_USBTRAFFIC);
-  		if ((retVal = SetQHYCCDParam(pCamHandle, CONTROL_USBTRAFFIC, 50)) != QHYCCD_SUCCESS)
+		/*设置USB传输速度*/
+		if(ApplyParam(CONTROL_USBTRAFFIC,UsbTraffic) != true)
   		{
 			IDLog("Unable to set camera USBTRAFFIC failure, error code is  %d\n", retVal);
 			return false;
 		}
 		/*设置相机增益*/
-		retVal = IsQHYCCDControlAvailable(pCamHandle, CONTROL_GAIN);
-		if ((retVal = SetQHYCCDParam(pCamHandle, CONTROL_GAIN, Gain)) != QHYCCD_SUCCESS)
+		if(ApplyParam(CONTROL_GAIN,Gain) != true)
 		{
 			IDLog("Unable to set camera GAIN failure, error code is  %d\n", retVal);
 			return false;
 		}
 		/*设置相机偏置*/
-		retVal = IsQHYCCDControlAvailable(pCamHandle, CONTROL_OFFSET);
-		if((retVal = SetQHYCCDParam(pCamHandle, CONTROL_OFFSET, Offset)) != QHYCCD_SUCCESS)
+		if(ApplyParam(CONTROL_OFFSET,Offset) != true)
 		{
 			IDLog("Unable to set camera OFFSET failure, error code is  %d\n", retVal);
 			return false;
 		}
 		/*设置像素合并模式*/
-		if((retVal = SetQHYCCDBinMode(pCamHandle,Bin,Bin)) != QHYCCD_SUCCESS)
+		if(Controls.Apply(CONTROL_CACHE_FORMAT,{Bin},[this](const std::vector<double> &Values)
+		{
+			if((retVal = SetQHYCCDBinMode(pCamHandle,Values[0],Values[0])) != QHYCCD_SUCCESS)
+				return false;
+			/*合并模式改变后SDK需要重新设置画面，子画面不变时也要写入*/
+			Controls.Invalidate(CONTROL_CACHE_START);
+			return true;
+		}) == false)
 		{
 			IDLog("Unable to set camera BIN MODE failure, error code is  %d\n", retVal);
 			return false;
 		}
 		else
 		{
-			if((retVal = SetQHYCCDResolution(pCamHandle, 0, 0, CamWidth/Bin, CamHeight/Bin)) != QHYCCD_SUCCESS)
+			std::unique_lock<std::mutex> lock(stateLock);
+			/*子画面超出传感器时截断*/
+			const int fullWidth = iMaxWidth/Bin,fullHeight = iMaxHeight/Bin;
+			int StartX = 0,StartY = 0;
+			CamWidth = fullWidth;
+			CamHeight = fullHeight;
+			if(RoiWidth > 0 && RoiHeight > 0)
+			{
+				StartX = std::clamp(RoiX,0,fullWidth - 1);
+				StartY = std::clamp(RoiY,0,fullHeight - 1);
+				CamWidth = std::min(RoiWidth,fullWidth - StartX);
+				CamHeight = std::min(RoiHeight,fullHeight - StartY);
+			}
+			lock.unlock();
+			/*画面大小变化可能导致传感器重新初始化，不变时不再设置*/
+			if(Controls.Apply(CONTROL_CACHE_START,{(double)StartX,(double)StartY,(double)CamWidth,(double)CamHeight},[this](const std::vector<double> &Values)
+			{
+				return (retVal = SetQHYCCDResolution(pCamHandle, Values[0], Values[1], Values[2], Values[3])) == QHYCCD_SUCCESS;
+			}) == false)
 			{
 				IDLog("Unable to set camera frame size failure, error code is  %d\n", retVal);
 				return false;
 			}
 			CamBin = Bin;
+			lock.lock();
+			CamState.Bin = Bin;
+			CamState.Gain = Gain;
+			CamState.Offset = Offset;
+			CamState.StartX = StartX;
+			CamState.StartY = StartY;
+			CamState.Width = CamWidth;
+			CamState.Height = CamHeight;
 		}
-		/*设置相机USB速度
-		retVal = IsQHYCCDControlAvailable(pCamHandle, CONTROL_SPEED);
-		if((retVal = SetQHYCCDParam(pCamHandle, CONTROL_SPEED,1)) != QHYCCD_SUCCESS)
-		{
-			IDLog("Unable to set camera speed failure, error code is  %d\n", retVal);
-			return false;
-		}
-		*/
-		retVal = SetQHYCCDParam(pCamHandle, CONTROL_DDR, 1.0);
-		retVal = IsQHYCCDControlAvailable(pCamHandle, CONTROL_USBTRAFFIC);
-		if((retVal = SetQHYCCDParam(pCamHandle, CONTROL_USBTRAFFIC,50)) != QHYCCD_SUCCESS)
-		{
-			IDLog("Unable to set camera speed failure, error code is  %d\n", retVal);
-			return false;
-		}
+		/*部分型号没有DDR,忽略错误*/
+		ApplyParam(CONTROL_DDR,1.0);
 		/*设置相机图像深度*/
-		if((retVal = IsQHYCCDControlAvailable(pCamHandle, CAM_16BITS)) == QHYCCD_SUCCESS)
+		const int bits = IsQHYCCDControlAvailable(pCamHandle, CAM_16BITS) == QHYCCD_SUCCESS ? 16 : 8;
+		if(ApplyParam(CONTROL_TRANSFERBIT,bits) != true)
 		{
-			if ((retVal = SetQHYCCDParam(pCamHandle, CONTROL_TRANSFERBIT, 16)) != QHYCCD_SUCCESS)
-			{
-				IDLog("Unable to set camera 16 bits mode failure, error code is  %d\n", retVal);
-				return false;
-			}
+			IDLog("Unable to set camera %d bits mode failure, error code is  %d\n", bits, retVal);
+			return false;
 		}
-		else
+		return true;
+	}
+
+	/*
+     * name: ApplyParam(CONTROL_ID Id,double Value)
+     * @param Id:控制项
+     * @param Value:需要设置的值
+     * describe: Set a parameter through the control cache
+     * 描述：通过控制项缓存设置参数，值不变时不调用SDK
+     * calls: SetQHYCCDParam()
+     */
+	bool QHYCCD::ApplyParam(CONTROL_ID Id,double Value)
+	{
+		return Controls.Apply(Id,Value,[this,Id](double Value) { return (retVal = SetQHYCCDParam(pCamHandle,Id,Value)) == QHYCCD_SUCCESS; });
+	}
+
+	/*
+     * name: LoadControlCaps()
+     * describe: Read the range of the controls the driver writes
+     * 描述：读取驱动使用的控制项的取值范围
+     * calls: IsQHYCCDControlAvailable()
+     * calls: GetQHYCCDParamMinMaxStep()
+     * note: Values out of range are refused by the cache without calling the SDK
+     */
+	void QHYCCD::LoadControlCaps()
+	{
+		Controls.Clear();
+		static const struct { CONTROL_ID Id; const char *Name; } Used[] = {
+			{CONTROL_EXPOSURE,"Exposure"},{CONTROL_GAIN,"Gain"},{CONTROL_OFFSET,"Offset"},
+			{CONTROL_USBTRAFFIC,"USB traffic"},{CONTROL_TRANSFERBIT,"Transfer bits"}
+		};
+		for(const auto &control : Used)
 		{
-			if ((retVal = SetQHYCCDParam(pCamHandle, CONTROL_TRANSFERBIT,8)) != QHYCCD_SUCCESS)
-			{
-				IDLog("Unable to set camera 8 bits mode failure, error code is  %d\n", retVal);
-				return false;
-			}
+			double min,max,step;
+			if(IsQHYCCDControlAvailable(pCamHandle,control.Id) != QHYCCD_SUCCESS ||
+			   GetQHYCCDParamMinMaxStep(pCamHandle,control.Id,&min,&max,&step) != QHYCCD_SUCCESS)
+				continue;
+			Controls.SetRange(control.Id,control.Name,min,max,step);
 		}
-		return true;
 	}
 
 	/*
@@ -421,15 +1063,7 @@ namespace AstroAir
      * 描述：存储图像
      * calls: GetQHYCCDMemLength()
 	 * calls: GetQHYCCDSingleFrame()
-     * calls: fits_create_file()
-     * calls: fits_create_img()
-     * calls: fits_update_key()
-     * calls: fits_write_img()
-     * calls: fits_close_file()
-     * calls: fits_report_error()
-	 * calls: SaveImage()
-	 * calls: SaveFitsImage()
-	 * calls: clacHistogram()
+     * calls: SubmitFrame()
      */
     bool QHYCCD::SaveImage(std::string FitsName)
     {
@@ -438,12 +1072,46 @@ namespace AstroAir
 			//std::unique_lock<std::mutex> guard(ccdBufferLock);
 			uint32_t imgSize = GetQHYCCDMemLength(pCamHandle);		//设置图像大小
 			//long imgSize = CamWidth*CamHeight*(1 + (Image_type==16));
-			unsigned char * imgBuf = new unsigned char [imgSize];		//图像缓冲区大小
-			long naxis = 2;
-			CamWidth /= CamBin;
-			CamHeight /= CamBin;
+			/*缓冲区与图像参数由下载任务共同持有，下载超时后SDK仍可安全写入*/
+			struct FrameInfo
+			{
+				unsigned int Width,Height,Bpp,Channels;
+			};
+			FRAMEBUFFER buffer = Frames.Acquire(imgSize);
+			if(buffer == nullptr)
+				return false;
+			auto frame = std::make_shared<FrameInfo>(FrameInfo{CamWidth,CamHeight,Image_type,channels});
+			qhyccd_handle *handle = pCamHandle;
+			const int64_t downloadStart = MonotonicNs();
+			/*下载期间读取进度，区分等待相机读出的时间与USB传输的时间*/
+			std::atomic<int64_t> firstProgressNs{0};
+			std::jthread progress([handle,&firstProgressNs](std::stop_token Stop)
+			{
+				while(SleepUntil(Stop,std::chrono::steady_clock::now() + std::chrono::milliseconds(QHY_PROGRESS_POLL)))
+				{
+					double percent = GetQHYCCDReadingProgress(handle);
+					if(percent > 0)
+					{
+						METRICS::Set("usb.reading_progress.QHYCCD",percent);
+						int64_t expected = 0;
+						firstProgressNs.compare_exchange_strong(expected,MonotonicNs());
+					}
+				}
+			});
 			/*曝光后获取图像信息*/
-			if ((retVal = GetQHYCCDLiveFrame(pCamHandle, &CamWidth, &CamHeight, &Image_type, &channels, imgBuf)) != QHYCCD_SUCCESS)
+			bool downloaded = SDK.Call<unsigned int>("GetQHYCCDSingleFrame",SDK_DOWNLOAD_TIMEOUT,[handle,frame,buffer]() { return GetQHYCCDSingleFrame(handle, &frame->Width, &frame->Height, &frame->Bpp, &frame->Channels, buffer.get()); },retVal,CaptureToken());
+			progress.request_stop();
+			progress.join();
+			if(downloaded == false)
+			{
+				IDLog("Image download timed out or was aborted\n");
+				return false;
+			}
+			CamWidth = frame->Width;
+			CamHeight = frame->Height;
+			Image_type = frame->Bpp;
+			channels = frame->Channels;
+			if (retVal != QHYCCD_SUCCESS)
 			{
 				/*获取图像失败*/
 				IDLog("GetQHYCCDSingleFrame error (%d)\n",retVal);
@@ -451,46 +1119,39 @@ namespace AstroAir
 			}
 			//guard.unlock();
 			IDLog("Download complete.\n");
-			/*将图像写入本地文件*/
-			#if(HAS_FITSIO==ON)
-				char datatype[40];		//相机品牌
-				char keywords[40];		//相机品牌
-				char value[20];		//相机名称
-				char description[40];		//相机描述
-				strcpy(datatype, "TSTRING");
-				strcpy(keywords, "Camera");
-				strcpy(value,iCamId);
-				strcpy(description,"ZWOASI");
-
-				fitsfile *fptr;		//cFitsIO定义
-				int FitsStatus;		//cFitsio状态
-				long naxes[2] = {CamWidth,CamHeight};
-				long nelements;
-				long fpixel = 1;
-
-				fits_create_file(&fptr, FitsName.c_str(), &FitsStatus);		//创建Fits文件
-				if(Image_type == 1)		//创建Fits图像
-					fits_create_img(fptr, USHORT_IMG, naxis, naxes, &FitsStatus);		//16位
-				else
-					fits_create_img(fptr, BYTE_IMG,   naxis, naxes, &FitsStatus);		//8位或12位
-				if(strcmp(datatype, "TSTRING") == 0)		//写入Fits图像头文件
-				{
-					fits_update_key(fptr, TSTRING, keywords, value, description, &FitsStatus);
-				}
-				if(Image_type == 1)		//将缓存图像写入SD卡
-					fits_write_img(fptr, TUSHORT, fpixel, imgSize, &imgBuf[0], &FitsStatus);		//16位
-				else
-					fits_write_img(fptr, TBYTE, fpixel, imgSize, &imgBuf[0], &FitsStatus);		//8位或12位
-				fits_close_file(fptr, &FitsStatus);		//关闭Fits图像
-				fits_report_error(stderr, FitsStatus);		//如果有错则返回错误信息
-			#endif
-			#if(HAS_OPENCV==ON)
-				OPENCV::SaveImage(imgBuf,FitsName,isColorCamera,CamHeight,CamWidth);
-				OPENCV::clacHistogram(imgBuf,isColorCamera,CamHeight,CamWidth);
-			#endif
-			if(imgBuf)
-				delete[] imgBuf;		//删除图像缓存
+			FRAMEHEADER info;
+			info.Width = CamWidth;
+			info.Height = CamHeight;
+			info.BitDepth = Image_type;
+			info.Channels = channels;
+			info.Size = (uint64_t)CamWidth * CamHeight * channels * ((Image_type + 7) / 8);		//缓冲区按最大分辨率分配，只发布实际图像
+			info.MonotonicNs = MonotonicNs();
+			info.UtcNs = UtcNs();
+			RecordDownload(info.Size,downloadStart,info.MonotonicNs);
+			if(firstProgressNs > 0)
+			{
+				METRICS::Observe("usb.readout_wait_ms.QHYCCD",(firstProgressNs - downloadStart) / 1e6);
+				METRICS::Observe("usb.transfer_ms.QHYCCD",(info.MonotonicNs - firstProgressNs) / 1e6);
+			}
+			/*交给流水线保存，缓冲区在所有阶段处理完后归还*/
+			SubmitFrame(info,buffer,FitsName,iCamId);
 		}
 		return true;
 	}
 }
+
+#ifdef HAS_PLUGIN
+/*插件入口*/
+extern "C"
+{
+	bool AirInitSDK()
+	{
+		return AstroAir::QHYCCD::InitSDK();
+	}
+
+	AstroAir::WSSERVER *AirCreateDevice()
+	{
+		return new AstroAir::QHYCCD();
+	}
+}
+#endif
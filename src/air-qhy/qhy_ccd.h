@@ -36,16 +36,26 @@ Description:QHY camera driver
 #ifndef _QHYCCD_H_
 #define _QHYCCD_H_
 
-#include "../wsserver.h"
+#include "../camera.h"
+#include "../watchdog.h"
+#include "../exposure.h"
+#include "../video.h"
+#include "../controls.h"
 #include "../libqhy/qhyccd.h"
 
 #include <atomic>
+#include <mutex>
+#include <future>
 
 #define MAXDEVICENUM 5
+#define BURST_MAX_FRAMES 1000		//单次连拍最多帧数
+#define BURST_MAX_MEMORY (2048UL << 20)		//连拍缓冲区总大小上限(字节)
+#define QHY_USB_TRAFFIC 50		//默认USB传输速度，可在config.air中用camera.qhy.usbtraffic修改
+#define QHY_PROGRESS_POLL 100		//下载中读取进度的间隔(毫秒)
 
 namespace AstroAir
 {
-	class QHYCCD: public WSSERVER
+	class QHYCCD: public CAMERA
 	{
 		public:
 			/*构造函数，重置参数*/
@@ -62,12 +72,47 @@ namespace AstroAir
 			virtual bool StartExposure(int exp,int bin,bool IsSave,std::string FitsName,int Gain,int Offset) override;
 			/*停止曝光*/
 			virtual bool AbortExposure() override;
+			/*视频采集*/
+			virtual bool StartVideo(int exp,int bin,int Gain,int Offset) override;
+			virtual bool StopVideo() override;
+			/*高速连拍*/
+			virtual bool StartBurst(int exp,int bin,int Gain,int Offset,int Count,std::string FitsName) override;
+			/*设置子画面*/
+			virtual bool SetROI(int StartX,int StartY,int Width,int Height) override;
 			/*设置相机参数*/
 			virtual bool SetCameraConfig(double Bin,double Gain,double Offset);
 			/*存储图像*/
 			virtual bool SaveImage(std::string FitsName);
+			/*使用快照快速连接相机*/
+			virtual bool QuickConnect(const DeviceState &state) override;
+			/*恢复相机设置*/
+			virtual bool RestoreState(const DeviceState &state) override;
+			/*获取相机当前状态*/
+			virtual bool GetState(DeviceState &state) override;
+			/*初始化SDK，可重复调用*/
+			static bool InitSDK();
+			/*释放SDK*/
+			static void ReleaseSDK();
+		protected:
+			/*制冷控制线程读写制冷*/
+			virtual bool ReadCooler(double &Temperature,double &Power) override;
+			virtual bool WriteCooler(bool Enable,double SetPoint) override;
 		private:
+			/*打开相机并初始化*/
+			bool OpenCamera();
+			/*读取各控制项的取值范围*/
+			void LoadControlCaps();
+			/*写入一个控制项，值不变时跳过*/
+			bool ApplyParam(CONTROL_ID Id,double Value);
+			/*实际曝光时间(微秒)*/
+			int64_t ActualExposure(int64_t Requested);
+			/*切换回单帧模式并恢复之前的设置*/
+			bool SingleFrameMode();
+			/*读取config.air中的USB传输速度*/
+			static int LoadUsbTraffic();
+
 			int CamNumber = 0;
+			int UsbTraffic = QHY_USB_TRAFFIC;		//当前使用的USB传输速度
 			char *CamName[MAXDEVICENUM];
 			int CamBin;
 			char iCamId[32] = {0};
@@ -76,6 +121,15 @@ namespace AstroAir
 
 			std::mutex condMutex;
 			std::mutex ccdBufferLock;
+			std::mutex stateLock;
+			/*相机当前状态，用于快照*/
+			DeviceState CamState;
+			/*SDK调用看门狗*/
+			SDKEXECUTOR SDK{"QHYCCD"};
+			/*视频采集线程*/
+			VIDEOCAPTURE Video{"QHYCCD"};
+			/*已写入相机的控制项*/
+			CONTROLCACHE Controls{"QHYCCD"};
 
 			/*相机配置参数*/
 			double chipWidth;
@@ -85,6 +139,11 @@ namespace AstroAir
 
 			unsigned int iMaxWidth = 0;		//最大高度
 			unsigned int iMaxHeight = 0;		//最大宽度
+			/*子画面，以合并后的像素为单位，宽高为0时拍摄全画面，由stateLock保护*/
+			int RoiX = 0;
+			int RoiY = 0;
+			int RoiWidth = 0;
+			int RoiHeight = 0;
 			unsigned int CamWidth = 0;
 			unsigned int CamHeight = 0;
 			unsigned int channels = 1; 		//通道，默认为黑白相机
@@ -100,7 +159,8 @@ namespace AstroAir
 			std::atomic_bool isConnected;
 			std::atomic_bool InExposure;
 			std::atomic_bool InVideo;
-			std::atomic_bool InCooling;
+			std::atomic_bool InBurst{false};
+			std::atomic_bool BurstAbort{false};		//停止曝光时结束正在进行的连拍
 	};
 }
 
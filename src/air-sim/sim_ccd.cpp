@@ -0,0 +1,622 @@
+/*
+ * sim_ccd.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Simulated camera driver
+
+**************************************************/
+
+#include "sim_ccd.h"
+#include "../logger.h"
+#include "../discovery.h"
+#include "../metrics.h"
+#include "../airconfig.h"
+#include "../membudget.h"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <thread>
+#include <string.h>
+
+namespace AstroAir
+{
+	/*
+	 * name: ScanCameras()
+	 * describe: Discovery backend,the simulator is always connected
+	 * 描述：设备扫描后端，模拟相机始终在线
+	 */
+	static std::vector<DeviceInfo> ScanCameras()
+	{
+		SIMCONFIG config = SIMULATORCCD::LoadConfig();
+		DeviceInfo device;
+		device.Brand = SIM_BRAND;
+		device.Name = SIM_DEVICE_NAME;
+		device.Id = "0";
+		device.Index = 0;
+		device.MaxWidth = config.Width;
+		device.MaxHeight = config.Height;
+		device.IsColor = !config.Bayer.empty();
+		return {device};
+	}
+
+	/*驱动加载时注册扫描后端，模拟相机没有USB设备*/
+	static const bool ScannerRegistered = (DISCOVERY::RegisterBackend(SIM_BRAND,ScanCameras),true);
+
+	SIMULATORCCD::SIMULATORCCD() : CAMERA(SIM_BRAND)
+	{
+	}
+
+	SIMULATORCCD::~SIMULATORCCD()
+	{
+		if(isConnected == true)
+			Disconnect();
+	}
+
+	/*
+	 * name: LoadConfig()
+	 * describe: Read the simulator settings from config.air
+	 * 描述：读取config.air中的模拟相机参数
+	 * note: Missing or invalid values keep their defaults
+	 */
+	SIMCONFIG SIMULATORCCD::LoadConfig()
+	{
+		SIMCONFIG config;
+		Json::Value root;
+		if(AIRCONFIG::Load(root) == false)
+			return config;
+		const Json::Value &sim = root["camera"]["simulator"];
+		if(sim.isObject() == false)
+			return config;
+		config.Width = std::max(16,sim.get("width",config.Width).asInt());
+		config.Height = std::max(16,sim.get("height",config.Height).asInt());
+		config.BitDepth = sim.get("bitdepth",config.BitDepth).asInt() > 8 ? 16 : 8;
+		config.Bayer = sim.get("bayer",config.Bayer).asString();
+		config.Readout = std::max(0.0,sim.get("readout",config.Readout).asDouble());
+		config.Noise = std::max(0.0,sim.get("noise",config.Noise).asDouble());
+		config.Stars = std::max(0.0,sim.get("stars",config.Stars).asDouble());
+		config.Seeing = std::max(0.5,sim.get("seeing",config.Seeing).asDouble());
+		config.Drift = sim.get("drift",config.Drift).asDouble();
+		if(!config.Bayer.empty() && config.Bayer != "RGGB" && config.Bayer != "BGGR" && config.Bayer != "GRBG" && config.Bayer != "GBRG")
+		{
+			IDLog("Unknown bayer pattern %s,simulate a mono camera\n",config.Bayer.c_str());
+			config.Bayer.clear();
+		}
+		return config;
+	}
+
+	/*
+	 * name: Connect(std::string Device_name)
+	 * @param Device_name:相机名称
+	 * describe: Create the simulated sky
+	 * 描述：生成模拟星空
+	 * note: The star field is the same on every connection,so results can be compared
+	 */
+	bool SIMULATORCCD::Connect(std::string Device_name)
+	{
+		Config = LoadConfig();
+		BayerPattern = Config.Bayer;
+		Random.seed(20211018);
+		std::uniform_real_distribution<double> uniform(0,1);
+		/*星等分布近似幂律，暗星多亮星少*/
+		int count = Config.Stars * Config.Width * Config.Height / 1e6;
+		Stars.clear();
+		for(int i = 0;i < count;i++)
+		{
+			STAR star;
+			star.X = uniform(Random) * Config.Width;
+			star.Y = uniform(Random) * Config.Height;
+			star.Flux = std::min(200000.0,200 * pow(std::max(uniform(Random),1e-4),-1.5));
+			Stars.push_back(star);
+		}
+		Epoch = std::chrono::steady_clock::now();
+		{
+			std::lock_guard<std::mutex> lock(stateLock);
+			CamState = DeviceState();
+			CamState.Brand = SIM_BRAND;
+			CamState.Name = Device_name;
+			CamState.Id = "0";
+			CamState.Index = 0;
+		}
+		SetCameraConfig(1,0,0);
+		Frames.Reserve((size_t)Config.Width * Config.Height * Config.BitDepth / 8);
+		{
+			std::lock_guard<std::mutex> lock(thermalLock);
+			ThermalTime = std::chrono::steady_clock::now();
+		}
+		StartCooler();
+		isConnected = true;
+		IDLog("Simulated %dx%d %d bit %s camera with %d stars\n",Config.Width,Config.Height,Config.BitDepth,Config.Bayer.empty() ? "mono" : Config.Bayer.c_str(),count);
+		return true;
+	}
+
+	/*
+	 * name: Disconnect()
+	 * describe: Stop all tasks
+	 * 描述：停止所有任务
+	 */
+	bool SIMULATORCCD::Disconnect()
+	{
+		StopCooler();
+		StopVideo();
+		AbortExposure();
+		DrainFrames();
+		isConnected = false;
+		return true;
+	}
+
+	/*
+	 * name: SetCameraConfig(int Bin,int Gain,int Offset)
+	 * @param Bin:像素合并
+	 * @param Gain:增益
+	 * @param Offset:偏置
+	 * describe: Set the frame layout
+	 * 描述：设置画面参数
+	 */
+	void SIMULATORCCD::SetCameraConfig(int Bin,int Gain,int Offset)
+	{
+		Bin = std::max(1,Bin);
+		std::lock_guard<std::mutex> lock(stateLock);
+		const int fullWidth = Config.Width/Bin,fullHeight = Config.Height/Bin;
+		int StartX = 0,StartY = 0;
+		CamWidth = fullWidth;
+		CamHeight = fullHeight;
+		if(RoiWidth > 0 && RoiHeight > 0)
+		{
+			StartX = std::clamp(RoiX,0,fullWidth - 1);
+			StartY = std::clamp(RoiY,0,fullHeight - 1);
+			CamWidth = std::min(RoiWidth,fullWidth - StartX);
+			CamHeight = std::min(RoiHeight,fullHeight - StartY);
+		}
+		CamState.Bin = Bin;
+		CamState.Gain = Gain;
+		CamState.Offset = Offset;
+		CamState.StartX = StartX;
+		CamState.StartY = StartY;
+		CamState.Width = CamWidth;
+		CamState.Height = CamHeight;
+	}
+
+	/*
+	 * name: StartExposure(int exp,int bin,bool IsSave,std::string FitsName,int Gain,int Offset)
+	 * @param exp:曝光时间(秒)
+	 * @param bin:像素合并
+	 * @param IsSave:是否保存图像
+	 * @param FitsName:保存图像名称
+	 * @param Gain:增益
+	 * @param Offset:偏置
+	 * describe: Simulate an exposure
+	 * 描述：模拟曝光
+	 * note: The exposure is timed by the exposure engine like a real camera
+	 */
+	bool SIMULATORCCD::StartExposure(int exp,int bin,bool IsSave,std::string FitsName,int Gain,int Offset)
+	{
+		if(isConnected == false)
+			return false;
+		std::unique_lock<std::mutex> guard(condMutex);
+		CaptureScope capture(this);
+		SetCameraConfig(bin,Gain,Offset);
+		ExposureTime = exp;
+		InExposure = true;
+		auto start = std::chrono::steady_clock::now();
+		const int64_t exposureStart = MonotonicNs();
+		bool ok = EXPOSURE::Wait(SIM_DEVICE_NAME,exp * 1000,[start,exp](int &Remaining)
+		{
+			auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+			Remaining = std::max<int>(0,exp * 1000 - elapsed);
+			return Remaining == 0 ? EXPOSURE::EXPOSURE_DONE : EXPOSURE::EXPOSURE_WORKING;
+		},capture.Stop);
+		InExposure = false;
+		if(ok == false)
+		{
+			IDLog("Simulated exposure aborted\n");
+			return false;
+		}
+		capture.Exposure(exposureStart,exposureStart + (int64_t)exp * 1000000000);
+		guard.unlock();
+		if(IsSave == true)
+			return SaveImage(FitsName);
+		return true;
+	}
+
+	/*
+	 * name: AbortExposure()
+	 * describe: Abort the exposure or the readout
+	 * 描述：停止曝光或读出
+	 * note: exposure.abort_ms.Simulator measures how long the capture thread takes to stop
+	 */
+	bool SIMULATORCCD::AbortExposure()
+	{
+		bool ok = CancelCapture();
+		InExposure = false;
+		return ok;
+	}
+
+	/*
+	 * name: Render(unsigned char *Buffer,FRAMEHEADER &Header,double Exposure)
+	 * @param Buffer:图像缓冲区
+	 * @param Header:帧信息
+	 * @param Exposure:曝光时间(秒)
+	 * describe: Render a star field with seeing,drift and noise
+	 * 描述：生成带有视宁度、漂移与噪声的星空图像
+	 * note: Values are computed in 16 bit ADU and scaled down for 8 bit frames
+	 */
+	bool SIMULATORCCD::Render(unsigned char *Buffer,FRAMEHEADER &Header,double Exposure)
+	{
+		std::lock_guard<std::mutex> render(renderLock);
+		DeviceState state;
+		{
+			std::lock_guard<std::mutex> lock(stateLock);
+			state = CamState;
+		}
+		const int bin = state.Bin,w = state.Width,h = state.Height;
+		std::normal_distribution<double> normal(0,1);
+		/*跟踪漂移与视宁度抖动*/
+		double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - Epoch).count();
+		double dx = Config.Drift * t * 0.8,dy = Config.Drift * t * 0.6;
+		double sigma = std::max(0.3,Config.Seeing / 2.355 * (1 + 0.05 * normal(Random))) / bin;
+		double gain = pow(10,state.Gain / 200.0);		//增益单位为0.1dB
+		double bias = 100 + state.Offset * 16;
+		double sky = 20 * Exposure * bin * bin;
+		std::vector<float> signal(w * h,sky);
+		const int radius = ceil(sigma * 3);
+		for(auto &star : Stars)
+		{
+			double sx = (star.X + dx) / bin - state.StartX,sy = (star.Y + dy) / bin - state.StartY;
+			if(sx < -radius || sy < -radius || sx >= w + radius || sy >= h + radius)
+				continue;
+			double amplitude = star.Flux * Exposure / (2 * M_PI * sigma * sigma);
+			for(int y = std::max(0,(int)sy - radius);y <= std::min(h - 1,(int)sy + radius);y++)
+			{
+				for(int x = std::max(0,(int)sx - radius);x <= std::min(w - 1,(int)sx + radius);x++)
+				{
+					double r2 = (x - sx) * (x - sx) + (y - sy) * (y - sy);
+					signal[y * w + x] += amplitude * exp(-r2 / (2 * sigma * sigma));
+				}
+			}
+		}
+		/*拜耳阵列中各颜色的响应*/
+		double response[4] = {1,1,1,1};
+		if(!Config.Bayer.empty())
+		{
+			for(int i = 0;i < 4;i++)
+				response[i] = Config.Bayer[i] == 'R' ? 0.7 : (Config.Bayer[i] == 'B' ? 0.5 : 1);
+		}
+		const double maximum = 65535;
+		const double scale = Config.BitDepth == 8 ? 1.0 / 256 : 1;
+		for(int y = 0;y < h;y++)
+		{
+			for(int x = 0;x < w;x++)
+			{
+				double electrons = signal[y * w + x] * response[((y + state.StartY) & 1) * 2 + ((x + state.StartX) & 1)];
+				/*散粒噪声与读出噪声*/
+				double value = bias + (electrons + sqrt(electrons) * normal(Random)) * gain + Config.Noise * normal(Random);
+				value = std::clamp(value,0.0,maximum) * scale;
+				if(Config.BitDepth == 8)
+					Buffer[y * w + x] = (unsigned char)value;
+				else
+				{
+					uint16_t pixel = (uint16_t)value;
+					memcpy(Buffer + (y * w + x) * 2,&pixel,2);
+				}
+			}
+		}
+		Header.Width = w;
+		Header.Height = h;
+		Header.BitDepth = Config.BitDepth;
+		Header.Channels = 1;
+		Header.Size = (uint64_t)w * h * Config.BitDepth / 8;
+		Header.MonotonicNs = MonotonicNs();
+		Header.UtcNs = UtcNs();
+		return true;
+	}
+
+	/*
+	 * name: SaveImage(std::string FitsName)
+	 * @param FitsName:保存图像名称
+	 * describe: Read out the simulated frame and save it
+	 * 描述：读出模拟图像并保存
+	 * note: Readout takes as long as the configured USB speed allows
+	 */
+	bool SIMULATORCCD::SaveImage(std::string FitsName)
+	{
+		size_t imgSize;
+		{
+			std::lock_guard<std::mutex> lock(stateLock);
+			imgSize = (size_t)CamWidth * CamHeight * Config.BitDepth / 8;
+		}
+		FRAMEBUFFER buffer = Frames.Acquire(imgSize);
+		if(buffer == nullptr)
+			return false;
+		auto start = std::chrono::steady_clock::now();
+		const int64_t downloadStart = MonotonicNs();
+		FRAMEHEADER frame;
+		Render(buffer.get(),frame,ExposureTime);
+		std::chrono::duration<double,std::milli> render = std::chrono::steady_clock::now() - start;
+		METRICS::Set("sim.render_ms",render.count());
+		/*模拟USB读出时间，读出中可以停止*/
+		if(Config.Readout > 0 && SleepUntil(CaptureToken(),start + std::chrono::microseconds((long)(frame.Size / Config.Readout))) == false)
+		{
+			IDLog("Readout aborted\n");
+			return false;
+		}
+		frame.MonotonicNs = MonotonicNs();
+		frame.UtcNs = UtcNs();
+		RecordDownload(frame.Size,downloadStart,frame.MonotonicNs);
+		IDLog("Download complete.\n");
+		/*交给流水线保存，缓冲区在所有阶段处理完后归还*/
+		SubmitFrame(frame,buffer,FitsName,SIM_DEVICE_NAME);
+		return true;
+	}
+
+	/*
+	 * name: StartVideo(int exp,int bin,int Gain,int Offset)
+	 * @param exp:单帧曝光时间(毫秒)
+	 * @param bin:像素合并
+	 * @param Gain:增益
+	 * @param Offset:偏置
+	 * describe: Start streaming simulated frames
+	 * 描述：开始模拟视频采集
+	 * note: The frame rate is limited by the exposure and the readout speed
+	 */
+	bool SIMULATORCCD::StartVideo(int exp,int bin,int Gain,int Offset)
+	{
+		if(isConnected == false || InVideo == true)
+			return false;
+		SetCameraConfig(bin,Gain,Offset);
+		size_t size;
+		{
+			std::lock_guard<std::mutex> lock(stateLock);
+			size = (size_t)CamWidth * CamHeight * Config.BitDepth / 8;
+		}
+		double readout = Config.Readout > 0 ? size / Config.Readout / 1000 : 0;
+		auto period = std::chrono::microseconds((long)(std::max<double>(exp,readout) * 1000));
+		auto next = std::make_shared<std::chrono::steady_clock::time_point>(std::chrono::steady_clock::now());
+		InVideo = true;
+		bool ok = Video.Start(size,[this,exp,period,next](unsigned char *Buffer,FRAMEHEADER &Header)
+		{
+			*next += period;
+			std::this_thread::sleep_until(*next);
+			return Render(Buffer,Header,exp / 1000.0);
+		},[this](const FRAMEHEADER &Header,const unsigned char *Data) { VideoFrame(Header,Data); });
+		if(ok == false)
+			InVideo = false;
+		return ok;
+	}
+
+	/*
+	 * name: StopVideo()
+	 * describe: Stop streaming
+	 * 描述：停止视频采集
+	 */
+	bool SIMULATORCCD::StopVideo()
+	{
+		if(InVideo == false)
+			return true;
+		Video.Stop();
+		StopRecord();
+		InVideo = false;
+		return true;
+	}
+
+	/*
+	 * name: StartBurst(int exp,int bin,int Gain,int Offset,int Count,std::string FitsName)
+	 * @param exp:单帧曝光时间(毫秒)
+	 * @param bin:像素合并
+	 * @param Gain:增益
+	 * @param Offset:偏置
+	 * @param Count:连拍帧数
+	 * @param FitsName:保存图像名称
+	 * describe: Capture Count frames back to back and save them
+	 * 描述：连续拍摄Count帧并保存
+	 * note: Works like the QHY burst mode: every buffer is taken before the first frame and the frames
+	 *       go to the pipeline after the last one. AbortExposure() ends the burst,the frames taken are kept
+	 */
+	bool SIMULATORCCD::StartBurst(int exp,int bin,int Gain,int Offset,int Count,std::string FitsName)
+	{
+		if(isConnected == false)
+			return false;
+		std::unique_lock<std::mutex> guard(condMutex);
+		if(InExposure == true || InVideo == true)
+		{
+			IDLog("Camera is busy,can not start burst\n");
+			return false;
+		}
+		if(Count <= 0 || Count > SIM_BURST_MAX_FRAMES)
+		{
+			IDLog("Burst of %d frames is out of range 1-%d\n",Count,SIM_BURST_MAX_FRAMES);
+			return false;
+		}
+		SetCameraConfig(bin,Gain,Offset);
+		size_t frameSize;
+		{
+			std::lock_guard<std::mutex> lock(stateLock);
+			frameSize = (size_t)CamWidth * CamHeight * Config.BitDepth / 8;
+		}
+		if(frameSize * Count > MEMBUDGET::Limit())
+		{
+			IDLog("Burst of %d frames needs %zu MB,limit is %zu MB\n",Count,frameSize * Count >> 20,MEMBUDGET::Limit() >> 20);
+			return false;
+		}
+		/*连拍开始前取出全部缓冲区*/
+		Frames.Reserve(frameSize,Count);
+		std::vector<FRAMEBUFFER> buffers;
+		for(int i = 0;i < Count;i++)
+		{
+			FRAMEBUFFER buffer = Frames.Acquire(frameSize);
+			if(buffer == nullptr)
+			{
+				IDLog("Unable to allocate buffers for the burst\n");
+				return false;
+			}
+			buffers.push_back(buffer);
+		}
+		std::vector<FRAMEHEADER> headers;
+		{
+			CaptureScope capture(this);
+			InExposure = true;
+			/*帧率受曝光时间与读出速度限制*/
+			double readout = Config.Readout > 0 ? frameSize / Config.Readout / 1000 : 0;
+			auto period = std::chrono::microseconds((long)(std::max<double>(exp,readout) * 1000));
+			auto start = std::chrono::steady_clock::now();
+			auto next = start;
+			while((int)headers.size() < Count)
+			{
+				next += period;
+				if(SleepUntil(capture.Stop,next) == false)
+					break;
+				FRAMEHEADER Header;
+				Render(buffers[headers.size()].get(),Header,exp / 1000.0);
+				headers.push_back(Header);
+			}
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			InExposure = false;
+			METRICS::Add("burst.frames",headers.size());
+			METRICS::Add("burst.dropped",Count - headers.size());
+			if(headers.size() > 1)
+				METRICS::Set("burst.fps",(headers.size() - 1) / elapsed.count());
+			IDLog("Burst got %zu of %d frames in %.3f s\n",headers.size(),Count,elapsed.count());
+		}
+		guard.unlock();
+		/*拍到的帧全部保存，只有最后一帧生成预览*/
+		for(size_t i = 0;i < headers.size();i++)
+			SubmitFrame(headers[i],buffers[i],BurstName(FitsName,i + 1),SIM_DEVICE_NAME,i + 1 == headers.size());
+		return (int)headers.size() == Count;
+	}
+
+	/*
+	 * name: SetROI(int StartX,int StartY,int Width,int Height)
+	 * @param StartX:子画面左上角X坐标(合并后像素)
+	 * @param StartY:子画面左上角Y坐标(合并后像素)
+	 * @param Width:子画面宽度，为0时拍摄全画面
+	 * @param Height:子画面高度，为0时拍摄全画面
+	 * describe: Render only a part of the sensor
+	 * 描述：只生成传感器的一部分
+	 */
+	bool SIMULATORCCD::SetROI(int StartX,int StartY,int Width,int Height)
+	{
+		if(StartX < 0 || StartY < 0 || Width < 0 || Height < 0)
+			return false;
+		DeviceState state;
+		{
+			std::lock_guard<std::mutex> lock(stateLock);
+			RoiX = StartX;
+			RoiY = StartY;
+			RoiWidth = Width;
+			RoiHeight = Height;
+			state = CamState;
+		}
+		if(isConnected == true && InExposure == false && InVideo == false)
+			SetCameraConfig(state.Bin,state.Gain,state.Offset);
+		return true;
+	}
+
+	/*
+	 * name: ReadCooler(double &Temperature,double &Power)
+	 * @param Temperature:传感器温度(°C)
+	 * @param Power:制冷功率(%)
+	 * describe: Advance the thermal model to now and read it
+	 * 描述：将热模型推进到当前时间并读取
+	 */
+	bool SIMULATORCCD::ReadCooler(double &Temperature,double &Power)
+	{
+		std::lock_guard<std::mutex> lock(thermalLock);
+		auto now = std::chrono::steady_clock::now();
+		std::chrono::duration<double> dt = now - ThermalTime;
+		ThermalTime = now;
+		/*制冷能力有限，最多低于环境温度SIM_COOLING_DELTA*/
+		double target = CoolerEnable ? std::max(CoolerTarget,SIM_AMBIENT - SIM_COOLING_DELTA) : SIM_AMBIENT;
+		SensorTemp += (target - SensorTemp) * (1 - exp(-dt.count() / SIM_THERMAL_TAU));
+		Temperature = SensorTemp;
+		Power = CoolerEnable ? std::clamp((SIM_AMBIENT - SensorTemp) / SIM_COOLING_DELTA * 100,0.0,100.0) : 0;
+		return true;
+	}
+
+	bool SIMULATORCCD::WriteCooler(bool Enable,double SetPoint)
+	{
+		std::lock_guard<std::mutex> lock(thermalLock);
+		CoolerEnable = Enable;
+		CoolerTarget = SetPoint;
+		return true;
+	}
+
+	bool SIMULATORCCD::QuickConnect(const DeviceState &state)
+	{
+		return Connect(state.Name);
+	}
+
+	/*
+	 * name: RestoreState(const DeviceState &state)
+	 * @param state:上次保存的相机状态
+	 * describe: Restore bin,gain,offset,subframe and cooling
+	 * 描述：恢复像素合并、增益、偏置、子画面与制冷设置
+	 */
+	bool SIMULATORCCD::RestoreState(const DeviceState &state)
+	{
+		const int bin = state.Bin > 0 ? state.Bin : 1;
+		{
+			std::lock_guard<std::mutex> lock(stateLock);
+			bool subframe = state.Width > 0 && (state.StartX > 0 || state.StartY > 0 || state.Width < Config.Width/bin || state.Height < Config.Height/bin);
+			RoiX = subframe ? state.StartX : 0;
+			RoiY = subframe ? state.StartY : 0;
+			RoiWidth = subframe ? state.Width : 0;
+			RoiHeight = subframe ? state.Height : 0;
+		}
+		SetCameraConfig(bin,state.Gain,state.Offset);
+		return RestoreCooler(state);
+	}
+
+	bool SIMULATORCCD::GetState(DeviceState &state)
+	{
+		if(isConnected == false)
+			return false;
+		{
+			std::lock_guard<std::mutex> lock(stateLock);
+			state = CamState;
+		}
+		FillCoolerState(state);
+		return true;
+	}
+}
+
+#ifdef HAS_PLUGIN
+/*插件入口*/
+extern "C"
+{
+	/*模拟相机不需要初始化SDK*/
+	bool AirInitSDK()
+	{
+		return true;
+	}
+
+	AstroAir::WSSERVER *AirCreateDevice()
+	{
+		return new AstroAir::SIMULATORCCD();
+	}
+}
+#endif
@@ -0,0 +1,142 @@
+/*
+ * sim_ccd.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Simulated camera driver
+
+**************************************************/
+
+#pragma once
+
+#ifndef _SIM_CCD_H_
+#define _SIM_CCD_H_
+
+#include "../camera.h"
+#include "../exposure.h"
+#include "../video.h"
+
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <chrono>
+#include <vector>
+#include <string>
+
+#define SIM_BRAND "Simulator"
+#define SIM_DEVICE_NAME "Simulator Camera"
+#define SIM_AMBIENT 20.0		//环境温度(°C)
+#define SIM_COOLING_DELTA 40.0		//制冷最多低于环境温度多少(°C)
+#define SIM_THERMAL_TAU 30.0		//传感器温度的时间常数(秒)
+#define SIM_BURST_MAX_FRAMES 1000		//单次连拍最多帧数
+
+namespace AstroAir
+{
+	/*模拟相机参数，来自config.air中camera.simulator*/
+	struct SIMCONFIG
+	{
+		int Width = 1920;		//传感器宽度
+		int Height = 1080;		//传感器高度
+		int BitDepth = 16;		//8或16
+		std::string Bayer;		//拜耳阵列(RGGB,BGGR,GRBG,GBRG)，为空时为黑白相机
+		double Readout = 40;		//读出速度(MB/s)
+		double Noise = 8;		//读出噪声(ADU)
+		double Stars = 50;		//每百万像素的星点数量
+		double Seeing = 3;		//星点半高全宽(像素)
+		double Drift = 0.5;		//跟踪漂移(像素/秒)
+	};
+
+	/*
+	 * A camera without hardware. Frames are rendered star fields with
+	 * seeing,drift,shot and read noise,so the capture,processing and
+	 * streaming paths can be exercised and measured on any machine.
+	 */
+	class SIMULATORCCD: public CAMERA
+	{
+		public:
+			explicit SIMULATORCCD();
+			virtual ~SIMULATORCCD();
+			virtual bool Connect(std::string Device_name) override;
+			virtual bool Disconnect() override;
+			virtual bool StartExposure(int exp,int bin,bool IsSave,std::string FitsName,int Gain,int Offset) override;
+			virtual bool AbortExposure() override;
+			virtual bool StartVideo(int exp,int bin,int Gain,int Offset) override;
+			virtual bool StopVideo() override;
+			virtual bool StartBurst(int exp,int bin,int Gain,int Offset,int Count,std::string FitsName) override;
+			virtual bool SetROI(int StartX,int StartY,int Width,int Height) override;
+			virtual bool QuickConnect(const DeviceState &state) override;
+			virtual bool RestoreState(const DeviceState &state) override;
+			virtual bool GetState(DeviceState &state) override;
+			/*存储图像*/
+			virtual bool SaveImage(std::string FitsName);
+			/*读取config.air中的模拟参数*/
+			static SIMCONFIG LoadConfig();
+		protected:
+			/*一阶热模型，传感器温度按时间常数趋向设定温度*/
+			virtual bool ReadCooler(double &Temperature,double &Power) override;
+			virtual bool WriteCooler(bool Enable,double SetPoint) override;
+		private:
+			struct STAR
+			{
+				double X,Y;		//全画面坐标
+				double Flux;		//每秒总通量(ADU)
+			};
+			/*设置画面参数*/
+			void SetCameraConfig(int Bin,int Gain,int Offset);
+			/*生成一帧图像*/
+			bool Render(unsigned char *Buffer,FRAMEHEADER &Header,double Exposure);
+
+			SIMCONFIG Config;
+			std::vector<STAR> Stars;
+			std::mt19937 Random;
+			std::chrono::steady_clock::time_point Epoch;		//连接时间，用于计算漂移
+			std::mutex condMutex;
+			std::mutex stateLock;
+			std::mutex renderLock;
+			DeviceState CamState;
+			int CamWidth = 0;
+			int CamHeight = 0;
+			/*子画面，以合并后的像素为单位，由stateLock保护*/
+			int RoiX = 0;
+			int RoiY = 0;
+			int RoiWidth = 0;
+			int RoiHeight = 0;
+			double ExposureTime = 0;		//上一次曝光时间(秒)
+			std::atomic_bool isConnected{false};
+			std::atomic_bool InExposure{false};
+			std::atomic_bool InVideo{false};
+			VIDEOCAPTURE Video{SIM_BRAND};
+			/*模拟制冷状态，由thermalLock保护*/
+			std::mutex thermalLock;
+			double SensorTemp = SIM_AMBIENT;
+			double CoolerTarget = SIM_AMBIENT;
+			bool CoolerEnable = false;
+			std::chrono::steady_clock::time_point ThermalTime;
+	};
+}
+
+#endif
@@ -0,0 +1,69 @@
+/*
+ * airconfig.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Shared reader of config.air
+
+**************************************************/
+
+#include <fstream>
+#include <memory>
+#include <json/json.h>
+
+#include "logger.h"
+#include "airconfig.h"
+
+namespace AstroAir::AIRCONFIG
+{
+	/*
+	 * name: Load(Json::Value &Root)
+	 * @param Root:解析后的配置
+	 * describe: Read and parse config.air from the working directory
+	 * 描述：读取并解析工作目录下的config.air
+	 * @return false: The file is missing or is not valid JSON
+	 * note: Each module reads its own section once at startup,so the file is not cached
+	 */
+	bool Load(Json::Value &Root)
+	{
+		std::ifstream in(AIR_CONFIG_FILE, std::ios::binary);
+		if(!in.is_open())
+			return false;
+		std::string line,jsonStr;
+		while(getline(in, line))
+			jsonStr.append(line);
+		Json::String errs;
+		Json::CharReaderBuilder reader;
+		std::unique_ptr<Json::CharReader> const json_read(reader.newCharReader());
+		if(json_read->parse(jsonStr.c_str(), jsonStr.c_str() + jsonStr.length(), &Root, &errs) == false)
+		{
+			IDLog("Unable to parse %s: %s\n",AIR_CONFIG_FILE,errs.c_str());
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,52 @@
+/*
+ * airconfig.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Shared reader of config.air
+
+**************************************************/
+
+#pragma once
+
+#ifndef _AIRCONFIG_H_
+#define _AIRCONFIG_H_
+
+#define AIR_CONFIG_FILE "config.air"
+
+namespace Json
+{
+	class Value;
+}
+
+namespace AstroAir::AIRCONFIG
+{
+	/*读取并解析config.air，文件不存在或格式错误时返回false*/
+	bool Load(Json::Value &Root);
+}
+
+#endif
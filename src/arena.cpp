@@ -0,0 +1,116 @@
+/*
+ * arena.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Per frame scratch memory for processing stages
+
+**************************************************/
+
+#include "logger.h"
+#include "metrics.h"
+#include "arena.h"
+
+namespace AstroAir
+{
+	ARENAPOOL::ARENAPOOL(std::string Name)
+	{
+		shared = std::make_shared<Shared>(Name + " arena");
+	}
+
+	FRAMEARENA::~FRAMEARENA()
+	{
+		Reset();
+	}
+
+	void FRAMEARENA::Bind(const ARENAPOOL &Pool)
+	{
+		std::lock_guard<std::mutex> guard(Lock);
+		Source = Pool.shared;
+	}
+
+	/*
+	 * name: Allocate(size_t Size,size_t Align)
+	 * @param Size:字节数
+	 * @param Align:对齐字节数，需为2的幂且不大于页大小
+	 * describe: Take scratch memory for this frame
+	 * 描述：为这一帧取出暂存内存
+	 * @return nullptr: The block of this frame is too small,use the heap instead
+	 * note: The block comes from the pool on the first call,so a frame without processing takes no memory
+	 */
+	void *FRAMEARENA::Allocate(size_t Size,size_t Align)
+	{
+		std::lock_guard<std::mutex> guard(Lock);
+		Wanted += Size + Align;		//按最坏的对齐计算
+		if(Block == nullptr && Source != nullptr)
+		{
+			{
+				std::lock_guard<std::mutex> lock(Source->Lock);
+				Capacity = Source->Size;
+			}
+			if(Capacity > 0 && (Block = Source->Blocks.Acquire(Capacity)) == nullptr)
+				Capacity = 0;
+		}
+		/*内存块按页对齐，偏移对齐即地址对齐*/
+		const size_t start = (Used + Align - 1) & ~(Align - 1);
+		if(Block == nullptr || start + Size > Capacity)
+		{
+			METRICS::Add("arena.overflows");
+			return nullptr;
+		}
+		Used = start + Size;
+		return Block.get() + start;
+	}
+
+	/*
+	 * name: Reset()
+	 * describe: Give the whole block back when the frame retires
+	 * 描述：帧处理完成后一次归还全部内存
+	 * note: A frame that needed more than its block makes the pool keep larger blocks from now on
+	 */
+	void FRAMEARENA::Reset()
+	{
+		std::lock_guard<std::mutex> guard(Lock);
+		if(Source != nullptr && Wanted > 0)
+		{
+			if(Block != nullptr)
+				METRICS::Observe("arena.used_kb",Used / 1024.0);
+			std::lock_guard<std::mutex> lock(Source->Lock);
+			if(Wanted > Source->Size)
+			{
+				Source->Size = (Wanted + ARENA_GRANULE - 1) / ARENA_GRANULE * ARENA_GRANULE;
+				Source->Blocks.Reserve(Source->Size,ARENA_BLOCKS);
+				METRICS::Set("arena.block_mb",Source->Size / (double)(1 << 20));
+				IDLog("Frame scratch memory grows to %zu MB\n",Source->Size >> 20);
+			}
+		}
+		Block = nullptr;
+		Capacity = 0;
+		Used = 0;
+		Wanted = 0;
+	}
+}
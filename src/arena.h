@@ -0,0 +1,109 @@
+/*
+ * arena.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Per frame scratch memory for processing stages
+
+**************************************************/
+
+#pragma once
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+#include "framepool.h"
+
+#define ARENA_ALIGN 64		//默认对齐字节数，一条缓存行
+#define ARENA_GRANULE (1 << 20)		//暂存区大小按该值取整
+#define ARENA_BLOCKS 3		//保留的暂存区数量，与同时处理的帧数相当
+
+namespace AstroAir
+{
+	/*
+	 * Scratch memory of one camera. It learns how much a frame needs from
+	 * the frames that retired before,so after the first frame every
+	 * intermediate of the processing stages comes out of a pooled block.
+	 */
+	class ARENAPOOL
+	{
+		public:
+			explicit ARENAPOOL(std::string Name);
+		private:
+			friend class FRAMEARENA;
+			struct Shared
+			{
+				FRAMEPOOL Blocks;
+				std::mutex Lock;
+				size_t Size = 0;		//每帧需要的字节数，0表示还不知道
+				explicit Shared(std::string Name) : Blocks(Name) {}
+			};
+			std::shared_ptr<Shared> shared;
+	};
+
+	/*
+	 * Bump allocator over one block from an ARENAPOOL. The stages of a frame
+	 * take aligned scratch memory from it without freeing anything; the
+	 * whole block goes back to the pool in one step when the frame retires.
+	 * A request that does not fit returns nullptr and the caller uses the
+	 * heap, the pool then grows for the next frames.
+	 */
+	class FRAMEARENA
+	{
+		public:
+			FRAMEARENA() = default;
+			~FRAMEARENA();
+			FRAMEARENA(const FRAMEARENA &) = delete;
+			FRAMEARENA &operator=(const FRAMEARENA &) = delete;
+			/*使用Pool中的内存，需在第一次Allocate之前调用*/
+			void Bind(const ARENAPOOL &Pool);
+			/*取出Size字节的对齐内存，空间不足时返回nullptr*/
+			void *Allocate(size_t Size,size_t Align = ARENA_ALIGN);
+			template<typename T>
+			T *Allocate(size_t Count)
+			{
+				return static_cast<T *>(Allocate(Count * sizeof(T),alignof(T) > ARENA_ALIGN ? alignof(T) : ARENA_ALIGN));
+			}
+			/*一次归还全部内存，之后分配的指针全部失效*/
+			void Reset();
+		private:
+			std::mutex Lock;		//各阶段在不同线程中分配
+			std::shared_ptr<ARENAPOOL::Shared> Source;
+			FRAMEBUFFER Block;		//第一次分配时才取出
+			size_t Capacity = 0;
+			size_t Used = 0;
+			size_t Wanted = 0;		//请求的总字节数，包括没能满足的请求
+	};
+}
+
+#endif
@@ -0,0 +1,758 @@
+/*
+ * camera.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Common base of camera drivers
+
+**************************************************/
+
+#include "camera.h"
+#include "logger.h"
+#include "pixel.h"
+#include "opencv.h"
+#include "cooling.h"
+#include "metrics.h"
+#include "membudget.h"
+#include "discovery.h"
+
+#include <fitsio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <time.h>
+
+namespace AstroAir
+{
+	/*
+	 * name: IsoTime(int64_t UtcNs)
+	 * @param UtcNs:UTC时间(纳秒)
+	 * describe: Format a UTC time for FITS,microseconds included
+	 * 描述：将UTC时间格式化为FITS使用的ISO格式，精确到微秒
+	 */
+	static std::string IsoTime(int64_t UtcNs)
+	{
+		time_t seconds = UtcNs / 1000000000;
+		struct tm utc;
+		gmtime_r(&seconds,&utc);
+		char text[32];
+		size_t len = strftime(text,sizeof(text),"%Y-%m-%dT%H:%M:%S",&utc);
+		snprintf(text + len,sizeof(text) - len,".%06ld",(long)(UtcNs % 1000000000 / 1000));
+		return text;
+	}
+
+	/*
+	 * name: Statistics(const unsigned char *imgBuf,const FRAMEHEADER &Header,FRAMESTATS &Stats)
+	 * @param imgBuf:图像缓冲区
+	 * @param Header:帧信息，决定位深与通道数
+	 * @param Stats:统计结果，位置与大小由调用者填写
+	 * describe: Minimum,maximum,mean,standard deviation and histogram of an image
+	 * 描述：计算图像的最小值、最大值、均值、标准差与直方图
+	 * @return false: Unsupported format
+	 */
+	static bool Statistics(const unsigned char *imgBuf,const FRAMEHEADER &Header,FRAMESTATS &Stats)
+	{
+		const size_t pixels = (size_t)Header.Width * Header.Height;
+		Stats.Channels = Header.Channels;
+		Stats.BitDepth = Header.BitDepth;
+		return PIXEL::Dispatch(Header,[&]<typename T,int Channels>()
+		{
+			const T *source = reinterpret_cast<const T *>(imgBuf);
+			const size_t count = pixels * Channels;
+			if(count == 0)
+				return;
+			T low,high;
+			double sum,sumsq;
+			PIXEL::MinMax<T>(source,count,low,high);
+			PIXEL::Moments<T>(source,count,sum,sumsq);
+			PIXEL::HISTOGRAM<Channels> bins;
+			PIXEL::Histogram<T,Channels>(source,pixels,(sizeof(T) - 1) * 8,bins);
+			Stats.Min = low;
+			Stats.Max = high;
+			Stats.Mean = sum / count;
+			Stats.StdDev = sqrt(std::max(0.0,sumsq / count - Stats.Mean * Stats.Mean));
+			Stats.Histogram.fill(0);
+			for(auto &channel : bins)
+				for(int i = 0;i < 256;i++)
+					Stats.Histogram[i] += channel[i];
+		});
+	}
+
+	/*
+	 * name: Region(const FRAMEJOB &Job,int &X,int &Y,int &Width,int &Height,FRAMEHEADER &Header,std::vector<unsigned char> &Copy)
+	 * @param Job:缓存的帧
+	 * @param X,Y,Width,Height:需要的区域，宽高为0时取整帧，返回实际使用的区域
+	 * @param Header:区域的帧信息
+	 * @param Copy:区域不是整帧时保存复制出的像素
+	 * describe: Cut a rectangle out of a cached frame
+	 * 描述：从缓存的帧中截取一块区域
+	 * @return nullptr: The frame is empty
+	 * note: The rectangle is clipped to the frame,with a Bayer pattern the corner moves to even pixels so the colors stay right
+	 */
+	static const unsigned char *Region(const FRAMEJOB &Job,int &X,int &Y,int &Width,int &Height,FRAMEHEADER &Header,std::vector<unsigned char> &Copy)
+	{
+		Header = Job.Header;
+		const int w = Job.Header.Width,h = Job.Header.Height;
+		if(w <= 0 || h <= 0)
+			return nullptr;
+		if(Width <= 0 || Height <= 0)
+		{
+			X = Y = 0;
+			Width = w;
+			Height = h;
+		}
+		X = std::clamp(X,0,w - 1);
+		Y = std::clamp(Y,0,h - 1);
+		if(!Job.Bayer.empty())
+		{
+			X &= ~1;
+			Y &= ~1;
+		}
+		Width = std::min(Width,w - X);
+		Height = std::min(Height,h - Y);
+		if(Width == w && Height == h)
+			return Job.Buffer.get();
+		const size_t pixel = (size_t)Header.Channels * ((Header.BitDepth + 7) / 8);
+		Copy.resize((size_t)Width * Height * pixel);
+		for(int row = 0;row < Height;row++)
+			memcpy(Copy.data() + row * Width * pixel,Job.Buffer.get() + ((size_t)(Y + row) * w + X) * pixel,Width * pixel);
+		Header.Width = Width;
+		Header.Height = Height;
+		Header.Size = Copy.size();
+		return Copy.data();
+	}
+
+	/*
+	 * name: CAMERA(std::string Brand)
+	 * @param Brand:相机品牌
+	 * describe: Set up the frame pool and the pipeline
+	 * 描述：初始化帧缓冲池与处理流水线
+	 */
+	CAMERA::CAMERA(std::string Brand) : Brand(Brand),Frames(Brand),Scratch(Brand),Pipeline(Brand)
+	{
+		/*下载完成后即可开始下一次曝光，保存与预览在流水线中进行*/
+		Pipeline.AddStage("writer",std::bind(&CAMERA::WriteFits,this,std::placeholders::_1));
+		Pipeline.AddStage("preview",std::bind(&CAMERA::WritePreview,this,std::placeholders::_1));
+		Pipeline.AddStage("analysis",std::bind(&CAMERA::Analyse,this,std::placeholders::_1));
+	}
+
+	CAMERA::~CAMERA()
+	{
+		StopCooler();
+		HoldScan(false);
+	}
+
+	/*
+	 * name: SubmitFrame(const FRAMEHEADER &Header,FRAMEBUFFER Buffer,std::string FitsName,std::string Camera,bool Preview)
+	 * @param Header:帧信息
+	 * @param Buffer:图像数据
+	 * @param FitsName:保存图像名称
+	 * @param Camera:相机名称
+	 * @param Preview:是否生成预览图与直方图
+	 * describe: Publish a downloaded frame and queue it for saving
+	 * 描述：发布下载完成的帧并交给流水线保存
+	 * note: The buffer goes back to the pool after every stage has dropped it,during a capture the command and exposure times are filled in
+	 */
+	void CAMERA::SubmitFrame(const FRAMEHEADER &Header,FRAMEBUFFER Buffer,std::string FitsName,std::string Camera,bool Preview)
+	{
+		auto job = std::make_shared<FRAMEJOB>();
+		job->Header = Header;
+		{
+			/*拍摄中下载的帧带上命令与曝光时间*/
+			std::lock_guard<std::mutex> lock(captureLock);
+			if(Capturing == true && job->Header.CommandNs == 0)
+			{
+				job->Header.CommandNs = CommandNs;
+				job->Header.ExposureStartNs = ExposureStartNs;
+				job->Header.ExposureEndNs = ExposureEndNs;
+			}
+		}
+		PublishFrame(job->Header,Buffer.get());
+		job->Buffer = Buffer;
+		job->FileName = FitsName;
+		job->Camera = Camera;
+		job->Bayer = Header.Channels == 1 ? BayerPattern : "";
+		job->Preview = Preview;
+		job->Arena.Bind(Scratch);
+		/*内存紧张时不生成预览与直方图，帧写入FITS后即可归还缓冲区*/
+		if(Preview == true && MEMBUDGET::Pressure() == true)
+		{
+			job->Preview = false;
+			METRICS::Add("membudget.skipped_previews");
+		}
+		Cache.Put(job);
+		Pipeline.Submit(job);
+	}
+
+	/*
+	 * name: CaptureScope(CAMERA *Camera)
+	 * @param Camera:相机
+	 * describe: Begin an exposure that AbortExposure() can stop
+	 * 描述：开始一次可由AbortExposure()停止的拍摄
+	 */
+	CAMERA::CaptureScope::CaptureScope(CAMERA *Camera) : Camera(Camera)
+	{
+		std::lock_guard<std::mutex> lock(Camera->captureLock);
+		Camera->Capture = std::stop_source();
+		Camera->Capturing = true;
+		Camera->CaptureThread = std::this_thread::get_id();
+		Camera->CancelNs = 0;
+		Camera->CommandNs = MonotonicNs();
+		Camera->ExposureStartNs = 0;
+		Camera->ExposureEndNs = 0;
+		Stop = Camera->Capture.get_token();
+	}
+
+	/*
+	 * name: ~CaptureScope()
+	 * describe: End the exposure and wake a waiting AbortExposure()
+	 * 描述：结束拍摄并唤醒正在等待的AbortExposure()
+	 * note: The time from the stop request to here is the abort latency
+	 */
+	CAMERA::CaptureScope::~CaptureScope()
+	{
+		std::lock_guard<std::mutex> lock(Camera->captureLock);
+		Camera->Capturing = false;
+		if(Camera->CancelNs > 0)
+		{
+			double latency = (MonotonicNs() - Camera->CancelNs) / 1e6;
+			METRICS::Set("exposure.abort_ms." + Camera->Brand,latency);
+			METRICS::Add("exposure.aborted");
+			/*超过目标延迟的停止，AbortExposure()已经返回失败*/
+			if(latency > CAPTURE_ABORT_WAIT)
+				METRICS::Add("exposure.abort_slow");
+			IDLog("Exposure of %s stopped after %.1f ms\n",Camera->Brand.c_str(),latency);
+			Camera->CancelNs = 0;
+		}
+		Camera->captureCond.notify_all();
+	}
+
+	/*
+	 * name: Exposure(int64_t StartNs,int64_t EndNs)
+	 * @param StartNs:曝光开始的单调时钟(纳秒)
+	 * @param EndNs:曝光结束的单调时钟(纳秒)
+	 * describe: Note when the sensor integrated,SubmitFrame() copies it into the header
+	 * 描述：记录曝光时间，SubmitFrame()将其写入帧信息
+	 */
+	void CAMERA::CaptureScope::Exposure(int64_t StartNs,int64_t EndNs)
+	{
+		std::lock_guard<std::mutex> lock(Camera->captureLock);
+		Camera->ExposureStartNs = StartNs;
+		Camera->ExposureEndNs = EndNs;
+	}
+
+	/*
+	 * name: CancelCapture()
+	 * describe: Stop the running exposure,download included
+	 * 描述：停止正在进行的拍摄，包括下载
+	 * @return false: The capture thread did not leave within CAPTURE_ABORT_WAIT
+	 * note: Called from the capture thread itself it only requests the stop
+	 */
+	bool CAMERA::CancelCapture()
+	{
+		std::stop_source source;
+		{
+			std::lock_guard<std::mutex> lock(captureLock);
+			if(Capturing == false)
+				return true;
+			if(CaptureThread == std::this_thread::get_id())
+			{
+				Capture.request_stop();
+				return true;
+			}
+			if(CancelNs == 0)
+				CancelNs = MonotonicNs();
+			source = Capture;
+		}
+		/*停止回调中会取消等待中的曝光与SDK调用，不能持有captureLock*/
+		source.request_stop();
+		std::unique_lock<std::mutex> lock(captureLock);
+		if(captureCond.wait_for(lock,std::chrono::milliseconds(CAPTURE_ABORT_WAIT),[this]() { return Capturing == false; }) == false)
+		{
+			IDLog("%s capture thread did not stop in time\n",Brand.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	std::stop_token CAMERA::CaptureToken()
+	{
+		std::lock_guard<std::mutex> lock(captureLock);
+		return Capturing ? Capture.get_token() : std::stop_token();
+	}
+
+	/*
+	 * name: SleepUntil(std::stop_token Stop,std::chrono::steady_clock::time_point Deadline)
+	 * @param Stop:停止令牌
+	 * @param Deadline:结束时间
+	 * describe: Sleep until the deadline unless a stop is requested first
+	 * 描述：等待到指定时间，请求停止时立即返回
+	 * @return false: Stopped
+	 */
+	bool CAMERA::SleepUntil(std::stop_token Stop,std::chrono::steady_clock::time_point Deadline)
+	{
+		std::mutex mutex;
+		std::condition_variable_any cond;
+		std::unique_lock<std::mutex> lock(mutex);
+		return cond.wait_until(lock,Stop,Deadline,[]() { return false; }) == false && Stop.stop_requested() == false;
+	}
+
+	/*
+	 * name: RecordDownload(size_t Bytes,int64_t StartNs,int64_t EndNs)
+	 * @param Bytes:下载的字节数
+	 * @param StartNs:开始下载的单调时钟(纳秒)
+	 * @param EndNs:下载完成的单调时钟(纳秒)
+	 * describe: Record the duration and the throughput of one download
+	 * 描述：记录一次下载的耗时与吞吐量，用于调整USB带宽设置
+	 */
+	void CAMERA::RecordDownload(size_t Bytes,int64_t StartNs,int64_t EndNs)
+	{
+		METRICS::Add("usb.frames." + Brand);
+		METRICS::Add("usb.bytes." + Brand,Bytes);
+		if(EndNs <= StartNs)
+			return;
+		double ms = (EndNs - StartNs) / 1e6;
+		METRICS::Observe("usb.download_ms." + Brand,ms);
+		METRICS::Observe("usb.throughput_mbs." + Brand,Bytes / 1048576.0 / (ms / 1000));
+	}
+
+	/*
+	 * name: BurstName(std::string FitsName,int Index)
+	 * @param FitsName:连拍的图像名称
+	 * @param Index:帧序号，从1开始
+	 * describe: File name of one frame of a burst
+	 * 描述：连拍中一帧的文件名
+	 * note: Burst.fits becomes Burst_0001.fits,the index goes before the extension
+	 */
+	std::string CAMERA::BurstName(std::string FitsName,int Index)
+	{
+		char suffix[16];
+		snprintf(suffix,sizeof(suffix),"_%04d",Index);
+		size_t dot = FitsName.rfind('.');
+		size_t slash = FitsName.rfind('/');
+		if(dot == std::string::npos || (slash != std::string::npos && dot < slash))
+			return FitsName + suffix;
+		return FitsName.substr(0,dot) + suffix + FitsName.substr(dot);
+	}
+
+	/*
+	 * name: DrainFrames()
+	 * describe: Wait until the submitted frames are saved
+	 * 描述：等待已提交的帧保存完成
+	 */
+	void CAMERA::DrainFrames()
+	{
+		Pipeline.Drain();
+	}
+
+	/*
+	 * name: Cooling(bool SetPoint,bool CoolDown,bool ASync,bool Warmup,bool CoolerOFF,double Temperature,double Ramp)
+	 * @param SetPoint:直接设置目标温度
+	 * @param CoolDown:以Ramp的速度移向目标温度
+	 * @param ASync:不等待到达目标温度
+	 * @param Warmup:缓慢回温后关闭制冷
+	 * @param CoolerOFF:立即关闭制冷
+	 * @param Temperature:目标温度(°C)
+	 * @param Ramp:温度变化速度(°C/分钟)
+	 * describe: Hand the cooler command to the cooling controller
+	 * 描述：将制冷命令交给制冷控制线程
+	 * @return false: The camera has no cooler,the target is unreasonable or it was not reached in time
+	 */
+	bool CAMERA::Cooling(bool SetPoint,bool CoolDown,bool ASync,bool Warmup,bool CoolerOFF,double Temperature,double Ramp)
+	{
+		const int Id = CoolerId;
+		if(Id < 0)
+		{
+			IDLog("%s camera has no cooler\n",Brand.c_str());
+			return false;
+		}
+		if(CoolerOFF == true)
+			return COOLING::Off(Id);
+		if(Warmup == true)
+			return COOLING::Warmup(Id,Ramp);
+		if(SetPoint == false && CoolDown == false)
+			return false;
+		/*判断输入温度是否合理*/
+		if(Temperature < -50 || Temperature > 40)
+		{
+			IDLog("The temperature setting is unreasonable, please reset it.\n");
+			return false;
+		}
+		if(COOLING::SetTarget(Id,Temperature,SetPoint ? 0 : Ramp) == false)
+			return false;
+		if(ASync == true)
+			return true;
+		if(COOLING::WaitTarget(Id,COOLING_WAIT_MAX) == false)
+		{
+			IDLog("%s camera did not reach %g C in time\n",Brand.c_str(),Temperature);
+			return false;
+		}
+		return true;
+	}
+
+	bool CAMERA::ReadCooler(double &Temperature,double &Power)
+	{
+		return false;
+	}
+
+	bool CAMERA::WriteCooler(bool Enable,double SetPoint)
+	{
+		return false;
+	}
+
+	/*
+	 * name: StartCooler(bool Rewrite)
+	 * @param Rewrite:每次采样都写入设定温度
+	 * describe: Register the camera with the cooling controller
+	 * 描述：将相机交给制冷控制线程采样
+	 * note: Call it after the camera is open,the cooler is left as it is until a command arrives
+	 */
+	void CAMERA::StartCooler(bool Rewrite)
+	{
+		if(CoolerId >= 0)
+			return;
+		CoolerId = COOLING::Register(Brand,
+			[this](double &Temperature,double &Power) { return ReadCooler(Temperature,Power); },
+			[this](bool Enable,double SetPoint) { return WriteCooler(Enable,SetPoint); },
+			[this](const COOLINGSAMPLE &Sample) { TelemetryReady(Sample); },Rewrite);
+	}
+
+	/*
+	 * name: StopCooler()
+	 * describe: Stop sampling the camera
+	 * 描述：停止对相机采样
+	 * note: Call it before the camera is closed,the cooler itself keeps its state
+	 */
+	void CAMERA::StopCooler()
+	{
+		const int Id = CoolerId.exchange(-1);
+		if(Id >= 0)
+			COOLING::Unregister(Id);
+	}
+
+	/*
+	 * name: HoldScan(bool Open)
+	 * @param Open:相机是否已打开
+	 * describe: Keep the background scan away from the brand while the camera is open
+	 * 描述：相机打开期间后台不扫描该品牌
+	 * calls: DISCOVERY::Hold()
+	 * calls: DISCOVERY::Release()
+	 * note: The brand is held only on the transition,so a failed Disconnect()
+	 *       followed by another connect does not hold it twice
+	 */
+	void CAMERA::HoldScan(bool Open)
+	{
+		if(ScanHeld.exchange(Open) == Open)
+			return;
+		if(Open == true)
+			DISCOVERY::Hold(Brand);
+		else
+			DISCOVERY::Release(Brand);
+	}
+
+	/*
+	 * name: RestoreCooler(const DeviceState &state)
+	 * @param state:上次保存的相机状态
+	 * describe: Cool down to the saved target again
+	 * 描述：重新制冷到快照中的目标温度
+	 * note: The ramp starts from the current temperature,a warm sensor is not shocked
+	 */
+	bool CAMERA::RestoreCooler(const DeviceState &state)
+	{
+		if(state.CoolerOn == false || CoolerId < 0)
+			return true;
+		return COOLING::SetTarget(CoolerId,state.TargetTemperature);
+	}
+
+	void CAMERA::FillCoolerState(DeviceState &state)
+	{
+		bool on = false;
+		double target = 0;
+		if(CoolerId >= 0 && COOLING::GetTarget(CoolerId,on,target) == true)
+		{
+			state.CoolerOn = on;
+			state.TargetTemperature = target;
+		}
+	}
+
+	/*
+	 * name: WriteFits(std::shared_ptr<FRAMEJOB> Job)
+	 * @param Job:下载完成的帧
+	 * describe: Pipeline stage,write the frame to a FITS file
+	 * 描述：流水线阶段，将图像写入FITS文件
+	 * note: Color frames are stored as three planes,FITS has no interleaved layout
+	 */
+	void CAMERA::WriteFits(std::shared_ptr<FRAMEJOB> Job)
+	{
+		#if(HAS_FITSIO==ON)
+			const FRAMEHEADER &Header = Job->Header;
+			const size_t pixels = (size_t)Header.Width * Header.Height;
+			const bool is16Bit = Header.BitDepth > 8;
+			/*彩色图像转为平面格式，暂存区不够时才使用堆内存*/
+			const unsigned char *data = Job->Buffer.get();
+			std::vector<unsigned char> spill;
+			if(Header.Channels > 1)
+			{
+				const size_t bytes = pixels * Header.Channels * (is16Bit ? 2 : 1);
+				unsigned char *planes = Job->Arena.Allocate<unsigned char>(bytes);
+				if(planes == nullptr)
+				{
+					spill.resize(bytes);
+					planes = spill.data();
+				}
+				PIXEL::Dispatch(Header,[&]<typename T,int Channels>()
+				{
+					PIXEL::Planar<T,Channels>(reinterpret_cast<const T *>(data),reinterpret_cast<T *>(planes),pixels);
+				});
+				data = planes;
+			}
+			char keywords[FLEN_KEYWORD];		//关键字
+			char value[FLEN_VALUE];		//相机名称
+			char description[FLEN_COMMENT];		//相机品牌
+			strcpy(keywords, "Camera");
+			snprintf(value,sizeof(value),"%s",Job->Camera.c_str());
+			snprintf(description,sizeof(description),"%s",Brand.c_str());
+
+			fitsfile *fptr;		//cFitsIO定义
+			int FitsStatus = 0;		//cFitsio状态
+			long naxis = Header.Channels > 1 ? 3 : 2;
+			long naxes[3] = {Header.Width,Header.Height,Header.Channels};
+			long nelements = pixels * Header.Channels;		//像素数量
+			long fpixel = 1;
+
+			fits_create_file(&fptr, Job->FileName.c_str(), &FitsStatus);		//创建Fits文件
+			fits_create_img(fptr, is16Bit ? USHORT_IMG : BYTE_IMG, naxis, naxes, &FitsStatus);		//16位或8位
+			fits_update_key(fptr, TSTRING, keywords, value, description, &FitsStatus);		//写入Fits图像头文件
+			if(!Job->Bayer.empty())
+			{
+				snprintf(value,sizeof(value),"%s",Job->Bayer.c_str());
+				fits_update_key(fptr, TSTRING, "BAYERPAT", value, "Bayer color pattern", &FitsStatus);
+			}
+			/*拍摄各阶段的UTC时间*/
+			const int64_t offset = Header.UtcNs - Header.MonotonicNs;
+			if(Header.ExposureStartNs > 0)
+			{
+				fits_update_key(fptr, TSTRING, "DATE-OBS", const_cast<char *>(IsoTime(Header.ExposureStartNs + offset).c_str()), "UTC start of exposure", &FitsStatus);
+				if(Header.ExposureEndNs > Header.ExposureStartNs)
+				{
+					double exptime = (Header.ExposureEndNs - Header.ExposureStartNs) / 1e9;
+					fits_update_key(fptr, TSTRING, "DATE-END", const_cast<char *>(IsoTime(Header.ExposureEndNs + offset).c_str()), "UTC end of exposure", &FitsStatus);
+					fits_update_key(fptr, TDOUBLE, "EXPTIME", &exptime, "Exposure time in seconds", &FitsStatus);
+				}
+			}
+			if(Header.CommandNs > 0)
+				fits_update_key(fptr, TSTRING, "DATE-CMD", const_cast<char *>(IsoTime(Header.CommandNs + offset).c_str()), "UTC the driver received the command", &FitsStatus);
+			fits_update_key(fptr, TSTRING, "DATE-DL", const_cast<char *>(IsoTime(Header.UtcNs).c_str()), "UTC the download completed", &FitsStatus);
+			fits_write_img(fptr, is16Bit ? TUSHORT : TBYTE, fpixel, nelements, const_cast<unsigned char *>(data), &FitsStatus);		//将缓存图像写入文件
+			fits_close_file(fptr, &FitsStatus);		//关闭Fits图像
+			fits_report_error(stderr, FitsStatus);		//如果有错则返回错误信息
+		#endif
+		Job->FitsNs = MonotonicNs();
+	}
+
+	/*
+	 * name: WritePreview(std::shared_ptr<FRAMEJOB> Job)
+	 * @param Job:下载完成的帧
+	 * describe: Pipeline stage,encode the JPG preview and tell the server
+	 * 描述：流水线阶段，生成JPG预览图并通知服务器
+	 */
+	void CAMERA::WritePreview(std::shared_ptr<FRAMEJOB> Job)
+	{
+		if(Job->Preview == false)
+			return;
+		#if(HAS_OPENCV==ON)
+			/*彩色转换与8位图像的大小，超出预算时跳过这一帧的预览*/
+			const size_t pixels = (size_t)Job->Header.Width * Job->Header.Height * (Job->Bayer.empty() ? Job->Header.Channels : 3);
+			const size_t bytes = pixels * ((Job->Header.BitDepth + 7) / 8) + pixels;
+			if(MEMBUDGET::Reserve(bytes,true) == false)
+			{
+				METRICS::Add("membudget.skipped_previews");
+				return;
+			}
+			OPENCV::SaveImage(Job->Buffer.get(),Job->FileName,Job->Header,Job->Bayer,-1,-1,&Job->Arena);
+			MEMBUDGET::Release(bytes);
+		#endif
+		FRAMETIMING timing;
+		timing.CommandNs = Job->Header.CommandNs;
+		timing.ExposureStartNs = Job->Header.ExposureStartNs;
+		timing.ExposureEndNs = Job->Header.ExposureEndNs;
+		timing.DownloadNs = Job->Header.MonotonicNs;
+		timing.FitsNs = Job->FitsNs;		//与预览并行写入，可能尚未完成
+		timing.PreviewNs = MonotonicNs();
+		timing.UtcOffsetNs = Job->Header.UtcNs - Job->Header.MonotonicNs;
+		PreviewReady(Job->FileName,timing);
+	}
+
+	/*
+	 * name: Analyse(std::shared_ptr<FRAMEJOB> Job)
+	 * @param Job:下载完成的帧
+	 * describe: Pipeline stage,calculate the histogram
+	 * 描述：流水线阶段，计算直方图
+	 */
+	void CAMERA::Analyse(std::shared_ptr<FRAMEJOB> Job)
+	{
+		if(Job->Preview == false)
+			return;
+		#if(HAS_OPENCV==ON)
+			OPENCV::clacHistogram(Job->Buffer.get(),Job->Header);
+		#endif
+	}
+
+	/*
+	 * name: StartRecord(std::string FileName,bool Direct)
+	 * @param FileName:SER文件名
+	 * @param Direct:是否使用O_DIRECT写入
+	 * describe: Record the video stream to a SER file
+	 * 描述：将视频流录制为SER文件
+	 * @return false: A recording is already running
+	 * note: The file is created with the next video frame,so recording may start before or after StartVideo()
+	 */
+	bool CAMERA::StartRecord(std::string FileName,bool Direct)
+	{
+		std::lock_guard<std::mutex> guard(recordLock);
+		if(Recorder != nullptr || FileName.empty())
+			return false;
+		Recorder = std::make_unique<SERWRITER>(Brand);
+		RecordName = FileName;
+		RecordDirect = Direct;
+		return true;
+	}
+
+	/*
+	 * name: StopRecord()
+	 * describe: Finish the SER file
+	 * 描述：结束录制并写入SER文件尾
+	 * @return false: Some frames could not be written
+	 */
+	bool CAMERA::StopRecord()
+	{
+		std::unique_ptr<SERWRITER> recorder;
+		{
+			std::lock_guard<std::mutex> guard(recordLock);
+			recorder.swap(Recorder);
+			RecordName.clear();
+		}
+		/*在锁外关闭，写入剩余数据时不阻塞视频线程*/
+		if(recorder == nullptr || recorder->IsOpen() == false)
+			return true;
+		return recorder->Close();
+	}
+
+	/*
+	 * name: VideoFrame(const FRAMEHEADER &Header,const unsigned char *Data)
+	 * @param Header:帧信息
+	 * @param Data:图像数据，只在调用期间有效
+	 * describe: Record and publish one video frame
+	 * 描述：录制并发布一帧视频
+	 * note: Runs on the consumer thread of the video capture
+	 */
+	void CAMERA::VideoFrame(const FRAMEHEADER &Header,const unsigned char *Data)
+	{
+		{
+			std::lock_guard<std::mutex> guard(recordLock);
+			if(Recorder != nullptr && Recorder->IsOpen() == false)
+			{
+				if(Recorder->Open(RecordName,Header,BayerPattern,Brand,RecordDirect) == false)
+				{
+					IDLog("Unable to record video to %s\n",RecordName.c_str());
+					Recorder = nullptr;
+				}
+			}
+			if(Recorder != nullptr)
+				Recorder->Write(Header,Data);
+		}
+		PublishFrame(Header,Data);
+	}
+
+	/*
+	 * name: StretchImage(std::string FitsName,int Low,int High,int X,int Y,int Width,int Height)
+	 * @param FitsName:图像名称，为空时使用最新一帧
+	 * @param Low:黑点(ADU)，小于0时自动确定
+	 * @param High:白点(ADU)，小于0时自动确定
+	 * @param X,Y,Width,Height:预览的区域，宽高为0时为整帧
+	 * describe: Make a new preview of a cached frame
+	 * 描述：使用缓存的原始帧重新生成预览图
+	 * @return false: The frame is no longer cached
+	 * note: Nothing is read from the disk,the client gets the usual NewJPGReady message
+	 */
+	bool CAMERA::StretchImage(std::string FitsName,int Low,int High,int X,int Y,int Width,int Height)
+	{
+		std::shared_ptr<FRAMEJOB> Job = Cache.Get(FitsName);
+		if(Job == nullptr)
+		{
+			IDLog("%s is not in the frame cache\n",FitsName.c_str());
+			return false;
+		}
+		const int64_t start = MonotonicNs();
+		#if(HAS_OPENCV==ON)
+			FRAMEHEADER header;
+			std::vector<unsigned char> copy;
+			const unsigned char *data = Region(*Job,X,Y,Width,Height,header,copy);
+			if(data == nullptr)
+				return false;
+			OPENCV::SaveImage(data,Job->FileName,header,Job->Bayer,Low,High);
+		#endif
+		METRICS::Observe("framecache.stretch_ms",(MonotonicNs() - start) / 1e6);
+		/*只带上拍摄时间，不计入拍摄延迟统计*/
+		FRAMETIMING timing;
+		timing.ExposureStartNs = Job->Header.ExposureStartNs;
+		timing.DownloadNs = Job->Header.MonotonicNs;
+		timing.UtcOffsetNs = Job->Header.UtcNs - Job->Header.MonotonicNs;
+		PreviewReady(Job->FileName,timing);
+		return true;
+	}
+
+	/*
+	 * name: ImageStats(std::string FitsName,int X,int Y,int Width,int Height,FRAMESTATS &Stats)
+	 * @param FitsName:图像名称，为空时使用最新一帧
+	 * @param X,Y,Width,Height:统计的区域，宽高为0时为整帧
+	 * @param Stats:统计结果
+	 * describe: Statistics of a cached frame
+	 * 描述：计算缓存帧的统计信息
+	 * @return false: The frame is no longer cached
+	 */
+	bool CAMERA::ImageStats(std::string FitsName,int X,int Y,int Width,int Height,FRAMESTATS &Stats)
+	{
+		std::shared_ptr<FRAMEJOB> Job = Cache.Get(FitsName);
+		if(Job == nullptr)
+		{
+			IDLog("%s is not in the frame cache\n",FitsName.c_str());
+			return false;
+		}
+		FRAMEHEADER header;
+		std::vector<unsigned char> copy;
+		const unsigned char *data = Region(*Job,X,Y,Width,Height,header,copy);
+		if(data == nullptr)
+			return false;
+		Stats.X = X;
+		Stats.Y = Y;
+		Stats.Width = Width;
+		Stats.Height = Height;
+		return Statistics(data,header,Stats);
+	}
+}
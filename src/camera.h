@@ -0,0 +1,161 @@
+/*
+ * camera.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Common base of camera drivers
+
+**************************************************/
+
+#pragma once
+
+#ifndef _CAMERA_H_
+#define _CAMERA_H_
+
+#include "wsserver.h"
+#include "framepool.h"
+#include "pipeline.h"
+#include "framecache.h"
+#include "serwriter.h"
+
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <stop_token>
+#include <memory>
+
+#define CAPTURE_ABORT_WAIT 100		//停止曝光的目标延迟，也是等待拍摄线程退出的最长时间(毫秒)
+
+namespace AstroAir
+{
+	/*
+	 * Base of the camera drivers. A driver only downloads the frame into a
+	 * buffer from Frames and hands it to SubmitFrame(); publishing,the FITS
+	 * file,the preview and the histogram are shared and run in the pipeline.
+	 */
+	class CAMERA : public WSSERVER
+	{
+		public:
+			explicit CAMERA(std::string Brand);
+			virtual ~CAMERA();
+			/*制冷，由制冷控制线程按设定速度调整温度*/
+			virtual bool Cooling(bool SetPoint,bool CoolDown,bool ASync,bool Warmup,bool CoolerOFF,double Temperature,double Ramp) override;
+			/*使用缓存的原始帧重新生成预览与统计*/
+			virtual bool StretchImage(std::string FitsName,int Low,int High,int X,int Y,int Width,int Height) override;
+			virtual bool ImageStats(std::string FitsName,int X,int Y,int Width,int Height,FRAMESTATS &Stats) override;
+			/*将视频流录制为SER文件*/
+			virtual bool StartRecord(std::string FileName,bool Direct) override;
+			virtual bool StopRecord() override;
+		protected:
+			/*
+			 * One exposure from start to download. Every wait inside it takes
+			 * Stop,so AbortExposure() wakes the capture thread at once instead
+			 * of waiting for the SDK or the next poll.
+			 */
+			class CaptureScope
+			{
+				public:
+					explicit CaptureScope(CAMERA *Camera);
+					~CaptureScope();
+					/*记录曝光开始与结束的单调时钟(纳秒)，下载的帧会带上这些时间*/
+					void Exposure(int64_t StartNs,int64_t EndNs);
+					std::stop_token Stop;
+				private:
+					CAMERA *Camera;
+			};
+			/*停止正在进行的拍摄并等待拍摄线程退出*/
+			bool CancelCapture();
+			/*当前拍摄的停止令牌，没有拍摄时不会被请求停止*/
+			std::stop_token CaptureToken();
+			/*可取消的等待，返回false表示被停止*/
+			static bool SleepUntil(std::stop_token Stop,std::chrono::steady_clock::time_point Deadline);
+			/*记录一次下载的字节数与单调时钟(纳秒)，统计USB吞吐量*/
+			void RecordDownload(size_t Bytes,int64_t StartNs,int64_t EndNs);
+			/*下载完成后调用，发布帧并交给流水线保存*/
+			void SubmitFrame(const FRAMEHEADER &Header,FRAMEBUFFER Buffer,std::string FitsName,std::string Camera,bool Preview = true);
+			/*视频采集的每一帧，录制时写入SER文件，然后发布*/
+			void VideoFrame(const FRAMEHEADER &Header,const unsigned char *Data);
+			/*连拍中第Index帧的文件名*/
+			static std::string BurstName(std::string FitsName,int Index);
+			/*等待已提交的帧处理完成*/
+			void DrainFrames();
+			/*读取传感器温度(°C)与制冷功率(%)，在制冷线程中调用，不能使用拍摄路径上的锁*/
+			virtual bool ReadCooler(double &Temperature,double &Power);
+			/*打开或关闭制冷并写入设定温度*/
+			virtual bool WriteCooler(bool Enable,double SetPoint);
+			/*连接制冷相机后开始采样，断开前停止。Rewrite为真时每次采样都写入设定温度*/
+			void StartCooler(bool Rewrite = false);
+			void StopCooler();
+			/*恢复快照中的制冷设置*/
+			bool RestoreCooler(const DeviceState &state);
+			/*将制冷状态写入快照*/
+			void FillCoolerState(DeviceState &state);
+			/*相机打开或关闭后调用，占用或释放该品牌的设备扫描，重复调用不改变计数*/
+			void HoldScan(bool Open);
+
+			std::string Brand;		//相机品牌，写入FITS头
+			std::string BayerPattern;		//原始图像的拜耳阵列(如RGGB)，黑白相机为空
+			/*帧缓冲池*/
+			FRAMEPOOL Frames;
+			/*流水线各阶段的暂存内存*/
+			ARENAPOOL Scratch;
+		private:
+			/*正在进行的拍摄，由captureLock保护*/
+			std::mutex captureLock;
+			std::condition_variable captureCond;
+			std::stop_source Capture;
+			bool Capturing = false;
+			std::thread::id CaptureThread;
+			int64_t CancelNs = 0;		//请求停止的时间，用于统计停止延迟
+			/*当前拍摄各阶段的单调时钟(纳秒)*/
+			int64_t CommandNs = 0;
+			int64_t ExposureStartNs = 0;
+			int64_t ExposureEndNs = 0;
+			/*最近几帧的原始数据*/
+			FRAMECACHE Cache;
+			/*视频录制，收到第一帧后才知道图像格式，因此在VideoFrame中创建文件*/
+			std::mutex recordLock;
+			std::unique_ptr<SERWRITER> Recorder;
+			std::string RecordName;
+			bool RecordDirect = false;
+			/*制冷控制编号，没有制冷时为-1*/
+			std::atomic_int CoolerId{-1};
+			/*是否占用了设备扫描，析构时仍占用则释放*/
+			std::atomic_bool ScanHeld{false};
+			/*流水线各阶段*/
+			void WriteFits(std::shared_ptr<FRAMEJOB> Job);
+			void WritePreview(std::shared_ptr<FRAMEJOB> Job);
+			void Analyse(std::shared_ptr<FRAMEJOB> Job);
+
+			/*图像保存、预览与分析流水线，最先析构以便处理完剩余的帧*/
+			PIPELINE Pipeline;
+	};
+}
+
+#endif
@@ -11,3 +11,8 @@
 #define HAS_QHY ON
 #define HAS_ASI ON
 #define HAS_INDI ON
+#define HAS_SIMULATOR ON
+
+#define HAS_LIBUSB
+#define HAS_PLUGIN
+#define PLUGIN_DIR "/usr/local/lib/airserver"
\ No newline at end of file
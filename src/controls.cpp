@@ -0,0 +1,155 @@
+/*
+ * controls.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Cache of camera control values
+
+**************************************************/
+
+#include <cmath>
+
+#include "logger.h"
+#include "metrics.h"
+#include "controls.h"
+
+namespace AstroAir
+{
+	CONTROLCACHE::CONTROLCACHE(std::string Device) : Device(Device)
+	{
+	}
+
+	/*
+	 * name: SetRange(int Id,std::string Name,double Min,double Max,double Step)
+	 * @param Id:控制项编号
+	 * @param Name:控制项名称，用于日志
+	 * @param Min:最小值
+	 * @param Max:最大值
+	 * @param Step:步长，为0时不检查
+	 * describe: Keep the range of a control read from the SDK
+	 * 描述：记录SDK给出的控制项取值范围
+	 */
+	void CONTROLCACHE::SetRange(int Id,std::string Name,double Min,double Max,double Step)
+	{
+		std::lock_guard<std::mutex> guard(Lock);
+		Entry &entry = Entries[Id];
+		entry.Name = Name;
+		entry.HasRange = true;
+		entry.Min = Min;
+		entry.Max = Max;
+		entry.Step = Step;
+	}
+
+	/*
+	 * name: Apply(int Id,double Value,std::function<bool(double Value)> Write)
+	 * @param Id:控制项编号
+	 * @param Value:需要设置的值
+	 * @param Write:调用SDK写入的函数
+	 * describe: Write a control only if the value changed
+	 * 描述：只有值变化时才调用SDK写入
+	 * @return false: Out of range or the SDK failed
+	 */
+	bool CONTROLCACHE::Apply(int Id,double Value,std::function<bool(double Value)> Write)
+	{
+		{
+			std::lock_guard<std::mutex> guard(Lock);
+			auto it = Entries.find(Id);
+			if(it != Entries.end() && it->second.HasRange == true)
+			{
+				const Entry &entry = it->second;
+				bool offStep = entry.Step > 0 && std::fabs(std::remainder(Value - entry.Min,entry.Step)) > entry.Step * 1e-6;
+				if(Value < entry.Min || Value > entry.Max || offStep == true)
+				{
+					METRICS::Add("controls.rejected");
+					IDLog("%s of %s should be in [%g,%g] with step %g,got %g\n",entry.Name.c_str(),Device.c_str(),entry.Min,entry.Max,entry.Step,Value);
+					return false;
+				}
+			}
+		}
+		return Apply(Id,std::vector<double>{Value},[&Write](const std::vector<double> &Values) { return Write(Values[0]); });
+	}
+
+	/*
+	 * name: Apply(int Id,std::vector<double> Values,WRITEFUNC Write)
+	 * @param Id:控制项编号，组合设置使用CONTROL_CACHE_*
+	 * @param Values:需要设置的值
+	 * @param Write:调用SDK写入的函数
+	 * describe: Write a group of values only if one of them changed
+	 * 描述：只有值变化时才调用SDK写入
+	 * note: The SDK is called without the lock,a failed write forgets the value so it is sent again next time
+	 */
+	bool CONTROLCACHE::Apply(int Id,std::vector<double> Values,WRITEFUNC Write)
+	{
+		{
+			std::lock_guard<std::mutex> guard(Lock);
+			auto it = Entries.find(Id);
+			if(it != Entries.end() && it->second.Known == true && it->second.Values == Values)
+			{
+				METRICS::Add("controls.skipped");
+				return true;
+			}
+		}
+		METRICS::Add("controls.writes");
+		bool ok = Write(Values);
+		std::lock_guard<std::mutex> guard(Lock);
+		Entry &entry = Entries[Id];
+		entry.Known = ok;
+		entry.Values = Values;
+		return ok;
+	}
+
+	/*
+	 * name: Invalidate()
+	 * describe: Forget every value,the next Apply() writes it again
+	 * 描述：清除所有记录的值，下次设置时重新写入
+	 */
+	void CONTROLCACHE::Invalidate()
+	{
+		std::lock_guard<std::mutex> guard(Lock);
+		for(auto &it : Entries)
+			it.second.Known = false;
+	}
+
+	void CONTROLCACHE::Invalidate(int Id)
+	{
+		std::lock_guard<std::mutex> guard(Lock);
+		auto it = Entries.find(Id);
+		if(it != Entries.end())
+			it->second.Known = false;
+	}
+
+	/*
+	 * name: Clear()
+	 * describe: Forget values and ranges,used when the camera is closed
+	 * 描述：清除记录的值与取值范围，关闭相机时使用
+	 */
+	void CONTROLCACHE::Clear()
+	{
+		std::lock_guard<std::mutex> guard(Lock);
+		Entries.clear();
+	}
+}
@@ -0,0 +1,93 @@
+/*
+ * controls.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Cache of camera control values
+
+**************************************************/
+
+#pragma once
+
+#ifndef _CONTROLS_H_
+#define _CONTROLS_H_
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*不对应SDK控制项的组合设置，编号避开各SDK的控制项*/
+#define CONTROL_CACHE_FORMAT 0x10000		//像素合并、画面大小与图像格式
+#define CONTROL_CACHE_START 0x10001		//子画面起点
+
+namespace AstroAir
+{
+	/*
+	 * Remembers the last value written to each control of a camera, so
+	 * SetCameraConfig() before every exposure only talks to the SDK for
+	 * the values that actually changed. The range read once from the SDK
+	 * is used to refuse bad values without a USB transfer.
+	 * Invalidate() after anything that resets the camera (open,init,mode switch).
+	 */
+	class CONTROLCACHE
+	{
+		public:
+			/*写入函数，返回是否成功*/
+			typedef std::function<bool(const std::vector<double> &Values)> WRITEFUNC;
+
+			explicit CONTROLCACHE(std::string Device);
+			/*记录SDK给出的取值范围*/
+			void SetRange(int Id,std::string Name,double Min,double Max,double Step);
+			/*值变化时才写入*/
+			bool Apply(int Id,double Value,std::function<bool(double Value)> Write);
+			bool Apply(int Id,std::vector<double> Values,WRITEFUNC Write);
+			/*相机重置后清除记录的值*/
+			void Invalidate();
+			void Invalidate(int Id);
+			/*清除记录的值与取值范围*/
+			void Clear();
+		private:
+			struct Entry
+			{
+				std::string Name;
+				bool HasRange = false;
+				double Min = 0;
+				double Max = 0;
+				double Step = 0;
+				bool Known = false;		//Values是否与相机一致
+				std::vector<double> Values;
+			};
+
+			std::string Device;
+			std::mutex Lock;
+			std::map<int,Entry> Entries;
+	};
+}
+
+#endif
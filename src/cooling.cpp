@@ -0,0 +1,438 @@
+/*
+ * cooling.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Cooling controller and temperature telemetry
+
+**************************************************/
+
+#include <map>
+#include <queue>
+#include <cmath>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+
+#include "logger.h"
+#include "metrics.h"
+#include "threads.h"
+#include "frame.h"
+#include "cooling.h"
+
+namespace AstroAir::COOLING
+{
+	typedef std::chrono::steady_clock Clock;
+
+	enum MODE
+	{
+		MODE_OFF,		//制冷关闭
+		MODE_COOL,		//移向并保持目标温度
+		MODE_WARMUP		//回温，到达后关闭
+	};
+
+	struct Cooler
+	{
+		std::string Device;
+		READFUNC Read;
+		WRITEFUNC Write;
+		TELEMETRYFUNC Telemetry;
+		MODE Mode = MODE_OFF;
+		double Target = 0;
+		double Ramp = COOLING_RAMP;
+		double SetPoint = NAN;		//当前设定温度，未知时为NAN
+		Clock::time_point Stepped;		//上次移动设定温度的时间
+		Clock::time_point Due;		//下一次执行的时间，与之不同的定时器已经过期
+		bool Written = false;		//关闭状态是否已经写入相机
+		bool Rewrite = false;		//每次采样都写入设定温度
+		/*固定大小的环形缓冲区*/
+		std::vector<COOLINGSAMPLE> Ring;
+		size_t Next = 0;
+		/*抽取窗口内的累计值*/
+		COOLINGSAMPLE Sum;
+		int Count = 0;
+	};
+
+	typedef std::pair<Clock::time_point,int> Timer;
+
+	/*
+	 * Same shape as the exposure engine: one thread sleeps until the next
+	 * camera is due,reads it,moves the setpoint one ramp step and goes
+	 * back to sleep. The callbacks go straight to the SDK without the
+	 * locks of the capture path,so a read never waits for a download.
+	 */
+	struct Engine
+	{
+		std::mutex Lock;
+		std::condition_variable Cond;
+		std::map<int,Cooler> Coolers;
+		std::priority_queue<Timer,std::vector<Timer>,std::greater<Timer>> Timers;
+		int NextId = 0;
+		int Current = -1;		//正在调用回调的相机
+		bool Running = false;
+		std::thread Worker;
+
+		~Engine()
+		{
+			{
+				std::lock_guard<std::mutex> guard(Lock);
+				Running = false;
+			}
+			Cond.notify_all();
+			if(Worker.joinable())
+				Worker.join();
+		}
+	};
+
+	static Engine &State()
+	{
+		static Engine engine;
+		return engine;
+	}
+
+	/*
+	 * name: Step(Cooler &cooler,double Temperature,Clock::time_point Now)
+	 * @param cooler:相机
+	 * @param Temperature:当前温度
+	 * @param Now:本次采样时间
+	 * describe: Move the setpoint toward the target by the ramp times the time since the last step
+	 * 描述：按距上次移动的时间将设定温度向目标移动
+	 * note: Commands run the cooler at once,so the steps are not always COOLING_INTERVAL apart
+	 */
+	static void Step(Cooler &cooler,double Temperature,Clock::time_point Now)
+	{
+		std::chrono::duration<double,std::milli> elapsed = Now - cooler.Stepped;
+		cooler.Stepped = Now;
+		if(std::isnan(cooler.SetPoint))
+		{
+			cooler.SetPoint = Temperature;		//从当前温度开始变化
+			elapsed = elapsed.zero();
+		}
+		const double step = cooler.Ramp > 0 ? cooler.Ramp * elapsed.count() / 60000.0 : INFINITY;
+		const double diff = cooler.Target - cooler.SetPoint;
+		cooler.SetPoint = std::fabs(diff) <= step ? cooler.Target : cooler.SetPoint + std::copysign(step,diff);
+	}
+
+	/*
+	 * name: Work()
+	 * describe: Controller thread,sample and drive each cooler when it is due
+	 * 描述：控制线程，按时采样并调整每台相机的制冷
+	 */
+	static void Work()
+	{
+		THREADS::Enter(THREADS::ROLE_PROCESSING,"air-cooling");
+		Engine &E = State();
+		std::unique_lock<std::mutex> lock(E.Lock);
+		while(E.Running == true)
+		{
+			if(E.Timers.empty())
+			{
+				E.Cond.wait(lock);
+				continue;
+			}
+			Timer next = E.Timers.top();
+			if(Clock::now() < next.first)
+			{
+				E.Cond.wait_until(lock,next.first);
+				continue;
+			}
+			E.Timers.pop();
+			auto it = E.Coolers.find(next.second);
+			if(it == E.Coolers.end())
+				continue;		//已注销
+			if(it->second.Due != next.first)
+				continue;		//命令已经重新安排了这台相机
+			E.Current = next.second;
+			READFUNC Read = it->second.Read;
+			lock.unlock();
+			double temperature = NAN,power = 0;
+			bool ok = Read(temperature,power);
+			METRICS::Add("cooling.samples");
+			lock.lock();
+			it = E.Coolers.find(next.second);
+			if(it == E.Coolers.end())
+			{
+				/*回调期间已注销*/
+				E.Current = -1;
+				E.Cond.notify_all();
+				continue;
+			}
+			Cooler &cooler = it->second;
+			/*计算新的设定温度，只在变化时写入*/
+			bool write = false,enable = cooler.Mode != MODE_OFF;
+			double previous = cooler.SetPoint;
+			if(ok == true && cooler.Mode != MODE_OFF)
+			{
+				Step(cooler,temperature,Clock::now());
+				write = cooler.Rewrite || cooler.SetPoint != previous;
+				/*设定温度已到回温目标且传感器跟上后关闭制冷*/
+				if(cooler.Mode == MODE_WARMUP && cooler.SetPoint == cooler.Target && temperature >= cooler.Target - COOLING_TOLERANCE)
+				{
+					cooler.Mode = MODE_OFF;
+					cooler.Written = false;
+					enable = false;
+				}
+			}
+			if(cooler.Mode == MODE_OFF && cooler.Written == false)
+			{
+				write = true;
+				cooler.Written = true;
+				cooler.SetPoint = NAN;
+			}
+			WRITEFUNC Write = cooler.Write;
+			double setpoint = cooler.SetPoint;
+			COOLINGSAMPLE sample;
+			bool publish = false;
+			if(ok == true)
+			{
+				sample.UtcNs = UtcNs();
+				sample.Temperature = temperature;
+				sample.Power = power;
+				sample.SetPoint = enable ? setpoint : NAN;
+				sample.CoolerOn = enable;
+				if(cooler.Ring.size() < COOLING_HISTORY)
+					cooler.Ring.push_back(sample);
+				else
+					cooler.Ring[cooler.Next] = sample;
+				cooler.Next = (cooler.Next + 1) % COOLING_HISTORY;
+				/*抽取窗口取平均值后推送*/
+				cooler.Sum.Temperature += temperature;
+				cooler.Sum.Power += power;
+				if(++cooler.Count >= COOLING_DECIMATE)
+				{
+					sample.Temperature = cooler.Sum.Temperature / cooler.Count;
+					sample.Power = cooler.Sum.Power / cooler.Count;
+					cooler.Sum = COOLINGSAMPLE();
+					cooler.Count = 0;
+					publish = true;
+				}
+				E.Cond.notify_all();		//唤醒等待目标温度的线程
+			}
+			else
+				METRICS::Add("cooling.read_errors");
+			TELEMETRYFUNC Telemetry = cooler.Telemetry;
+			std::string device = cooler.Device;
+			lock.unlock();
+			if(write == true && Write(enable,setpoint) == false)
+			{
+				IDLog("Unable to set the cooler of %s\n",device.c_str());
+				METRICS::Add("cooling.write_errors");
+			}
+			if(publish == true && Telemetry)
+				Telemetry(sample);
+			lock.lock();
+			E.Current = -1;
+			E.Cond.notify_all();
+			/*每台相机只有一个有效的定时器，回调期间的命令已经安排了下一次执行*/
+			it = E.Coolers.find(next.second);
+			if(it != E.Coolers.end() && it->second.Due == next.first)
+			{
+				it->second.Due = next.first + std::chrono::milliseconds(COOLING_INTERVAL);
+				E.Timers.push(Timer(it->second.Due,next.second));
+			}
+		}
+	}
+
+	/*
+	 * name: Register(std::string Device,READFUNC Read,WRITEFUNC Write,TELEMETRYFUNC Telemetry,bool Rewrite)
+	 * @param Device:设备名称，用于日志
+	 * @param Read:读取温度与制冷功率
+	 * @param Write:写入制冷状态与设定温度
+	 * @param Telemetry:抽取后的温度数据接收者
+	 * @param Rewrite:每次采样都写入设定温度，用于在SDK中调节温度的相机
+	 * describe: Start sampling a cooled camera
+	 * 描述：开始对制冷相机采样
+	 * note: The cooler is left as it is until a target is set
+	 */
+	int Register(std::string Device,READFUNC Read,WRITEFUNC Write,TELEMETRYFUNC Telemetry,bool Rewrite)
+	{
+		Engine &E = State();
+		std::lock_guard<std::mutex> guard(E.Lock);
+		if(E.Running == false)
+		{
+			E.Running = true;
+			E.Worker = std::thread(Work);
+		}
+		int Id = ++E.NextId;
+		Cooler &cooler = E.Coolers[Id];
+		cooler.Device = Device;
+		cooler.Read = Read;
+		cooler.Write = Write;
+		cooler.Telemetry = Telemetry;
+		cooler.Rewrite = Rewrite;
+		cooler.Written = true;
+		cooler.Ring.reserve(COOLING_HISTORY);
+		cooler.Due = Clock::now();
+		E.Timers.push(Timer(cooler.Due,Id));
+		E.Cond.notify_all();
+		return Id;
+	}
+
+	/*
+	 * name: Unregister(int Id)
+	 * @param Id:相机编号
+	 * describe: Stop sampling a camera
+	 * 描述：停止对相机采样
+	 * note: Waits for a callback of the camera that is running,must not be called from one
+	 */
+	void Unregister(int Id)
+	{
+		Engine &E = State();
+		std::unique_lock<std::mutex> lock(E.Lock);
+		E.Coolers.erase(Id);
+		E.Cond.wait(lock,[&E,Id]() { return E.Current != Id; });
+	}
+
+	/*修改相机的控制状态并立即执行一次，原来的定时器随之过期*/
+	static bool Command(int Id,std::function<void(Cooler &cooler)> Change)
+	{
+		Engine &E = State();
+		std::lock_guard<std::mutex> guard(E.Lock);
+		auto it = E.Coolers.find(Id);
+		if(it == E.Coolers.end())
+			return false;
+		Change(it->second);
+		it->second.Due = Clock::now();
+		E.Timers.push(Timer(it->second.Due,Id));
+		E.Cond.notify_all();
+		return true;
+	}
+
+	/*
+	 * name: SetTarget(int Id,double Target,double Ramp)
+	 * @param Id:相机编号
+	 * @param Target:目标温度(°C)
+	 * @param Ramp:温度变化速度(°C/分钟)，为0时直接设置
+	 * describe: Cool down or warm up to a target and hold it
+	 * 描述：降温或升温到目标温度并保持
+	 */
+	bool SetTarget(int Id,double Target,double Ramp)
+	{
+		return Command(Id,[Target,Ramp](Cooler &cooler)
+		{
+			cooler.Mode = MODE_COOL;
+			cooler.Target = Target;
+			cooler.Ramp = Ramp;
+		});
+	}
+
+	/*
+	 * name: Warmup(int Id,double Ramp)
+	 * @param Id:相机编号
+	 * @param Ramp:温度变化速度(°C/分钟)
+	 * describe: Ramp up to COOLING_WARMUP_TEMP and switch the cooler off
+	 * 描述：缓慢升温到COOLING_WARMUP_TEMP后关闭制冷，避免传感器结露
+	 */
+	bool Warmup(int Id,double Ramp)
+	{
+		return Command(Id,[Ramp](Cooler &cooler)
+		{
+			if(cooler.Mode == MODE_OFF)
+				return;
+			cooler.Mode = MODE_WARMUP;
+			cooler.Target = COOLING_WARMUP_TEMP;
+			cooler.Ramp = Ramp;
+		});
+	}
+
+	bool Off(int Id)
+	{
+		return Command(Id,[](Cooler &cooler)
+		{
+			cooler.Mode = MODE_OFF;
+			cooler.Written = false;
+		});
+	}
+
+	/*
+	 * name: WaitTarget(int Id,int Timeout)
+	 * @param Id:相机编号
+	 * @param Timeout:超时时间(毫秒)
+	 * describe: Wait until the setpoint reached the target and the sensor followed it
+	 * 描述：等待设定温度到达目标且传感器温度跟上
+	 * @return false: Timed out,the cooler was switched off or the camera unregistered
+	 */
+	bool WaitTarget(int Id,int Timeout)
+	{
+		Engine &E = State();
+		std::unique_lock<std::mutex> lock(E.Lock);
+		bool reached = false;
+		E.Cond.wait_for(lock,std::chrono::milliseconds(Timeout),[&E,Id,&reached]()
+		{
+			auto it = E.Coolers.find(Id);
+			if(it == E.Coolers.end() || it->second.Mode == MODE_OFF)
+				return true;
+			const Cooler &cooler = it->second;
+			if(cooler.Ring.empty() || cooler.SetPoint != cooler.Target)
+				return false;
+			const COOLINGSAMPLE &last = cooler.Ring[(cooler.Next + COOLING_HISTORY - 1) % COOLING_HISTORY];
+			reached = std::fabs(last.Temperature - cooler.Target) <= COOLING_TOLERANCE;
+			return reached;
+		});
+		return reached;
+	}
+
+	bool GetTarget(int Id,bool &CoolerOn,double &Target)
+	{
+		Engine &E = State();
+		std::lock_guard<std::mutex> guard(E.Lock);
+		auto it = E.Coolers.find(Id);
+		if(it == E.Coolers.end())
+			return false;
+		CoolerOn = it->second.Mode == MODE_COOL;
+		Target = it->second.Target;
+		return true;
+	}
+
+	bool Latest(int Id,COOLINGSAMPLE &Sample)
+	{
+		Engine &E = State();
+		std::lock_guard<std::mutex> guard(E.Lock);
+		auto it = E.Coolers.find(Id);
+		if(it == E.Coolers.end() || it->second.Ring.empty())
+			return false;
+		Sample = it->second.Ring[(it->second.Next + COOLING_HISTORY - 1) % COOLING_HISTORY];
+		return true;
+	}
+
+	std::vector<COOLINGSAMPLE> History(int Id)
+	{
+		Engine &E = State();
+		std::lock_guard<std::mutex> guard(E.Lock);
+		std::vector<COOLINGSAMPLE> samples;
+		auto it = E.Coolers.find(Id);
+		if(it == E.Coolers.end())
+			return samples;
+		const Cooler &cooler = it->second;
+		/*缓冲区写满后最旧的样本在Next处*/
+		size_t start = cooler.Ring.size() < COOLING_HISTORY ? 0 : cooler.Next;
+		for(size_t i = 0;i < cooler.Ring.size();i++)
+			samples.push_back(cooler.Ring[(start + i) % cooler.Ring.size()]);
+		return samples;
+	}
+}
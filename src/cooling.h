@@ -0,0 +1,94 @@
+/*
+ * cooling.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Cooling controller and temperature telemetry
+
+**************************************************/
+
+#pragma once
+
+#ifndef _COOLING_H_
+#define _COOLING_H_
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <stdint.h>
+
+#define COOLING_INTERVAL 1000		//温度采样间隔(毫秒)
+#define COOLING_HISTORY 3600		//环形缓冲区样本数，默认间隔下为一小时
+#define COOLING_DECIMATE 10		//每多少个样本推送一次平均值
+#define COOLING_RAMP 5.0		//默认温度变化速度(°C/分钟)，为0时直接设置
+#define COOLING_TOLERANCE 0.5		//与目标温度相差多少以内视为到达(°C)
+#define COOLING_WARMUP_TEMP 20.0		//回温的目标温度，到达后关闭制冷(°C)
+#define COOLING_WAIT_MAX 1800000		//同步制冷最长等待时间(毫秒)
+
+namespace AstroAir
+{
+	/*一次温度采样*/
+	struct COOLINGSAMPLE
+	{
+		int64_t UtcNs = 0;		//采样时间
+		double Temperature = 0;		//传感器温度(°C)
+		double Power = 0;		//制冷功率(%)
+		double SetPoint = 0;		//当前设定温度(°C)
+		bool CoolerOn = false;
+	};
+}
+
+namespace AstroAir::COOLING
+{
+	/*读取温度与制冷功率，在控制线程中调用，不能使用拍摄路径上的锁*/
+	typedef std::function<bool(double &Temperature,double &Power)> READFUNC;
+	/*打开或关闭制冷并写入设定温度*/
+	typedef std::function<bool(bool Enable,double SetPoint)> WRITEFUNC;
+	/*抽取后的温度数据，在控制线程中调用，不能阻塞*/
+	typedef std::function<void(const COOLINGSAMPLE &Sample)> TELEMETRYFUNC;
+
+	/*注册一台制冷相机，开始采样，返回编号。Rewrite为真时每次采样都写入设定温度*/
+	int Register(std::string Device,READFUNC Read,WRITEFUNC Write,TELEMETRYFUNC Telemetry,bool Rewrite = false);
+	/*停止采样，返回后不会再调用该相机的函数*/
+	void Unregister(int Id);
+	/*以Ramp(°C/分钟)的速度将设定温度移向Target*/
+	bool SetTarget(int Id,double Target,double Ramp = COOLING_RAMP);
+	/*缓慢回温后关闭制冷*/
+	bool Warmup(int Id,double Ramp = COOLING_RAMP);
+	/*立即关闭制冷*/
+	bool Off(int Id);
+	/*等待温度到达目标，Timeout为毫秒*/
+	bool WaitTarget(int Id,int Timeout);
+	/*制冷是否打开以及目标温度*/
+	bool GetTarget(int Id,bool &CoolerOn,double &Target);
+	/*最近一次采样*/
+	bool Latest(int Id,COOLINGSAMPLE &Sample);
+	/*环形缓冲区中的全部样本，按时间排序*/
+	std::vector<COOLINGSAMPLE> History(int Id);
+}
+
+#endif
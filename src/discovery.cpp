@@ -0,0 +1,448 @@
+/*
+ * discovery.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Device discovery service
+
+Using:libusb<https://libusb.info>
+
+**************************************************/
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include "config.h"
+#include "logger.h"
+#include "discovery.h"
+
+#ifdef HAS_LIBUSB
+	#include <libusb-1.0/libusb.h>
+#endif
+
+namespace AstroAir::DISCOVERY
+{
+	/*扫描后端*/
+	struct Backend
+	{
+		ScanFunc Scan;
+		int VendorId = 0;
+		bool Pending = true;		//是否需要扫描
+		std::chrono::steady_clock::time_point DueAt;		//最早扫描时间
+		int Open = 0;		//已打开的设备数，SDK在设备打开时扫描不安全
+	};
+
+	#ifdef HAS_LIBUSB
+	/*一个厂商的热插拔监听，回调只设置Fired，不使用任何锁*/
+	struct HotplugEntry
+	{
+		std::string Brand;
+		libusb_hotplug_callback_handle Handle;
+		std::atomic_bool Fired{false};
+	};
+	#endif
+
+	struct DiscoveryState
+	{
+		std::mutex Lock;		//保护Backends
+		std::map<std::string,Backend> Backends;
+		std::shared_mutex DeviceLock;		//保护Devices
+		std::unordered_map<std::string,DeviceInfo> Devices;
+		std::mutex ScanLock;		//同一时间只允许一个SDK扫描
+		std::condition_variable Cond;
+		std::thread Worker;
+		std::atomic_bool Running{false};
+		int Interval = 0;
+		#ifdef HAS_LIBUSB
+			libusb_context *Usb = nullptr;
+			bool Hotplug = false;
+			/*libusb在持有内部锁时调用回调，因此注册与回调都不能与Lock交错*/
+			std::mutex HotplugLock;		//只保护Callbacks，持有时不调用libusb
+			std::vector<std::unique_ptr<HotplugEntry>> Callbacks;
+		#endif
+	};
+
+	/*使用函数内静态变量，保证驱动的静态注册可以安全调用*/
+	static DiscoveryState &State()
+	{
+		static DiscoveryState state;
+		return state;
+	}
+
+	static std::string DeviceKey(const std::string &Brand,const std::string &Name)
+	{
+		return Brand + "/" + Name;
+	}
+
+	#ifdef HAS_LIBUSB
+	/*
+	 * name: HotplugCallback(libusb_context *ctx,libusb_device *dev,libusb_hotplug_event event,void *user_data)
+	 * describe: Note that a device of the vendor was plugged or unplugged
+	 * 描述：记录设备插拔，由后台线程安排重新扫描
+	 * note: libusb holds its hotplug lock here,so the callback takes no lock at all
+	 */
+	static int HotplugCallback(libusb_context *ctx,libusb_device *dev,libusb_hotplug_event event,void *user_data)
+	{
+		static_cast<HotplugEntry *>(user_data)->Fired = true;
+		return 0;
+	}
+
+	/*
+	 * name: RegisterHotplug(std::string Brand,int VendorId)
+	 * describe: Listen to hotplug events of the vendor
+	 * 描述：监听指定厂商的USB热插拔事件
+	 * note: Must be called without S.Lock,libusb takes its hotplug lock inside
+	 */
+	static void RegisterHotplug(std::string Brand,int VendorId)
+	{
+		DiscoveryState &S = State();
+		if(VendorId == 0)
+			return;
+		auto entry = std::make_unique<HotplugEntry>();
+		entry->Brand = Brand;
+		int events = LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT;
+		if(libusb_hotplug_register_callback(S.Usb,events,LIBUSB_HOTPLUG_NO_FLAGS,VendorId,LIBUSB_HOTPLUG_MATCH_ANY,
+											LIBUSB_HOTPLUG_MATCH_ANY,HotplugCallback,entry.get(),&entry->Handle) != LIBUSB_SUCCESS)
+		{
+			IDLog("Unable to listen to hotplug events of %s\n",Brand.c_str());
+			return;
+		}
+		std::lock_guard<std::mutex> guard(S.HotplugLock);
+		S.Callbacks.push_back(std::move(entry));
+	}
+
+	/*
+	 * name: TakeHotplug()
+	 * describe: Turn the hotplug events noted by the callbacks into delayed rescans
+	 * 描述：将回调记录的插拔事件转为延迟的重新扫描
+	 * note: The SDK needs a moment before a new device can be seen,so the scan is delayed by one second
+	 */
+	static void TakeHotplug()
+	{
+		DiscoveryState &S = State();
+		std::vector<std::string> fired;
+		{
+			std::lock_guard<std::mutex> guard(S.HotplugLock);
+			for(auto &entry : S.Callbacks)
+				if(entry->Fired.exchange(false) == true)
+					fired.push_back(entry->Brand);
+		}
+		if(fired.empty())
+			return;
+		std::lock_guard<std::mutex> guard(S.Lock);
+		for(auto &Brand : fired)
+		{
+			auto it = S.Backends.find(Brand);
+			if(it != S.Backends.end())
+			{
+				it->second.Pending = true;
+				it->second.DueAt = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+			}
+		}
+	}
+	#endif
+
+	/*
+	 * name: RegisterBackend(std::string Brand,ScanFunc Scan,int VendorId)
+	 * @param Brand:设备品牌
+	 * @param Scan:扫描函数
+	 * @param VendorId:USB厂商ID
+	 * describe: Register the scanner of a brand
+	 * 描述：注册品牌扫描后端
+	 * note: Drivers register themselves when they are loaded,simulated backends can be registered the same way
+	 */
+	void RegisterBackend(std::string Brand,ScanFunc Scan,int VendorId)
+	{
+		DiscoveryState &S = State();
+		bool hotplug = false;
+		{
+			std::lock_guard<std::mutex> guard(S.Lock);
+			Backend &backend = S.Backends[Brand];
+			backend.Scan = Scan;
+			backend.VendorId = VendorId;
+			backend.Pending = true;
+			backend.DueAt = std::chrono::steady_clock::now();
+			#ifdef HAS_LIBUSB
+				hotplug = S.Running == true && S.Hotplug == true;
+			#endif
+			S.Cond.notify_one();
+		}
+		/*插件在事件线程运行时加载，注册回调不能持有Lock*/
+		#ifdef HAS_LIBUSB
+			if(hotplug == true)
+				RegisterHotplug(Brand,VendorId);
+		#endif
+	}
+
+	/*
+	 * name: ScanNow(std::string Brand)
+	 * @param Brand:设备品牌
+	 * describe: Scan the brand and replace its cached devices
+	 * 描述：扫描指定品牌并更新缓存
+	 */
+	void ScanNow(std::string Brand)
+	{
+		DiscoveryState &S = State();
+		ScanFunc Scan;
+		{
+			std::lock_guard<std::mutex> guard(S.Lock);
+			auto it = S.Backends.find(Brand);
+			if(it == S.Backends.end())
+				return;
+			Scan = it->second.Scan;
+			it->second.Pending = false;
+		}
+		std::vector<DeviceInfo> found;
+		{
+			std::lock_guard<std::mutex> guard(S.ScanLock);
+			found = Scan();
+		}
+		std::unique_lock<std::shared_mutex> lock(S.DeviceLock);
+		for(auto it = S.Devices.begin();it != S.Devices.end();)
+		{
+			if(it->second.Brand == Brand)
+				it = S.Devices.erase(it);
+			else
+				++it;
+		}
+		for(auto &info : found)
+			S.Devices[DeviceKey(Brand,info.Name)] = info;
+	}
+
+	/*
+	 * name: Hold(std::string Brand)
+	 * @param Brand:设备品牌
+	 * describe: A device of the brand was opened
+	 * 描述：打开了该品牌的设备
+	 * note: Background scans of the brand wait until every device is released,because the SDK may be downloading or exposing
+	 */
+	void Hold(std::string Brand)
+	{
+		DiscoveryState &S = State();
+		std::lock_guard<std::mutex> guard(S.Lock);
+		auto it = S.Backends.find(Brand);
+		if(it != S.Backends.end())
+			it->second.Open++;
+	}
+
+	/*
+	 * name: Release(std::string Brand)
+	 * @param Brand:设备品牌
+	 * describe: A device of the brand was closed,run the scans deferred meanwhile
+	 * 描述：关闭了该品牌的设备，执行期间推迟的扫描
+	 */
+	void Release(std::string Brand)
+	{
+		DiscoveryState &S = State();
+		std::lock_guard<std::mutex> guard(S.Lock);
+		auto it = S.Backends.find(Brand);
+		if(it != S.Backends.end() && it->second.Open > 0)
+			it->second.Open--;
+		S.Cond.notify_one();
+	}
+
+	/*
+	 * name: Work()
+	 * describe: Background thread,scan brands when they are due
+	 * 描述：后台线程，在需要时扫描设备
+	 * note: Brands with an open device are skipped and stay pending,ScanNow() from the driver itself still scans them
+	 */
+	static void Work()
+	{
+		DiscoveryState &S = State();
+		auto next = std::chrono::steady_clock::now() + std::chrono::seconds(S.Interval);
+		while(S.Running == true)
+		{
+			#ifdef HAS_LIBUSB
+			if(S.Hotplug == true)
+			{
+				struct timeval tv = {0,200000};
+				libusb_handle_events_timeout_completed(S.Usb,&tv,nullptr);
+				TakeHotplug();
+			}
+			else
+			#endif
+			{
+				std::unique_lock<std::mutex> lock(S.Lock);
+				S.Cond.wait_for(lock,std::chrono::milliseconds(200));
+			}
+			std::vector<std::string> due;
+			{
+				std::lock_guard<std::mutex> guard(S.Lock);
+				auto now = std::chrono::steady_clock::now();
+				bool periodic = S.Interval > 0 && now >= next;
+				if(periodic)
+					next = now + std::chrono::seconds(S.Interval);
+				for(auto &it : S.Backends)
+				{
+					if(periodic == true)
+						it.second.Pending = true;
+					if(it.second.Pending == true && now >= it.second.DueAt && it.second.Open == 0)
+						due.push_back(it.first);
+				}
+			}
+			for(auto &Brand : due)
+				ScanNow(Brand);
+		}
+	}
+
+	/*
+	 * name: Start(int Interval)
+	 * @param Interval:定时扫描间隔(秒)
+	 * describe: Start the background discovery thread
+	 * 描述：启动后台设备扫描线程
+	 * note: Without hotplug support a 30 seconds interval is used when none is given
+	 */
+	void Start(int Interval)
+	{
+		DiscoveryState &S = State();
+		std::vector<std::pair<std::string,int>> vendors;
+		{
+			std::lock_guard<std::mutex> guard(S.Lock);
+			if(S.Running == true)
+				return;
+			S.Interval = Interval;
+			#ifdef HAS_LIBUSB
+				if(libusb_init(&S.Usb) == LIBUSB_SUCCESS && libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG))
+				{
+					S.Hotplug = true;
+					for(auto &it : S.Backends)
+						vendors.push_back({it.first,it.second.VendorId});
+				}
+				else
+					IDLog("USB hotplug is not supported,rescan devices periodically\n");
+				if(S.Hotplug == false && S.Interval <= 0)
+					S.Interval = 30;
+			#else
+				if(S.Interval <= 0)
+					S.Interval = 30;
+			#endif
+			S.Running = true;
+		}
+		/*此后注册的后端由RegisterBackend()自己监听*/
+		#ifdef HAS_LIBUSB
+			for(auto &it : vendors)
+				RegisterHotplug(it.first,it.second);
+		#endif
+		S.Worker = std::thread(Work);
+	}
+
+	/*
+	 * name: Stop()
+	 * describe: Stop the background discovery thread
+	 * 描述：停止后台设备扫描线程
+	 */
+	void Stop()
+	{
+		DiscoveryState &S = State();
+		if(S.Running == false)
+			return;
+		S.Running = false;
+		S.Cond.notify_one();
+		if(S.Worker.joinable())
+			S.Worker.join();
+		#ifdef HAS_LIBUSB
+			std::vector<std::unique_ptr<HotplugEntry>> callbacks;
+			{
+				std::lock_guard<std::mutex> guard(S.HotplugLock);
+				callbacks.swap(S.Callbacks);
+			}
+			for(auto &entry : callbacks)
+				libusb_hotplug_deregister_callback(S.Usb,entry->Handle);
+			{
+				std::lock_guard<std::mutex> guard(S.Lock);
+				S.Hotplug = false;
+			}
+			if(S.Usb != nullptr)
+				libusb_exit(S.Usb);
+			S.Usb = nullptr;
+		#endif
+	}
+
+	/*
+	 * name: Rescan(std::string Brand)
+	 * @param Brand:设备品牌，为空时扫描所有品牌
+	 * describe: Ask the background thread to rescan
+	 * 描述：请求后台线程重新扫描
+	 */
+	void Rescan(std::string Brand)
+	{
+		DiscoveryState &S = State();
+		std::lock_guard<std::mutex> guard(S.Lock);
+		for(auto &it : S.Backends)
+		{
+			if(Brand.empty() || it.first == Brand)
+			{
+				it.second.Pending = true;
+				it.second.DueAt = std::chrono::steady_clock::now();
+			}
+		}
+		S.Cond.notify_one();
+	}
+
+	/*
+	 * name: Find(std::string Brand,std::string Name,DeviceInfo &info)
+	 * @param Brand:设备品牌
+	 * @param Name:设备名称
+	 * @param info:找到的设备信息
+	 * describe: Look up a device in the cache
+	 * 描述：在缓存中查找设备
+	 * @return false: The device has not been seen by the last scan
+	 */
+	bool Find(std::string Brand,std::string Name,DeviceInfo &info)
+	{
+		DiscoveryState &S = State();
+		std::shared_lock<std::shared_mutex> lock(S.DeviceLock);
+		auto it = S.Devices.find(DeviceKey(Brand,Name));
+		if(it == S.Devices.end())
+			return false;
+		info = it->second;
+		return true;
+	}
+
+	/*
+	 * name: List()
+	 * describe: Get all devices found by the last scans
+	 * 描述：获取所有已发现的设备
+	 */
+	std::vector<DeviceInfo> List()
+	{
+		DiscoveryState &S = State();
+		std::shared_lock<std::shared_mutex> lock(S.DeviceLock);
+		std::vector<DeviceInfo> devices;
+		for(auto &it : S.Devices)
+			devices.push_back(it.second);
+		return devices;
+	}
+}
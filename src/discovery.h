@@ -0,0 +1,83 @@
+/*
+ * discovery.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Device discovery service
+
+**************************************************/
+
+#pragma once
+
+#ifndef _DISCOVERY_H_
+#define _DISCOVERY_H_
+
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace AstroAir
+{
+	/*已发现的设备信息*/
+	struct DeviceInfo
+	{
+		std::string Brand;		//设备品牌
+		std::string Name;		//设备名称，与config.air中的名称一致
+		std::string Id;		//SDK设备ID
+		int Index = -1;		//SDK设备序号
+		int MaxWidth = 0;
+		int MaxHeight = 0;
+		bool IsColor = false;
+		bool IsCooler = false;
+	};
+
+	/*后端扫描函数，返回该品牌当前连接的全部设备*/
+	typedef std::function<std::vector<DeviceInfo>()> ScanFunc;
+
+	namespace DISCOVERY
+	{
+		/*注册品牌扫描后端，VendorId用于USB热插拔过滤，0表示不监听*/
+		void RegisterBackend(std::string Brand,ScanFunc Scan,int VendorId = 0);
+		/*启动后台扫描线程，Interval为定时扫描间隔(秒)，0表示只在热插拔时扫描*/
+		void Start(int Interval = 0);
+		/*停止后台扫描线程*/
+		void Stop();
+		/*请求重新扫描，Brand为空时扫描所有品牌*/
+		void Rescan(std::string Brand = "");
+		/*立即扫描指定品牌，在调用线程中执行*/
+		void ScanNow(std::string Brand);
+		/*打开或关闭该品牌的设备时调用，有设备打开时后台不扫描该品牌*/
+		void Hold(std::string Brand);
+		void Release(std::string Brand);
+		/*查找设备*/
+		bool Find(std::string Brand,std::string Name,DeviceInfo &info);
+		/*获取所有已发现设备*/
+		std::vector<DeviceInfo> List();
+	}
+}
+
+#endif
@@ -0,0 +1,848 @@
+/*
+ * drvhost.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Host camera drivers in child processes
+
+**************************************************/
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+
+#include "logger.h"
+#include "metrics.h"
+#include "watchdog.h"
+#include "drvhost.h"
+
+namespace AstroAir
+{
+	static std::atomic_bool HostEnabled{false};
+
+	/*托管品牌的USB厂商ID，用于在服务器中监听热插拔*/
+	static const std::map<std::string,int> HostVendors = {
+		{"ZWOASI",0x03c3},
+		{"QHYCCD",0x1618}
+	};
+
+	/*使用紧凑格式发送Json消息*/
+	static bool SendMessage(int Socket,const Json::Value &Message)
+	{
+		Json::StreamWriterBuilder writer;
+		writer["indentation"] = "";
+		std::string msg = Json::writeString(writer,Message);
+		if(msg.size() > HOST_MESSAGE_SIZE)
+			return false;
+		return ::send(Socket,msg.data(),msg.size(),MSG_NOSIGNAL) == (ssize_t)msg.size();
+	}
+
+	static bool ParseMessage(const char *Data,size_t Size,Json::Value &Message)
+	{
+		Json::String errs;
+		Json::CharReaderBuilder reader;
+		std::unique_ptr<Json::CharReader>const json_read(reader.newCharReader());
+		return json_read->parse(Data,Data + Size,&Message,&errs);
+	}
+
+	/*
+	 * name: DRIVERHOST(std::string Brand)
+	 * @param Brand:设备品牌
+	 * describe: Start the driver process of the brand
+	 * 描述：启动指定品牌的驱动进程
+	 */
+	DRIVERHOST::DRIVERHOST(std::string Brand)
+	{
+		this->Brand = Brand;
+		char path[PATH_MAX];
+		ssize_t len = readlink("/proc/self/exe",path,sizeof(path) - 1);
+		if(len > 0)
+			Program.assign(path,len);
+		/*驱动进程由接收线程启动，等待第一次启动完成*/
+		Reader = std::thread(&DRIVERHOST::Receive,this);
+		std::unique_lock<std::mutex> lock(Lock);
+		Cond.wait(lock,[this]() { return Spawned == true; });
+	}
+
+	/*
+	 * name: ~DRIVERHOST()
+	 * describe: Stop the driver process
+	 * 描述：停止驱动进程
+	 * note: The child closes its device when the socket is closed,it is killed if it does not exit in time
+	 */
+	DRIVERHOST::~DRIVERHOST()
+	{
+		Running = false;
+		{
+			std::lock_guard<std::mutex> guard(Lock);
+			if(Socket >= 0)
+				shutdown(Socket,SHUT_RDWR);
+			Cond.notify_all();
+		}
+		if(Reader.joinable())
+			Reader.join();
+		if(Restorer.joinable())
+			Restorer.join();
+		if(Connected.exchange(false) == true)
+			DISCOVERY::Release(Brand);
+		if(Pid > 0)
+		{
+			int status;
+			for(int i = 0;i < 20 && waitpid(Pid,&status,WNOHANG) == 0;i++)
+				usleep(100000);
+			if(kill(Pid,0) == 0)
+			{
+				kill(Pid,SIGKILL);
+				waitpid(Pid,&status,0);
+			}
+		}
+		if(Socket >= 0)
+			close(Socket);
+	}
+
+	void DRIVERHOST::Enable(bool enable)
+	{
+		HostEnabled = enable;
+	}
+
+	bool DRIVERHOST::Enabled()
+	{
+		return HostEnabled;
+	}
+
+	/*
+	 * name: Supported(std::string Brand)
+	 * @param Brand:设备品牌
+	 * describe: Whether the driver of the brand can run in a child process
+	 * 描述：该品牌驱动是否可以在子进程中运行
+	 * note: Closed source camera SDKs and the simulator,INDI drivers already run in indiserver
+	 */
+	bool DRIVERHOST::Supported(std::string Brand)
+	{
+		return Brand == "ZWOASI" || Brand == "QHYCCD" || Brand == "Simulator";
+	}
+
+	/*
+	 * name: RegisterScanner(std::string Brand)
+	 * @param Brand:设备品牌
+	 * describe: Register a scan backend of the hosted brand in the server
+	 * 描述：在服务器中注册托管品牌的扫描后端
+	 * note: The scan runs in a driver process of its own that never opens a device,
+	 *       it is started on the first scan and kept until the server exits
+	 */
+	void DRIVERHOST::RegisterScanner(std::string Brand)
+	{
+		auto vendor = HostVendors.find(Brand);
+		DISCOVERY::RegisterBackend(Brand,[Brand]()
+		{
+			static std::mutex ScannerLock;
+			static std::map<std::string,DRIVERHOST *> Scanners;
+			DRIVERHOST *scanner;
+			{
+				std::lock_guard<std::mutex> guard(ScannerLock);
+				DRIVERHOST *&host = Scanners[Brand];
+				if(host == nullptr)
+					host = new DRIVERHOST(Brand);
+				scanner = host;
+			}
+			return scanner->Scan();
+		},vendor == HostVendors.end() ? 0 : vendor->second);
+	}
+
+	/*
+	 * name: Spawn()
+	 * describe: Start the driver process
+	 * 描述：启动驱动进程
+	 * note: The child execs the server again instead of running on after fork,
+	 *       the locks held by other threads of the server must not leak into it.
+	 *       PR_SET_PDEATHSIG fires when the forking thread exits,so only the reader
+	 *       thread,which lives as long as this object,may call it
+	 */
+	bool DRIVERHOST::Spawn()
+	{
+		if(Program.empty())
+		{
+			IDLog("Unable to find the server program,can not start the driver process of %s\n",Brand.c_str());
+			return false;
+		}
+		int fds[2];
+		if(socketpair(AF_UNIX,SOCK_SEQPACKET | SOCK_CLOEXEC,0,fds) != 0)
+		{
+			IDLog("Unable to create the socket of the driver process\n");
+			return false;
+		}
+		const char *program = Program.c_str();
+		const char *brand = Brand.c_str();
+		pid_t pid = fork();
+		if(pid == 0)
+		{
+			/*子进程只调用异步信号安全的函数*/
+			prctl(PR_SET_PDEATHSIG,SIGKILL);
+			if(fds[1] == HOST_FD)
+				fcntl(HOST_FD,F_SETFD,0);
+			else
+				dup2(fds[1],HOST_FD);
+			execl(program,program,"-H",brand,(char *)nullptr);
+			_exit(127);
+		}
+		close(fds[1]);
+		if(pid < 0)
+		{
+			close(fds[0]);
+			IDLog("Unable to start the driver process of %s\n",Brand.c_str());
+			return false;
+		}
+		std::lock_guard<std::mutex> guard(Lock);
+		Socket = fds[0];
+		Pid = pid;
+		Generation++;
+		IDLog("Driver process of %s started,pid is %d\n",Brand.c_str(),pid);
+		return true;
+	}
+
+	/*
+	 * name: Receive()
+	 * describe: Wait for replies,restart the driver process when it dies
+	 * 描述：接收驱动进程的返回，驱动进程退出后重新启动
+	 */
+	void DRIVERHOST::Receive()
+	{
+		bool started = Spawn();
+		{
+			std::lock_guard<std::mutex> guard(Lock);
+			Spawned = true;
+			Cond.notify_all();
+		}
+		if(started == false)
+			return;
+		std::vector<char> buffer(HOST_MESSAGE_SIZE);
+		while(Running == true)
+		{
+			int fd;
+			{
+				std::lock_guard<std::mutex> guard(Lock);
+				fd = Socket;
+			}
+			ssize_t len = fd >= 0 ? recv(fd,buffer.data(),buffer.size(),0) : 0;
+			if(len > 0)
+			{
+				Json::Value Reply;
+				if(ParseMessage(buffer.data(),len,Reply) == false)
+					continue;
+				/*帧事件在返回之前到达，曝光返回时帧已经交给接收者*/
+				if(Reply.isMember("Event"))
+				{
+					if(Reply["Event"].asString() == "Preview")
+					{
+						/*单调时钟在进程间通用，时间可以直接使用*/
+						FRAMETIMING timing;
+						timing.CommandNs = Reply["CommandNs"].asInt64();
+						timing.ExposureStartNs = Reply["ExposureStartNs"].asInt64();
+						timing.ExposureEndNs = Reply["ExposureEndNs"].asInt64();
+						timing.DownloadNs = Reply["DownloadNs"].asInt64();
+						timing.FitsNs = Reply["FitsNs"].asInt64();
+						timing.PreviewNs = Reply["PreviewNs"].asInt64();
+						timing.UtcOffsetNs = Reply["UtcOffsetNs"].asInt64();
+						PreviewReady(Reply["Name"].asString(),timing);
+					}
+					else if(Reply["Event"].asString() == "Telemetry")
+					{
+						COOLINGSAMPLE sample;
+						sample.UtcNs = Reply["UtcNs"].asInt64();
+						sample.Temperature = Reply["Temperature"].asDouble();
+						sample.Power = Reply["Power"].asDouble();
+						sample.SetPoint = Reply["SetPoint"].asDouble();
+						sample.CoolerOn = Reply["CoolerOn"].asBool();
+						TelemetryReady(sample);
+					}
+					else if(Reply["Event"].asString() == "Fault")
+						DeviceFault(Reply["Function"].asString(),Reply["Stalled"].asBool());
+					else
+						TakeFrame(Reply);
+					continue;
+				}
+				std::lock_guard<std::mutex> guard(Lock);
+				Replies[Reply["Id"].asInt()] = Reply;
+				Cond.notify_all();
+				continue;
+			}
+			if(len < 0 && errno == EINTR)
+				continue;
+			if(Running == false)
+				break;
+			/*驱动进程已退出，正在等待的调用全部失败*/
+			pid_t dead;
+			{
+				std::lock_guard<std::mutex> guard(Lock);
+				dead = Pid;
+				if(Socket >= 0)
+					close(Socket);
+				Socket = -1;
+				Pid = -1;
+				Generation++;
+				Replies.clear();
+				Cond.notify_all();
+			}
+			/*在锁外回收，连接断开但进程仍未退出时将其杀死，不让其他调用等待*/
+			int status = 0;
+			if(dead > 0)
+			{
+				for(int i = 0;i < 20 && waitpid(dead,&status,WNOHANG) == 0;i++)
+					usleep(50000);
+				if(kill(dead,0) == 0)
+				{
+					kill(dead,SIGKILL);
+					waitpid(dead,&status,0);
+				}
+			}
+			IDLog("Driver process of %s exited unexpectedly (status %d),restart it\n",Brand.c_str(),status);
+			METRICS::Add("host.crashes");
+			{
+				/*崩溃的进程来不及删除共享内存*/
+				std::lock_guard<std::mutex> guard(RingLock);
+				if(Ring != nullptr)
+					Ring->Unlink();
+				Ring = nullptr;
+			}
+			sleep(HOST_RESTART_DELAY);
+			if(Running == false || Spawn() == false)
+				break;
+			if(Connected == true)
+			{
+				if(Restorer.joinable())
+					Restorer.join();
+				Restorer = std::thread(&DRIVERHOST::Restore,this);
+			}
+		}
+	}
+
+	/*
+	 * name: Call(Json::Value &Request,Json::Value &Reply,int Timeout)
+	 * @param Request:调用内容
+	 * @param Reply:驱动进程的返回
+	 * @param Timeout:超时时间(毫秒)
+	 * describe: Call the driver process and wait for the reply
+	 * 描述：调用驱动进程并等待返回
+	 * @return false: The driver process died or did not answer in time
+	 * note: A driver process that does not answer is killed,it is restarted like a crashed one
+	 */
+	bool DRIVERHOST::Call(Json::Value &Request,Json::Value &Reply,int Timeout)
+	{
+		std::unique_lock<std::mutex> lock(Lock);
+		if(Socket < 0)
+		{
+			IDLog("Driver process of %s is not running\n",Brand.c_str());
+			return false;
+		}
+		int id = ++NextId;
+		uint64_t gen = Generation;
+		Request["Id"] = Json::Value(id);
+		if(SendMessage(Socket,Request) == false)
+			return false;
+		if(Cond.wait_for(lock,std::chrono::milliseconds(Timeout),[&]() { return Replies.count(id) > 0 || Generation != gen || Running == false; }) == false)
+		{
+			IDLog("Driver process of %s did not answer %s in time\n",Brand.c_str(),Request["Call"].asCString());
+			METRICS::Add("host.timeouts");
+			if(Pid > 0)
+				kill(Pid,SIGKILL);
+			return false;
+		}
+		auto it = Replies.find(id);
+		if(it == Replies.end())
+			return false;
+		Reply = it->second;
+		Replies.erase(it);
+		lock.unlock();
+		if(Reply.isMember("State"))
+		{
+			std::lock_guard<std::mutex> guard(stateLock);
+			LastState = SNAPSHOT::FromJson(Reply["State"]);
+			HasState = true;
+		}
+		return true;
+	}
+
+	/*
+	 * name: Restore()
+	 * describe: Reopen the device in the new driver process
+	 * 描述：在新的驱动进程中重新打开设备并恢复设置
+	 */
+	void DRIVERHOST::Restore()
+	{
+		DeviceState state;
+		{
+			std::lock_guard<std::mutex> guard(stateLock);
+			if(HasState == false)
+				return;
+			state = LastState;
+		}
+		if(QuickConnect(state) == true && RestoreState(state) == true)
+		{
+			METRICS::Add("host.restores");
+			IDLog("%s is restored after the driver process restarted\n",state.Name.c_str());
+		}
+		else
+			IDLog("Unable to restore %s after the driver process restarted\n",state.Name.c_str());
+	}
+
+	/*
+	 * name: TakeFrame(const Json::Value &Event)
+	 * @param Event:驱动进程发来的帧事件
+	 * describe: Hand the frame in shared memory to the frame sink
+	 * 描述：将共享内存中的帧交给帧接收者
+	 */
+	void DRIVERHOST::TakeFrame(const Json::Value &Event)
+	{
+		std::lock_guard<std::mutex> guard(RingLock);
+		std::string name = Event["Ring"].asString();
+		if(Ring == nullptr || Ring->Name() != name)
+		{
+			if((Ring = SHMRING::Open(name)) == nullptr)
+			{
+				IDLog("Unable to open the frame ring %s\n",name.c_str());
+				return;
+			}
+		}
+		uint64_t index = Event["Frame"].asUInt64();
+		FRAMEHEADER Header;
+		const unsigned char *Data;
+		if(Ring->Read(index,Header,Data) == false)
+		{
+			METRICS::Add("host.frames_lost");
+			return;
+		}
+		METRICS::Set("host.frame_latency_ms",(MonotonicNs() - Header.MonotonicNs) / 1e6);
+		PublishFrame(Header,Data);
+		if(Ring->Valid(index) == false)
+			METRICS::Add("host.frames_overwritten");
+	}
+
+	/*
+	 * name: Scan()
+	 * describe: Scan the devices of the brand in the driver process
+	 * 描述：在驱动进程中扫描该品牌的设备
+	 * @return: Empty if the driver process died or did not answer in time
+	 */
+	std::vector<DeviceInfo> DRIVERHOST::Scan()
+	{
+		std::vector<DeviceInfo> devices;
+		Json::Value Request,Reply;
+		Request["Call"] = Json::Value("Scan");
+		Request["Brand"] = Json::Value(Brand);
+		if(Call(Request,Reply,SDK_TIMEOUT) == false || Reply["Ret"].asBool() == false)
+			return devices;
+		for(const Json::Value &item : Reply["Devices"])
+		{
+			DeviceInfo info;
+			info.Brand = Brand;
+			info.Name = item["Name"].asString();
+			info.Id = item["Id"].asString();
+			info.Index = item["Index"].asInt();
+			info.MaxWidth = item["MaxWidth"].asInt();
+			info.MaxHeight = item["MaxHeight"].asInt();
+			info.IsColor = item["IsColor"].asBool();
+			info.IsCooler = item["IsCooler"].asBool();
+			devices.push_back(info);
+		}
+		return devices;
+	}
+
+	/*设备在驱动进程中打开，服务器的后台扫描同样需要避开它*/
+	bool DRIVERHOST::Connect(std::string Device_name)
+	{
+		Json::Value Request,Reply;
+		Request["Call"] = Json::Value("Connect");
+		Request["Name"] = Json::Value(Device_name);
+		if(Call(Request,Reply,SDK_DOWNLOAD_TIMEOUT) == false || Reply["Ret"].asBool() == false)
+			return false;
+		if(Connected.exchange(true) == false)
+			DISCOVERY::Hold(Brand);
+		return true;
+	}
+
+	bool DRIVERHOST::Disconnect()
+	{
+		if(Connected.exchange(false) == true)
+			DISCOVERY::Release(Brand);
+		Json::Value Request,Reply;
+		Request["Call"] = Json::Value("Disconnect");
+		return Call(Request,Reply,SDK_TIMEOUT) == true && Reply["Ret"].asBool() == true;
+	}
+
+	bool DRIVERHOST::StartExposure(int exp,int bin,bool IsSave,std::string FitsName,int Gain,int Offset)
+	{
+		Json::Value Request,Reply;
+		Request["Call"] = Json::Value("StartExposure");
+		Request["Expo"] = Json::Value(exp);
+		Request["Bin"] = Json::Value(bin);
+		Request["IsSave"] = Json::Value(IsSave);
+		Request["FitsName"] = Json::Value(FitsName);
+		Request["Gain"] = Json::Value(Gain);
+		Request["Offset"] = Json::Value(Offset);
+		return Call(Request,Reply,exp * 1000 + SDK_DOWNLOAD_TIMEOUT + SDK_TIMEOUT) == true && Reply["Ret"].asBool() == true;
+	}
+
+	bool DRIVERHOST::AbortExposure()
+	{
+		Json::Value Request,Reply;
+		Request["Call"] = Json::Value("AbortExposure");
+		return Call(Request,Reply,SDK_TIMEOUT) == true && Reply["Ret"].asBool() == true;
+	}
+
+	bool DRIVERHOST::StartVideo(int exp,int bin,int Gain,int Offset)
+	{
+		Json::Value Request,Reply;
+		Request["Call"] = Json::Value("StartVideo");
+		Request["Expo"] = Json::Value(exp);
+		Request["Bin"] = Json::Value(bin);
+		Request["Gain"] = Json::Value(Gain);
+		Request["Offset"] = Json::Value(Offset);
+		return Call(Request,Reply,SDK_DOWNLOAD_TIMEOUT) == true && Reply["Ret"].asBool() == true;
+	}
+
+	bool DRIVERHOST::StopVideo()
+	{
+		Json::Value Request,Reply;
+		Request["Call"] = Json::Value("StopVideo");
+		return Call(Request,Reply,SDK_DOWNLOAD_TIMEOUT) == true && Reply["Ret"].asBool() == true;
+	}
+
+	bool DRIVERHOST::StartBurst(int exp,int bin,int Gain,int Offset,int Count,std::string FitsName)
+	{
+		Json::Value Request,Reply;
+		Request["Call"] = Json::Value("StartBurst");
+		Request["Expo"] = Json::Value(exp);
+		Request["Bin"] = Json::Value(bin);
+		Request["Gain"] = Json::Value(Gain);
+		Request["Offset"] = Json::Value(Offset);
+		Request["Count"] = Json::Value(Count);
+		Request["FitsName"] = Json::Value(FitsName);
+		return Call(Request,Reply,Count * exp + SDK_DOWNLOAD_TIMEOUT + SDK_TIMEOUT) == true && Reply["Ret"].asBool() == true;
+	}
+
+	bool DRIVERHOST::SetROI(int StartX,int StartY,int Width,int Height)
+	{
+		Json::Value Request,Reply;
+		Request["Call"] = Json::Value("SetROI");
+		Request["X"] = Json::Value(StartX);
+		Request["Y"] = Json::Value(StartY);
+		Request["Width"] = Json::Value(Width);
+		Request["Height"] = Json::Value(Height);
+		return Call(Request,Reply,SDK_TIMEOUT) == true && Reply["Ret"].asBool() == true;
+	}
+
+	bool DRIVERHOST::Cooling(bool SetPoint,bool CoolDown,bool ASync,bool Warmup,bool CoolerOFF,double Temperature,double Ramp)
+	{
+		Json::Value Request,Reply;
+		Request["Call"] = Json::Value("Cooling");
+		Request["SetPoint"] = Json::Value(SetPoint);
+		Request["CoolDown"] = Json::Value(CoolDown);
+		Request["ASync"] = Json::Value(ASync);
+		Request["Warmup"] = Json::Value(Warmup);
+		Request["CoolerOFF"] = Json::Value(CoolerOFF);
+		Request["Temperature"] = Json::Value(Temperature);
+		Request["Ramp"] = Json::Value(Ramp);
+		/*同步制冷一直等到温度到达目标*/
+		const int timeout = ASync ? SDK_TIMEOUT : COOLING_WAIT_MAX + SDK_TIMEOUT;
+		return Call(Request,Reply,timeout) == true && Reply["Ret"].asBool() == true;
+	}
+
+	bool DRIVERHOST::StartRecord(std::string FileName,bool Direct)
+	{
+		Json::Value Request,Reply;
+		Request["Call"] = Json::Value("StartRecord");
+		Request["FileName"] = Json::Value(FileName);
+		Request["Direct"] = Json::Value(Direct);
+		return Call(Request,Reply,SDK_TIMEOUT) == true && Reply["Ret"].asBool() == true;
+	}
+
+	bool DRIVERHOST::StopRecord()
+	{
+		Json::Value Request,Reply;
+		Request["Call"] = Json::Value("StopRecord");
+		return Call(Request,Reply,SDK_TIMEOUT) == true && Reply["Ret"].asBool() == true;
+	}
+
+	bool DRIVERHOST::StretchImage(std::string FitsName,int Low,int High,int X,int Y,int Width,int Height)
+	{
+		Json::Value Request,Reply;
+		Request["Call"] = Json::Value("StretchImage");
+		Request["FitsName"] = Json::Value(FitsName);
+		Request["Low"] = Json::Value(Low);
+		Request["High"] = Json::Value(High);
+		Request["X"] = Json::Value(X);
+		Request["Y"] = Json::Value(Y);
+		Request["Width"] = Json::Value(Width);
+		Request["Height"] = Json::Value(Height);
+		return Call(Request,Reply,SDK_TIMEOUT) == true && Reply["Ret"].asBool() == true;
+	}
+
+	/*缓存的帧在驱动进程中，统计结果随返回一起传回*/
+	bool DRIVERHOST::ImageStats(std::string FitsName,int X,int Y,int Width,int Height,FRAMESTATS &Stats)
+	{
+		Json::Value Request,Reply;
+		Request["Call"] = Json::Value("ImageStats");
+		Request["FitsName"] = Json::Value(FitsName);
+		Request["X"] = Json::Value(X);
+		Request["Y"] = Json::Value(Y);
+		Request["Width"] = Json::Value(Width);
+		Request["Height"] = Json::Value(Height);
+		if(Call(Request,Reply,SDK_TIMEOUT) == false || Reply["Ret"].asBool() == false)
+			return false;
+		Stats = StatsFromJson(Reply["Stats"]);
+		return true;
+	}
+
+	bool DRIVERHOST::QuickConnect(const DeviceState &state)
+	{
+		Json::Value Request,Reply;
+		Request["Call"] = Json::Value("QuickConnect");
+		SNAPSHOT::ToJson(state,Request["State"]);
+		if(Call(Request,Reply,SDK_DOWNLOAD_TIMEOUT) == false || Reply["Ret"].asBool() == false)
+			return false;
+		if(Connected.exchange(true) == false)
+			DISCOVERY::Hold(Brand);
+		return true;
+	}
+
+	bool DRIVERHOST::RestoreState(const DeviceState &state)
+	{
+		Json::Value Request,Reply;
+		Request["Call"] = Json::Value("RestoreState");
+		SNAPSHOT::ToJson(state,Request["State"]);
+		return Call(Request,Reply,SDK_DOWNLOAD_TIMEOUT) == true && Reply["Ret"].asBool() == true;
+	}
+
+	/*
+	 * name: GetState(DeviceState &state)
+	 * @param state:设备当前状态
+	 * describe: Get the state reported with the last reply
+	 * 描述：获取驱动进程最近一次返回的设备状态，不需要等待驱动进程
+	 */
+	bool DRIVERHOST::GetState(DeviceState &state)
+	{
+		if(Connected == false)
+			return false;
+		std::lock_guard<std::mutex> guard(stateLock);
+		if(HasState == false)
+			return false;
+		state = LastState;
+		return true;
+	}
+
+	/*驱动进程的共享状态，处理线程可能比主循环活得更久*/
+	struct HostContext
+	{
+		WSSERVER *Device = nullptr;
+		int Socket = -1;
+		std::mutex WriteLock;
+		std::mutex RingLock;
+		std::unique_ptr<SHMRING> Ring;
+		int RingCount = 0;
+	};
+
+	/*
+	 * name: Handle(std::shared_ptr<HostContext> Host,Json::Value Request)
+	 * describe: Run one call on the real driver and send the reply
+	 * 描述：在驱动上执行一次调用并返回结果
+	 */
+	static void Handle(std::shared_ptr<HostContext> Host,Json::Value Request)
+	{
+		WSSERVER *Device = Host->Device;
+		const std::string call = Request["Call"].asString();
+		Json::Value Reply;
+		Reply["Id"] = Request["Id"];
+		bool ret = false;
+		if(call == "Connect")
+			ret = Device->Connect(Request["Name"].asString());
+		else if(call == "Disconnect")
+			ret = Device->Disconnect();
+		else if(call == "StartExposure")
+			ret = Device->StartExposure(Request["Expo"].asInt(),Request["Bin"].asInt(),Request["IsSave"].asBool(),Request["FitsName"].asString(),Request["Gain"].asInt(),Request["Offset"].asInt());
+		else if(call == "AbortExposure")
+			ret = Device->AbortExposure();
+		else if(call == "StartVideo")
+			ret = Device->StartVideo(Request["Expo"].asInt(),Request["Bin"].asInt(),Request["Gain"].asInt(),Request["Offset"].asInt());
+		else if(call == "StopVideo")
+			ret = Device->StopVideo();
+		else if(call == "StartBurst")
+			ret = Device->StartBurst(Request["Expo"].asInt(),Request["Bin"].asInt(),Request["Gain"].asInt(),Request["Offset"].asInt(),Request["Count"].asInt(),Request["FitsName"].asString());
+		else if(call == "SetROI")
+			ret = Device->SetROI(Request["X"].asInt(),Request["Y"].asInt(),Request["Width"].asInt(),Request["Height"].asInt());
+		else if(call == "Cooling")
+			ret = Device->Cooling(Request["SetPoint"].asBool(),Request["CoolDown"].asBool(),Request["ASync"].asBool(),Request["Warmup"].asBool(),Request["CoolerOFF"].asBool(),Request["Temperature"].asDouble(),Request["Ramp"].asDouble());
+		else if(call == "StartRecord")
+			ret = Device->StartRecord(Request["FileName"].asString(),Request["Direct"].asBool());
+		else if(call == "StopRecord")
+			ret = Device->StopRecord();
+		else if(call == "StretchImage")
+			ret = Device->StretchImage(Request["FitsName"].asString(),Request["Low"].asInt(),Request["High"].asInt(),Request["X"].asInt(),Request["Y"].asInt(),Request["Width"].asInt(),Request["Height"].asInt());
+		else if(call == "ImageStats")
+		{
+			FRAMESTATS stats;
+			if((ret = Device->ImageStats(Request["FitsName"].asString(),Request["X"].asInt(),Request["Y"].asInt(),Request["Width"].asInt(),Request["Height"].asInt(),stats)) == true)
+				WSSERVER::StatsToJson(stats,Reply["Stats"]);
+		}
+		else if(call == "QuickConnect")
+			ret = Device->QuickConnect(SNAPSHOT::FromJson(Request["State"]));
+		else if(call == "RestoreState")
+			ret = Device->RestoreState(SNAPSHOT::FromJson(Request["State"]));
+		else if(call == "Scan")
+		{
+			std::string Brand = Request["Brand"].asString();
+			DISCOVERY::ScanNow(Brand);
+			Reply["Devices"] = Json::Value(Json::arrayValue);
+			for(auto &info : DISCOVERY::List())
+			{
+				if(info.Brand != Brand)
+					continue;
+				Json::Value item;
+				item["Name"] = Json::Value(info.Name);
+				item["Id"] = Json::Value(info.Id);
+				item["Index"] = Json::Value(info.Index);
+				item["MaxWidth"] = Json::Value(info.MaxWidth);
+				item["MaxHeight"] = Json::Value(info.MaxHeight);
+				item["IsColor"] = Json::Value(info.IsColor);
+				item["IsCooler"] = Json::Value(info.IsCooler);
+				Reply["Devices"].append(item);
+			}
+			ret = true;
+		}
+		else
+			IDLog("Unknown call %s from the server\n",call.c_str());
+		Reply["Ret"] = Json::Value(ret);
+		DeviceState state;
+		if(Device->GetState(state) == true)
+			SNAPSHOT::ToJson(state,Reply["State"]);
+		std::lock_guard<std::mutex> guard(Host->WriteLock);
+		SendMessage(Host->Socket,Reply);
+	}
+
+	/*
+	 * name: Serve(std::string Brand,int Socket)
+	 * @param Brand:设备品牌
+	 * @param Socket:与服务器通信的描述符
+	 * describe: Main loop of the driver process
+	 * 描述：驱动进程主循环
+	 * @return 0: The server closed the connection
+	 * note: Every call runs on its own thread,so an abort is not queued behind a running exposure
+	 */
+	int DRIVERHOST::Serve(std::string Brand,int Socket)
+	{
+		auto Host = std::make_shared<HostContext>();
+		Host->Socket = Socket;
+		if((Host->Device = CreateDriver(Brand)) == nullptr)
+		{
+			IDLog("Driver process does not know brand %s\n",Brand.c_str());
+			return 1;
+		}
+		/*帧写入共享内存后通知服务器，分辨率变大时换一个更大的环*/
+		Host->Device->SetFrameSink([Host](const FRAMEHEADER &Header,const unsigned char *Data)
+		{
+			Json::Value Event;
+			{
+				std::lock_guard<std::mutex> guard(Host->RingLock);
+				if(Host->Ring == nullptr || Host->Ring->SlotSize() < Header.Size)
+				{
+					std::string name = "/airserver-" + std::to_string(getpid()) + "-" + std::to_string(Host->RingCount++);
+					Host->Ring = SHMRING::Create(name,HOST_RING_SLOTS,Header.Size);
+				}
+				if(Host->Ring == nullptr || Host->Ring->Publish(Header,Data) == false)
+				{
+					METRICS::Add("host.frames_dropped");
+					return;
+				}
+				Event["Event"] = Json::Value("Frame");
+				Event["Ring"] = Json::Value(Host->Ring->Name());
+				Event["Frame"] = Json::Value((Json::UInt64)(Host->Ring->Written() - 1));
+			}
+			std::lock_guard<std::mutex> guard(Host->WriteLock);
+			SendMessage(Host->Socket,Event);
+		});
+		/*预览图由驱动进程生成，通知服务器发送给客户端*/
+		Host->Device->SetPreviewSink([Host](std::string FitsName,const FRAMETIMING &Timing)
+		{
+			Json::Value Event;
+			Event["Event"] = Json::Value("Preview");
+			Event["Name"] = Json::Value(FitsName);
+			Event["CommandNs"] = Json::Value((Json::Int64)Timing.CommandNs);
+			Event["ExposureStartNs"] = Json::Value((Json::Int64)Timing.ExposureStartNs);
+			Event["ExposureEndNs"] = Json::Value((Json::Int64)Timing.ExposureEndNs);
+			Event["DownloadNs"] = Json::Value((Json::Int64)Timing.DownloadNs);
+			Event["FitsNs"] = Json::Value((Json::Int64)Timing.FitsNs);
+			Event["PreviewNs"] = Json::Value((Json::Int64)Timing.PreviewNs);
+			Event["UtcOffsetNs"] = Json::Value((Json::Int64)Timing.UtcOffsetNs);
+			std::lock_guard<std::mutex> guard(Host->WriteLock);
+			SendMessage(Host->Socket,Event);
+		});
+		/*制冷温度数据同样转发给服务器*/
+		Host->Device->SetTelemetrySink([Host](const COOLINGSAMPLE &Sample)
+		{
+			Json::Value Event;
+			Event["Event"] = Json::Value("Telemetry");
+			Event["UtcNs"] = Json::Value((Json::Int64)Sample.UtcNs);
+			Event["Temperature"] = Json::Value(Sample.Temperature);
+			Event["Power"] = Json::Value(Sample.Power);
+			Event["CoolerOn"] = Json::Value(Sample.CoolerOn);
+			if(Sample.CoolerOn == true)
+				Event["SetPoint"] = Json::Value(Sample.SetPoint);
+			std::lock_guard<std::mutex> guard(Host->WriteLock);
+			SendMessage(Host->Socket,Event);
+		});
+		/*SDK卡死与恢复由服务器处理*/
+		Host->Device->SetFaultSink([Host](std::string Func,bool Stalled)
+		{
+			Json::Value Event;
+			Event["Event"] = Json::Value("Fault");
+			Event["Function"] = Json::Value(Func);
+			Event["Stalled"] = Json::Value(Stalled);
+			std::lock_guard<std::mutex> guard(Host->WriteLock);
+			SendMessage(Host->Socket,Event);
+		});
+		std::vector<char> buffer(HOST_MESSAGE_SIZE);
+		while(true)
+		{
+			ssize_t len = recv(Socket,buffer.data(),buffer.size(),0);
+			if(len < 0 && errno == EINTR)
+				continue;
+			if(len <= 0)
+				break;
+			Json::Value Request;
+			if(ParseMessage(buffer.data(),len,Request) == false)
+				continue;
+			std::thread(Handle,Host,Request).detach();
+		}
+		IDLog("Server closed the connection,driver process of %s exits\n",Brand.c_str());
+		Host->Device->Disconnect();
+		return 0;
+	}
+}
@@ -0,0 +1,131 @@
+/*
+ * drvhost.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Host camera drivers in child processes
+
+**************************************************/
+
+#pragma once
+
+#ifndef _DRVHOST_H_
+#define _DRVHOST_H_
+
+#include "wsserver.h"
+#include "shmring.h"
+#include "discovery.h"
+
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <sys/types.h>
+
+#define HOST_FD 3		//驱动进程中与服务器通信的描述符
+#define HOST_RING_SLOTS 4		//帧共享内存槽数
+#define HOST_MESSAGE_SIZE 65536		//单条消息最大长度
+#define HOST_RESTART_DELAY 1		//驱动进程崩溃后重启前等待(秒)
+
+namespace AstroAir
+{
+	/*
+	 * Stands in for a camera driver that runs in a child process. Calls are
+	 * forwarded as json messages over a socket pair,frames come back through
+	 * a shared memory ring and are handed to the frame sink without a copy.
+	 * If the child dies it is started again and the device is reopened with
+	 * the last known state.
+	 */
+	class DRIVERHOST: public WSSERVER
+	{
+		public:
+			explicit DRIVERHOST(std::string Brand);
+			virtual ~DRIVERHOST();
+			virtual bool Connect(std::string Device_name) override;
+			virtual bool Disconnect() override;
+			virtual bool StartExposure(int exp,int bin,bool IsSave,std::string FitsName,int Gain,int Offset) override;
+			virtual bool AbortExposure() override;
+			virtual bool StartVideo(int exp,int bin,int Gain,int Offset) override;
+			virtual bool StopVideo() override;
+			virtual bool StartBurst(int exp,int bin,int Gain,int Offset,int Count,std::string FitsName) override;
+			virtual bool SetROI(int StartX,int StartY,int Width,int Height) override;
+			virtual bool Cooling(bool SetPoint,bool CoolDown,bool ASync,bool Warmup,bool CoolerOFF,double Temperature,double Ramp) override;
+			virtual bool StartRecord(std::string FileName,bool Direct) override;
+			virtual bool StopRecord() override;
+			virtual bool StretchImage(std::string FitsName,int Low,int High,int X,int Y,int Width,int Height) override;
+			virtual bool ImageStats(std::string FitsName,int X,int Y,int Width,int Height,FRAMESTATS &Stats) override;
+			virtual bool QuickConnect(const DeviceState &state) override;
+			virtual bool RestoreState(const DeviceState &state) override;
+			virtual bool GetState(DeviceState &state) override;
+			/*是否在子进程中运行驱动*/
+			static void Enable(bool enable);
+			static bool Enabled();
+			/*该品牌是否可以在子进程中运行*/
+			static bool Supported(std::string Brand);
+			/*在服务器中注册托管品牌的扫描后端，扫描在独立的驱动进程中执行*/
+			static void RegisterScanner(std::string Brand);
+			/*驱动进程主循环*/
+			static int Serve(std::string Brand,int Socket);
+		private:
+			/*启动驱动进程*/
+			bool Spawn();
+			/*接收驱动进程的返回，进程退出时重启*/
+			void Receive();
+			/*调用驱动进程并等待返回*/
+			bool Call(Json::Value &Request,Json::Value &Reply,int Timeout);
+			/*驱动进程重启后恢复设备*/
+			void Restore();
+			/*从共享内存中取出驱动进程发布的帧*/
+			void TakeFrame(const Json::Value &Event);
+			/*在驱动进程中扫描该品牌的设备*/
+			std::vector<DeviceInfo> Scan();
+
+			std::string Brand;
+			std::string Program;
+			pid_t Pid = -1;
+			int Socket = -1;
+			std::mutex Lock;		//保护Pid,Socket,Replies
+			std::condition_variable Cond;
+			std::map<int,Json::Value> Replies;
+			int NextId = 0;
+			uint64_t Generation = 0;		//每次启动驱动进程加一，旧的调用随之失败
+			bool Spawned = false;		//接收线程已尝试第一次启动
+			std::atomic_bool Running{true};
+			std::atomic_bool Connected{false};
+			std::thread Reader;
+			std::thread Restorer;
+			/*最后已知的设备状态，用于重启后恢复*/
+			std::mutex stateLock;
+			DeviceState LastState;
+			bool HasState = false;
+			std::mutex RingLock;
+			std::unique_ptr<SHMRING> Ring;
+	};
+}
+
+#endif
@@ -0,0 +1,234 @@
+/*
+ * exposure.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Event driven exposure engine
+
+**************************************************/
+
+#include <map>
+#include <queue>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <future>
+
+#include "logger.h"
+#include "metrics.h"
+#include "threads.h"
+#include "exposure.h"
+
+namespace AstroAir::EXPOSURE
+{
+	typedef std::chrono::steady_clock Clock;
+
+	struct Job
+	{
+		std::string Device;
+		POLLFUNC Poll;
+		DONEFUNC Complete;
+		Clock::time_point Deadline;		//超过该时间仍未完成则判定失败
+		int Interval = EXPOSURE_POLL_MIN;		//当前查询间隔
+	};
+
+	typedef std::pair<Clock::time_point,int> Timer;
+
+	/*
+	 * One thread sleeps until the next exposure is due and polls it,so any
+	 * number of cameras costs a single mostly idle thread.
+	 */
+	struct Engine
+	{
+		std::mutex Lock;
+		std::condition_variable Cond;
+		std::map<int,Job> Jobs;
+		std::priority_queue<Timer,std::vector<Timer>,std::greater<Timer>> Timers;
+		int NextId = 0;
+		bool Running = false;
+		std::thread Worker;
+
+		~Engine()
+		{
+			{
+				std::lock_guard<std::mutex> guard(Lock);
+				Running = false;
+			}
+			Cond.notify_all();
+			if(Worker.joinable())
+				Worker.join();
+		}
+	};
+
+	static Engine &State()
+	{
+		static Engine engine;
+		return engine;
+	}
+
+	/*
+	 * name: Work()
+	 * describe: Engine thread,poll the exposures when they are due
+	 * 描述：引擎线程，在曝光到期时查询状态
+	 * note: The interval doubles from EXPOSURE_POLL_MIN up to EXPOSURE_POLL_MAX,a remaining time reported by the camera is used when it is known
+	 */
+	static void Work()
+	{
+		THREADS::Enter(THREADS::ROLE_CAPTURE,"air-exposure");
+		Engine &E = State();
+		std::unique_lock<std::mutex> lock(E.Lock);
+		while(E.Running == true)
+		{
+			if(E.Timers.empty())
+			{
+				E.Cond.wait(lock);
+				continue;
+			}
+			Timer next = E.Timers.top();
+			if(Clock::now() < next.first)
+			{
+				E.Cond.wait_until(lock,next.first);
+				continue;
+			}
+			E.Timers.pop();
+			THREADS::Wakeup(THREADS::ROLE_CAPTURE,next.first);
+			auto it = E.Jobs.find(next.second);
+			if(it == E.Jobs.end())
+				continue;		//已取消
+			POLLFUNC Poll = it->second.Poll;
+			lock.unlock();
+			int Remaining = -1;
+			STATUS status = Poll(Remaining);
+			METRICS::Add("exposure.polls");
+			lock.lock();
+			if((it = E.Jobs.find(next.second)) == E.Jobs.end())
+				continue;		//查询期间被取消
+			Job &job = it->second;
+			auto now = Clock::now();
+			if(status == EXPOSURE_WORKING && now > job.Deadline)
+			{
+				IDLog("Exposure of %s did not finish in time\n",job.Device.c_str());
+				status = EXPOSURE_FAILED;
+			}
+			if(status == EXPOSURE_WORKING)
+			{
+				int wait = Remaining > EXPOSURE_LEAD ? Remaining - EXPOSURE_LEAD : job.Interval;
+				job.Interval = std::min(job.Interval * 2,EXPOSURE_POLL_MAX);
+				E.Timers.push(Timer(now + std::chrono::milliseconds(wait),next.second));
+				continue;
+			}
+			DONEFUNC Complete = job.Complete;
+			E.Jobs.erase(it);
+			lock.unlock();
+			Complete(status == EXPOSURE_DONE);
+			lock.lock();
+		}
+	}
+
+	/*
+	 * name: Submit(std::string Device,int Duration,POLLFUNC Poll,DONEFUNC Complete)
+	 * @param Device:设备名称，用于日志
+	 * @param Duration:曝光时间(毫秒)
+	 * @param Poll:查询曝光状态
+	 * @param Complete:曝光结束回调
+	 * describe: Watch an exposure that has been started
+	 * 描述：监视一次已经开始的曝光
+	 * note: The first poll happens EXPOSURE_LEAD ms before the expected end,nothing runs while the sensor integrates
+	 */
+	int Submit(std::string Device,int Duration,POLLFUNC Poll,DONEFUNC Complete)
+	{
+		Engine &E = State();
+		std::lock_guard<std::mutex> guard(E.Lock);
+		if(E.Running == false)
+		{
+			E.Running = true;
+			E.Worker = std::thread(Work);
+		}
+		int Id = ++E.NextId;
+		auto now = Clock::now();
+		Job &job = E.Jobs[Id];
+		job.Device = Device;
+		job.Poll = Poll;
+		job.Complete = Complete;
+		job.Deadline = now + std::chrono::milliseconds(Duration + EXPOSURE_GRACE);
+		E.Timers.push(Timer(now + std::chrono::milliseconds(std::max(Duration - EXPOSURE_LEAD,0)),Id));
+		E.Cond.notify_all();
+		return Id;
+	}
+
+	/*
+	 * name: Cancel(int Id)
+	 * @param Id:曝光编号
+	 * describe: Stop watching an exposure,its callback reports failure at once
+	 * 描述：取消监视曝光，回调立即以失败结束
+	 * @return false: The exposure has already finished
+	 */
+	bool Cancel(int Id)
+	{
+		Engine &E = State();
+		DONEFUNC Complete;
+		{
+			std::lock_guard<std::mutex> guard(E.Lock);
+			auto it = E.Jobs.find(Id);
+			if(it == E.Jobs.end())
+				return false;
+			Complete = it->second.Complete;
+			E.Jobs.erase(it);
+		}
+		Complete(false);
+		return true;
+	}
+
+	/*
+	 * name: Wait(std::string Device,int Duration,POLLFUNC Poll,std::stop_token Stop)
+	 * @param Device:设备名称，用于日志
+	 * @param Duration:曝光时间(毫秒)
+	 * @param Poll:查询曝光状态
+	 * @param Stop:停止曝光时请求停止
+	 * describe: Watch an exposure and block until it ends
+	 * 描述：监视曝光并等待结束
+	 * @return false: The exposure failed or was stopped
+	 * note: A stop request cancels the job at once,the caller does not wait for the next poll
+	 */
+	bool Wait(std::string Device,int Duration,POLLFUNC Poll,std::stop_token Stop)
+	{
+		auto done = std::make_shared<std::promise<bool>>();
+		std::future<bool> finished = done->get_future();
+		const int Id = Submit(Device,Duration,Poll,[done](bool Success) { done->set_value(Success); });
+		std::stop_callback cancel(Stop,[Id]() { Cancel(Id); });
+		return finished.get();
+	}
+
+	int Pending()
+	{
+		Engine &E = State();
+		std::lock_guard<std::mutex> guard(E.Lock);
+		return E.Jobs.size();
+	}
+}
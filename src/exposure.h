@@ -0,0 +1,72 @@
+/*
+ * exposure.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Event driven exposure engine
+
+**************************************************/
+
+#pragma once
+
+#ifndef _EXPOSURE_H_
+#define _EXPOSURE_H_
+
+#include <string>
+#include <functional>
+#include <stop_token>
+
+#define EXPOSURE_LEAD 100		//预计结束前多久开始查询(毫秒)
+#define EXPOSURE_POLL_MIN 5		//最短查询间隔(毫秒)
+#define EXPOSURE_POLL_MAX 200		//最长查询间隔(毫秒)
+#define EXPOSURE_GRACE 60000		//超过预计结束时间多久判定曝光失败(毫秒)
+
+namespace AstroAir::EXPOSURE
+{
+	enum STATUS
+	{
+		EXPOSURE_WORKING,
+		EXPOSURE_DONE,
+		EXPOSURE_FAILED
+	};
+
+	/*查询曝光状态，Remaining为相机报告的剩余时间(毫秒)，未知时保持-1*/
+	typedef std::function<STATUS(int &Remaining)> POLLFUNC;
+	/*曝光结束回调，在引擎线程中执行，不能阻塞*/
+	typedef std::function<void(bool Success)> DONEFUNC;
+
+	/*提交一次已经开始的曝光，返回曝光编号*/
+	int Submit(std::string Device,int Duration,POLLFUNC Poll,DONEFUNC Complete);
+	/*取消曝光，回调以失败结束*/
+	bool Cancel(int Id);
+	/*提交曝光并等待结束，Stop被请求时立即返回false*/
+	bool Wait(std::string Device,int Duration,POLLFUNC Poll,std::stop_token Stop);
+	/*正在等待的曝光数量*/
+	int Pending();
+}
+
+#endif
@@ -0,0 +1,113 @@
+/*
+ * frame.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Frame description shared by drivers and consumers
+
+**************************************************/
+
+#pragma once
+
+#ifndef _FRAME_H_
+#define _FRAME_H_
+
+#include <stdint.h>
+#include <array>
+#include <chrono>
+#include <functional>
+
+namespace AstroAir
+{
+	/*
+	 * Describes one downloaded frame. The layout is fixed size and has no
+	 * pointers,so it can be copied into shared memory as it is.
+	 */
+	struct FRAMEHEADER
+	{
+		uint64_t Sequence = 0;		//帧序号
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		uint32_t BitDepth = 8;		//每个通道的位数
+		uint32_t Channels = 1;
+		uint64_t Size = 0;		//图像数据字节数
+		int64_t MonotonicNs = 0;		//下载完成时的单调时钟(纳秒)
+		int64_t UtcNs = 0;		//下载完成时的UTC时间(纳秒)
+		/*拍摄各阶段的单调时钟(纳秒)，未知时为0，UTC时间由UtcNs - MonotonicNs换算*/
+		int64_t CommandNs = 0;		//驱动收到拍摄命令
+		int64_t ExposureStartNs = 0;		//曝光开始
+		int64_t ExposureEndNs = 0;		//曝光结束
+	};
+
+	/*
+	 * Where the time from command to screen went for one frame. All values
+	 * are CLOCK_MONOTONIC nanoseconds,0 when the stage did not happen.
+	 */
+	struct FRAMETIMING
+	{
+		int64_t CommandNs = 0;
+		int64_t ExposureStartNs = 0;
+		int64_t ExposureEndNs = 0;
+		int64_t DownloadNs = 0;
+		int64_t FitsNs = 0;		//FITS文件写入完成
+		int64_t PreviewNs = 0;		//预览图生成完成
+		int64_t UtcOffsetNs = 0;		//UTC时间与单调时钟之差
+	};
+
+	/*一帧或其一部分的统计，数值为原始ADU*/
+	struct FRAMESTATS
+	{
+		uint32_t X = 0;
+		uint32_t Y = 0;
+		uint32_t Width = 0;
+		uint32_t Height = 0;
+		uint32_t Channels = 1;
+		uint32_t BitDepth = 8;
+		double Min = 0;
+		double Max = 0;
+		double Mean = 0;
+		double StdDev = 0;
+		std::array<uint32_t,256> Histogram{};		//所有通道合计，按位深压缩到256级
+	};
+
+	/*帧数据回调，Data只在回调期间有效*/
+	typedef std::function<void(const FRAMEHEADER &Header,const unsigned char *Data)> FRAMESINK;
+
+	/*单调时钟(纳秒)，CLOCK_MONOTONIC在进程间通用*/
+	inline int64_t MonotonicNs()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	/*UTC时间(纳秒)*/
+	inline int64_t UtcNs()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+}
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ * framecache.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Cache of the latest raw frames
+
+**************************************************/
+
+#include "metrics.h"
+#include "membudget.h"
+#include "framecache.h"
+
+namespace AstroAir
+{
+	FRAMECACHE::FRAMECACHE(size_t Count) : Count(Count)
+	{
+		Reclaimer = MEMBUDGET::AddReclaimer([this]() { Clear(); });
+	}
+
+	FRAMECACHE::~FRAMECACHE()
+	{
+		MEMBUDGET::RemoveReclaimer(Reclaimer);
+	}
+
+	/*
+	 * name: Put(std::shared_ptr<FRAMEJOB> Job)
+	 * @param Job:下载完成的帧
+	 * describe: Keep a frame for later requests
+	 * 描述：缓存一帧供之后的请求使用
+	 * note: The cache holds at most Count frames and FRAMECACHE_SHARE of the memory budget,the oldest frames go first
+	 */
+	void FRAMECACHE::Put(std::shared_ptr<FRAMEJOB> Job)
+	{
+		FRAMELIST dropped;		//在锁外释放，缓冲区归还时会进入缓冲池
+		{
+			std::lock_guard<std::mutex> guard(Lock);
+			auto it = Index.find(Job->FileName);
+			if(it != Index.end())
+			{
+				Bytes -= (*it->second)->Header.Size;
+				dropped.splice(dropped.end(),Frames,it->second);
+				Index.erase(it);
+			}
+			if(MEMBUDGET::Pressure() == true)
+			{
+				METRICS::Add("framecache.skipped");
+				return;
+			}
+			const size_t limit = MEMBUDGET::Limit() * FRAMECACHE_SHARE;
+			while(!Frames.empty() && (Frames.size() >= Count || Bytes + Job->Header.Size > limit))
+			{
+				Bytes -= Frames.back()->Header.Size;
+				Index.erase(Frames.back()->FileName);
+				dropped.splice(dropped.end(),Frames,std::prev(Frames.end()));
+			}
+			if(Job->Header.Size > limit || Count == 0)
+				return;
+			Frames.push_front(Job);
+			Index[Job->FileName] = Frames.begin();
+			Bytes += Job->Header.Size;
+			METRICS::Set("framecache.frames",Frames.size());
+		}
+	}
+
+	/*
+	 * name: Get(std::string FileName)
+	 * @param FileName:FITS文件名，为空时取最新一帧
+	 * describe: Look up a cached frame
+	 * 描述：查找缓存的帧
+	 * @return nullptr: The frame is not cached
+	 */
+	std::shared_ptr<FRAMEJOB> FRAMECACHE::Get(std::string FileName)
+	{
+		std::lock_guard<std::mutex> guard(Lock);
+		FRAMELIST::iterator it;
+		if(FileName.empty())
+			it = Frames.begin();
+		else
+		{
+			auto found = Index.find(FileName);
+			it = found == Index.end() ? Frames.end() : found->second;
+		}
+		if(it == Frames.end())
+		{
+			METRICS::Add("framecache.misses");
+			return nullptr;
+		}
+		METRICS::Add("framecache.hits");
+		Frames.splice(Frames.begin(),Frames,it);
+		return Frames.front();
+	}
+
+	void FRAMECACHE::Clear()
+	{
+		FRAMELIST dropped;
+		std::lock_guard<std::mutex> guard(Lock);
+		dropped.swap(Frames);
+		Index.clear();
+		Bytes = 0;
+		METRICS::Set("framecache.frames",0);
+	}
+}
@@ -0,0 +1,82 @@
+/*
+ * framecache.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Cache of the latest raw frames
+
+**************************************************/
+
+#pragma once
+
+#ifndef _FRAMECACHE_H_
+#define _FRAMECACHE_H_
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+
+#include "pipeline.h"
+
+#define FRAMECACHE_SIZE 4		//最多缓存的帧数
+#define FRAMECACHE_SHARE 0.25		//缓存最多占用内存预算的比例
+
+namespace AstroAir
+{
+	/*
+	 * Keeps the last few frames after the pipeline is done with them, so a
+	 * new stretch,crop or statistics request is served from memory instead
+	 * of reading the FITS file back. Frames are looked up by file name and
+	 * dropped least recently used first; the whole cache is dropped when
+	 * the frame pool runs out of memory budget.
+	 */
+	class FRAMECACHE
+	{
+		public:
+			explicit FRAMECACHE(size_t Count = FRAMECACHE_SIZE);
+			~FRAMECACHE();
+			/*缓存一帧，同名的旧帧被替换，内存紧张时不缓存*/
+			void Put(std::shared_ptr<FRAMEJOB> Job);
+			/*按文件名取出一帧并标为最近使用，名称为空时取最新一帧，不存在时返回空*/
+			std::shared_ptr<FRAMEJOB> Get(std::string FileName);
+			/*丢弃所有缓存的帧*/
+			void Clear();
+		private:
+			typedef std::list<std::shared_ptr<FRAMEJOB>> FRAMELIST;
+
+			std::mutex Lock;
+			FRAMELIST Frames;		//最近使用的在前
+			std::unordered_map<std::string,FRAMELIST::iterator> Index;
+			size_t Count;
+			size_t Bytes = 0;
+			int Reclaimer = -1;
+	};
+}
+
+#endif
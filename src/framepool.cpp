@@ -0,0 +1,200 @@
+/*
+ * framepool.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Reusable frame buffer pool
+
+**************************************************/
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <chrono>
+
+#include "logger.h"
+#include "metrics.h"
+#include "membudget.h"
+#include "framepool.h"
+
+namespace AstroAir
+{
+	FRAMEPOOL::FRAMEPOOL(std::string Name)
+	{
+		pool = std::make_shared<Pool>();
+		pool->Name = Name;
+	}
+
+	/*
+	 * name: ~FRAMEPOOL()
+	 * describe: Free the idle buffers
+	 * 描述：释放空闲缓冲区
+	 * note: Buffers still in use are freed when their last user drops them
+	 */
+	FRAMEPOOL::~FRAMEPOOL()
+	{
+		std::lock_guard<std::mutex> guard(pool->Lock);
+		for(auto buffer : pool->Free)
+			Deallocate(buffer,pool->BufferSize);
+		pool->Free.clear();
+		pool->Count = 0;
+	}
+
+	/*按页对齐分配，便于DMA与直接写盘，超出内存预算时返回空*/
+	unsigned char *FRAMEPOOL::Allocate(size_t Size)
+	{
+		if(MEMBUDGET::Reserve(Size) == false)
+			return nullptr;
+		void *buffer = nullptr;
+		if(posix_memalign(&buffer,sysconf(_SC_PAGESIZE),Size) != 0)
+		{
+			MEMBUDGET::Release(Size);
+			return nullptr;
+		}
+		METRICS::Add("framepool.allocations");
+		return static_cast<unsigned char *>(buffer);
+	}
+
+	void FRAMEPOOL::Deallocate(unsigned char *Buffer,size_t Size)
+	{
+		free(Buffer);
+		MEMBUDGET::Release(Size);
+	}
+
+	/*
+	 * name: Reserve(size_t BufferSize,int Count)
+	 * @param BufferSize:单帧最大字节数
+	 * @param Count:缓冲区数量
+	 * describe: Allocate the buffers when the camera is connected
+	 * 描述：连接相机时按最大分辨率分配缓冲区
+	 * note: Idle buffers of a smaller size are dropped,buffers in use are dropped when they come back
+	 */
+	void FRAMEPOOL::Reserve(size_t BufferSize,int Count)
+	{
+		std::lock_guard<std::mutex> guard(pool->Lock);
+		if(BufferSize != pool->BufferSize)
+		{
+			for(auto buffer : pool->Free)
+				Deallocate(buffer,pool->BufferSize);
+			pool->Free.clear();
+			pool->BufferSize = BufferSize;
+		}
+		pool->Count = Count;
+		while((int)pool->Free.size() < Count)
+		{
+			unsigned char *buffer = Allocate(BufferSize);
+			if(buffer == nullptr)
+			{
+				/*内存预算不足时少保留几个缓冲区，拍摄时等待归还*/
+				IDLog("Unable to allocate %zu bytes for the frame pool of %s,keep %zu buffers\n",BufferSize,pool->Name.c_str(),pool->Free.size());
+				break;
+			}
+			pool->Free.push_back(buffer);
+		}
+	}
+
+	/*
+	 * name: Acquire(size_t Size)
+	 * @param Size:需要的字节数
+	 * describe: Get a buffer from the pool
+	 * 描述：从缓冲池中取出缓冲区
+	 * @return nullptr: Out of memory
+	 * note: When every buffer is busy a new one is allocated rather than waiting,it stays in the pool only while the pool is not full.
+	 *       Once the memory budget is used up the frame caches are dropped,then it waits up to FRAMEPOOL_WAIT for a buffer to come back.
+	 */
+	FRAMEBUFFER FRAMEPOOL::Acquire(size_t Size)
+	{
+		unsigned char *buffer = nullptr;
+		size_t BufferSize;
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(FRAMEPOOL_WAIT);
+		bool missed = false,reclaimed = false;
+		std::unique_lock<std::mutex> lock(pool->Lock);
+		while(true)
+		{
+			if(Size > pool->BufferSize)
+			{
+				/*分辨率超过预计，以后都按新的大小分配*/
+				for(auto it : pool->Free)
+					Deallocate(it,pool->BufferSize);
+				pool->Free.clear();
+				pool->BufferSize = Size;
+			}
+			BufferSize = pool->BufferSize;
+			if(!pool->Free.empty())
+			{
+				buffer = pool->Free.back();
+				pool->Free.pop_back();
+				break;
+			}
+			if(missed == false)
+			{
+				missed = true;
+				METRICS::Add("framepool.misses");
+			}
+			lock.unlock();
+			buffer = Allocate(BufferSize);
+			if(buffer == nullptr && reclaimed == false)
+			{
+				/*先丢弃缓存的旧帧，其中的缓冲区可能回到这个缓冲池*/
+				reclaimed = true;
+				MEMBUDGET::Reclaim();
+				lock.lock();
+				continue;
+			}
+			lock.lock();
+			if(buffer != nullptr)
+				break;
+			/*超出内存预算，等待其他帧处理完归还缓冲区，其他缓冲池释放的预算不会通知这里，因此定时重试*/
+			METRICS::Add("framepool.budget_waits");
+			pool->Returned.wait_for(lock,std::chrono::milliseconds(FRAMEPOOL_RETRY));
+			if(std::chrono::steady_clock::now() >= deadline)
+			{
+				IDLog("Unable to allocate %zu bytes for a frame of %s within the memory budget\n",BufferSize,pool->Name.c_str());
+				return nullptr;
+			}
+		}
+		lock.unlock();
+		std::shared_ptr<Pool> owner = pool;
+		return FRAMEBUFFER(buffer,[owner,BufferSize](unsigned char *Buffer) { Release(owner,BufferSize,Buffer); });
+	}
+
+	/*缓冲区的最后一个使用者释放时调用*/
+	void FRAMEPOOL::Release(std::shared_ptr<Pool> pool,size_t Size,unsigned char *Buffer)
+	{
+		std::lock_guard<std::mutex> guard(pool->Lock);
+		if(Size == pool->BufferSize && (int)pool->Free.size() < pool->Count)
+			pool->Free.push_back(Buffer);
+		else
+			Deallocate(Buffer,Size);
+		pool->Returned.notify_all();
+	}
+
+	int FRAMEPOOL::Available()
+	{
+		std::lock_guard<std::mutex> guard(pool->Lock);
+		return pool->Free.size();
+	}
+}
@@ -0,0 +1,92 @@
+/*
+ * framepool.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Reusable frame buffer pool
+
+**************************************************/
+
+#pragma once
+
+#ifndef _FRAMEPOOL_H_
+#define _FRAMEPOOL_H_
+
+#include <stddef.h>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <string>
+
+#define FRAMEPOOL_SIZE 4		//默认缓冲区数量：下载、写文件、预览、发送各一个
+#define FRAMEPOOL_WAIT 10000		//超出内存预算时等待缓冲区归还的最长时间(毫秒)
+#define FRAMEPOOL_RETRY 100		//等待期间重新申请内存的间隔(毫秒)
+
+namespace AstroAir
+{
+	/*帧缓冲区，最后一个使用者释放后自动回到缓冲池*/
+	typedef std::shared_ptr<unsigned char[]> FRAMEBUFFER;
+
+	/*
+	 * Keeps page aligned frame buffers for reuse. A buffer handed out by
+	 * Acquire() returns to the pool when its last reference is dropped,
+	 * so the capture loop does no large allocation once the pool is warm.
+	 * Every buffer counts against MEMBUDGET; when the budget is used up
+	 * Acquire() waits for a buffer to come back instead of allocating.
+	 */
+	class FRAMEPOOL
+	{
+		public:
+			explicit FRAMEPOOL(std::string Name);
+			~FRAMEPOOL();
+			/*按相机最大分辨率预先分配缓冲区*/
+			void Reserve(size_t BufferSize,int Count = FRAMEPOOL_SIZE);
+			/*取出一个至少Size字节的缓冲区*/
+			FRAMEBUFFER Acquire(size_t Size);
+			/*空闲缓冲区数量*/
+			int Available();
+		private:
+			struct Pool
+			{
+				std::string Name;
+				std::mutex Lock;
+				std::condition_variable Returned;		//缓冲区归还或释放时通知
+				std::vector<unsigned char *> Free;
+				size_t BufferSize = 0;
+				int Count = 0;		//需要保留的缓冲区数量
+			};
+			static unsigned char *Allocate(size_t Size);
+			static void Deallocate(unsigned char *Buffer,size_t Size);
+			static void Release(std::shared_ptr<Pool> pool,size_t Size,unsigned char *Buffer);
+
+			/*缓冲区可能比缓冲池活得更久，因此共同持有*/
+			std::shared_ptr<Pool> pool;
+	};
+}
+
+#endif
@@ -34,9 +34,12 @@ Description:Main program of astroair server
 #include <stdio.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <string.h>
 #include <thread>
 
 #include "wsserver.h"
+#include "discovery.h"
+#include "drvhost.h"
 
 using namespace AstroAir;
 
@@ -61,6 +64,7 @@ void usage(char *me)
 	fprintf(stderr, " -s       : stop server\n");
     fprintf(stderr, " -p p     : alternate IP port, default %d\n", AIRPORT);
 	fprintf(stderr, " -c       : write a configure file for server\n");
+	fprintf(stderr, " -o       : run camera drivers in child processes,put it before -v\n");
     exit(2);
 }
 
@@ -177,6 +181,8 @@ void configure()
 	std::cin >> ok;
 	if(ok == "Y")
 	{
+		WSSERVER::PreloadDrivers();
+		DISCOVERY::Start();
 		std::thread t1(start_server);
 		std::thread t2(start_server_tls);
 		t1.join();
@@ -199,17 +205,18 @@ void configure()
  */
 int main(int argc, char *argv[])
 {
-	/*输出Logo*/
-	PrintLogo();
-	char *optarg;
-    int optind, opterr, optopt;
-    int verbose = 0;
+	/*驱动进程由服务器启动，不输出Logo*/
+	if(argc < 2 || strcmp(argv[1],"-H") != 0)
+		PrintLogo();
     int opt = -1;
-    while ((opt = getopt(argc, argv, "vp:sc")) != -1) 
+    while ((opt = getopt(argc, argv, "vp:scoH:")) != -1) 
     {    
 		switch (opt) 
 		{    
 			case 'v':{
+				/*后台扫描设备，连接时直接查询缓存*/
+				WSSERVER::PreloadDrivers();
+				DISCOVERY::Start();
 				std::thread t1(start_server);
 				std::thread t2(start_server_tls);
 				t1.join();
@@ -226,6 +233,12 @@ int main(int argc, char *argv[])
 			case 'c':
 				configure();
 				break;
+			case 'o':
+				DRIVERHOST::Enable(true);
+				break;
+			/*作为驱动进程运行，只由服务器内部使用*/
+			case 'H':
+				return DRIVERHOST::Serve(optarg,HOST_FD);
 			default:
 				usage(argv[0]);
 		}
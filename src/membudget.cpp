@@ -0,0 +1,199 @@
+/*
+ * membudget.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Process wide memory budget for frame buffers
+
+**************************************************/
+
+#include <mutex>
+#include <map>
+#include <algorithm>
+#include <stdint.h>
+#include <unistd.h>
+#include <json/json.h>
+
+#include "logger.h"
+#include "airconfig.h"
+#include "metrics.h"
+#include "membudget.h"
+
+namespace AstroAir::MEMBUDGET
+{
+	struct Budget
+	{
+		std::mutex Lock;
+		size_t Limit = 0;
+		size_t Used = 0;
+	};
+
+	/*
+	 * name: DefaultLimit()
+	 * describe: Budget from config.air,or a share of the physical memory
+	 * 描述：读取config.air中的server.memory_mb，未配置时按物理内存计算
+	 */
+	static size_t DefaultLimit()
+	{
+		Json::Value root;
+		if(AIRCONFIG::Load(root) == true && root["server"]["memory_mb"].asInt64() > 0)
+			return (size_t)root["server"]["memory_mb"].asInt64() << 20;
+		long pages = sysconf(_SC_PHYS_PAGES);
+		long size = sysconf(_SC_PAGESIZE);
+		if(pages <= 0 || size <= 0)
+			return SIZE_MAX;
+		return (size_t)(pages * (double)size * MEMBUDGET_SHARE);
+	}
+
+	static Budget &State()
+	{
+		static Budget budget;
+		static std::once_flag once;
+		std::call_once(once,[]()
+		{
+			budget.Limit = DefaultLimit();
+			METRICS::Set("membudget.limit_mb",budget.Limit >> 20);
+			IDLog("Memory budget is %zu MB\n",budget.Limit >> 20);
+		});
+		return budget;
+	}
+
+	/*
+	 * name: SetLimit(size_t Bytes)
+	 * @param Bytes:预算字节数，0表示按物理内存自动设置
+	 * describe: Change the memory budget
+	 * 描述：修改内存预算
+	 * note: Memory already reserved stays reserved even if it is over the new limit
+	 */
+	void SetLimit(size_t Bytes)
+	{
+		Budget &B = State();
+		if(Bytes == 0)
+			Bytes = DefaultLimit();
+		std::lock_guard<std::mutex> guard(B.Lock);
+		B.Limit = Bytes;
+		METRICS::Set("membudget.limit_mb",Bytes >> 20);
+	}
+
+	size_t Limit()
+	{
+		Budget &B = State();
+		std::lock_guard<std::mutex> guard(B.Lock);
+		return B.Limit;
+	}
+
+	size_t Used()
+	{
+		Budget &B = State();
+		std::lock_guard<std::mutex> guard(B.Lock);
+		return B.Used;
+	}
+
+	/*
+	 * name: Reserve(size_t Bytes,bool Optional)
+	 * @param Bytes:需要的字节数
+	 * @param Optional:是否为可选用途
+	 * describe: Reserve memory against the budget
+	 * 描述：按预算预留内存
+	 * @return false: Over the budget,nothing is reserved
+	 */
+	bool Reserve(size_t Bytes,bool Optional)
+	{
+		Budget &B = State();
+		std::lock_guard<std::mutex> guard(B.Lock);
+		size_t limit = Optional ? (size_t)(B.Limit * MEMBUDGET_OPTIONAL) : B.Limit;
+		if(B.Used + Bytes > limit)
+		{
+			METRICS::Add(Optional ? "membudget.refused_optional" : "membudget.refused");
+			return false;
+		}
+		B.Used += Bytes;
+		METRICS::Set("membudget.used_mb",B.Used / 1048576.0);
+		return true;
+	}
+
+	void Release(size_t Bytes)
+	{
+		Budget &B = State();
+		std::lock_guard<std::mutex> guard(B.Lock);
+		B.Used -= std::min(Bytes,B.Used);
+		METRICS::Set("membudget.used_mb",B.Used / 1048576.0);
+	}
+
+	bool Pressure()
+	{
+		Budget &B = State();
+		std::lock_guard<std::mutex> guard(B.Lock);
+		return B.Used >= B.Limit * MEMBUDGET_OPTIONAL;
+	}
+
+	/*可丢弃缓存的释放函数，调用期间持有锁，注销时等待调用结束*/
+	struct Reclaimers
+	{
+		std::mutex Lock;
+		std::map<int,std::function<void()>> Funcs;
+		int NextId = 0;
+	};
+
+	static Reclaimers &ReclaimState()
+	{
+		static Reclaimers reclaimers;
+		return reclaimers;
+	}
+
+	int AddReclaimer(std::function<void()> Reclaim)
+	{
+		Reclaimers &R = ReclaimState();
+		std::lock_guard<std::mutex> guard(R.Lock);
+		R.Funcs[R.NextId] = Reclaim;
+		return R.NextId++;
+	}
+
+	void RemoveReclaimer(int Id)
+	{
+		Reclaimers &R = ReclaimState();
+		std::lock_guard<std::mutex> guard(R.Lock);
+		R.Funcs.erase(Id);
+	}
+
+	/*
+	 * name: Reclaim()
+	 * describe: Drop every cache that registered itself
+	 * 描述：释放所有已注册的缓存
+	 * note: The functions must not reserve memory or call back into the budget's reclaimers
+	 */
+	void Reclaim()
+	{
+		Reclaimers &R = ReclaimState();
+		std::lock_guard<std::mutex> guard(R.Lock);
+		if(R.Funcs.empty())
+			return;
+		METRICS::Add("membudget.reclaims");
+		for(auto &it : R.Funcs)
+			it.second();
+	}
+}
@@ -0,0 +1,71 @@
+/*
+ * membudget.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Process wide memory budget for frame buffers
+
+**************************************************/
+
+#pragma once
+
+#ifndef _MEMBUDGET_H_
+#define _MEMBUDGET_H_
+
+#include <stddef.h>
+#include <functional>
+
+#define MEMBUDGET_SHARE 0.5		//未配置时预算占物理内存的比例
+#define MEMBUDGET_OPTIONAL 0.8		//预览、分析等可选用途最多使用预算的比例，其余留给帧缓冲区
+
+/*
+ * One budget for the large buffers of the whole process. Frame buffers are
+ * essential and may use all of it; previews and analysis are optional and
+ * are refused once the budget is mostly used,so on a small board they are
+ * skipped before the frames that must be saved run out of memory.
+ */
+namespace AstroAir::MEMBUDGET
+{
+	/*设置预算(字节)，0表示按物理内存自动设置*/
+	void SetLimit(size_t Bytes);
+	size_t Limit();
+	/*已预留的字节数*/
+	size_t Used();
+	/*预留内存，Optional为真时只能使用预算的MEMBUDGET_OPTIONAL，返回false表示超出预算*/
+	bool Reserve(size_t Bytes,bool Optional = false);
+	/*归还预留的内存*/
+	void Release(size_t Bytes);
+	/*可选用途已无法预留时为真*/
+	bool Pressure();
+	/*注册超出预算时释放缓存的函数，返回编号*/
+	int AddReclaimer(std::function<void()> Reclaim);
+	void RemoveReclaimer(int Id);
+	/*释放所有可丢弃的缓存，帧缓冲区超出预算时调用*/
+	void Reclaim();
+}
+
+#endif
@@ -0,0 +1,170 @@
+/*
+ * metrics.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Runtime metrics of astroair server
+
+**************************************************/
+
+#include <mutex>
+#include <cmath>
+#include <algorithm>
+
+#include "metrics.h"
+
+namespace AstroAir::METRICS
+{
+	static std::mutex &MetricsLock()
+	{
+		static std::mutex lock;
+		return lock;
+	}
+
+	static std::map<std::string,double> &Values()
+	{
+		static std::map<std::string,double> values;
+		return values;
+	}
+
+	/*一个观测值的最近样本与累计直方图*/
+	struct Series
+	{
+		std::vector<double> Window;
+		size_t Next = 0;
+		uint64_t Count = 0;
+		std::vector<uint64_t> Buckets = std::vector<uint64_t>(METRICS_BUCKETS,0);
+	};
+
+	static std::map<std::string,Series> &Observations()
+	{
+		static std::map<std::string,Series> observations;
+		return observations;
+	}
+
+	/*
+	 * name: Add(std::string Name,double Value)
+	 * @param Name:指标名称
+	 * @param Value:增加的值
+	 * describe: Increase a counter
+	 * 描述：计数器累加
+	 */
+	void Add(std::string Name,double Value)
+	{
+		std::lock_guard<std::mutex> guard(MetricsLock());
+		Values()[Name] += Value;
+	}
+
+	/*
+	 * name: Set(std::string Name,double Value)
+	 * @param Name:指标名称
+	 * @param Value:当前值
+	 * describe: Set a gauge
+	 * 描述：设置指标当前值
+	 */
+	void Set(std::string Name,double Value)
+	{
+		std::lock_guard<std::mutex> guard(MetricsLock());
+		Values()[Name] = Value;
+	}
+
+	/*
+	 * name: Get(std::string Name)
+	 * @param Name:指标名称
+	 * describe: Get the value of a metric
+	 * 描述：获取指标的值
+	 */
+	double Get(std::string Name)
+	{
+		std::lock_guard<std::mutex> guard(MetricsLock());
+		auto it = Values().find(Name);
+		return it == Values().end() ? 0 : it->second;
+	}
+
+	/*
+	 * name: Observe(std::string Name,double Value)
+	 * @param Name:指标名称
+	 * @param Value:观测值
+	 * describe: Record one sample,e.g. the duration or speed of a download
+	 * 描述：记录一次观测值，例如一次下载的耗时或速度
+	 * note: Statistics cover the last METRICS_WINDOW samples,the histogram covers all of them
+	 */
+	void Observe(std::string Name,double Value)
+	{
+		std::lock_guard<std::mutex> guard(MetricsLock());
+		Series &series = Observations()[Name];
+		if(series.Window.size() < METRICS_WINDOW)
+			series.Window.push_back(Value);
+		else
+			series.Window[series.Next] = Value;
+		series.Next = (series.Next + 1) % METRICS_WINDOW;
+		series.Count++;
+		int bucket = Value > 1 ? (int)std::ceil(std::log2(Value)) : 0;
+		series.Buckets[std::min(bucket,METRICS_BUCKETS - 1)]++;
+	}
+
+	/*
+	 * name: All()
+	 * describe: Get all metrics
+	 * 描述：获取所有指标
+	 */
+	std::map<std::string,double> All()
+	{
+		std::lock_guard<std::mutex> guard(MetricsLock());
+		std::map<std::string,double> values = Values();
+		for(auto &it : Observations())
+		{
+			std::vector<double> window = it.second.Window;
+			if(window.empty())
+				continue;
+			std::sort(window.begin(),window.end());
+			double sum = 0;
+			for(double value : window)
+				sum += value;
+			values[it.first + ".count"] = it.second.Count;
+			values[it.first + ".mean"] = sum / window.size();
+			values[it.first + ".p50"] = window[window.size() / 2];
+			values[it.first + ".p95"] = window[std::min(window.size() - 1,window.size() * 95 / 100)];
+			values[it.first + ".max"] = window.back();
+		}
+		return values;
+	}
+
+	/*
+	 * name: Histograms()
+	 * describe: Get the histogram of every observed metric
+	 * 描述：获取所有观测值的直方图
+	 */
+	std::map<std::string,std::vector<uint64_t>> Histograms()
+	{
+		std::lock_guard<std::mutex> guard(MetricsLock());
+		std::map<std::string,std::vector<uint64_t>> histograms;
+		for(auto &it : Observations())
+			histograms[it.first] = it.second.Buckets;
+		return histograms;
+	}
+}
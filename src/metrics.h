@@ -0,0 +1,63 @@
+/*
+ * metrics.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Runtime metrics of astroair server
+
+**************************************************/
+
+#pragma once
+
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <string>
+#include <map>
+#include <vector>
+#include <stdint.h>
+
+#define METRICS_WINDOW 128		//滚动统计保留的样本数
+#define METRICS_BUCKETS 32		//直方图桶数，上界依次为1,2,4...
+
+namespace AstroAir::METRICS
+{
+	/*计数器累加*/
+	void Add(std::string Name,double Value = 1);
+	/*设置当前值*/
+	void Set(std::string Name,double Value);
+	/*获取指标，不存在时返回0*/
+	double Get(std::string Name);
+	/*记录一次观测值，用于滚动统计与直方图*/
+	void Observe(std::string Name,double Value);
+	/*获取所有指标，观测值展开为.count,.mean,.p50,.p95,.max*/
+	std::map<std::string,double> All();
+	/*观测值的累计直方图，第i个桶统计不大于2^i的值*/
+	std::map<std::string,std::vector<uint64_t>> Histograms();
+}
+
+#endif
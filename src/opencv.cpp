@@ -33,90 +33,141 @@ Description:OPENCV Library
 #include <vector>
 #include <string.h>
 #include <fstream>
+#include <algorithm>
+#include <limits>
 
 #include "logger.h"
 #include "opencv.h"
+#include "pixel.h"
 
 namespace AstroAir::OPENCV
 {
 	/*
-     * name: SaveImage(unsigned char *imgBuf,std::string ImageName,bool isColor,int ImageHeight,int ImageWidth)
+	 * name: Bounds(const PIXEL::HISTOGRAM<Channels> &Bins,size_t Pixels,int Shift,T &Low,T &High)
+	 * describe: Black and white point of the preview from the histogram
+	 * 描述：依据直方图确定预览图的黑点与白点
+	 * note: The darkest 0.1% and the brightest 0.1% of the pixels are clipped,so a few hot pixels or saturated stars do not flatten the preview
+	 */
+	template<typename T,int Channels>
+	static void Bounds(const PIXEL::HISTOGRAM<Channels> &Bins,size_t Pixels,int Shift,T &Low,T &High)
+	{
+		std::array<uint64_t,256> total{};
+		for(auto &channel : Bins)
+			for(int i = 0;i < 256;i++)
+				total[i] += channel[i];
+		const uint64_t clip = Pixels * Channels / 1000;
+		int low = 0,high = 255;
+		for(uint64_t sum = 0;low < 255 && (sum += total[low]) <= clip;low++);
+		for(uint64_t sum = 0;high > low && (sum += total[high]) <= clip;high--);
+		Low = (T)(low << Shift);
+		High = (T)(((high + 1) << Shift) - 1);
+	}
+
+	/*
+	 * name: BayerCode(std::string Bayer)
+	 * describe: OpenCV names a Bayer pattern by its second row,so RGGB is BayerBG
+	 * 描述：OpenCV以第二行命名拜耳阵列，RGGB对应BayerBG
+	 */
+	static int BayerCode(std::string Bayer)
+	{
+		if(Bayer == "BGGR")
+			return cv::COLOR_BayerRG2BGR;
+		if(Bayer == "GRBG")
+			return cv::COLOR_BayerGB2BGR;
+		if(Bayer == "GBRG")
+			return cv::COLOR_BayerGR2BGR;
+		return cv::COLOR_BayerBG2BGR;
+	}
+
+	/*
+	 * name: Scratch(FRAMEARENA *Arena,int Rows,int Cols,int Type)
+	 * describe: An image in the scratch memory of the frame,or on the heap when it does not fit
+	 * 描述：在帧的暂存区中创建图像，放不下时使用堆内存
+	 */
+	static cv::Mat Scratch(FRAMEARENA *Arena,int Rows,int Cols,int Type)
+	{
+		void *data = Arena != nullptr ? Arena->Allocate((size_t)Rows * Cols * CV_ELEM_SIZE(Type)) : nullptr;
+		return data != nullptr ? cv::Mat(Rows,Cols,Type,data) : cv::Mat(Rows,Cols,Type);
+	}
+
+	/*
+     * name: SaveImage(const unsigned char *imgBuf,std::string ImageName,const FRAMEHEADER &Header,std::string Bayer,int Low,int High,FRAMEARENA *Arena)
      * @param imgBuf:图像缓冲区
 	 * @param ImageName:保存图像名称
-	 * @param isColor:图像是否为彩色
-	 * @param ImageHeight:图像高度
-	 * @param ImageWidth:图像宽度
+	 * @param Header:帧信息，决定位深与通道数
+	 * @param Bayer:拜耳阵列，为空时不做插值
+	 * @param Low:黑点(ADU)，小于0时由直方图确定
+	 * @param High:白点(ADU)，小于0时由直方图确定
+	 * @param Arena:帧的暂存区，为空时使用堆内存
      * describe: Save JPG Image
      * 描述： 保存JPG图像
      * calls: imwrite()
      * calls: IDLog()
-     * note: The default quality of JPG image is 100
+     * note: The frame is stretched to 8 bit by a kernel specialized for its format,the default quality of JPG image is 100.
+     *       The 8 bit image and the debayered image are the only large intermediates,both come from the arena.
      */
-	void SaveImage(unsigned char *imgBuf,std::string ImageName,bool isColor,int ImageHeight,int ImageWidth)
+	void SaveImage(const unsigned char *imgBuf,std::string ImageName,const FRAMEHEADER &Header,std::string Bayer,int Low,int High,FRAMEARENA *Arena)
 	{
-		std::vector<int> compression_params;		//图像质量
-		compression_params.push_back(cv::IMWRITE_JPEG_QUALITY);		//JPG图像质量
-		compression_params.push_back(100);
-		const char* JPGName = strtok(const_cast<char *>(ImageName.c_str()),".");
-		strcat(const_cast<char *>(JPGName), ".jpg");
-		if(isColor == true)
+		static const std::vector<int> compression_params = {cv::IMWRITE_JPEG_QUALITY,100};		//JPG图像质量
+		std::string JPGName = ImageName.substr(0,ImageName.find('.')) + ".jpg";
+		const size_t pixels = (size_t)Header.Width * Header.Height;
+		cv::Mat img = Scratch(Arena,Header.Height,Header.Width,Header.Channels == 3 ? CV_8UC3 : CV_8UC1);
+		bool ok = PIXEL::Dispatch(Header,[&]<typename T,int Channels>()
 		{
-			cv::Mat img(ImageHeight,ImageWidth, CV_8UC3, imgBuf);		//3通道图像信息
-			imwrite(JPGName,img, compression_params);
+			const T *source = reinterpret_cast<const T *>(imgBuf);
+			const int shift = (sizeof(T) - 1) * 8;
+			PIXEL::HISTOGRAM<Channels> bins;
+			PIXEL::Histogram<T,Channels>(source,pixels,shift,bins);
+			T low,high;
+			Bounds<T,Channels>(bins,pixels,shift,low,high);
+			/*客户端指定的黑点与白点*/
+			if(Low >= 0)
+				low = (T)std::min<int>(Low,std::numeric_limits<T>::max());
+			if(High >= 0)
+				high = (T)std::min<int>(High,std::numeric_limits<T>::max());
+			PIXEL::Stretch<T>(source,img.data,pixels * Channels,low,high);
+		});
+		if(ok == false)
+		{
+			IDLog("Unable to make a preview of %d channel image\n",Header.Channels);
+			return;
 		}
-		else
+		if(Header.Channels == 1 && !Bayer.empty())
 		{
-			cv::Mat img(ImageHeight,ImageWidth, CV_8UC1, imgBuf);		//单通道图像信息
-			imwrite(JPGName,img, compression_params);		//写入文件
+			/*目标图像尺寸与类型已经正确，cvtColor不会重新分配*/
+			cv::Mat color = Scratch(Arena,Header.Height,Header.Width,CV_8UC3);
+			cv::cvtColor(img,color,BayerCode(Bayer));		//拜耳阵列插值为彩色图像
+			img = color;
 		}
+		imwrite(JPGName,img, compression_params);
 		IDLog("JPG image saved successfully\n");
 	} 
 
 	/*
-     * name: clacHistogram(unsigned char *imgBuf,bool isColor,int ImageHeight,int ImageWidth)
+     * name: clacHistogram(const unsigned char *imgBuf,const FRAMEHEADER &Header)
      * @param imgBuf:图像缓冲区
-	 * @param isColor:图像是否为彩色
-	 * @param ImageHeight:图像高度
-	 * @param ImageWidth:图像宽度
+	 * @param Header:帧信息，决定位深与通道数
      * describe: Calculate histogram
      * 描述： 计算直方图
-     * calls: calcHist()
      * calls: IDLog()
-     * note: The result of histogram calculation will be output to a file
+     * note: One row of 256 bins per channel is written to histogram.txt,the bins stay on the stack
      */
-	void clacHistogram(unsigned char *imgBuf,bool isColor,int ImageHeight,int ImageWidth)
+	void clacHistogram(const unsigned char *imgBuf,const FRAMEHEADER &Header)
 	{
-		cv::MatND dstHist;  
-		/*最大值&最小值*/
-		double minValue = 0;
-		double maxValue = 0;
-		float hranges[] = { 0,255 }; //特征空间的取值范围
-		if(isColor == true)		//如果是彩色相机
+		const size_t pixels = (size_t)Header.Width * Header.Height;
+		bool ok = PIXEL::Dispatch(Header,[&]<typename T,int Channels>()
 		{
-			IDLog("Start calculating color image histogram\n");
-			cv::Mat img(ImageHeight,ImageWidth, CV_8UC3, imgBuf);		//3通道图像信息
-			int histSize[3] = {256,256,256};
-			const float *ranges[3] = { hranges , hranges , hranges};
-			int channels[3] = {0,1,2};
-			cv::calcHist(&img, 1, channels, cv::Mat(), dstHist, 3, histSize, ranges);
-			IDLog("Finish calculating color image histogram\n");
-		}
-		else		//默认为黑白相机
-		{
-			IDLog("Start calculating histogram of mono image\n");
-			cv::Mat img(ImageHeight,ImageWidth, CV_8UC1, imgBuf);		//单通道图像信息
-			const float *ranges[] = { hranges };
-			int histSize = 256;  //存放每个维度的直方图的尺寸的数组
-			int channels = 0;  //通道数
-			cv::calcHist(&img, 1, &channels, cv::Mat(), dstHist, 1, &histSize, ranges);
-			IDLog("Finish calculating histogram of mono image\n");
-		}
-		std::ofstream outfile;
-		outfile.open("histogram.txt");
-		if(outfile.is_open())
-		{
-			outfile << dstHist;
-			outfile.close();
-		}
+			PIXEL::HISTOGRAM<Channels> bins;
+			PIXEL::Histogram<T,Channels>(reinterpret_cast<const T *>(imgBuf),pixels,(sizeof(T) - 1) * 8,bins);
+			std::ofstream outfile;
+			outfile.open("histogram.txt");
+			if(outfile.is_open())
+			{
+				outfile << cv::Mat(Channels,256,CV_32SC1,bins.data());
+				outfile.close();
+			}
+		});
+		if(ok == false)
+			IDLog("Unable to calculate histogram of %d channel image\n",Header.Channels);
 	}
 }
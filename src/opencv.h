@@ -39,10 +39,14 @@ Description:OPENCV Library
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/opencv.hpp>
 
+#include "frame.h"
+#include "arena.h"
+
 namespace AstroAir::OPENCV
 {
-	void SaveImage(unsigned char *imgBuf,std::string ImageName,bool isColor,int ImageHeight,int ImageWidth);
-	void clacHistogram(unsigned char *imgBuf,bool isColor,int ImageHeight,int ImageWidth);
+	/*保存JPG预览图，Bayer为拜耳阵列(如RGGB)，为空时不做插值。Low与High为黑点与白点(ADU)，小于0时自动确定。Arena不为空时中间图像使用帧的暂存区*/
+	void SaveImage(const unsigned char *imgBuf,std::string ImageName,const FRAMEHEADER &Header,std::string Bayer = "",int Low = -1,int High = -1,FRAMEARENA *Arena = nullptr);
+	void clacHistogram(const unsigned char *imgBuf,const FRAMEHEADER &Header);
 }
 
 #endif
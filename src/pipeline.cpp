@@ -0,0 +1,142 @@
+/*
+ * pipeline.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Frame processing pipeline
+
+**************************************************/
+
+#include <chrono>
+#include <exception>
+
+#include "logger.h"
+#include "metrics.h"
+#include "threads.h"
+#include "pipeline.h"
+
+namespace AstroAir
+{
+	PIPELINE::PIPELINE(std::string Name) : Name(Name)
+	{
+	}
+
+	/*
+	 * name: ~PIPELINE()
+	 * describe: Finish the queued frames and stop the stages
+	 * 描述：处理完排队的帧后停止所有阶段
+	 */
+	PIPELINE::~PIPELINE()
+	{
+		for(auto &stage : Stages)
+			stage->Queue.Close();
+		for(auto &stage : Stages)
+		{
+			if(stage->Worker.joinable())
+				stage->Worker.join();
+		}
+	}
+
+	/*
+	 * name: AddStage(std::string Stage,STAGEFUNC Handler,int Depth)
+	 * @param Stage:阶段名称，用于日志和指标
+	 * @param Handler:处理函数
+	 * @param Depth:队列长度
+	 * describe: Add a stage with its own thread
+	 * 描述：添加一个独立线程的处理阶段
+	 */
+	void PIPELINE::AddStage(std::string Stage,STAGEFUNC Handler,int Depth)
+	{
+		Stages.push_back(std::make_unique<PIPELINE::Stage>(Stage,Handler,Depth));
+		PIPELINE::Stage *stage = Stages.back().get();
+		stage->Worker = std::thread(&PIPELINE::Work,this,stage);
+	}
+
+	/*
+	 * name: Submit(std::shared_ptr<FRAMEJOB> Job)
+	 * @param Job:下载完成的帧
+	 * describe: Hand the frame to every stage
+	 * 描述：将帧交给所有阶段
+	 * note: The frame buffer goes back to the pool after the last stage drops it,the scratch memory as soon as the last stage finishes
+	 */
+	void PIPELINE::Submit(std::shared_ptr<FRAMEJOB> Job)
+	{
+		Job->Pending = Stages.size();
+		{
+			std::lock_guard<std::mutex> guard(Lock);
+			InFlight += Stages.size();
+		}
+		for(auto &stage : Stages)
+		{
+			if(stage->Queue.Push(Job) == true)
+				METRICS::Add("pipeline.stalls." + stage->Name);
+		}
+	}
+
+	/*
+	 * name: Drain()
+	 * describe: Wait for all submitted frames
+	 * 描述：等待已提交的帧全部处理完成
+	 */
+	void PIPELINE::Drain()
+	{
+		std::unique_lock<std::mutex> lock(Lock);
+		Idle.wait(lock,[this]() { return InFlight == 0; });
+	}
+
+	/*
+	 * name: Work(Stage *stage)
+	 * describe: Stage thread
+	 * 描述：处理阶段线程
+	 */
+	void PIPELINE::Work(Stage *stage)
+	{
+		THREADS::Enter(THREADS::ROLE_PROCESSING,Name + "-" + stage->Name);
+		std::shared_ptr<FRAMEJOB> Job;
+		while(stage->Queue.Pop(Job) == true)
+		{
+			auto start = std::chrono::steady_clock::now();
+			try
+			{
+				stage->Handler(Job);
+			}
+			catch(const std::exception &e)
+			{
+				IDLog("%s stage of %s failed: %s\n",stage->Name.c_str(),Name.c_str(),e.what());
+			}
+			std::chrono::duration<double,std::milli> diff = std::chrono::steady_clock::now() - start;
+			METRICS::Set("pipeline." + stage->Name + "_ms",diff.count());
+			/*缓存中的帧可能还要存在很久，暂存内存在最后一个阶段完成时就归还*/
+			if(--Job->Pending == 0)
+				Job->Arena.Reset();
+			Job = nullptr;
+			std::lock_guard<std::mutex> guard(Lock);
+			if(--InFlight == 0)
+				Idle.notify_all();
+		}
+	}
+}
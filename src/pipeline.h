@@ -0,0 +1,152 @@
+/*
+ * pipeline.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Frame processing pipeline
+
+**************************************************/
+
+#pragma once
+
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+
+#include "frame.h"
+#include "framepool.h"
+#include "arena.h"
+
+#define PIPELINE_DEPTH 2		//每个阶段最多排队的帧数
+
+namespace AstroAir
+{
+	/*一帧下载完成的图像以及处理它需要的信息*/
+	struct FRAMEJOB
+	{
+		FRAMEHEADER Header;
+		FRAMEBUFFER Buffer;
+		std::string FileName;		//FITS文件名
+		std::string Camera;		//相机名称，写入FITS头
+		std::string Bayer;		//拜耳阵列，彩色或黑白图像为空
+		bool Preview = true;		//是否生成预览图与直方图，连拍时只有最后一帧生成
+		std::atomic<int64_t> FitsNs{0};		//FITS写入完成的时间，各阶段并行执行
+		FRAMEARENA Arena;		//各阶段的暂存内存，所有阶段处理完后一次归还
+		std::atomic<int> Pending{0};		//尚未处理这一帧的阶段数
+	};
+
+	typedef std::function<void(std::shared_ptr<FRAMEJOB> Job)> STAGEFUNC;
+
+	/*有界队列，满时Push阻塞，关闭后Pop取完剩余元素返回false*/
+	template<typename T>
+	class BOUNDEDQUEUE
+	{
+		public:
+			explicit BOUNDEDQUEUE(size_t Capacity) : Capacity(Capacity) {}
+			/*放入元素，返回是否需要等待*/
+			bool Push(T Item)
+			{
+				std::unique_lock<std::mutex> lock(Lock);
+				bool waited = Items.size() >= Capacity;
+				NotFull.wait(lock,[this]() { return Items.size() < Capacity || Closed; });
+				Items.push_back(std::move(Item));
+				NotEmpty.notify_one();
+				return waited;
+			}
+			bool Pop(T &Item)
+			{
+				std::unique_lock<std::mutex> lock(Lock);
+				NotEmpty.wait(lock,[this]() { return !Items.empty() || Closed; });
+				if(Items.empty())
+					return false;
+				Item = std::move(Items.front());
+				Items.pop_front();
+				NotFull.notify_one();
+				return true;
+			}
+			void Close()
+			{
+				std::lock_guard<std::mutex> guard(Lock);
+				Closed = true;
+				NotEmpty.notify_all();
+				NotFull.notify_all();
+			}
+		private:
+			size_t Capacity;
+			std::deque<T> Items;
+			std::mutex Lock;
+			std::condition_variable NotEmpty;
+			std::condition_variable NotFull;
+			bool Closed = false;
+	};
+
+	/*
+	 * Fans every submitted frame out to a set of stages (file writer,
+	 * preview,analysis),each running on its own thread behind a bounded
+	 * queue. The camera can start the next exposure as soon as the frame
+	 * is submitted; a slow stage only blocks capture once its queue is full.
+	 */
+	class PIPELINE
+	{
+		public:
+			explicit PIPELINE(std::string Name);
+			~PIPELINE();
+			/*添加处理阶段，需在提交第一帧之前调用*/
+			void AddStage(std::string Stage,STAGEFUNC Handler,int Depth = PIPELINE_DEPTH);
+			/*提交一帧给所有阶段*/
+			void Submit(std::shared_ptr<FRAMEJOB> Job);
+			/*等待已提交的帧全部处理完成*/
+			void Drain();
+		private:
+			struct Stage
+			{
+				std::string Name;
+				STAGEFUNC Handler;
+				BOUNDEDQUEUE<std::shared_ptr<FRAMEJOB>> Queue;
+				std::thread Worker;
+				Stage(std::string Name,STAGEFUNC Handler,int Depth) : Name(Name),Handler(Handler),Queue(Depth) {}
+			};
+			void Work(Stage *stage);
+
+			std::string Name;
+			std::vector<std::unique_ptr<Stage>> Stages;
+			std::mutex Lock;
+			std::condition_variable Idle;
+			int InFlight = 0;		//尚未处理完的任务数
+	};
+}
+
+#endif
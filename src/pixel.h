@@ -0,0 +1,155 @@
+/*
+ * pixel.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Pixel kernels specialized by bit depth and channel layout
+
+**************************************************/
+
+#pragma once
+
+#ifndef _PIXEL_H_
+#define _PIXEL_H_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+
+#include "frame.h"
+
+/*
+ * Every kernel is a template on the pixel type and the number of
+ * interleaved channels, so each frame format gets its own loop without a
+ * per-pixel branch and the compiler is free to vectorize it. The format
+ * is looked at once per frame, in Dispatch().
+ */
+namespace AstroAir::PIXEL
+{
+	/*每个通道256级的直方图*/
+	template<int Channels>
+	using HISTOGRAM = std::array<std::array<uint32_t,256>,Channels>;
+
+	/*
+	 * name: Dispatch(const FRAMEHEADER &Header,F &&Func)
+	 * @param Header:帧信息
+	 * @param Func:模板参数为<像素类型,通道数>的函数对象
+	 * describe: Call the kernel specialized for the frame format
+	 * 描述：依据帧格式调用对应的特化函数
+	 * @return false: Unsupported format
+	 */
+	template<typename F>
+	bool Dispatch(const FRAMEHEADER &Header,F &&Func)
+	{
+		const bool wide = Header.BitDepth > 8;
+		if(Header.Channels == 1)
+		{
+			if(wide)
+				Func.template operator()<uint16_t,1>();
+			else
+				Func.template operator()<uint8_t,1>();
+			return true;
+		}
+		if(Header.Channels == 3)
+		{
+			if(wide)
+				Func.template operator()<uint16_t,3>();
+			else
+				Func.template operator()<uint8_t,3>();
+			return true;
+		}
+		return false;
+	}
+
+	/*求最小值与最大值*/
+	template<typename T>
+	void MinMax(const T *Source,size_t Count,T &Min,T &Max)
+	{
+		T low = std::numeric_limits<T>::max(),high = 0;
+		for(size_t i = 0;i < Count;i++)
+		{
+			low = std::min(low,Source[i]);
+			high = std::max(high,Source[i]);
+		}
+		Min = low;
+		Max = high;
+	}
+
+	/*求和与平方和，用于均值与标准差*/
+	template<typename T>
+	void Moments(const T *Source,size_t Count,double &Sum,double &SumSq)
+	{
+		uint64_t sum = 0;
+		double sumsq = 0;
+		for(size_t i = 0;i < Count;i++)
+		{
+			sum += Source[i];
+			sumsq += (double)Source[i] * Source[i];
+		}
+		Sum = sum;
+		SumSq = sumsq;
+	}
+
+	/*线性拉伸到8位，Min映射为0，Max映射为255*/
+	template<typename T>
+	void Stretch(const T *Source,uint8_t *Target,size_t Count,T Min,T Max)
+	{
+		const float scale = Max > Min ? 255.0f / (Max - Min) : 0.0f;
+		const float offset = Min;
+		for(size_t i = 0;i < Count;i++)
+			Target[i] = (uint8_t)std::clamp((Source[i] - offset) * scale,0.0f,255.0f);
+	}
+
+	/*各通道直方图，Shift为压缩到8位需要右移的位数*/
+	template<typename T,int Channels>
+	void Histogram(const T *Source,size_t Pixels,int Shift,HISTOGRAM<Channels> &Bins)
+	{
+		for(auto &channel : Bins)
+			channel.fill(0);
+		for(size_t i = 0;i < Pixels;i++)
+		{
+			for(int c = 0;c < Channels;c++)
+				Bins[c][(uint8_t)(Source[i * Channels + c] >> Shift)]++;
+		}
+	}
+
+	/*交错存储转为按通道分平面存储，FITS需要平面格式*/
+	template<typename T,int Channels>
+	void Planar(const T *Source,T *Target,size_t Pixels)
+	{
+		for(int c = 0;c < Channels;c++)
+		{
+			T *plane = Target + c * Pixels;
+			for(size_t i = 0;i < Pixels;i++)
+				plane[i] = Source[i * Channels + c];
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,170 @@
+/*
+ * plugin.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Driver plugin loader
+
+**************************************************/
+
+#include <dlfcn.h>
+#include <stdlib.h>
+#include <map>
+#include <mutex>
+#include <future>
+
+#include "config.h"
+#include "logger.h"
+#include "plugin.h"
+
+#ifndef PLUGIN_DIR
+	#define PLUGIN_DIR "/usr/local/lib/airserver"
+#endif
+
+namespace AstroAir::PLUGIN
+{
+	typedef bool (*InitFunc)();
+	typedef WSSERVER *(*CreateFunc)();
+
+	/*已加载的插件*/
+	struct PluginInfo
+	{
+		void *Handle = nullptr;
+		CreateFunc Create = nullptr;
+	};
+
+	/*品牌与插件的对应关系*/
+	static const std::map<std::string,std::string> PluginNames = {
+		{"ZWOASI","air-asi"},
+		{"QHYCCD","air-qhy"},
+		{"Simulator","air-sim"},
+		{"INDI","air-indi"},
+		{"INDIMount","air-indi"},
+		{"INDIFocus","air-indi"},
+		{"INDIFilter","air-indi"}
+	};
+
+	static std::mutex PluginLock;
+	static std::map<std::string,std::shared_future<PluginInfo>> Plugins;
+
+	/*
+	 * name: LoadPlugin(std::string Name)
+	 * @param Name:插件名称
+	 * describe: Open the plugin and initialize its SDK
+	 * 描述：打开插件并初始化SDK
+	 * calls: dlopen()
+	 * calls: dlsym()
+	 * note: Search $AIRSERVER_PLUGIN_DIR, then the install directory, then the default library path
+	 */
+	static PluginInfo LoadPlugin(std::string Name)
+	{
+		PluginInfo info;
+		std::string File = "lib" + Name + ".so";
+		std::vector<std::string> Paths;
+		if(const char *env = getenv("AIRSERVER_PLUGIN_DIR"))
+			Paths.push_back(std::string(env) + "/" + File);
+		Paths.push_back(std::string(PLUGIN_DIR) + "/" + File);
+		Paths.push_back(File);
+		for(auto &Path : Paths)
+		{
+			if((info.Handle = dlopen(Path.c_str(),RTLD_NOW | RTLD_LOCAL)) != nullptr)
+				break;
+		}
+		if(info.Handle == nullptr)
+		{
+			IDLog("Unable to load driver plugin %s,%s\n",Name.c_str(),dlerror());
+			return info;
+		}
+		info.Create = reinterpret_cast<CreateFunc>(dlsym(info.Handle,PLUGIN_CREATE_SYMBOL));
+		InitFunc Init = reinterpret_cast<InitFunc>(dlsym(info.Handle,PLUGIN_INIT_SYMBOL));
+		if(info.Create == nullptr)
+		{
+			IDLog("Driver plugin %s has no %s entry\n",Name.c_str(),PLUGIN_CREATE_SYMBOL);
+			return info;
+		}
+		if(Init != nullptr && Init() == false)
+			IDLog("Driver plugin %s failed to initialize its SDK\n",Name.c_str());
+		IDLog("Loaded driver plugin %s\n",Name.c_str());
+		return info;
+	}
+
+	/*
+	 * name: GetPlugin(std::string Brand)
+	 * @param Brand:设备品牌
+	 * describe: Get the loading task of the plugin,start it if needed
+	 * 描述：获取插件的加载任务，如未开始则启动
+	 * note: The caller must hold PluginLock
+	 */
+	static std::shared_future<PluginInfo> GetPlugin(std::string Brand)
+	{
+		auto it = PluginNames.find(Brand);
+		if(it == PluginNames.end())
+			return std::shared_future<PluginInfo>();
+		auto task = Plugins.find(it->second);
+		if(task != Plugins.end())
+			return task->second;
+		std::shared_future<PluginInfo> loading = std::async(std::launch::async,LoadPlugin,it->second).share();
+		Plugins[it->second] = loading;
+		return loading;
+	}
+
+	/*
+	 * name: Preload(const std::vector<std::string> &Brands)
+	 * @param Brands:配置文件中的设备品牌
+	 * describe: Load the plugins named by the profile in parallel
+	 * 描述：并行加载配置文件中用到的插件
+	 * note: Returns at once,the SDK initialization runs in background threads
+	 */
+	void Preload(const std::vector<std::string> &Brands)
+	{
+		std::lock_guard<std::mutex> guard(PluginLock);
+		for(auto &Brand : Brands)
+			GetPlugin(Brand);
+	}
+
+	/*
+	 * name: CreateDevice(std::string Brand)
+	 * @param Brand:设备品牌
+	 * describe: Create a device from the plugin of the brand
+	 * 描述：从对应插件中创建设备
+	 * @return nullptr: Unknown brand or the plugin could not be loaded
+	 */
+	WSSERVER *CreateDevice(std::string Brand)
+	{
+		std::shared_future<PluginInfo> loading;
+		{
+			std::lock_guard<std::mutex> guard(PluginLock);
+			loading = GetPlugin(Brand);
+		}
+		if(loading.valid() == false)
+			return nullptr;
+		const PluginInfo &info = loading.get();
+		if(info.Create == nullptr)
+			return nullptr;
+		return info.Create();
+	}
+}
@@ -0,0 +1,63 @@
+/*
+ * plugin.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Driver plugin loader
+
+**************************************************/
+
+#pragma once
+
+#ifndef _PLUGIN_H_
+#define _PLUGIN_H_
+
+#include <string>
+#include <vector>
+
+/*
+ * Every driver plugin exports these two C functions:
+ *   bool AirInitSDK()          -- initialize the vendor SDK, called once off the main thread
+ *   WSSERVER *AirCreateDevice() -- create a new device of this driver
+ */
+#define PLUGIN_INIT_SYMBOL "AirInitSDK"
+#define PLUGIN_CREATE_SYMBOL "AirCreateDevice"
+
+namespace AstroAir
+{
+	class WSSERVER;
+
+	namespace PLUGIN
+	{
+		/*后台并行加载品牌对应的插件并初始化SDK*/
+		void Preload(const std::vector<std::string> &Brands);
+		/*创建设备，如插件尚未加载则先加载*/
+		WSSERVER *CreateDevice(std::string Brand);
+	}
+}
+
+#endif
@@ -0,0 +1,319 @@
+/*
+ * sequence.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Server side exposure sequence
+
+**************************************************/
+
+#include <chrono>
+
+#include "logger.h"
+#include "metrics.h"
+#include "sequence.h"
+
+namespace AstroAir
+{
+	/*
+	 * name: ~SEQUENCE()
+	 * describe: Abort the running sequence
+	 * 描述：中止正在运行的序列
+	 */
+	SEQUENCE::~SEQUENCE()
+	{
+		Stop();
+	}
+
+	/*
+	 * name: Start(const SEQUENCEPLAN &Plan,SEQUENCEHOOKS Hooks)
+	 * @param Plan:拍摄计划
+	 * @param Hooks:设备接口
+	 * describe: Start a sequence on its own thread
+	 * 描述：在独立线程中开始序列
+	 * @return false: A sequence is running or the plan is empty
+	 */
+	bool SEQUENCE::Start(const SEQUENCEPLAN &Plan,SEQUENCEHOOKS Hooks)
+	{
+		if(Plan.Count <= 0 || !Hooks.Expose)
+			return false;
+		std::lock_guard<std::mutex> worker(WorkerLock);
+		{
+			std::lock_guard<std::mutex> guard(Lock);
+			if(Running == true)
+				return false;
+		}
+		/*回收上一次序列的线程*/
+		if(Worker.joinable())
+			Worker.join();
+		std::lock_guard<std::mutex> guard(Lock);
+		Running = true;
+		Paused = false;
+		Aborted = false;
+		AbortExposure = Hooks.AbortExposure;
+		Worker = std::thread(&SEQUENCE::Run,this,Plan,Hooks);
+		return true;
+	}
+
+	/*
+	 * name: Pause()
+	 * describe: Pause after the current frame
+	 * 描述：当前帧完成后暂停
+	 */
+	void SEQUENCE::Pause()
+	{
+		std::lock_guard<std::mutex> guard(Lock);
+		if(Running == true)
+			Paused = true;
+	}
+
+	/*
+	 * name: Resume()
+	 * describe: Resume a paused sequence
+	 * 描述：继续暂停的序列
+	 */
+	void SEQUENCE::Resume()
+	{
+		std::lock_guard<std::mutex> guard(Lock);
+		Paused = false;
+		Cond.notify_all();
+	}
+
+	/*
+	 * name: Abort()
+	 * describe: Stop the sequence and the running exposure
+	 * 描述：停止序列和正在进行的曝光
+	 */
+	void SEQUENCE::Abort()
+	{
+		std::function<void()> abort;
+		{
+			std::lock_guard<std::mutex> guard(Lock);
+			if(Running == false || Aborted == true)
+				return;
+			Aborted = true;
+			Cond.notify_all();
+			abort = AbortExposure;
+		}
+		if(abort)
+			abort();
+	}
+
+	/*
+	 * name: Stop()
+	 * describe: Abort the sequence and wait for its thread
+	 * 描述：中止序列并等待序列线程退出
+	 */
+	void SEQUENCE::Stop()
+	{
+		Abort();
+		std::lock_guard<std::mutex> worker(WorkerLock);
+		if(Worker.joinable())
+			Worker.join();
+	}
+
+	/*
+	 * name: IsRunning()
+	 * describe: Whether a sequence is running
+	 * 描述：序列是否正在运行
+	 */
+	bool SEQUENCE::IsRunning()
+	{
+		std::lock_guard<std::mutex> guard(Lock);
+		return Running;
+	}
+
+	/*
+	 * name: Expand(const SEQUENCEPLAN &Plan,time_t Start)
+	 * @param Plan:拍摄计划
+	 * @param Start:序列开始时间
+	 * describe: Plan every frame of the sequence
+	 * 描述：展开序列中的每一帧
+	 * note: Each filter takes Count frames in turn
+	 */
+	std::vector<SEQUENCEFRAME> SEQUENCE::Expand(const SEQUENCEPLAN &Plan,time_t Start)
+	{
+		std::vector<std::string> filters = Plan.Filters;
+		if(filters.empty())
+			filters.push_back("");
+		std::vector<SEQUENCEFRAME> frames;
+		int total = Plan.Count * filters.size();
+		std::string current;
+		for(auto &filter : filters)
+		{
+			for(int i = 0;i < Plan.Count;i++)
+			{
+				SEQUENCEFRAME frame;
+				frame.Index = frames.size() + 1;
+				frame.Total = total;
+				frame.Filter = filter;
+				frame.ChangeFilter = !filter.empty() && filter != current;
+				/*第一帧之前不抖动*/
+				frame.Dither = Plan.DitherEvery > 0 && frame.Index > 1 && (frame.Index - 1) % Plan.DitherEvery == 0;
+				frame.FileName = FileName(Plan,frame.Index,filter,Start);
+				current = filter;
+				frames.push_back(frame);
+			}
+		}
+		return frames;
+	}
+
+	/*
+	 * name: FileName(const SEQUENCEPLAN &Plan,int Index,std::string Filter,time_t Start)
+	 * @param Plan:拍摄计划
+	 * @param Index:帧序号
+	 * @param Filter:滤镜名称
+	 * @param Start:序列开始时间
+	 * describe: Fill in the naming template
+	 * 描述：依据模板生成文件名
+	 * note: Supports {index} {exp} {bin} {gain} {offset} {filter} {date}
+	 */
+	std::string SEQUENCE::FileName(const SEQUENCEPLAN &Plan,int Index,std::string Filter,time_t Start)
+	{
+		char index[16],date[32];
+		snprintf(index,sizeof(index),"%04d",Index);
+		struct tm tm;
+		gmtime_r(&Start,&tm);
+		strftime(date,sizeof(date),"%Y%m%d-%H%M%S",&tm);
+		const std::pair<std::string,std::string> fields[] = {
+			{"{index}",index},
+			{"{exp}",std::to_string(Plan.Exposure)},
+			{"{bin}",std::to_string(Plan.Bin)},
+			{"{gain}",std::to_string(Plan.Gain)},
+			{"{offset}",std::to_string(Plan.Offset)},
+			{"{filter}",Filter.empty() ? "L" : Filter},
+			{"{date}",date}
+		};
+		std::string name = Plan.NameTemplate;
+		for(auto &field : fields)
+		{
+			size_t pos;
+			while((pos = name.find(field.first)) != std::string::npos)
+				name.replace(pos,field.first.size(),field.second);
+		}
+		return name;
+	}
+
+	/*
+	 * name: WaitResume(const SEQUENCEFRAME &Frame,const SEQUENCEHOOKS &Hooks)
+	 * describe: Wait while the sequence is paused
+	 * 描述：序列暂停时等待
+	 * @return false: The sequence was aborted
+	 */
+	bool SEQUENCE::WaitResume(const SEQUENCEFRAME &Frame,const SEQUENCEHOOKS &Hooks)
+	{
+		std::unique_lock<std::mutex> lock(Lock);
+		if(Paused == true && Aborted == false)
+		{
+			lock.unlock();
+			if(Hooks.Progress)
+				Hooks.Progress(Frame,"Paused");
+			lock.lock();
+			Cond.wait(lock,[this]() { return Paused == false || Aborted == true; });
+			if(Aborted == false)
+			{
+				lock.unlock();
+				if(Hooks.Progress)
+					Hooks.Progress(Frame,"Resumed");
+				lock.lock();
+			}
+		}
+		return Aborted == false;
+	}
+
+	/*
+	 * name: Run(SEQUENCEPLAN Plan,SEQUENCEHOOKS Hooks)
+	 * describe: Sequence thread
+	 * 描述：序列线程
+	 */
+	void SEQUENCE::Run(SEQUENCEPLAN Plan,SEQUENCEHOOKS Hooks)
+	{
+		auto progress = [&Hooks](const SEQUENCEFRAME &Frame,std::string Status)
+		{
+			if(Hooks.Progress)
+				Hooks.Progress(Frame,Status);
+		};
+		std::vector<SEQUENCEFRAME> frames = Expand(Plan,time(nullptr));
+		IDLog("Sequence of %d frames started\n",(int)frames.size());
+		std::string status = "Finished";
+		SEQUENCEFRAME last;
+		last.Total = frames.size();
+		auto previous = std::chrono::steady_clock::now();
+		for(auto &frame : frames)
+		{
+			if(WaitResume(frame,Hooks) == false)
+			{
+				status = "Aborted";
+				break;
+			}
+			last = frame;
+			if(frame.ChangeFilter == true && (!Hooks.SetFilter || Hooks.SetFilter(frame.Filter) == false))
+			{
+				IDLog("Sequence failed to change filter to %s\n",frame.Filter.c_str());
+				status = "Failed";
+				break;
+			}
+			if(frame.Dither == true && (!Hooks.Dither || Hooks.Dither(Plan.DitherPixels) == false))
+			{
+				IDLog("Sequence failed to dither\n");
+				status = "Failed";
+				break;
+			}
+			progress(frame,"Exposing");
+			auto start = std::chrono::steady_clock::now();
+			/*两帧之间相机空闲的时间*/
+			if(frame.Index > 1)
+				METRICS::Set("sequence.idle_ms",std::chrono::duration<double,std::milli>(start - previous).count());
+			bool ok = Hooks.Expose(Plan,frame);
+			previous = std::chrono::steady_clock::now();
+			{
+				std::lock_guard<std::mutex> guard(Lock);
+				if(Aborted == true)
+				{
+					status = "Aborted";
+					break;
+				}
+			}
+			if(ok == false)
+			{
+				IDLog("Sequence failed at frame %d\n",frame.Index);
+				status = "Failed";
+				break;
+			}
+			METRICS::Add("sequence.frames");
+			progress(frame,"Done");
+		}
+		IDLog("Sequence %s\n",status.c_str());
+		{
+			std::lock_guard<std::mutex> guard(Lock);
+			Running = false;
+			Paused = false;
+			AbortExposure = nullptr;
+		}
+		progress(last,status);
+	}
+}
@@ -0,0 +1,122 @@
+/*
+ * sequence.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Server side exposure sequence
+
+**************************************************/
+
+#pragma once
+
+#ifndef _SEQUENCE_H_
+#define _SEQUENCE_H_
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <ctime>
+
+namespace AstroAir
+{
+	/*拍摄计划*/
+	struct SEQUENCEPLAN
+	{
+		int Count = 1;		//每个滤镜拍摄的张数
+		int Exposure = 1;		//曝光时间(秒)
+		int Bin = 1;
+		int Gain = 0;
+		int Offset = 0;
+		std::string NameTemplate = "Light_{filter}_{exp}s_{index}.fits";		//文件名模板
+		std::vector<std::string> Filters;		//依次拍摄的滤镜，为空时不切换滤镜
+		int DitherEvery = 0;		//每隔多少张抖动一次，0为不抖动
+		double DitherPixels = 5;		//抖动幅度(像素)
+	};
+
+	/*计划中的一帧，开始拍摄前全部展开*/
+	struct SEQUENCEFRAME
+	{
+		int Index = 0;		//从1开始
+		int Total = 0;
+		std::string FileName;
+		std::string Filter;
+		bool ChangeFilter = false;		//拍摄前需要切换滤镜
+		bool Dither = false;		//拍摄前需要抖动
+	};
+
+	/*序列与设备之间的接口，均在序列线程中调用*/
+	struct SEQUENCEHOOKS
+	{
+		std::function<bool(const SEQUENCEPLAN &Plan,const SEQUENCEFRAME &Frame)> Expose;		//拍摄并下载一帧
+		std::function<void()> AbortExposure;		//中止正在进行的曝光，在调用Abort()的线程中执行
+		std::function<bool(std::string Filter)> SetFilter;
+		std::function<bool(double Pixels)> Dither;
+		std::function<void(const SEQUENCEFRAME &Frame,std::string Status)> Progress;
+	};
+
+	/*
+	 * Runs a batch of exposures on the server. Every frame is planned up
+	 * front, so the next one starts as soon as the previous download has
+	 * finished; saving runs in the camera pipeline meanwhile. Pause takes
+	 * effect between frames,abort also stops the running exposure.
+	 */
+	class SEQUENCE
+	{
+		public:
+			~SEQUENCE();
+			/*开始序列，已有序列在运行时返回false*/
+			bool Start(const SEQUENCEPLAN &Plan,SEQUENCEHOOKS Hooks);
+			void Pause();
+			void Resume();
+			void Abort();
+			/*中止并等待序列线程退出*/
+			void Stop();
+			bool IsRunning();
+			/*展开拍摄计划*/
+			static std::vector<SEQUENCEFRAME> Expand(const SEQUENCEPLAN &Plan,time_t Start);
+			/*依据模板生成文件名*/
+			static std::string FileName(const SEQUENCEPLAN &Plan,int Index,std::string Filter,time_t Start);
+		private:
+			void Run(SEQUENCEPLAN Plan,SEQUENCEHOOKS Hooks);
+			/*暂停时等待，返回false表示已中止*/
+			bool WaitResume(const SEQUENCEFRAME &Frame,const SEQUENCEHOOKS &Hooks);
+
+			std::thread Worker;
+			std::mutex WorkerLock;		//保护Worker，等待线程时不能持有Lock
+			std::mutex Lock;
+			std::condition_variable Cond;
+			bool Running = false;
+			bool Paused = false;
+			bool Aborted = false;
+			std::function<void()> AbortExposure;
+	};
+}
+
+#endif
@@ -0,0 +1,352 @@
+/*
+ * serwriter.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:SER video file writer
+
+**************************************************/
+
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+
+#include "logger.h"
+#include "metrics.h"
+#include "threads.h"
+#include "serwriter.h"
+
+#define SER_EPOCH 621355968000000000LL		//0001-01-01到1970-01-01的SER时间单位(100纳秒)数
+
+namespace AstroAir
+{
+	/*SER文件中的整数均为小端序*/
+	static void Put32(unsigned char *Target,uint32_t Value)
+	{
+		for(int i = 0;i < 4;i++)
+			Target[i] = (Value >> (i * 8)) & 0xFF;
+	}
+
+	static void Put64(unsigned char *Target,uint64_t Value)
+	{
+		for(int i = 0;i < 8;i++)
+			Target[i] = (Value >> (i * 8)) & 0xFF;
+	}
+
+	/*UTC纳秒转为SER时间单位*/
+	static int64_t SerTime(int64_t UtcNs)
+	{
+		return UtcNs / 100 + SER_EPOCH;
+	}
+
+	/*拜耳阵列对应的SER颜色编号，彩色图像为驱动输出的BGR顺序*/
+	static int32_t SerColor(const FRAMEHEADER &Layout,std::string Bayer)
+	{
+		if(Layout.Channels == 3)
+			return 101;
+		if(Bayer == "RGGB")
+			return 8;
+		if(Bayer == "GRBG")
+			return 9;
+		if(Bayer == "GBRG")
+			return 10;
+		if(Bayer == "BGGR")
+			return 11;
+		return 0;
+	}
+
+	SERWRITER::SERWRITER(std::string Name) : Name(Name),Buffers(Name + " ser")
+	{
+	}
+
+	SERWRITER::~SERWRITER()
+	{
+		Close();
+	}
+
+	/*
+	 * name: Open(std::string FileName,const FRAMEHEADER &Layout,std::string Bayer,std::string Instrument,bool Direct)
+	 * @param FileName:SER文件名
+	 * @param Layout:第一帧的信息，决定图像尺寸与格式
+	 * @param Bayer:拜耳阵列，彩色或黑白图像为空
+	 * @param Instrument:相机名称，写入文件头
+	 * @param Direct:是否使用O_DIRECT绕过页缓存
+	 * describe: Create the file and start the I/O thread
+	 * 描述：创建SER文件并启动写入线程
+	 * @return false: The format is not supported,the file can not be created or the writer was used before
+	 * note: When the file system refuses O_DIRECT the file is written through the page cache
+	 */
+	bool SERWRITER::Open(std::string FileName,const FRAMEHEADER &Layout,std::string Bayer,std::string Instrument,bool Direct)
+	{
+		if(Started == true || Layout.Size == 0 || (Layout.Channels != 1 && Layout.Channels != 3))
+			return false;
+		int fd = open(FileName.c_str(),O_WRONLY | O_CREAT | O_TRUNC | (Direct ? O_DIRECT : 0),0644);
+		if(fd < 0 && Direct == true && errno == EINVAL)
+		{
+			IDLog("%s does not support O_DIRECT,write through the page cache\n",FileName.c_str());
+			Direct = false;
+			fd = open(FileName.c_str(),O_WRONLY | O_CREAT | O_TRUNC,0644);
+		}
+		if(fd < 0)
+		{
+			IDLog("Unable to create %s,%s\n",FileName.c_str(),strerror(errno));
+			return false;
+		}
+		Buffers.Reserve(SER_CHUNK,SER_QUEUE + 1);
+		if((Current.Buffer = Buffers.Acquire(SER_CHUNK)) == nullptr)
+		{
+			close(fd);
+			unlink(FileName.c_str());
+			return false;
+		}
+		this->FileName = FileName;
+		this->Layout = Layout;
+		this->Instrument = Instrument;
+		this->Direct = Direct;
+		Fd = fd;
+		ColorId = SerColor(Layout,Bayer);
+		StartUtcNs = Layout.UtcNs > 0 ? Layout.UtcNs : UtcNs();
+		OpenNs = MonotonicNs();
+		/*文件头先占位，帧数在关闭时写入*/
+		FillHeader(Current.Buffer.get(),0);
+		Current.Offset = 0;
+		Current.Used = SER_HEADER_SIZE;
+		Started = true;
+		Writer = std::thread(&SERWRITER::Work,this);
+		IDLog("Recording %ux%u %u bit video to %s%s\n",Layout.Width,Layout.Height,Layout.BitDepth,FileName.c_str(),Direct ? " with O_DIRECT" : "");
+		return true;
+	}
+
+	/*
+	 * name: Write(const FRAMEHEADER &Header,const unsigned char *Data)
+	 * @param Header:帧信息，尺寸与格式需与第一帧一致
+	 * @param Data:图像数据，只在调用期间使用
+	 * describe: Append one frame
+	 * 描述：追加一帧
+	 * @return false: The frame does not match the file or writing failed
+	 * note: The frame is copied into the current chunk,only a full chunk goes to the I/O thread
+	 */
+	bool SERWRITER::Write(const FRAMEHEADER &Header,const unsigned char *Data)
+	{
+		if(Fd < 0 || Failed == true)
+			return false;
+		if(Header.Size != Layout.Size || Header.Width != Layout.Width || Header.Height != Layout.Height || Header.BitDepth != Layout.BitDepth || Header.Channels != Layout.Channels)
+		{
+			METRICS::Add("ser.mismatch");
+			return false;
+		}
+		/*时间戳取曝光开始时间，驱动不知道时取下载完成时间*/
+		int64_t utc = Header.UtcNs;
+		if(Header.ExposureStartNs > 0)
+			utc += Header.ExposureStartNs - Header.MonotonicNs;
+		Stamps.push_back(SerTime(utc));
+		size_t remain = Header.Size;
+		while(remain > 0)
+		{
+			size_t n = std::min(remain,(size_t)SER_CHUNK - Current.Used);
+			memcpy(Current.Buffer.get() + Current.Used,Data,n);
+			Current.Used += n;
+			Data += n;
+			remain -= n;
+			if(Current.Used == SER_CHUNK && Flush() == false)
+				return false;
+		}
+		Count++;
+		METRICS::Add("ser.frames");
+		return true;
+	}
+
+	/*
+	 * name: Flush()
+	 * describe: Hand the full chunk to the I/O thread and start a new one
+	 * 描述：将写满的块交给写入线程并取出新的块
+	 */
+	bool SERWRITER::Flush()
+	{
+		const uint64_t next = Current.Offset + Current.Used;
+		/*写入线程跟不上时在这里等待，视频采集会因此丢弃旧帧*/
+		if(Queue.Push(std::move(Current)) == true)
+			METRICS::Add("ser.stalls");
+		Current = Chunk();
+		if((Current.Buffer = Buffers.Acquire(SER_CHUNK)) == nullptr)
+		{
+			Failed = true;
+			IDLog("Out of buffers while recording %s\n",FileName.c_str());
+			return false;
+		}
+		Current.Offset = next;
+		return true;
+	}
+
+	/*
+	 * name: Work()
+	 * describe: I/O thread,write the chunks in order
+	 * 描述：写入线程，依次写入每个块
+	 * note: With O_DIRECT the last chunk is padded to SER_ALIGN,Close() cuts the padding off
+	 */
+	void SERWRITER::Work()
+	{
+		THREADS::Enter(THREADS::ROLE_PROCESSING,"ser-" + Name);
+		Chunk chunk;
+		while(Queue.Pop(chunk))
+		{
+			if(Failed == true)
+				continue;
+			size_t size = chunk.Used;
+			if(Direct == true && size % SER_ALIGN != 0)
+			{
+				size = (size + SER_ALIGN - 1) / SER_ALIGN * SER_ALIGN;
+				memset(chunk.Buffer.get() + chunk.Used,0,size - chunk.Used);
+			}
+			int64_t start = MonotonicNs();
+			if(WriteAll(chunk.Buffer.get(),size,chunk.Offset) == false)
+			{
+				Failed = true;
+				METRICS::Add("ser.errors");
+				IDLog("Failed to write %s,%s\n",FileName.c_str(),strerror(errno));
+				continue;
+			}
+			double seconds = (MonotonicNs() - start) / 1e9;
+			if(seconds > 0)
+				METRICS::Observe("ser.write_mbs",chunk.Used / seconds / (1 << 20));
+			METRICS::Add("ser.bytes",chunk.Used);
+			chunk.Buffer = nullptr;
+		}
+	}
+
+	bool SERWRITER::WriteAll(const unsigned char *Data,size_t Size,uint64_t Offset)
+	{
+		while(Size > 0)
+		{
+			ssize_t n = pwrite(Fd,Data,Size,Offset);
+			if(n < 0 && errno == EINTR)
+				continue;
+			if(n <= 0)
+				return false;
+			Data += n;
+			Size -= n;
+			Offset += n;
+		}
+		return true;
+	}
+
+	/*
+	 * name: FillHeader(unsigned char *Target,uint32_t Count)
+	 * @param Target:至少SER_HEADER_SIZE字节
+	 * @param Count:帧数
+	 * describe: Build the SER header
+	 * 描述：生成SER文件头
+	 * note: LittleEndian is 0 for little endian data,the value every SER reader expects despite the specification
+	 */
+	void SERWRITER::FillHeader(unsigned char *Target,uint32_t Count)
+	{
+		memset(Target,0,SER_HEADER_SIZE);
+		memcpy(Target,"LUCAM-RECORDER",14);
+		Put32(Target + 14,0);		//LuID
+		Put32(Target + 18,ColorId);
+		Put32(Target + 22,0);		//LittleEndian
+		Put32(Target + 26,Layout.Width);
+		Put32(Target + 30,Layout.Height);
+		Put32(Target + 34,Layout.BitDepth);
+		Put32(Target + 38,Count);
+		/*Observer与Telescope留空*/
+		strncpy(reinterpret_cast<char *>(Target + 82),Instrument.c_str(),40);
+		/*本地时间由UTC时间加上时区偏移得到*/
+		time_t now = StartUtcNs / 1000000000;
+		struct tm local;
+		localtime_r(&now,&local);
+		Put64(Target + 162,SerTime(StartUtcNs) + (int64_t)local.tm_gmtoff * 10000000);
+		Put64(Target + 170,SerTime(StartUtcNs));
+	}
+
+	/*
+	 * name: Close()
+	 * describe: Write the remaining frames,the frame count and the timestamps
+	 * 描述：写入剩余的帧、帧数与时间戳并关闭文件
+	 * @return false: Some data could not be written
+	 */
+	bool SERWRITER::Close()
+	{
+		if(Fd < 0)
+			return false;
+		if(Current.Buffer != nullptr && Current.Used > 0)
+			Queue.Push(std::move(Current));
+		Current = Chunk();
+		Queue.Close();
+		if(Writer.joinable())
+			Writer.join();
+		const uint64_t count = Count;
+		const uint64_t end = SER_HEADER_SIZE + count * Layout.Size;
+		/*O_DIRECT只能写入对齐的数据，尾部与文件头使用普通方式写入*/
+		if(Direct == true)
+		{
+			close(Fd);
+			if((Fd = open(FileName.c_str(),O_WRONLY)) < 0)
+			{
+				IDLog("Unable to reopen %s,%s\n",FileName.c_str(),strerror(errno));
+				return false;
+			}
+		}
+		std::vector<unsigned char> trailer(Stamps.size() * 8);
+		for(size_t i = 0;i < Stamps.size();i++)
+			Put64(trailer.data() + i * 8,Stamps[i]);
+		unsigned char header[SER_HEADER_SIZE];
+		FillHeader(header,(uint32_t)count);
+		bool ok = Failed == false &&
+				  ftruncate(Fd,end) == 0 &&
+				  WriteAll(trailer.data(),trailer.size(),end) == true &&
+				  WriteAll(header,SER_HEADER_SIZE,0) == true &&
+				  fdatasync(Fd) == 0;
+		close(Fd);
+		Fd = -1;
+		double seconds = (MonotonicNs() - OpenNs) / 1e9;
+		double mbs = seconds > 0 ? end / seconds / (1 << 20) : 0;
+		METRICS::Set("ser.last_mbs",mbs);
+		if(ok == false)
+		{
+			METRICS::Add("ser.errors");
+			IDLog("Recording %s failed after %lu frames\n",FileName.c_str(),(unsigned long)count);
+			return false;
+		}
+		IDLog("Recorded %lu frames to %s,%.1f MB at %.1f MB/s\n",(unsigned long)count,FileName.c_str(),end / (double)(1 << 20),mbs);
+		return true;
+	}
+
+	bool SERWRITER::IsOpen()
+	{
+		return Fd >= 0;
+	}
+
+	uint64_t SERWRITER::Frames()
+	{
+		return Count;
+	}
+}
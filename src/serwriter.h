@@ -0,0 +1,109 @@
+/*
+ * serwriter.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:SER video file writer
+
+**************************************************/
+
+#pragma once
+
+#ifndef _SERWRITER_H_
+#define _SERWRITER_H_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <stdint.h>
+
+#include "frame.h"
+#include "framepool.h"
+#include "pipeline.h"
+
+#define SER_HEADER_SIZE 178		//SER文件头字节数
+#define SER_CHUNK (8 << 20)		//每次写入的字节数
+#define SER_ALIGN 4096		//O_DIRECT要求的对齐字节数
+#define SER_QUEUE 4		//等待写入的块数
+
+namespace AstroAir
+{
+	/*
+	 * Streams video frames into one SER file. Frames are packed back to
+	 * back into large page aligned chunks from a FRAMEPOOL, and a dedicated
+	 * I/O thread writes every full chunk with a single pwrite, optionally
+	 * with O_DIRECT so a long recording does not fill the page cache. The
+	 * frame count and the trailer of UTC timestamps are written on Close().
+	 */
+	class SERWRITER
+	{
+		public:
+			explicit SERWRITER(std::string Name);
+			~SERWRITER();
+			/*创建文件，Layout决定图像尺寸与格式，之后的帧必须与它一致。每个对象只写一个文件*/
+			bool Open(std::string FileName,const FRAMEHEADER &Layout,std::string Bayer,std::string Instrument,bool Direct);
+			/*追加一帧，写入线程跟不上时等待*/
+			bool Write(const FRAMEHEADER &Header,const unsigned char *Data);
+			/*写入剩余数据、帧数与时间戳并关闭文件*/
+			bool Close();
+			bool IsOpen();
+			uint64_t Frames();
+		private:
+			struct Chunk
+			{
+				FRAMEBUFFER Buffer;
+				uint64_t Offset = 0;		//在文件中的位置
+				size_t Used = 0;
+			};
+			void Work();
+			bool Flush();
+			bool WriteAll(const unsigned char *Data,size_t Size,uint64_t Offset);
+			void FillHeader(unsigned char *Target,uint32_t Count);
+
+			std::string Name;
+			std::string FileName;
+			FRAMEPOOL Buffers;
+			BOUNDEDQUEUE<Chunk> Queue{SER_QUEUE};
+			Chunk Current;		//正在填充的块，只由调用Write的线程访问
+			int Fd = -1;
+			bool Direct = false;
+			FRAMEHEADER Layout;
+			int32_t ColorId = 0;
+			std::string Instrument;
+			int64_t StartUtcNs = 0;
+			std::vector<int64_t> Stamps;		//每帧的UTC时间(SER时间单位)
+			std::atomic<uint64_t> Count{0};
+			std::thread Writer;
+			std::atomic_bool Started{false};
+			std::atomic_bool Failed{false};
+			int64_t OpenNs = 0;
+	};
+}
+
+#endif
@@ -0,0 +1,239 @@
+/*
+ * shmring.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Shared memory frame ring
+
+**************************************************/
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+#include "logger.h"
+#include "shmring.h"
+
+namespace AstroAir
+{
+	static_assert(std::atomic<uint64_t>::is_always_lock_free,"The frame ring needs lock free 64 bit atomics");
+	static_assert(std::atomic<uint32_t>::is_always_lock_free && sizeof(std::atomic<uint32_t>) == 4,"The frame ring needs lock free 32 bit atomics");
+
+	static uint64_t PageAlign(uint64_t Size)
+	{
+		uint64_t page = sysconf(_SC_PAGESIZE);
+		return (Size + page - 1) / page * page;
+	}
+
+	SHMRING::~SHMRING()
+	{
+		if(Head != nullptr)
+		{
+			/*通知仍映射着旧环的读端*/
+			if(Owner == true)
+				Head->Closed.store(1,std::memory_order_release);
+			munmap(Head,MapSize);
+		}
+		if(Owner == true)
+			Unlink();
+	}
+
+	/*
+	 * name: Create(const std::string &Name,uint32_t Slots,uint64_t SlotSize)
+	 * @param Name:共享内存名称，以/开头
+	 * @param Slots:槽数量
+	 * @param SlotSize:每个槽的最大帧大小
+	 * describe: Create the ring as the only writer
+	 * 描述：作为唯一写端创建共享内存环
+	 * @return nullptr: Unable to create the shared memory
+	 * note: An old ring with the same name is replaced
+	 */
+	std::unique_ptr<SHMRING> SHMRING::Create(const std::string &Name,uint32_t Slots,uint64_t SlotSize)
+	{
+		shm_unlink(Name.c_str());
+		int fd = shm_open(Name.c_str(),O_CREAT | O_EXCL | O_RDWR,0644);
+		if(fd < 0)
+		{
+			IDLog("Unable to create shared memory %s\n",Name.c_str());
+			return nullptr;
+		}
+		SlotSize = PageAlign(SlotSize);
+		uint64_t DataOffset = PageAlign(sizeof(SHMRINGHEADER) + sizeof(SHMSLOT) * Slots);
+		size_t MapSize = DataOffset + SlotSize * Slots;
+		void *map = MAP_FAILED;
+		if(ftruncate(fd,MapSize) == 0)
+			map = mmap(nullptr,MapSize,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+		close(fd);
+		if(map == MAP_FAILED)
+		{
+			IDLog("Unable to map %zu bytes of shared memory %s\n",MapSize,Name.c_str());
+			shm_unlink(Name.c_str());
+			return nullptr;
+		}
+		std::unique_ptr<SHMRING> ring(new SHMRING());
+		ring->ShmName = Name;
+		ring->Head = static_cast<SHMRINGHEADER *>(map);
+		ring->MapSize = MapSize;
+		ring->Owner = true;
+		/*ftruncate后内容全为0，只需填写头部*/
+		ring->Head->SlotCount = Slots;
+		ring->Head->SlotSize = SlotSize;
+		ring->Head->DataOffset = DataOffset;
+		ring->Head->Version = SHMRING_VERSION;
+		/*魔数最后写入，读端看到魔数即说明头部完整*/
+		std::atomic_thread_fence(std::memory_order_release);
+		ring->Head->Magic = SHMRING_MAGIC;
+		return ring;
+	}
+
+	/*
+	 * name: Open(const std::string &Name)
+	 * @param Name:共享内存名称
+	 * describe: Map an existing ring for reading
+	 * 描述：以只读方式映射已有的共享内存环
+	 * @return nullptr: The ring does not exist or is not a frame ring
+	 */
+	std::unique_ptr<SHMRING> SHMRING::Open(const std::string &Name)
+	{
+		int fd = shm_open(Name.c_str(),O_RDONLY,0);
+		if(fd < 0)
+			return nullptr;
+		struct stat st;
+		void *map = MAP_FAILED;
+		if(fstat(fd,&st) == 0 && (size_t)st.st_size >= sizeof(SHMRINGHEADER))
+			map = mmap(nullptr,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+		close(fd);
+		if(map == MAP_FAILED)
+			return nullptr;
+		SHMRINGHEADER *head = static_cast<SHMRINGHEADER *>(map);
+		if(head->Magic != SHMRING_MAGIC || head->Version != SHMRING_VERSION ||
+		   head->DataOffset + head->SlotSize * head->SlotCount > (uint64_t)st.st_size)
+		{
+			IDLog("%s is not a frame ring of this version\n",Name.c_str());
+			munmap(map,st.st_size);
+			return nullptr;
+		}
+		std::unique_ptr<SHMRING> ring(new SHMRING());
+		ring->ShmName = Name;
+		ring->Head = head;
+		ring->MapSize = st.st_size;
+		return ring;
+	}
+
+	SHMSLOT *SHMRING::Slot(uint64_t Index)
+	{
+		SHMSLOT *slots = reinterpret_cast<SHMSLOT *>(reinterpret_cast<unsigned char *>(Head) + sizeof(SHMRINGHEADER));
+		return &slots[Index % Head->SlotCount];
+	}
+
+	unsigned char *SHMRING::Data(uint64_t Index)
+	{
+		return reinterpret_cast<unsigned char *>(Head) + Head->DataOffset + (Index % Head->SlotCount) * Head->SlotSize;
+	}
+
+	/*
+	 * name: Publish(const FRAMEHEADER &Header,const unsigned char *Data)
+	 * @param Header:帧信息
+	 * @param Data:图像数据
+	 * describe: Copy a frame into the next slot
+	 * 描述：将一帧写入下一个槽
+	 * note: Single writer only,the oldest frame is overwritten when the ring is full
+	 */
+	bool SHMRING::Publish(const FRAMEHEADER &Header,const unsigned char *Data)
+	{
+		if(Owner == false || Header.Size > Head->SlotSize)
+			return false;
+		uint64_t Index = Head->Written.load(std::memory_order_relaxed);
+		SHMSLOT *slot = Slot(Index);
+		slot->Lock.store(2 * Index + 1,std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot->Header = Header;
+		memcpy(this->Data(Index),Data,Header.Size);
+		slot->Lock.store(2 * Index + 2,std::memory_order_release);
+		Head->Written.store(Index + 1,std::memory_order_release);
+		return true;
+	}
+
+	/*
+	 * name: Read(uint64_t Index,FRAMEHEADER &Header,const unsigned char *&Data)
+	 * @param Index:帧序号(从0开始)
+	 * @param Header:帧信息
+	 * @param Data:指向共享内存中的图像数据
+	 * describe: Get a frame without copying the image
+	 * 描述：读取帧信息，图像数据不复制
+	 * @return false: The frame is not written yet or already overwritten
+	 * note: Call Valid() after using Data to make sure the writer did not reuse the slot
+	 */
+	bool SHMRING::Read(uint64_t Index,FRAMEHEADER &Header,const unsigned char *&Data)
+	{
+		SHMSLOT *slot = Slot(Index);
+		if(slot->Lock.load(std::memory_order_acquire) != 2 * Index + 2)
+			return false;
+		Header = slot->Header;
+		Data = this->Data(Index);
+		return Valid(Index);
+	}
+
+	/*
+	 * name: Valid(uint64_t Index)
+	 * @param Index:帧序号
+	 * describe: Whether the frame is still in its slot
+	 * 描述：帧是否仍未被覆盖
+	 */
+	bool SHMRING::Valid(uint64_t Index)
+	{
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return Slot(Index)->Lock.load(std::memory_order_relaxed) == 2 * Index + 2;
+	}
+
+	bool SHMRING::Closed()
+	{
+		return Head->Closed.load(std::memory_order_acquire) != 0;
+	}
+
+	uint64_t SHMRING::Written()
+	{
+		return Head->Written.load(std::memory_order_acquire);
+	}
+
+	uint64_t SHMRING::SlotSize()
+	{
+		return Head->SlotSize;
+	}
+
+	std::string SHMRING::Name()
+	{
+		return ShmName;
+	}
+
+	void SHMRING::Unlink()
+	{
+		shm_unlink(ShmName.c_str());
+	}
+}
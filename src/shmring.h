@@ -0,0 +1,112 @@
+/*
+ * shmring.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Shared memory frame ring
+
+**************************************************/
+
+#pragma once
+
+#ifndef _SHMRING_H_
+#define _SHMRING_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "frame.h"
+
+#define SHMRING_MAGIC 0x41495246		//"AIRF"
+#define SHMRING_VERSION 2
+
+namespace AstroAir
+{
+	/*
+	 * Layout of the shared memory,readers outside the server may map it too:
+	 *   SHMRINGHEADER | SHMSLOT[SlotCount] | page aligned data of each slot
+	 * Every slot is a seqlock: Lock is odd while the writer fills the slot and
+	 * becomes 2*(frame index+1) once the frame is complete. A reader copies
+	 * Lock,reads the slot and checks Lock again,a changed value means the
+	 * frame was overwritten while it was being read. The writer sets Closed
+	 * when it goes away or replaces the ring with a larger one under the
+	 * same name,readers then map the name again.
+	 */
+	struct SHMRINGHEADER
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t SlotCount;
+		std::atomic<uint32_t> Closed;		//写端关闭后为1
+		uint64_t SlotSize;		//每个槽的数据区大小
+		uint64_t DataOffset;		//数据区相对共享内存起始的偏移
+		std::atomic<uint64_t> Written;		//已发布的帧数
+	};
+
+	struct alignas(64) SHMSLOT
+	{
+		std::atomic<uint64_t> Lock;
+		FRAMEHEADER Header;
+	};
+
+	class SHMRING
+	{
+		public:
+			~SHMRING();
+			/*创建共享内存环(写端)*/
+			static std::unique_ptr<SHMRING> Create(const std::string &Name,uint32_t Slots,uint64_t SlotSize);
+			/*打开已有的共享内存环(读端)*/
+			static std::unique_ptr<SHMRING> Open(const std::string &Name);
+			/*发布一帧，数据过大时返回false*/
+			bool Publish(const FRAMEHEADER &Header,const unsigned char *Data);
+			/*读取第Index帧的信息与数据指针，不复制数据*/
+			bool Read(uint64_t Index,FRAMEHEADER &Header,const unsigned char *&Data);
+			/*第Index帧是否仍然有效，读取数据后调用*/
+			bool Valid(uint64_t Index);
+			/*写端是否已关闭，读端应重新打开*/
+			bool Closed();
+			/*已发布的帧数*/
+			uint64_t Written();
+			uint64_t SlotSize();
+			std::string Name();
+			/*删除共享内存名称，已映射的进程不受影响*/
+			void Unlink();
+		private:
+			SHMRING() = default;
+			SHMSLOT *Slot(uint64_t Index);
+			unsigned char *Data(uint64_t Index);
+
+			std::string ShmName;
+			SHMRINGHEADER *Head = nullptr;
+			size_t MapSize = 0;
+			bool Owner = false;
+	};
+}
+
+#endif
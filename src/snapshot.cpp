@@ -0,0 +1,168 @@
+/*
+ * snapshot.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Device state snapshot for warm start
+
+Using:JsonCpp<https://github.com/open-source-parsers/jsoncpp>
+
+**************************************************/
+
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <stdio.h>
+
+#include <json/json.h>
+
+#include "logger.h"
+#include "snapshot.h"
+
+namespace AstroAir::SNAPSHOT
+{
+	/*
+	 * name: ToJson(const DeviceState &state,Json::Value &Device)
+	 * @param state:设备状态
+	 * @param Device:输出的Json对象
+	 * describe: Convert a device state to json
+	 * 描述：将设备状态转换为Json
+	 */
+	void ToJson(const DeviceState &state,Json::Value &Device)
+	{
+		Device["brand"] = Json::Value(state.Brand);
+		Device["name"] = Json::Value(state.Name);
+		Device["id"] = Json::Value(state.Id);
+		Device["index"] = Json::Value(state.Index);
+		Device["bin"] = Json::Value(state.Bin);
+		Device["gain"] = Json::Value(state.Gain);
+		Device["offset"] = Json::Value(state.Offset);
+		Device["roi"][0] = Json::Value(state.StartX);
+		Device["roi"][1] = Json::Value(state.StartY);
+		Device["roi"][2] = Json::Value(state.Width);
+		Device["roi"][3] = Json::Value(state.Height);
+		Device["cooler"] = Json::Value(state.CoolerOn);
+		Device["temperature"] = Json::Value(state.TargetTemperature);
+	}
+
+	/*
+	 * name: FromJson(const Json::Value &Device)
+	 * @param Device:Json对象
+	 * describe: Read a device state from json
+	 * 描述：从Json读取设备状态
+	 */
+	DeviceState FromJson(const Json::Value &Device)
+	{
+		DeviceState state;
+		state.Brand = Device["brand"].asString();
+		state.Name = Device["name"].asString();
+		state.Id = Device["id"].asString();
+		state.Index = Device.get("index",-1).asInt();
+		state.Bin = Device.get("bin",1).asInt();
+		state.Gain = Device["gain"].asInt();
+		state.Offset = Device["offset"].asInt();
+		state.StartX = Device["roi"][0].asInt();
+		state.StartY = Device["roi"][1].asInt();
+		state.Width = Device["roi"][2].asInt();
+		state.Height = Device["roi"][3].asInt();
+		state.CoolerOn = Device["cooler"].asBool();
+		state.TargetTemperature = Device["temperature"].asDouble();
+		return state;
+	}
+
+	/*
+	 * name: Save(const AIRSNAPSHOT &snapshot,std::string FileName)
+	 * @param snapshot:设备快照
+	 * @param FileName:快照文件名称
+	 * describe: Write the last known device state to disk
+	 * 描述：将设备最后已知状态写入文件
+	 * @return true: Snapshot saved successfully
+	 * @return false: Unable to write snapshot
+	 * note: Written to a temporary file first and renamed, so a crash never leaves half a snapshot
+	 */
+	bool Save(const AIRSNAPSHOT &snapshot,std::string FileName)
+	{
+		Json::Value Root;
+		for(auto &it : snapshot)
+			ToJson(it.second,Root[it.first]);
+		/*使用紧凑格式写入*/
+		Json::StreamWriterBuilder writer;
+		writer["indentation"] = "";
+		std::string TempName = FileName + ".tmp";
+		std::ofstream out(TempName,std::ios::out | std::ios::trunc);
+		if(!out.is_open())
+		{
+			IDLog("Unable to write device snapshot %s\n",TempName.c_str());
+			return false;
+		}
+		out << Json::writeString(writer,Root);
+		out.close();
+		if(rename(TempName.c_str(),FileName.c_str()) != 0)
+		{
+			IDLog("Unable to replace device snapshot %s\n",FileName.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	/*
+	 * name: Load(AIRSNAPSHOT &snapshot,std::string FileName)
+	 * @param snapshot:读取出的设备快照
+	 * @param FileName:快照文件名称
+	 * describe: Read the device state saved by the last session
+	 * 描述：读取上次运行时保存的设备状态
+	 * @return true: Snapshot loaded successfully
+	 * @return false: No usable snapshot
+	 */
+	bool Load(AIRSNAPSHOT &snapshot,std::string FileName)
+	{
+		std::ifstream in(FileName,std::ios::binary);
+		if(!in.is_open())
+			return false;
+		std::stringstream buffer;
+		buffer << in.rdbuf();
+		in.close();
+		std::string jsonStr = buffer.str();
+		Json::Value Root;
+		Json::String errs;
+		Json::CharReaderBuilder reader;
+		std::unique_ptr<Json::CharReader>const json_read(reader.newCharReader());
+		if(!json_read->parse(jsonStr.c_str(), jsonStr.c_str() + jsonStr.length(), &Root, &errs) || !Root.isObject())
+		{
+			IDLog("Device snapshot %s is damaged, ignore it\n",FileName.c_str());
+			return false;
+		}
+		snapshot.clear();
+		for(auto &role : Root.getMemberNames())
+		{
+			DeviceState state = FromJson(Root[role]);
+			if(!state.Brand.empty() && !state.Name.empty())
+				snapshot[role] = state;
+		}
+		return !snapshot.empty();
+	}
+}
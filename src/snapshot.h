@@ -0,0 +1,87 @@
+/*
+ * snapshot.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Device state snapshot for warm start
+
+**************************************************/
+
+#pragma once
+
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+#include <string>
+#include <map>
+
+#define SNAPSHOT_FILE "snapshot.json"
+
+namespace Json
+{
+	class Value;
+}
+
+namespace AstroAir
+{
+	/*单个设备的最后已知状态*/
+	struct DeviceState
+	{
+		std::string Brand;		//设备品牌
+		std::string Name;		//设备名称
+		std::string Id;		//SDK设备ID，用于跳过枚举直接打开
+		int Index = -1;		//SDK设备序号
+		/*相机参数*/
+		int Bin = 1;
+		int Gain = 0;
+		int Offset = 0;
+		int StartX = 0;
+		int StartY = 0;
+		int Width = 0;
+		int Height = 0;
+		bool CoolerOn = false;
+		double TargetTemperature = 0;
+
+		bool operator==(const DeviceState &other) const = default;
+	};
+
+	/*按设备角色(camera,mount,focus,filter,guide)保存的快照*/
+	typedef std::map<std::string,DeviceState> AIRSNAPSHOT;
+
+	namespace SNAPSHOT
+	{
+		/*设备状态与Json互相转换*/
+		void ToJson(const DeviceState &state,Json::Value &Device);
+		DeviceState FromJson(const Json::Value &Device);
+		/*保存快照*/
+		bool Save(const AIRSNAPSHOT &snapshot,std::string FileName = SNAPSHOT_FILE);
+		/*读取快照*/
+		bool Load(AIRSNAPSHOT &snapshot,std::string FileName = SNAPSHOT_FILE);
+	}
+}
+
+#endif
@@ -0,0 +1,152 @@
+/*
+ * threads.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Thread roles,CPU affinity and real-time scheduling
+
+**************************************************/
+
+#include <vector>
+#include <algorithm>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <json/json.h>
+
+#include "logger.h"
+#include "airconfig.h"
+#include "metrics.h"
+#include "threads.h"
+
+#define ROLE_COUNT 4
+
+namespace AstroAir::THREADS
+{
+	/*一个角色的设置*/
+	struct RoleConfig
+	{
+		std::vector<int> Cpus;		//为空时不限制
+		int Policy = SCHED_OTHER;
+		int Priority = 0;
+	};
+
+	const char *RoleName(ROLE Role)
+	{
+		static const char *Names[ROLE_COUNT] = {"capture","download","processing","network"};
+		return Role >= 0 && Role < ROLE_COUNT ? Names[Role] : "unknown";
+	}
+
+	/*
+	 * name: LoadConfig()
+	 * describe: Read the settings of every role from config.air
+	 * 描述：读取config.air中各角色的设置
+	 * note: Real-time policies are only accepted for the capture and download roles
+	 */
+	static std::vector<RoleConfig> LoadConfig()
+	{
+		std::vector<RoleConfig> roles(ROLE_COUNT);
+		Json::Value root;
+		if(AIRCONFIG::Load(root) == false)
+			return roles;
+		for(int i = 0;i < ROLE_COUNT;i++)
+		{
+			const Json::Value &role = root["threads"][RoleName((ROLE)i)];
+			if(role.isObject() == false)
+				continue;
+			for(const Json::Value &cpu : role["cpus"])
+				if(cpu.isInt() && cpu.asInt() >= 0 && cpu.asInt() < CPU_SETSIZE)
+					roles[i].Cpus.push_back(cpu.asInt());
+			std::string policy = role.get("policy","other").asString();
+			if(policy == "fifo" || policy == "rr")
+			{
+				if(i != ROLE_CAPTURE && i != ROLE_DOWNLOAD)
+				{
+					IDLog("Real-time policy is only allowed for capture and download threads,ignore it for %s\n",RoleName((ROLE)i));
+					continue;
+				}
+				roles[i].Policy = policy == "fifo" ? SCHED_FIFO : SCHED_RR;
+				roles[i].Priority = std::clamp(role.get("priority",50).asInt(),sched_get_priority_min(roles[i].Policy),sched_get_priority_max(roles[i].Policy));
+			}
+		}
+		return roles;
+	}
+
+	static const std::vector<RoleConfig> &Config()
+	{
+		static std::vector<RoleConfig> roles = LoadConfig();
+		return roles;
+	}
+
+	/*
+	 * name: Enter(ROLE Role,std::string Name)
+	 * @param Role:线程角色
+	 * @param Name:线程名，超过15个字符时截断
+	 * describe: Apply the name,affinity and scheduling of the role to the calling thread
+	 * 描述：将角色的线程名、CPU亲和性与调度策略应用到当前线程
+	 * note: A real-time policy needs CAP_SYS_NICE,without it the thread keeps the default scheduler
+	 */
+	void Enter(ROLE Role,std::string Name)
+	{
+		pthread_setname_np(pthread_self(),Name.substr(0,15).c_str());
+		if(Role < 0 || Role >= ROLE_COUNT)
+			return;
+		const RoleConfig &config = Config()[Role];
+		if(!config.Cpus.empty())
+		{
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			for(int cpu : config.Cpus)
+				CPU_SET(cpu,&set);
+			if(int err = pthread_setaffinity_np(pthread_self(),sizeof(set),&set); err != 0)
+				IDLog("Unable to set the CPU affinity of %s: %s\n",Name.c_str(),strerror(err));
+		}
+		if(config.Policy != SCHED_OTHER)
+		{
+			sched_param param;
+			param.sched_priority = config.Priority;
+			if(int err = pthread_setschedparam(pthread_self(),config.Policy,&param); err != 0)
+			{
+				METRICS::Add("thread.sched_denied");
+				IDLog("Unable to give %s real-time priority: %s\n",Name.c_str(),strerror(err));
+			}
+		}
+	}
+
+	/*
+	 * name: Wakeup(ROLE Role,std::chrono::steady_clock::time_point Due)
+	 * @param Role:线程角色
+	 * @param Due:预定的唤醒时间
+	 * describe: Record how late a timed wakeup was
+	 * 描述：记录定时唤醒的延迟(微秒)，用于比较调度设置的效果
+	 */
+	void Wakeup(ROLE Role,std::chrono::steady_clock::time_point Due)
+	{
+		auto late = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - Due).count();
+		METRICS::Observe(std::string("thread.jitter_us.") + RoleName(Role),std::max<int64_t>(late,0));
+	}
+}
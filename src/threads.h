@@ -0,0 +1,68 @@
+/*
+ * threads.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Thread roles,CPU affinity and real-time scheduling
+
+**************************************************/
+
+#pragma once
+
+#ifndef _THREADS_H_
+#define _THREADS_H_
+
+#include <string>
+#include <chrono>
+
+/*
+ * Every long running thread enters one of a few roles when it starts.
+ * config.air may pin a role to some CPUs and give the capture and
+ * download roles a real-time policy, e.g.
+ *   "threads":{"capture":{"cpus":[3],"policy":"fifo","priority":50},
+ *              "processing":{"cpus":[0,1,2]}}
+ * Roles without settings keep the default scheduler.
+ */
+namespace AstroAir::THREADS
+{
+	enum ROLE
+	{
+		ROLE_CAPTURE,		//曝光计时与视频采集
+		ROLE_DOWNLOAD,		//SDK调用与图像下载
+		ROLE_PROCESSING,		//保存、预览、分析与制冷
+		ROLE_NETWORK		//WebSocket服务器
+	};
+
+	/*在线程开始时调用，设置线程名、CPU亲和性与调度策略*/
+	void Enter(ROLE Role,std::string Name);
+	/*记录定时唤醒比预定时间晚了多少，统计为thread.jitter_us.<角色>*/
+	void Wakeup(ROLE Role,std::chrono::steady_clock::time_point Due);
+	/*角色名称*/
+	const char *RoleName(ROLE Role);
+}
+
+#endif
@@ -0,0 +1,198 @@
+/*
+ * video.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Streaming video capture
+
+**************************************************/
+
+#include <chrono>
+
+#include "logger.h"
+#include "metrics.h"
+#include "threads.h"
+#include "video.h"
+
+namespace AstroAir
+{
+	VIDEOCAPTURE::VIDEOCAPTURE(std::string Name) : Name(Name),Buffers(Name + " video")
+	{
+	}
+
+	VIDEOCAPTURE::~VIDEOCAPTURE()
+	{
+		Stop();
+	}
+
+	/*
+	 * name: Start(size_t FrameSize,GRABFUNC Grab,FRAMESINK Consumer)
+	 * @param FrameSize:单帧最大字节数
+	 * @param Grab:读取一帧
+	 * @param Consumer:帧接收者，在消费线程中调用
+	 * describe: Start the capture and consumer threads
+	 * 描述：启动采集线程与消费线程
+	 * @return false: Already running or out of memory
+	 */
+	bool VIDEOCAPTURE::Start(size_t FrameSize,GRABFUNC Grab,FRAMESINK Consumer)
+	{
+		if(Running == true)
+			return false;
+		Buffers.Reserve(FrameSize,VIDEO_BUFFERS);
+		for(int i = 0;i < VIDEO_BUFFERS;i++)
+		{
+			if((Slots[i] = Buffers.Acquire(FrameSize)) == nullptr)
+				return false;
+		}
+		this->Grab = Grab;
+		Sink = Consumer;
+		Writing = 0;
+		Ready = 1;
+		Reading = 2;
+		Fresh = false;
+		CapturedFrames = 0;
+		DroppedFrames = 0;
+		FrameRate = 0;
+		Running = true;
+		CaptureThread = std::thread(&VIDEOCAPTURE::Capture,this);
+		ConsumeThread = std::thread(&VIDEOCAPTURE::Consume,this);
+		IDLog("Video capture of %s started\n",Name.c_str());
+		return true;
+	}
+
+	/*
+	 * name: Stop()
+	 * describe: Stop capturing and wait for the threads
+	 * 描述：停止采集并等待线程退出
+	 * note: Returns after the current Grab() returns,so the SDK wait time of Grab should stay short
+	 */
+	void VIDEOCAPTURE::Stop()
+	{
+		{
+			std::lock_guard<std::mutex> guard(Lock);
+			if(Running == false)
+				return;
+			Running = false;
+		}
+		Cond.notify_all();
+		if(CaptureThread.joinable())
+			CaptureThread.join();
+		if(ConsumeThread.joinable())
+			ConsumeThread.join();
+		for(int i = 0;i < VIDEO_BUFFERS;i++)
+			Slots[i] = nullptr;
+		IDLog("Video capture of %s stopped,%lu frames captured,%lu dropped\n",Name.c_str(),(unsigned long)CapturedFrames,(unsigned long)DroppedFrames);
+	}
+
+	/*
+	 * name: Capture()
+	 * describe: Capture thread,read frames as fast as the camera sends them
+	 * 描述：采集线程，以相机的速度读取图像
+	 * note: The write slot belongs to this thread,only the swap needs the lock
+	 */
+	void VIDEOCAPTURE::Capture()
+	{
+		THREADS::Enter(THREADS::ROLE_CAPTURE,"video-" + Name);
+		auto window = std::chrono::steady_clock::now();
+		auto last = window;
+		uint64_t frames = 0;
+		while(Running == true)
+		{
+			if(Grab(Slots[Writing].get(),Headers[Writing]) == false)
+				continue;
+			CapturedFrames++;
+			frames++;
+			{
+				std::lock_guard<std::mutex> guard(Lock);
+				if(Fresh == true)
+				{
+					/*消费者没来得及读取上一帧*/
+					DroppedFrames++;
+					METRICS::Add("video.dropped." + Name);
+				}
+				std::swap(Writing,Ready);
+				Fresh = true;
+			}
+			Cond.notify_one();
+			auto now = std::chrono::steady_clock::now();
+			/*帧间隔的分布反映采集线程的抖动*/
+			METRICS::Observe("video.interval_ms." + Name,std::chrono::duration<double,std::milli>(now - last).count());
+			last = now;
+			std::chrono::duration<double> elapsed = now - window;
+			if(elapsed.count() >= 1)
+			{
+				FrameRate = frames / elapsed.count();
+				METRICS::Set("video.fps." + Name,FrameRate);
+				window = now;
+				frames = 0;
+			}
+		}
+	}
+
+	/*
+	 * name: Consume()
+	 * describe: Consumer thread,hand the newest frame to the sink
+	 * 描述：消费线程，将最新的帧交给接收者
+	 */
+	void VIDEOCAPTURE::Consume()
+	{
+		THREADS::Enter(THREADS::ROLE_PROCESSING,"consume-" + Name);
+		while(true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(Lock);
+				Cond.wait(lock,[this]() { return Fresh == true || Running == false; });
+				if(Fresh == false)
+					break;
+				std::swap(Reading,Ready);
+				Fresh = false;
+			}
+			if(Sink)
+				Sink(Headers[Reading],Slots[Reading].get());
+		}
+	}
+
+	bool VIDEOCAPTURE::IsRunning()
+	{
+		return Running;
+	}
+
+	double VIDEOCAPTURE::Fps()
+	{
+		return FrameRate;
+	}
+
+	uint64_t VIDEOCAPTURE::Captured()
+	{
+		return CapturedFrames;
+	}
+
+	uint64_t VIDEOCAPTURE::Dropped()
+	{
+		return DroppedFrames;
+	}
+}
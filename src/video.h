@@ -0,0 +1,103 @@
+/*
+ * video.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Streaming video capture
+
+**************************************************/
+
+#pragma once
+
+#ifndef _VIDEO_H_
+#define _VIDEO_H_
+
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+#include "frame.h"
+#include "framepool.h"
+
+#define VIDEO_BUFFERS 3		//三缓冲：采集、最新、读取各一个
+#define VIDEO_POLL_US 1000		//需要轮询的SDK没有新帧时的等待(微秒)
+
+namespace AstroAir
+{
+	/*从相机读取一帧到Buffer，没有新帧时返回false*/
+	typedef std::function<bool(unsigned char *Buffer,FRAMEHEADER &Header)> GRABFUNC;
+
+	/*
+	 * Streams frames from a camera on a dedicated capture thread into a
+	 * triple buffer. The consumer always gets the newest complete frame;
+	 * when it falls behind,older frames are dropped instead of stalling
+	 * the sensor. Frame rate and drops are exported as metrics.
+	 */
+	class VIDEOCAPTURE
+	{
+		public:
+			explicit VIDEOCAPTURE(std::string Name);
+			~VIDEOCAPTURE();
+			/*开始采集*/
+			bool Start(size_t FrameSize,GRABFUNC Grab,FRAMESINK Consumer);
+			/*停止采集*/
+			void Stop();
+			bool IsRunning();
+			/*最近一秒的帧率*/
+			double Fps();
+			/*采集与丢弃的帧数*/
+			uint64_t Captured();
+			uint64_t Dropped();
+		private:
+			void Capture();
+			void Consume();
+
+			std::string Name;
+			FRAMEPOOL Buffers;
+			FRAMEBUFFER Slots[VIDEO_BUFFERS];
+			FRAMEHEADER Headers[VIDEO_BUFFERS];
+			int Writing = 0;		//采集线程正在写入
+			int Ready = 1;		//最新的完整帧
+			int Reading = 2;		//消费线程正在读取
+			bool Fresh = false;		//Ready中是否有未读的帧
+			std::mutex Lock;
+			std::condition_variable Cond;
+			std::atomic_bool Running{false};
+			std::thread CaptureThread;
+			std::thread ConsumeThread;
+			GRABFUNC Grab;
+			FRAMESINK Sink;
+			std::atomic<uint64_t> CapturedFrames{0};
+			std::atomic<uint64_t> DroppedFrames{0};
+			std::atomic<double> FrameRate{0};
+	};
+}
+
+#endif
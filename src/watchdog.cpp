@@ -0,0 +1,305 @@
+/*
+ * watchdog.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Watchdog for blocking vendor SDK calls
+
+**************************************************/
+
+#include <chrono>
+#include <vector>
+
+#include "logger.h"
+#include "metrics.h"
+#include "threads.h"
+#include "watchdog.h"
+
+namespace AstroAir
+{
+	struct SDKEXECUTOR::Registry
+	{
+		std::mutex Lock;
+		std::vector<std::weak_ptr<State>> States;
+		std::jthread Thread;
+	};
+
+	/*
+	 * name: Watched()
+	 * describe: The executors checked by the watchdog,the thread starts with the first one
+	 * 描述：看门狗检查的执行器，第一个执行器创建时启动看门狗线程
+	 */
+	SDKEXECUTOR::Registry &SDKEXECUTOR::Watched()
+	{
+		static Registry registry;
+		return registry;
+	}
+
+	/*
+	 * name: SDKEXECUTOR(std::string Device)
+	 * @param Device:设备名称，用于日志和指标
+	 * describe: Start the SDK thread of the device
+	 * 描述：启动设备的SDK执行线程
+	 */
+	SDKEXECUTOR::SDKEXECUTOR(std::string Device)
+	{
+		state = std::make_shared<State>();
+		state->Device = Device;
+		Worker = std::thread(Work,state);
+		Registry &registry = Watched();
+		std::lock_guard<std::mutex> guard(registry.Lock);
+		registry.States.push_back(state);
+		if(registry.Thread.joinable() == false)
+			registry.Thread = std::jthread(Watch);
+	}
+
+	/*
+	 * name: ~SDKEXECUTOR()
+	 * describe: Stop the SDK thread
+	 * 描述：停止SDK执行线程
+	 * note: A thread stuck inside the SDK is detached,it exits by itself if the SDK ever returns
+	 */
+	SDKEXECUTOR::~SDKEXECUTOR()
+	{
+		{
+			std::lock_guard<std::mutex> guard(state->Lock);
+			state->Running = false;
+			/*驱动随后析构，卡住的调用返回时不再通知*/
+			state->Handler = nullptr;
+		}
+		state->Cond.notify_all();
+		if(state->Stalled == true)
+			Worker.detach();
+		else
+			Worker.join();
+	}
+
+	/*
+	 * name: Work(std::shared_ptr<State> state)
+	 * describe: SDK thread,run the tasks one by one
+	 * 描述：SDK执行线程，依次执行任务
+	 */
+	void SDKEXECUTOR::Work(std::shared_ptr<State> state)
+	{
+		THREADS::Enter(THREADS::ROLE_DOWNLOAD,"sdk-" + state->Device);
+		std::unique_lock<std::mutex> lock(state->Lock);
+		while(true)
+		{
+			state->Cond.wait(lock,[&state]() { return state->Running == false || (state->Current && state->Current->Done == false); });
+			if(state->Current == nullptr || state->Current->Done == true)
+				return;
+			std::shared_ptr<Task> task = state->Current;
+			lock.unlock();
+			THREADS::Wakeup(THREADS::ROLE_DOWNLOAD,task->Posted);
+			task->Job();
+			lock.lock();
+			task->Done = true;
+			state->Current = nullptr;
+			STALLHANDLER handler;
+			if(state->Stalled == true)
+			{
+				state->Stalled = false;
+				METRICS::Set("sdk.stalled." + state->Device,0);
+				IDLog("%s returned at last,%s is responding again\n",task->Func.c_str(),state->Device.c_str());
+				handler = state->Handler;
+			}
+			state->Cond.notify_all();
+			if(handler)
+			{
+				lock.unlock();
+				handler(task->Func,false);
+				lock.lock();
+			}
+		}
+	}
+
+	/*
+	 * name: MarkStalled(State &state,std::string Func,int Timeout)
+	 * @param state:执行器状态，调用者已加锁
+	 * @param Func:未返回的SDK函数
+	 * @param Timeout:超时时间(毫秒)
+	 * describe: Mark the SDK of the device as stuck
+	 * 描述：将设备SDK标记为卡死
+	 * @return The handler to call after unlocking,empty if the device was already stalled
+	 */
+	STALLHANDLER SDKEXECUTOR::MarkStalled(State &state,std::string Func,int Timeout)
+	{
+		if(state.Stalled == true)
+			return nullptr;
+		state.Stalled = true;
+		METRICS::Add("sdk.timeouts");
+		METRICS::Set("sdk.stalled." + state.Device,1);
+		IDLog("%s did not return within %d ms,%s is marked as stalled\n",Func.c_str(),Timeout,state.Device.c_str());
+		return state.Handler;
+	}
+
+	/*
+	 * name: Watch(std::stop_token Stop)
+	 * describe: Watchdog thread,check the running call of every executor
+	 * 描述：看门狗线程，检查每个执行器正在执行的调用
+	 * note: A call the caller stopped waiting for,such as a cancelled download,is only found here
+	 */
+	void SDKEXECUTOR::Watch(std::stop_token Stop)
+	{
+		THREADS::Enter(THREADS::ROLE_PROCESSING,"sdk-watchdog");
+		Registry &registry = Watched();
+		std::mutex sleep;
+		std::condition_variable_any wake;
+		while(Stop.stop_requested() == false)
+		{
+			{
+				std::unique_lock<std::mutex> lock(sleep);
+				wake.wait_for(lock,Stop,std::chrono::milliseconds(SDK_WATCH_INTERVAL),[]() { return false; });
+			}
+			std::vector<std::shared_ptr<State>> states;
+			{
+				std::lock_guard<std::mutex> guard(registry.Lock);
+				for(auto it = registry.States.begin();it != registry.States.end();)
+				{
+					if(auto state = it->lock())
+					{
+						states.push_back(state);
+						++it;
+					}
+					else
+						it = registry.States.erase(it);
+				}
+			}
+			auto now = std::chrono::steady_clock::now();
+			for(auto &state : states)
+			{
+				STALLHANDLER handler;
+				std::string func;
+				{
+					std::lock_guard<std::mutex> guard(state->Lock);
+					std::shared_ptr<Task> task = state->Current;
+					if(task == nullptr || task->Done == true || now < task->Deadline)
+						continue;
+					func = task->Func;
+					std::chrono::duration<double,std::milli> diff = task->Deadline - task->Posted;
+					handler = MarkStalled(*state,func,(int)diff.count());
+				}
+				if(handler)
+					handler(func,true);
+			}
+		}
+	}
+
+	/*
+	 * name: Run(const char *Func,int Timeout,std::function<void()> Job,std::stop_token Stop)
+	 * @param Func:SDK函数名称，用于日志
+	 * @param Timeout:超时时间(毫秒)
+	 * @param Job:需要执行的SDK调用
+	 * @param Stop:请求停止时立即返回，用于停止曝光
+	 * describe: Run an SDK call on the SDK thread and wait for it
+	 * 描述：在SDK线程中执行调用并等待结果
+	 * @return false: The call timed out,was cancelled or the SDK is still stuck in an earlier call
+	 * note: A cancelled call keeps running in the SDK,the next call waits for it before it starts
+	 */
+	bool SDKEXECUTOR::Run(const char *Func,int Timeout,std::function<void()> Job,std::stop_token Stop)
+	{
+		std::lock_guard<std::mutex> call(CallLock);
+		if(state->Stalled == true)
+		{
+			METRICS::Add("sdk.rejected");
+			IDLog("%s is not responding,refuse to call %s\n",state->Device.c_str(),Func);
+			return false;
+		}
+		if(Stop.stop_requested())
+			return false;
+		/*在加锁之前注册，已经请求停止时回调在这里直接执行*/
+		std::shared_ptr<State> shared = state;
+		std::stop_callback wake(Stop,[shared]()
+		{
+			std::lock_guard<std::mutex> guard(shared->Lock);
+			shared->Cond.notify_all();
+		});
+		std::unique_lock<std::mutex> lock(state->Lock);
+		auto start = std::chrono::steady_clock::now();
+		/*上一次被取消的调用仍在SDK中，等它返回后再开始*/
+		if(state->Current != nullptr && state->Cond.wait_for(lock,std::chrono::milliseconds(Timeout),[this,&Stop]() { return state->Current == nullptr || Stop.stop_requested(); }) == false)
+		{
+			std::string func = state->Current->Func;
+			STALLHANDLER handler = MarkStalled(*state,func,Timeout);
+			lock.unlock();
+			if(handler)
+				handler(func,true);
+			return false;
+		}
+		if(Stop.stop_requested())
+			return false;
+		auto task = std::make_shared<Task>();
+		task->Job = Job;
+		task->Func = Func;
+		task->Posted = std::chrono::steady_clock::now();
+		task->Deadline = task->Posted + std::chrono::milliseconds(Timeout);
+		state->Current = task;
+		state->Cond.notify_all();
+		METRICS::Add("sdk.calls");
+		if(state->Cond.wait_for(lock,std::chrono::milliseconds(Timeout),[&task,&Stop]() { return task->Done || Stop.stop_requested(); }) == false)
+		{
+			STALLHANDLER handler = MarkStalled(*state,Func,Timeout);
+			lock.unlock();
+			if(handler)
+				handler(Func,true);
+			return false;
+		}
+		if(task->Done == false)
+		{
+			/*调用仍在SDK中，不判定为卡死*/
+			METRICS::Add("sdk.cancelled");
+			IDLog("Stop waiting for %s of %s\n",Func,state->Device.c_str());
+			return false;
+		}
+		std::chrono::duration<double,std::milli> diff = std::chrono::steady_clock::now() - start;
+		METRICS::Set("sdk.last_call_ms." + state->Device,diff.count());
+		return true;
+	}
+
+	/*
+	 * name: IsStalled()
+	 * describe: Whether the SDK of the device is stuck
+	 * 描述：设备SDK是否卡死
+	 */
+	bool SDKEXECUTOR::IsStalled()
+	{
+		return state->Stalled;
+	}
+
+	/*
+	 * name: SetStallHandler(STALLHANDLER Handler)
+	 * @param Handler:卡死与恢复的处理者
+	 * describe: Tell the driver when the SDK gets stuck and when it returns
+	 * 描述：在SDK卡死与恢复时通知驱动
+	 * note: The handler runs on the caller,SDK or watchdog thread without any lock held,it must not call the SDK
+	 */
+	void SDKEXECUTOR::SetStallHandler(STALLHANDLER Handler)
+	{
+		std::lock_guard<std::mutex> guard(state->Lock);
+		state->Handler = Handler;
+	}
+}
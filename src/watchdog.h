@@ -0,0 +1,125 @@
+/*
+ * watchdog.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Watchdog for blocking vendor SDK calls
+
+**************************************************/
+
+#pragma once
+
+#ifndef _WATCHDOG_H_
+#define _WATCHDOG_H_
+
+#include <string>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <stop_token>
+
+/*默认SDK调用超时(毫秒)*/
+#define SDK_TIMEOUT 5000
+/*图像下载超时(毫秒)*/
+#define SDK_DOWNLOAD_TIMEOUT 60000
+/*看门狗检查正在执行的调用的间隔(毫秒)*/
+#define SDK_WATCH_INTERVAL 500
+
+namespace AstroAir
+{
+	/*设备SDK卡死(Stalled为真)或恢复时的处理者，参数为卡住的SDK函数*/
+	typedef std::function<void(std::string Func,bool Stalled)> STALLHANDLER;
+
+	/*
+	 * Runs the SDK calls of one device on a dedicated thread with a deadline.
+	 * When a call misses its deadline the caller gets false at once and the
+	 * executor is marked stalled: later calls fail fast instead of piling up
+	 * behind the stuck one, until the SDK finally returns. A watchdog thread
+	 * also checks the running call,so a call nobody waits for any more is
+	 * still detected.
+	 */
+	class SDKEXECUTOR
+	{
+		public:
+			explicit SDKEXECUTOR(std::string Device);
+			~SDKEXECUTOR();
+			/*在执行线程中运行Job，超时或Stop被请求时返回false*/
+			bool Run(const char *Func,int Timeout,std::function<void()> Job,std::stop_token Stop = {});
+			/*运行有返回值的SDK调用*/
+			template<typename T>
+			bool Call(const char *Func,int Timeout,std::function<T()> Job,T &Result,std::stop_token Stop = {})
+			{
+				/*结果由任务持有，超时或取消后SDK仍可安全写入*/
+				auto result = std::make_shared<T>();
+				if(Run(Func,Timeout,[Job,result]() { *result = Job(); },Stop) == false)
+					return false;
+				Result = *result;
+				return true;
+			}
+			/*设备SDK是否卡死*/
+			bool IsStalled();
+			/*设置卡死与恢复的处理者，在执行线程或看门狗线程中调用，不能调用SDK*/
+			void SetStallHandler(STALLHANDLER Handler);
+		private:
+			struct Task
+			{
+				std::function<void()> Job;
+				std::string Func;
+				std::chrono::steady_clock::time_point Posted;		//交给执行线程的时间
+				std::chrono::steady_clock::time_point Deadline;		//超过该时间仍未返回即为卡死
+				bool Done = false;
+			};
+			/*执行线程与执行器共享，执行线程卡死时执行器仍可被析构*/
+			struct State
+			{
+				std::string Device;
+				std::mutex Lock;
+				std::condition_variable Cond;
+				std::shared_ptr<Task> Current;
+				bool Running = true;
+				std::atomic_bool Stalled{false};
+				STALLHANDLER Handler;
+			};
+			static void Work(std::shared_ptr<State> state);
+			/*标记为卡死，返回需要通知的处理者，已经卡死时返回空*/
+			static STALLHANDLER MarkStalled(State &state,std::string Func,int Timeout);
+			/*看门狗线程与它检查的执行器*/
+			struct Registry;
+			static Registry &Watched();
+			static void Watch(std::stop_token Stop);
+
+			std::shared_ptr<State> state;
+			std::mutex CallLock;		//同一设备的SDK调用依次执行
+			std::thread Worker;
+	};
+}
+
+#endif
@@ -39,15 +39,31 @@ Using:JsonCpp<https://github.com/open-source-parsers/jsoncpp>
 #include "logger.h"
 #include "opencv.h"
 #include "base64.h"
+#include "discovery.h"
+#include "metrics.h"
+#include "membudget.h"
+#include "threads.h"
+#include "drvhost.h"
+#include "airconfig.h"
 
-#ifdef HAS_ASI
-    #include "air-asi/asi_ccd.h"
-#endif
-#ifdef HAS_QHY
-    #include "air-qhy/qhy_ccd.h"
-#endif
-#ifdef HAS_INDI
-    #include "air-indi/indi_device.h"
+#include <future>
+#include <algorithm>
+
+#ifdef HAS_PLUGIN
+    #include "plugin.h"
+#else
+    #ifdef HAS_ASI
+        #include "air-asi/asi_ccd.h"
+    #endif
+    #ifdef HAS_QHY
+        #include "air-qhy/qhy_ccd.h"
+    #endif
+    #ifdef HAS_INDI
+        #include "air-indi/indi_device.h"
+    #endif
+    #ifdef HAS_SIMULATOR
+        #include "air-sim/sim_ccd.h"
+    #endif
 #endif
 
 namespace AstroAir
@@ -89,6 +105,8 @@ namespace AstroAir
         isFocusConnected = false;       //电动调焦座连接状态
         isFilterConnected = false;      //滤镜轮连接状态
         isGuideConnected = false;       //导星软件连接状态
+        isConnectedTLS = false;
+        CCD = MOUNT = FOCUS = FILTER = GUIDE = nullptr;
     }
     
     /*
@@ -104,11 +122,13 @@ namespace AstroAir
         {
             stop();
         }
-        delete [] CCD;
-        delete [] MOUNT;
-        delete [] FOCUS;
-        delete [] FILTER;
-        delete [] GUIDE;
+        /*序列线程仍在使用设备*/
+        Sequence.Stop();
+        delete CCD;
+        delete MOUNT;
+        delete FOCUS;
+        delete FILTER;
+        delete GUIDE;
     }
 
     /*
@@ -363,6 +383,14 @@ namespace AstroAir
             case "RemoteGetAstroAirProfiles"_hash:
                 GetAstroAirProfiles();
                 break;
+            /*返回已发现的设备列表*/
+            case "RemoteGetDeviceList"_hash:
+                GetDeviceList();
+                break;
+            /*返回服务器运行指标*/
+            case "RemoteGetMetrics"_hash:
+                GetMetrics();
+                break;
             /*连接设备*/
             case "RemoteSetupConnect"_hash:{
                 std::thread ConnectThread(&WSSERVER::SetupConnect,this,root["params"]["TimeoutConnect"].asInt());
@@ -375,12 +403,95 @@ namespace AstroAir
                 CamThread.detach();
                 break;
             }
+            /*服务器端连续拍摄*/
+            case "RemoteCameraSequence"_hash:{
+                SEQUENCEPLAN Plan;
+                Plan.Count = root["params"]["Count"].asInt();
+                Plan.Exposure = root["params"]["Expo"].asInt();
+                Plan.Bin = root["params"]["Bin"].asInt();
+                Plan.Gain = root["params"]["Gain"].asInt();
+                Plan.Offset = root["params"]["Offset"].asInt();
+                if(root["params"].isMember("FileTemplate"))
+                    Plan.NameTemplate = root["params"]["FileTemplate"].asString();
+                for(auto &it : root["params"]["Filters"])
+                    Plan.Filters.push_back(it.asString());
+                Plan.DitherEvery = root["params"]["DitherEvery"].asInt();
+                if(root["params"].isMember("DitherPixels"))
+                    Plan.DitherPixels = root["params"]["DitherPixels"].asDouble();
+                StartSequence(Plan);
+                break;
+            }
+            case "RemoteSequencePause"_hash:
+                Sequence.Pause();
+                ActionResult("RemoteSequencePause",Sequence.IsRunning());
+                break;
+            case "RemoteSequenceResume"_hash:
+                Sequence.Resume();
+                ActionResult("RemoteSequenceResume",Sequence.IsRunning());
+                break;
+            case "RemoteSequenceAbort"_hash:{
+                /*停止曝光可能阻塞，不能占用消息线程*/
+                std::thread AbortThread(&SEQUENCE::Abort,&Sequence);
+                AbortThread.detach();
+                break;
+            }
             /*相机停止拍摄*/
-            case "RemoteActionAbort"_hash:
-				AbortExposure();
+            case "RemoteActionAbort"_hash:{
+				/*SDK卡死时停止曝光也可能阻塞，不能占用消息线程*/
+				std::thread AbortThread(&WSSERVER::AbortExposure,this);
+				AbortThread.detach();
 				break;
+			}
+            /*相机开始视频采集*/
+            case "RemoteVideoStart"_hash:{
+                std::thread VideoThread(&WSSERVER::StartVideo,this,root["params"]["Expo"].asInt(),root["params"]["Bin"].asInt(),root["params"]["Gain"].asInt(),root["params"]["Offset"].asInt());
+                VideoThread.detach();
+                break;
+            }
+            /*相机高速连拍*/
+            case "RemoteCameraBurst"_hash:{
+                std::thread BurstThread(&WSSERVER::StartBurst,this,root["params"]["Expo"].asInt(),root["params"]["Bin"].asInt(),root["params"]["Gain"].asInt(),root["params"]["Offset"].asInt(),root["params"]["Count"].asInt(),root["params"]["FitFileName"].asString());
+                BurstThread.detach();
+                break;
+            }
+            /*设置相机子画面*/
+            case "RemoteCameraROI"_hash:{
+                std::thread ROIThread(&WSSERVER::SetROI,this,root["params"]["X"].asInt(),root["params"]["Y"].asInt(),root["params"]["Width"].asInt(),root["params"]["Height"].asInt());
+                ROIThread.detach();
+                break;
+            }
+            /*相机停止视频采集*/
+            case "RemoteVideoStop"_hash:{
+                std::thread VideoThread(&WSSERVER::StopVideo,this);
+                VideoThread.detach();
+                break;
+            }
+            /*将视频流录制为SER文件*/
+            case "RemoteVideoRecord"_hash:{
+                std::thread RecordThread(&WSSERVER::StartRecord,this,root["params"]["FileName"].asString(),root["params"]["Direct"].asBool());
+                RecordThread.detach();
+                break;
+            }
+            /*结束录制*/
+            case "RemoteVideoRecordStop"_hash:{
+                std::thread RecordThread(&WSSERVER::StopRecord,this);
+                RecordThread.detach();
+                break;
+            }
+            /*使用缓存的原始帧重新拉伸预览*/
+            case "RemoteImageStretch"_hash:{
+                std::thread StretchThread(&WSSERVER::StretchImage,this,root["params"]["FitFileName"].asString(),root["params"].get("Low",-1).asInt(),root["params"].get("High",-1).asInt(),root["params"]["X"].asInt(),root["params"]["Y"].asInt(),root["params"]["Width"].asInt(),root["params"]["Height"].asInt());
+                StretchThread.detach();
+                break;
+            }
+            /*缓存的原始帧的统计*/
+            case "RemoteImageStats"_hash:{
+                std::thread StatsThread(&WSSERVER::GetImageStats,this,root["params"]["FitFileName"].asString(),root["params"]["X"].asInt(),root["params"]["Y"].asInt(),root["params"]["Width"].asInt(),root["params"]["Height"].asInt());
+                StatsThread.detach();
+                break;
+            }
             case "RemoteCooling"_hash:{
-                std::thread CoolingThread(&WSSERVER::Cooling,this,root["IsSetPoint"].asBool(),root["IsCoolDown"].asBool(),root["IsASync"].asBool(),root["IsWarmup"].asBool(),root["IsCoolerOFF"].asBool());
+                std::thread CoolingThread(&WSSERVER::Cooling,this,root["params"]["IsSetPoint"].asBool(),root["params"]["IsCoolDown"].asBool(),root["params"]["IsASync"].asBool(),root["params"]["IsWarmup"].asBool(),root["params"]["IsCoolerOFF"].asBool(),root["params"]["Temperature"].asDouble(),root["params"].get("Ramp",COOLING_RAMP).asDouble());
                 CoolingThread.detach();
                 break;
             }
@@ -403,11 +514,34 @@ namespace AstroAir
      */
     void WSSERVER::send(std::string message)
     {
+        SendTimed(message,nullptr);
+    }
+
+    /*
+     * name: SendTimed(std::string message,std::vector<int64_t> *Sent)
+     * @param message:需要发送的信息
+     * @param Sent:记录交给每个客户端的单调时钟(纳秒)，可以为空
+     * describe: Send information to every client and note when each one got it
+     * 描述：向所有客户端发送信息并记录时间
+     * note: websocketpp writes asynchronously,the time is when the message entered the connection's queue.
+     *       A client that is not reading skips new messages once its backlog passes the limit,
+     *       the limit is lower when the memory budget is tight.
+     */
+    void WSSERVER::SendTimed(std::string message,std::vector<int64_t> *Sent)
+    {
+        const size_t backlog = MEMBUDGET::Pressure() ? CLIENT_BACKLOG_PRESSURE : CLIENT_BACKLOG_MAX;
         for (auto it : m_connections)
         {
             try
             {
+                if(m_server.get_con_from_hdl(it)->get_buffered_amount() > backlog)
+                {
+                    METRICS::Add("server.throttled_messages");
+                    continue;
+                }
                 m_server.send(it, message, websocketpp::frame::opcode::text);
+                if(Sent != nullptr)
+                    Sent->push_back(MonotonicNs());
             }
             catch (websocketpp::exception const &e)
             {
@@ -422,7 +556,14 @@ namespace AstroAir
         {
             try
             {
+                if(m_server_tls.get_con_from_hdl(it)->get_buffered_amount() > backlog)
+                {
+                    METRICS::Add("server.throttled_messages");
+                    continue;
+                }
                 m_server_tls.send(it, message, websocketpp::frame::opcode::text);
+                if(Sent != nullptr)
+                    Sent->push_back(MonotonicNs());
             }
             catch (websocketpp::exception const &e)
             {
@@ -478,6 +619,7 @@ namespace AstroAir
     {
         try
         {
+            THREADS::Enter(THREADS::ROLE_NETWORK,"air-ws");
             IDLog("Start the server at port %d ...\n",port);
             m_server.listen(websocketpp::lib::asio::ip::tcp::v4(),port);
             m_server.start_accept();
@@ -504,6 +646,7 @@ namespace AstroAir
     {
         try
         {
+            THREADS::Enter(THREADS::ROLE_NETWORK,"air-wss");
             IDLog("Start the wss server at port %d ...\n",port);
             m_server_tls.listen(websocketpp::lib::asio::ip::tcp::v4(),port);
             m_server_tls.start_accept();
@@ -591,6 +734,59 @@ namespace AstroAir
         send(json_messenge);
     }
     
+    /*
+     * name: GetDeviceList()
+     * describe: Send the devices found by the discovery service to the client
+     * 描述：将设备扫描服务发现的设备发送至客户端
+     * calls: DISCOVERY::List()
+     * calls: send()
+     * note: The list comes from the cache,so this never waits for a USB scan
+     */
+    void WSSERVER::GetDeviceList()
+    {
+        std::vector<DeviceInfo> devices = DISCOVERY::List();
+        Json::Value Root;
+        Root["Event"] = Json::Value("RemoteActionResult");
+        Root["UID"] = Json::Value("RemoteGetDeviceList");
+        Root["ActionResultInt"] = Json::Value(4);
+        Root["ParamRet"]["DeviceNumber"] = Json::Value((int)devices.size());
+        for (int i = 0; i < devices.size(); i++)
+        {
+            Root["ParamRet"]["Devices"][i]["brand"] = Json::Value(devices[i].Brand);
+            Root["ParamRet"]["Devices"][i]["name"] = Json::Value(devices[i].Name);
+            Root["ParamRet"]["Devices"][i]["id"] = Json::Value(devices[i].Id);
+        }
+        json_messenge = Root.toStyledString();
+        send(json_messenge);
+    }
+
+    /*
+     * name: GetMetrics()
+     * describe: Send the runtime metrics to the client
+     * 描述：将服务器运行指标发送至客户端
+     * calls: METRICS::All()
+     * calls: send()
+     */
+    void WSSERVER::GetMetrics()
+    {
+        Json::Value Root;
+        Root["Event"] = Json::Value("RemoteActionResult");
+        Root["UID"] = Json::Value("RemoteGetMetrics");
+        Root["ActionResultInt"] = Json::Value(4);
+        for (auto &it : METRICS::All())
+            Root["ParamRet"]["Metrics"][it.first] = Json::Value(it.second);
+        /*直方图的第i个桶统计不大于2^i的值*/
+        for (auto &it : METRICS::Histograms())
+        {
+            Json::Value &buckets = Root["ParamRet"]["Histograms"][it.first];
+            buckets = Json::Value(Json::arrayValue);
+            for (uint64_t count : it.second)
+                buckets.append(Json::Value((Json::UInt64)count));
+        }
+        json_messenge = Root.toStyledString();
+        send(json_messenge);
+    }
+
     /*
      * name: SetupConnect(int timeout)
      * @param timeout:连接相机最长时间
@@ -625,8 +821,22 @@ namespace AstroAir
         /*将读取出的json数组转化为string*/
         std::unique_ptr<Json::CharReader>const json_read(reader.newCharReader());
         json_read->parse(jsonStr.c_str(), jsonStr.c_str() + jsonStr.length(), &root,&errs);
+        /*可选的共享内存帧发布*/
+        const Json::Value &ring = root["server"]["frame_ring"];
+        if(ring.isObject() && ring.get("enabled",false).asBool() == true)
+        {
+            ExportName = ring.get("name",EXPORT_RING_NAME).asString();
+            ExportSlots = std::max(2,ring.get("slots",EXPORT_RING_SLOTS).asInt());
+        }
         bool connect_ok = false;
         auto start = std::chrono::high_resolution_clock::now();
+        #ifdef HAS_PLUGIN
+            /*在后台并行加载配置文件中用到的驱动插件*/
+            PLUGIN::Preload({root["camera"]["brand"].asString(),root["mount"]["brand"].asString(),root["focus"]["brand"].asString(),
+                             root["filter"]["brand"].asString(),root["Guide"]["brand"].asString()});
+        #endif
+        /*优先使用上次保存的设备快照并行恢复连接*/
+        WarmStart();
         /*连接指定品牌的指定型号相机*/
         bool camera_ok = false;
         bool Has_Camera = false;
@@ -635,53 +845,14 @@ namespace AstroAir
         if(!Camera.empty() && !Camera_name.empty())
         {
             Has_Camera = true;
-            for(int i=1;i<=3;i++)
+            camera_ok = isCameraConnected;
+            for(int i=1;i<=3 && camera_ok == false;i++)
             {
-                const char* a = Camera.c_str();
-                switch(hash_(a))
-                {
-                    #ifdef HAS_ASI
-                    {
-                        #if HAS_ASI==ON
-                            case "ZWOASI"_hash:{
-                                /*初始化ASI相机，并赋值CCD*/
-                                ASICCD *ASICamera = new ASICCD();
-                                CCD = ASICamera;
-                                camera_ok = CCD->Connect(Camera_name);
-                                break;
-                            }
-                        #endif
-                    }
-                    #endif
-                    #ifdef HAS_QHY
-                    {
-                        #if HAS_QHY==ON
-                            case "QHYCCD"_hash:{
-                                /*初始化QHY相机，并赋值CCD*/
-                                QHYCCD *QHYCamera = new QHYCCD();
-                                CCD = QHYCamera;
-                                camera_ok = CCD->Connect(Camera_name);
-                                break;
-                            }
-                        #endif
-                    }
-                    #endif
-                    #ifdef HAS_INDI
-                    {
-                        #if HAS_INDI==ON
-                            case "INDI"_hash:{
-                                /*初始化INDI相机，并赋值CCD*/
-                                INDICCD *INDIDevice = new INDICCD();
-                                CCD = INDIDevice;
-                                camera_ok = CCD->Connect(Camera_name);
-                                break;
-                            }
-                        #endif
-                    }
-                    #endif
-                    default:
-                        UnknownDevice(301,"Unknown camera");		//未知相机返回错误信息
-                }
+                /*初始化指定品牌相机，并赋值CCD*/
+                if((CCD = NewDevice(Camera)) == nullptr)
+                    UnknownDevice(301,"Unknown camera");		//未知相机返回错误信息
+                else
+                    camera_ok = CCD->Connect(Camera_name);
                 if(camera_ok == true)
                 {
                     isCameraConnected = true;
@@ -713,7 +884,8 @@ namespace AstroAir
         if(!Mount.empty() && !Mount_name.empty())
         {
             Has_Mount = true;
-            for(int i=1;i<=3;i++)
+            mount_ok = isMountConnected;
+            for(int i=1;i<=3 && mount_ok == false;i++)
             {
                 const char* a = Mount.c_str();
                 switch(hash_(a))
@@ -739,9 +911,8 @@ namespace AstroAir
                     #ifdef HAS_INDI
                     case "INDIMount"_hash:{
 						/*初始化INDI赤道仪，并赋值MOUNT*/
-                        INDICCD *INDIDevice = new INDICCD();
-                        MOUNT = INDIDevice;
-                        mount_ok = MOUNT->Connect(Mount_name);
+                        MOUNT = NewDevice(Mount);
+                        mount_ok = MOUNT != nullptr && MOUNT->Connect(Mount_name);
                         break;
                     }
                     #endif
@@ -778,7 +949,8 @@ namespace AstroAir
         if(!Focus.empty() && !Focus_name.empty())
         {
             Has_Focus = true;
-            for(int i = 0;i<=3;i++)
+            focus_ok = isFocusConnected;
+            for(int i = 0;i<=3 && focus_ok == false;i++)
             {
                 const char* a = Focus.c_str();
                 switch(hash_(a))
@@ -802,9 +974,8 @@ namespace AstroAir
                     #ifdef HAS_INDI
                     case "INDIFocus"_hash:{
 						/*初始化INDI电动调焦座，并赋FOCUS*/
-                        INDICCD *INDIDevice = new INDICCD();
-                        FOCUS = INDIDevice;
-                        focus_ok = FOCUS->Connect(Focus_name);
+                        FOCUS = NewDevice(Focus);
+                        focus_ok = FOCUS != nullptr && FOCUS->Connect(Focus_name);
                         break;
                     }
                     #endif
@@ -841,7 +1012,8 @@ namespace AstroAir
         if(!Filter.empty() && !Filter_name.empty())
         {
             Has_Filter = true;
-            for(int i = 1;i<=3;i++)
+            filter_ok = isFilterConnected;
+            for(int i = 1;i<=3 && filter_ok == false;i++)
             {
                 const char* a = Filter.c_str();
                 switch(hash_(a))
@@ -865,9 +1037,8 @@ namespace AstroAir
                     #ifdef HAS_INDI
                     case "INDIFilter"_hash:{
 						/*初始化INDI滤镜轮，并赋FILTER*/
-                        INDICCD *INDIDevice = new INDICCD();
-                        FILTER = INDIDevice;
-                        filter_ok = FILTER->Connect(Filter_name);
+                        FILTER = NewDevice(Filter);
+                        filter_ok = FILTER != nullptr && FILTER->Connect(Filter_name);
                         break; 
                     }
                     #endif
@@ -904,7 +1075,8 @@ namespace AstroAir
         if(!Guide.empty() && !Guide_name.empty())
         {
             Has_Guide = true;
-            for(int i = 1;i<=3;i++)
+            guide_ok = isGuideConnected;
+            for(int i = 1;i<=3 && guide_ok == false;i++)
             {
                 const char* a = Guide.c_str();
                 switch(hash_(a))
@@ -959,12 +1131,211 @@ namespace AstroAir
         }
         /*判断设备是否完全连接成功*/
         if(connect_ok == true)
+        {
             SetupConnectSuccess();		//将连接上的设备列表发送给客户端
+            SaveSnapshot();
+        }
         else
             SetupConnectError(5);
         return;
     }
     
+    /*
+     * name: NewDevice(std::string Brand)
+     * @param Brand:设备品牌
+     * describe: Create a device for the server
+     * 描述：为服务器创建设备
+     * @return nullptr: Unknown brand
+     * note: Closed source camera SDKs can be hosted in a child process,so that a crash does not take the server down
+     */
+    WSSERVER *WSSERVER::NewDevice(std::string Brand)
+    {
+        WSSERVER *device;
+        if(DRIVERHOST::Enabled() == true && DRIVERHOST::Supported(Brand) == true)
+            device = new DRIVERHOST(Brand);
+        else
+            device = CreateDriver(Brand);
+        /*预览图在驱动的处理线程中生成，由服务器通知客户端*/
+        if(device != nullptr)
+        {
+            device->SetPreviewSink([this](std::string FitsName,const FRAMETIMING &Timing) { newJPGReadySend(FitsName,Timing); });
+            device->SetTelemetrySink([this](const COOLINGSAMPLE &Sample) { CoolingTelemetrySend(Sample); });
+            device->SetFaultSink([this,device](std::string Func,bool Stalled) { DeviceErrorSend(device,Func,Stalled); });
+            if(ExportSlots > 0)
+                device->SetFrameSink([this](const FRAMEHEADER &Header,const unsigned char *Data) { ExportFrame(Header,Data); });
+        }
+        return device;
+    }
+
+    /*
+     * name: CreateDriver(std::string Brand)
+     * @param Brand:设备品牌
+     * describe: Create a device driver by brand
+     * 描述：依据品牌创建设备驱动
+     * @return nullptr: Unknown brand
+     * note: With plugins enabled the driver is loaded on demand
+     */
+    WSSERVER *WSSERVER::CreateDriver(std::string Brand)
+    {
+    #ifdef HAS_PLUGIN
+        return PLUGIN::CreateDevice(Brand);
+    #else
+        const char* a = Brand.c_str();
+        switch(hash_(a))
+        {
+            #ifdef HAS_ASI
+                #if HAS_ASI==ON
+                    case "ZWOASI"_hash:
+                        return new ASICCD();
+                #endif
+            #endif
+            #ifdef HAS_QHY
+                #if HAS_QHY==ON
+                    case "QHYCCD"_hash:
+                        return new QHYCCD();
+                #endif
+            #endif
+            #ifdef HAS_INDI
+                #if HAS_INDI==ON
+                    case "INDI"_hash:
+                    case "INDIMount"_hash:
+                    case "INDIFocus"_hash:
+                    case "INDIFilter"_hash:
+                        return new INDICCD();
+                #endif
+            #endif
+            #ifdef HAS_SIMULATOR
+                #if HAS_SIMULATOR==ON
+                    case "Simulator"_hash:
+                        return new SIMULATORCCD();
+                #endif
+            #endif
+            default:
+                return nullptr;
+        }
+    #endif
+    }
+
+    /*
+     * name: PreloadDrivers()
+     * describe: Make the scan backends of the configured brands available at startup
+     * 描述：启动时注册配置文件中用到品牌的扫描后端
+     * calls: AIRCONFIG::Load()
+     * calls: DRIVERHOST::RegisterScanner()
+     * calls: PLUGIN::Preload()
+     * note: Without this the backends only appear once SetupConnect() loads a driver,
+     *       and hosted drivers only register them in the child,so the device list stays empty
+     */
+    void WSSERVER::PreloadDrivers()
+    {
+        Json::Value config;
+        if(AIRCONFIG::Load(config) == false)
+            return;
+        std::vector<std::string> brands;
+        for(const char *role : {"camera","mount","focus","filter","Guide"})
+        {
+            std::string Brand = config[role]["brand"].asString();
+            if(Brand.empty())
+                continue;
+            /*托管的品牌由扫描进程扫描，服务器中不加载SDK*/
+            if(DRIVERHOST::Enabled() == true && DRIVERHOST::Supported(Brand) == true)
+                DRIVERHOST::RegisterScanner(Brand);
+            else
+                brands.push_back(Brand);
+        }
+        #ifdef HAS_PLUGIN
+            PLUGIN::Preload(brands);
+        #endif
+    }
+
+    /*
+     * name: WarmStart()
+     * describe: Reconnect devices from the last snapshot in parallel
+     * 描述：依据上次保存的设备快照并行重新连接设备并恢复设置
+     * calls: SNAPSHOT::Load()
+     * calls: NewDevice()
+     * calls: QuickConnect()
+     * calls: RestoreState()
+     * note: Only devices whose brand and name still match config.air are restored,
+     *       the others are left to the normal connection process
+     */
+    void WSSERVER::WarmStart()
+    {
+        AIRSNAPSHOT snapshot;
+        if(SNAPSHOT::Load(snapshot) == false)
+            return;
+        auto start = std::chrono::high_resolution_clock::now();
+        const char *roles[5] = {"camera","mount","focus","filter","Guide"};
+        WSSERVER **devices[5] = {&CCD,&MOUNT,&FOCUS,&FILTER,&GUIDE};
+        std::atomic_bool *status[5] = {&isCameraConnected,&isMountConnected,&isFocusConnected,&isFilterConnected,&isGuideConnected};
+        std::future<WSSERVER*> tasks[5];
+        for(int i = 0;i < 5;i++)
+        {
+            auto it = snapshot.find(roles[i]);
+            if(*status[i] == true || it == snapshot.end())
+                continue;
+            const DeviceState state = it->second;
+            if(state.Brand != root[roles[i]]["brand"].asString() || state.Name != root[roles[i]]["name"].asString())
+                continue;
+            /*每个设备在独立线程中连接，互不等待*/
+            tasks[i] = std::async(std::launch::async,[this,state]() -> WSSERVER*
+            {
+                WSSERVER *device = NewDevice(state.Brand);
+                if(device == nullptr || device->QuickConnect(state) == false)
+                {
+                    delete device;
+                    return nullptr;
+                }
+                if(device->RestoreState(state) == false)
+                    IDLog("Unable to restore all settings of %s\n",state.Name.c_str());
+                return device;
+            });
+        }
+        for(int i = 0;i < 5;i++)
+        {
+            if(tasks[i].valid() == false)
+                continue;
+            WSSERVER *device = tasks[i].get();
+            if(device != nullptr)
+            {
+                *devices[i] = device;
+                *status[i] = true;
+                IDLog("Restored %s from snapshot\n",roles[i]);
+            }
+        }
+        LastSnapshot = snapshot;
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> diff = end - start;
+        IDLog("Warm start took %g seconds\n", diff.count());
+    }
+
+    /*
+     * name: SaveSnapshot()
+     * describe: Save the state of all connected devices
+     * 描述：保存所有已连接设备的状态
+     * calls: GetState()
+     * calls: SNAPSHOT::Save()
+     * note: The file is only rewritten when something has changed
+     */
+    void WSSERVER::SaveSnapshot()
+    {
+        lock_guard<mutex> guard(mtx_snapshot);
+        const char *roles[5] = {"camera","mount","focus","filter","Guide"};
+        WSSERVER *devices[5] = {CCD,MOUNT,FOCUS,FILTER,GUIDE};
+        std::atomic_bool *status[5] = {&isCameraConnected,&isMountConnected,&isFocusConnected,&isFilterConnected,&isGuideConnected};
+        AIRSNAPSHOT snapshot;
+        for(int i = 0;i < 5;i++)
+        {
+            DeviceState state;
+            if(*status[i] == true && devices[i] != nullptr && devices[i]->GetState(state) == true)
+                snapshot[roles[i]] = state;
+        }
+        if(snapshot.empty() || snapshot == LastSnapshot)
+            return;
+        if(SNAPSHOT::Save(snapshot) == true)
+            LastSnapshot = snapshot;
+    }
+    
     /*
      * name: Connect(std::string Device_name)
      * @param Device_name:连接相机名称
@@ -1019,7 +1390,6 @@ namespace AstroAir
 		if(isCameraConnected == true)
 		{
 			bool camera_ok = false;
-            Image_Name = FitsName;
 			if ((camera_ok = CCD->StartExposure(exp, bin, IsSave, FitsName, Gain, Offset)) != true)
 			{
 				/*返回曝光错误的原因*/
@@ -1031,7 +1401,7 @@ namespace AstroAir
 			}
 			/*将拍摄成功的消息返回至客户端*/
 			StartExposureSuccess();
-            newJPGReadySend();
+            SaveSnapshot();
 		}
 		else
 		{
@@ -1075,12 +1445,485 @@ namespace AstroAir
         }
         return true;
     }
+
+    /*
+     * name: StartVideo(int exp,int bin,int Gain,int Offset)
+     * @param exp:单帧曝光时间(毫秒)
+     * @param bin:像素合并模式
+     * @param Gain:相机增益
+     * @param Offset:相机偏置
+     * describe: Start streaming video from the camera
+     * 描述：相机开始视频采集
+     * note: Frames are delivered to the frame sink of the camera,not written to files
+     */
+    bool WSSERVER::StartVideo(int exp,int bin,int Gain,int Offset)
+    {
+		if(isCameraConnected == false)
+		{
+			IDLog("Try to start video without a camera\n");
+			VideoResult("RemoteVideoStart",false);
+			return false;
+		}
+		bool camera_ok = CCD->StartVideo(exp,bin,Gain,Offset);
+		VideoResult("RemoteVideoStart",camera_ok);
+		return camera_ok;
+    }
+
+    /*
+     * name: StopVideo()
+     * describe: Stop streaming video
+     * 描述：相机停止视频采集
+     */
+    bool WSSERVER::StopVideo()
+    {
+		if(isCameraConnected == false)
+			return false;
+		bool camera_ok = CCD->StopVideo();
+		VideoResult("RemoteVideoStop",camera_ok);
+		return camera_ok;
+    }
+
+    /*
+     * name: StartRecord(std::string FileName,bool Direct)
+     * @param FileName:SER文件名
+     * @param Direct:是否使用O_DIRECT写入，适合长时间录制到SD卡等慢速存储
+     * describe: Record the video stream to a SER file
+     * 描述：将视频流录制为SER文件
+     * note: Recording ends with StopRecord() or when the video stops
+     */
+    bool WSSERVER::StartRecord(std::string FileName,bool Direct)
+    {
+		if(isCameraConnected == false)
+		{
+			IDLog("Try to record video without a camera\n");
+			ActionResult("RemoteVideoRecord",false);
+			return false;
+		}
+		bool camera_ok = CCD->StartRecord(FileName,Direct);
+		ActionResult("RemoteVideoRecord",camera_ok);
+		return camera_ok;
+    }
+
+    /*
+     * name: StopRecord()
+     * describe: Finish the SER file
+     * 描述：结束视频录制
+     */
+    bool WSSERVER::StopRecord()
+    {
+		if(isCameraConnected == false)
+			return false;
+		bool camera_ok = CCD->StopRecord();
+		VideoResult("RemoteVideoRecordStop",camera_ok);
+		return camera_ok;
+    }
     
-    bool WSSERVER::Cooling(bool SetPoint,bool CoolDown,bool ASync,bool Warmup,bool CoolerOFF)
+    /*
+     * name: StartBurst(int exp,int bin,int Gain,int Offset,int Count,std::string FitsName)
+     * @param exp:单帧曝光时间(毫秒)
+     * @param bin:像素合并模式
+     * @param Gain:相机增益
+     * @param Offset:相机偏置
+     * @param Count:连拍帧数
+     * @param FitsName:保存图像名称，帧序号加在扩展名之前
+     * describe: Capture a burst of frames at the highest rate of the camera
+     * 描述：以相机最高帧率连续拍摄多帧
+     * note: Used for occultation timing and lucky imaging,the reply is sent when the burst is over
+     */
+    bool WSSERVER::StartBurst(int exp,int bin,int Gain,int Offset,int Count,std::string FitsName)
+    {
+		if(isCameraConnected == false)
+		{
+			IDLog("Try to start a burst without a camera\n");
+			ActionResult("RemoteCameraBurst",false);
+			return false;
+		}
+		bool camera_ok = CCD->StartBurst(exp,bin,Gain,Offset,Count,FitsName);
+		ActionResult("RemoteCameraBurst",camera_ok);
+		return camera_ok;
+    }
+
+    /*
+     * name: SetROI(int StartX,int StartY,int Width,int Height)
+     * @param StartX:子画面左上角X坐标(合并后像素)
+     * @param StartY:子画面左上角Y坐标(合并后像素)
+     * @param Width:子画面宽度，为0时拍摄全画面
+     * @param Height:子画面高度，为0时拍摄全画面
+     * describe: Capture only a part of the sensor
+     * 描述：只拍摄传感器的一部分
+     * note: Used by focusing and framing,the subframe stays until it is cleared
+     */
+    bool WSSERVER::SetROI(int StartX,int StartY,int Width,int Height)
+    {
+		if(isCameraConnected == false)
+		{
+			IDLog("Try to set a subframe without a camera\n");
+			ActionResult("RemoteCameraROI",false);
+			return false;
+		}
+		bool camera_ok = CCD->SetROI(StartX,StartY,Width,Height);
+		ActionResult("RemoteCameraROI",camera_ok);
+		if(camera_ok == true)
+			SaveSnapshot();
+		return camera_ok;
+    }
+
+    /*
+     * name: StretchImage(std::string FitsName,int Low,int High,int X,int Y,int Width,int Height)
+     * @param FitsName:图像名称，为空时使用最新一帧
+     * @param Low:黑点(ADU)，小于0时自动确定
+     * @param High:白点(ADU)，小于0时自动确定
+     * @param X,Y,Width,Height:预览的区域，宽高为0时为整帧
+     * describe: Make a new preview from the raw frame kept by the camera
+     * 描述：使用相机缓存的原始帧重新生成预览图
+     * note: The new preview arrives as NewJPGReady,only frames still in the cache can be stretched
+     */
+    bool WSSERVER::StretchImage(std::string FitsName,int Low,int High,int X,int Y,int Width,int Height)
+    {
+		if(isCameraConnected == false)
+		{
+			IDLog("Try to stretch an image without a camera\n");
+			ActionResult("RemoteImageStretch",false);
+			return false;
+		}
+		bool camera_ok = CCD->StretchImage(FitsName,Low,High,X,Y,Width,Height);
+		ActionResult("RemoteImageStretch",camera_ok);
+		return camera_ok;
+    }
+
+    /*
+     * name: ImageStats(std::string FitsName,int X,int Y,int Width,int Height,FRAMESTATS &Stats)
+     * describe: Statistics of the raw frame kept by the camera
+     * 描述：计算相机缓存的原始帧的统计信息
+     */
+    bool WSSERVER::ImageStats(std::string FitsName,int X,int Y,int Width,int Height,FRAMESTATS &Stats)
+    {
+		if(isCameraConnected == false)
+			return false;
+		return CCD->ImageStats(FitsName,X,Y,Width,Height,Stats);
+    }
+
+    /*
+     * name: GetImageStats(std::string FitsName,int X,int Y,int Width,int Height)
+     * @param FitsName:图像名称，为空时使用最新一帧
+     * @param X,Y,Width,Height:统计的区域，宽高为0时为整帧
+     * describe: Send the statistics of a cached frame to the client
+     * 描述：向客户端发送缓存帧的统计信息
+     */
+    void WSSERVER::GetImageStats(std::string FitsName,int X,int Y,int Width,int Height)
+    {
+        FRAMESTATS stats;
+        if(ImageStats(FitsName,X,Y,Width,Height,stats) == false)
+        {
+            ActionResult("RemoteImageStats",false);
+            return;
+        }
+        Json::Value Root;
+        Root["Event"] = Json::Value("ImageStats");
+        Root["File"] = Json::Value(FitsName);
+        StatsToJson(stats,Root["ParamRet"]);
+        send(Root.toStyledString());
+    }
+
+    /*
+     * name: StatsToJson(const FRAMESTATS &Stats,Json::Value &Root)
+     * describe: Convert the statistics of a frame to Json
+     * 描述：将图像统计转换为Json
+     */
+    void WSSERVER::StatsToJson(const FRAMESTATS &Stats,Json::Value &Root)
+    {
+        Root["X"] = Json::Value(Stats.X);
+        Root["Y"] = Json::Value(Stats.Y);
+        Root["Width"] = Json::Value(Stats.Width);
+        Root["Height"] = Json::Value(Stats.Height);
+        Root["Channels"] = Json::Value(Stats.Channels);
+        Root["BitDepth"] = Json::Value(Stats.BitDepth);
+        Root["Min"] = Json::Value(Stats.Min);
+        Root["Max"] = Json::Value(Stats.Max);
+        Root["Mean"] = Json::Value(Stats.Mean);
+        Root["StdDev"] = Json::Value(Stats.StdDev);
+        Root["Histogram"] = Json::Value(Json::arrayValue);
+        for(uint32_t count : Stats.Histogram)
+            Root["Histogram"].append(Json::Value(count));
+    }
+
+    FRAMESTATS WSSERVER::StatsFromJson(const Json::Value &Root)
+    {
+        FRAMESTATS Stats;
+        Stats.X = Root["X"].asUInt();
+        Stats.Y = Root["Y"].asUInt();
+        Stats.Width = Root["Width"].asUInt();
+        Stats.Height = Root["Height"].asUInt();
+        Stats.Channels = Root["Channels"].asUInt();
+        Stats.BitDepth = Root["BitDepth"].asUInt();
+        Stats.Min = Root["Min"].asDouble();
+        Stats.Max = Root["Max"].asDouble();
+        Stats.Mean = Root["Mean"].asDouble();
+        Stats.StdDev = Root["StdDev"].asDouble();
+        for(Json::ArrayIndex i = 0;i < Root["Histogram"].size() && i < Stats.Histogram.size();i++)
+            Stats.Histogram[i] = Root["Histogram"][i].asUInt();
+        return Stats;
+    }
+
+    /*
+     * name: Cooling(bool SetPoint,bool CoolDown,bool ASync,bool Warmup,bool CoolerOFF,double Temperature,double Ramp)
+     * @param SetPoint:直接设置目标温度
+     * @param CoolDown:以Ramp的速度降温到目标温度
+     * @param ASync:不等待到达目标温度
+     * @param Warmup:缓慢回温后关闭制冷
+     * @param CoolerOFF:立即关闭制冷
+     * @param Temperature:目标温度(°C)
+     * @param Ramp:温度变化速度(°C/分钟)
+     * describe: Control the cooler of the camera
+     * 描述：控制相机制冷
+     */
+    bool WSSERVER::Cooling(bool SetPoint,bool CoolDown,bool ASync,bool Warmup,bool CoolerOFF,double Temperature,double Ramp)
+    {
+		if(isCameraConnected == false)
+		{
+			IDLog("Try to control the cooler without a camera\n");
+			ActionResult("RemoteCooling",false);
+			return false;
+		}
+		bool camera_ok = CCD->Cooling(SetPoint,CoolDown,ASync,Warmup,CoolerOFF,Temperature,Ramp);
+		ActionResult("RemoteCooling",camera_ok);
+		if(camera_ok == true)
+			SaveSnapshot();
+		return camera_ok;
+    }
+
+    /*
+     * name: MoveFilter(std::string Filter)
+     * @param Filter:滤镜名称
+     * describe: Move the filter wheel
+     * 描述：切换滤镜
+     * note: Filter wheel drivers should override this
+     */
+    bool WSSERVER::MoveFilter(std::string Filter)
+    {
+        if(isFilterConnected == false)
+        {
+            IDLog("No filter wheel to move to %s\n",Filter.c_str());
+            return false;
+        }
+        return FILTER->MoveFilter(Filter);
+    }
+
+    /*
+     * name: Dither(double Pixels)
+     * @param Pixels:抖动幅度(像素)
+     * describe: Dither the mount through the guider
+     * 描述：通过导星软件抖动
+     * note: Guider drivers should override this,it returns after the guider settled
+     */
+    bool WSSERVER::Dither(double Pixels)
+    {
+        if(isGuideConnected == false)
+        {
+            IDLog("No guider to dither\n");
+            return false;
+        }
+        return GUIDE->Dither(Pixels);
+    }
+
+    /*
+     * name: StartSequence(const SEQUENCEPLAN &Plan)
+     * @param Plan:拍摄计划
+     * describe: Run a batch of exposures on the server
+     * 描述：在服务器端连续拍摄
+     * note: Progress of every frame is sent as SequenceProgress events.
+     *       Plans with filters or dithering are refused,no filter wheel or guider driver implements them yet.
+     */
+    void WSSERVER::StartSequence(const SEQUENCEPLAN &Plan)
+    {
+        if(isCameraConnected == false)
+        {
+            IDLog("Try to start a sequence without a camera\n");
+            ActionResult("RemoteCameraSequence",false,"No camera connected");
+            return;
+        }
+        /*还没有滤镜轮与导星驱动，不能在拍摄中途才失败*/
+        if(Plan.Filters.empty() == false)
+        {
+            IDLog("Filter wheels are not supported in sequences yet\n");
+            ActionResult("RemoteCameraSequence",false,"Filter wheels are not supported in sequences yet");
+            return;
+        }
+        if(Plan.DitherEvery > 0)
+        {
+            IDLog("Dithering is not supported in sequences yet\n");
+            ActionResult("RemoteCameraSequence",false,"Dithering is not supported in sequences yet");
+            return;
+        }
+        SEQUENCEHOOKS Hooks;
+        Hooks.Expose = [this](const SEQUENCEPLAN &Plan,const SEQUENCEFRAME &Frame)
+        {
+            /*驱动在下载完成后返回，保存在流水线中进行，下一帧随即开始*/
+            return CCD->StartExposure(Plan.Exposure,Plan.Bin,true,Frame.FileName,Plan.Gain,Plan.Offset);
+        };
+        Hooks.AbortExposure = [this]() { CCD->AbortExposure(); };
+        Hooks.SetFilter = [this](std::string Filter) { return MoveFilter(Filter); };
+        Hooks.Dither = [this](double Pixels) { return Dither(Pixels); };
+        Hooks.Progress = [this](const SEQUENCEFRAME &Frame,std::string Status) { SequenceProgress(Frame,Status); };
+        bool ok = Sequence.Start(Plan,Hooks);
+        if(ok == false)
+            IDLog("A sequence is already running or the plan is empty\n");
+        ActionResult("RemoteCameraSequence",ok,ok ? "" : "A sequence is already running or the plan is empty");
+    }
+
+    /*
+     * name: QuickConnect(const DeviceState &state)
+     * @param state:上次保存的设备状态
+     * describe: Connect the device without enumerating every bus
+     * 描述：使用保存的设备ID直接连接设备
+     * calls: Connect(std::string Device_name)
+     * note: Drivers which can open a device by ID should override this
+     */
+    bool WSSERVER::QuickConnect(const DeviceState &state)
+    {
+        return Connect(state.Name);
+    }
+
+    /*
+     * name: RestoreState(const DeviceState &state)
+     * @param state:上次保存的设备状态
+     * describe: Restore the settings of the device
+     * 描述：恢复设备设置
+     */
+    bool WSSERVER::RestoreState(const DeviceState &state)
     {
         return true;
     }
 
+    /*
+     * name: GetState(DeviceState &state)
+     * @param state:设备当前状态
+     * describe: Get the current state of the device
+     * 描述：获取设备当前状态
+     * @return false: The device does not support snapshot
+     */
+    bool WSSERVER::GetState(DeviceState &state)
+    {
+        return false;
+    }
+
+    /*
+     * name: SetFrameSink(FRAMESINK Sink)
+     * @param Sink:帧接收者
+     * describe: Receive the frames downloaded by the driver
+     * 描述：接收驱动下载完成的帧
+     * note: Set it before the first exposure,the sink is called on the exposure thread
+     */
+    void WSSERVER::SetFrameSink(FRAMESINK Sink)
+    {
+        FrameSink = Sink;
+    }
+
+    /*
+     * name: PublishFrame(const FRAMEHEADER &Header,const unsigned char *Data)
+     * @param Header:帧信息
+     * @param Data:图像数据
+     * describe: Hand a downloaded frame to the sink
+     * 描述：将下载完成的帧交给接收者
+     * note: The sequence number is filled in here,drivers leave it empty
+     */
+    void WSSERVER::PublishFrame(const FRAMEHEADER &Header,const unsigned char *Data)
+    {
+        if(!FrameSink)
+            return;
+        FRAMEHEADER frame = Header;
+        if(frame.Sequence == 0)
+            frame.Sequence = ++FrameCount;
+        FrameSink(frame,Data);
+    }
+
+    /*
+     * name: ExportFrame(const FRAMEHEADER &Header,const unsigned char *Data)
+     * @param Header:帧信息
+     * @param Data:图像数据
+     * describe: Publish a frame to the shared memory ring for local tools
+     * 描述：将帧写入对外的共享内存环，本机的分析程序可直接读取，无需读取文件
+     * note: The ring is created with the first frame and replaced when a larger frame arrives,
+     *       readers see Closed() on the old one and map the name again
+     */
+    void WSSERVER::ExportFrame(const FRAMEHEADER &Header,const unsigned char *Data)
+    {
+        std::lock_guard<std::mutex> guard(ExportLock);
+        if(ExportRing == nullptr || ExportRing->SlotSize() < Header.Size)
+        {
+            ExportRing = nullptr;
+            if((ExportRing = SHMRING::Create(ExportName,ExportSlots,Header.Size)) != nullptr)
+                IDLog("Frames are published to shared memory %s\n",ExportName.c_str());
+        }
+        if(ExportRing == nullptr || ExportRing->Publish(Header,Data) == false)
+        {
+            METRICS::Add("export.frames_dropped");
+            return;
+        }
+        METRICS::Add("export.frames");
+    }
+
+    /*
+     * name: SetPreviewSink(PREVIEWSINK Sink)
+     * @param Sink:预览图接收者
+     * describe: Receive the previews made by the driver
+     * 描述：接收驱动生成的预览图
+     * note: The sink is called on the preview thread of the driver
+     */
+    void WSSERVER::SetPreviewSink(PREVIEWSINK Sink)
+    {
+        PreviewSink = Sink;
+    }
+
+    /*
+     * name: PreviewReady(std::string FitsName,const FRAMETIMING &Timing)
+     * @param FitsName:图像名称
+     * @param Timing:各阶段时间
+     * describe: Tell the sink that the preview of an image is written
+     * 描述：通知接收者图像的预览图已生成
+     */
+    void WSSERVER::PreviewReady(std::string FitsName,const FRAMETIMING &Timing)
+    {
+        if(PreviewSink)
+            PreviewSink(FitsName,Timing);
+    }
+
+    /*
+     * name: SetTelemetrySink(TELEMETRYSINK Sink)
+     * @param Sink:制冷温度数据接收者
+     * describe: Receive the decimated cooler telemetry of the driver
+     * 描述：接收驱动抽取后的制冷温度数据
+     * note: The sink is called on the cooling thread and must not block
+     */
+    void WSSERVER::SetTelemetrySink(TELEMETRYSINK Sink)
+    {
+        TelemetrySink = Sink;
+    }
+
+    void WSSERVER::TelemetryReady(const COOLINGSAMPLE &Sample)
+    {
+        if(TelemetrySink)
+            TelemetrySink(Sample);
+    }
+
+    /*
+     * name: SetFaultSink(FAULTSINK Sink)
+     * @param Sink:设备卡死与恢复的接收者
+     * describe: Receive the stalls of the vendor SDK reported by the driver
+     * 描述：接收驱动报告的SDK卡死与恢复
+     * note: The sink is called on the SDK or watchdog thread,it must not call into the driver
+     */
+    void WSSERVER::SetFaultSink(FAULTSINK Sink)
+    {
+        FaultSink = Sink;
+    }
+
+    void WSSERVER::DeviceFault(std::string Func,bool Stalled)
+    {
+        if(FaultSink)
+            FaultSink(Func,Stalled);
+    }
+
     /*
      * name: SetupConnectSuccess()
      * describe: Successfully connect device
@@ -1159,6 +2002,71 @@ namespace AstroAir
         send(json_messenge);
 	}
 
+	/*
+	 * name: VideoResult(std::string UID,bool Success)
+	 * @param UID:客户端命令
+	 * @param Success:是否成功
+	 * describe: Send the result of a video command with the statistics of the stream
+	 * 描述：返回视频命令的结果以及视频流统计信息
+	 * calls: METRICS::All()
+	 * calls: send()
+	 */
+	void WSSERVER::VideoResult(std::string UID,bool Success)
+	{
+        Json::Value Root;
+        Root["Event"] = Json::Value("RemoteActionResult");
+        Root["UID"] = Json::Value(UID);
+        Root["ActionResultInt"] = Json::Value(Success ? 4 : 5);
+        for (auto &it : METRICS::All())
+        {
+            if(it.first.compare(0,6,"video.") == 0 || it.first.compare(0,4,"ser.") == 0)
+                Root["ParamRet"][it.first] = Json::Value(it.second);
+        }
+        json_messenge = Root.toStyledString();
+        send(json_messenge);
+	}
+
+	/*
+	 * name: SequenceProgress(const SEQUENCEFRAME &Frame,std::string Status)
+	 * @param Frame:当前帧
+	 * @param Status:Exposing/Done/Paused/Resumed/Finished/Aborted/Failed
+	 * describe: Send the progress of the sequence to the client
+	 * 描述：将序列进度发送给客户端
+	 * note: Called on the sequence thread
+	 */
+	void WSSERVER::SequenceProgress(const SEQUENCEFRAME &Frame,std::string Status)
+	{
+        Json::Value Root;
+        Root["Event"] = Json::Value("SequenceProgress");
+        Root["UID"] = Json::Value("RemoteCameraSequence");
+        Root["Status"] = Json::Value(Status);
+        Root["Index"] = Json::Value(Frame.Index);
+        Root["Total"] = Json::Value(Frame.Total);
+        Root["FileName"] = Json::Value(Frame.FileName);
+        Root["Filter"] = Json::Value(Frame.Filter);
+        Root["IdleMs"] = Json::Value(METRICS::Get("sequence.idle_ms"));
+        send(Root.toStyledString());
+	}
+
+	/*
+	 * name: ActionResult(std::string UID,bool Success,std::string Motive)
+	 * @param UID:客户端命令
+	 * @param Success:是否成功
+	 * @param Motive:失败原因，为空时不发送
+	 * describe: Send the result of a client command
+	 * 描述：返回客户端命令的结果
+	 */
+	void WSSERVER::ActionResult(std::string UID,bool Success,std::string Motive)
+	{
+        Json::Value Root;
+        Root["Event"] = Json::Value("RemoteActionResult");
+        Root["UID"] = Json::Value(UID);
+        Root["ActionResultInt"] = Json::Value(Success ? 4 : 5);
+        if(Motive.empty() == false)
+            Root["Motive"] = Json::Value(Motive);
+        send(Root.toStyledString());
+	}
+
 	/*
 	 * name: StartExposureError()
 	 * describe: Error handling connection to device
@@ -1202,17 +2110,114 @@ namespace AstroAir
     }
     
     /*
-	 * name: newJPGReadySend()
+     * name: CoolingTelemetrySend(const COOLINGSAMPLE &Sample)
+     * @param Sample:抽取后的温度数据
+     * describe: Send the cooler telemetry to the client
+     * 描述：向客户端发送制冷温度数据
+     */
+    void WSSERVER::CoolingTelemetrySend(const COOLINGSAMPLE &Sample)
+    {
+        Json::Value Root;
+        Root["Event"] = Json::Value("CoolingTelemetry");
+        Root["Temperature"] = Json::Value(Sample.Temperature);
+        Root["CoolerPower"] = Json::Value(Sample.Power);
+        Root["CoolerOn"] = Json::Value(Sample.CoolerOn);
+        /*制冷关闭时没有设定温度*/
+        if(Sample.CoolerOn == true)
+            Root["SetPoint"] = Json::Value(Sample.SetPoint);
+        Root["UtcNs"] = Json::Value((Json::Int64)Sample.UtcNs);
+        /*在制冷线程中调用，不使用共享的json_messenge*/
+        std::string message = Root.toStyledString();
+        send(message);
+    }
+
+    /*
+     * name: DeviceErrorSend(WSSERVER *Device,std::string Func,bool Stalled)
+     * @param Device:卡死或恢复的设备
+     * @param Func:卡住的SDK函数
+     * @param Stalled:是否卡死
+     * describe: Tell the client that a device stopped responding,reconnect the camera once its SDK returns
+     * 描述：通知客户端设备无响应，相机SDK恢复后重新连接
+     * note: While stalled every SDK call of the device fails at once,so the dispatcher and the other devices keep going
+     */
+    void WSSERVER::DeviceErrorSend(WSSERVER *Device,std::string Func,bool Stalled)
+    {
+        const char *roles[5] = {"camera","mount","focus","filter","Guide"};
+        WSSERVER *devices[5] = {CCD,MOUNT,FOCUS,FILTER,GUIDE};
+        std::string role = "unknown";
+        for(int i = 0;i < 5;i++)
+            if(devices[i] == Device)
+                role = roles[i];
+        if(Stalled == true)
+        {
+            Json::Value Root;
+            Root["Event"] = Json::Value("DeviceError");
+            Root["Device"] = Json::Value(role);
+            Root["Function"] = Json::Value(Func);
+            Root["Stalled"] = Json::Value(true);
+            /*在SDK线程中调用，不使用共享的json_messenge*/
+            std::string message = Root.toStyledString();
+            send(message);
+            return;
+        }
+        /*SDK返回后句柄可能已经失效，在独立线程中重新连接*/
+        if(Device == CCD && isCameraConnected == true)
+        {
+            std::thread T(&WSSERVER::RecoverCamera,this,Device);
+            T.detach();
+        }
+    }
+
+    /*
+     * name: RecoverCamera(WSSERVER *Device)
+     * @param Device:SDK已恢复的相机
+     * describe: Reconnect the camera with its last settings after a stall
+     * 描述：SDK卡死恢复后使用原有设置重新连接相机
+     * calls: QuickConnect()
+     * calls: RestoreState()
+     */
+    void WSSERVER::RecoverCamera(WSSERVER *Device)
+    {
+        DeviceState state;
+        bool ok = Device->GetState(state) == true;
+        if(ok == true)
+        {
+            /*关闭失败时相机仍算打开，重新打开不会再次占用设备扫描*/
+            if(Device->Disconnect() == false)
+                IDLog("Unable to close the camera after the SDK stalled,reopen it anyway\n");
+            ok = Device->QuickConnect(state) == true && Device->RestoreState(state) == true;
+        }
+        /*重新连接失败时相机保持断开，由客户端处理*/
+        if(ok == false)
+        {
+            isCameraConnected = false;
+            IDLog("Unable to reconnect the camera after the SDK stalled\n");
+        }
+        else
+            IDLog("Reconnected the camera after the SDK stalled\n");
+        Json::Value Root;
+        Root["Event"] = Json::Value("DeviceError");
+        Root["Device"] = Json::Value("camera");
+        Root["Stalled"] = Json::Value(false);
+        Root["Reconnected"] = Json::Value(ok);
+        std::string message = Root.toStyledString();
+        send(message);
+    }
+
+    /*
+	 * name: newJPGReadySend(std::string FitsName,const FRAMETIMING &Timing)
+	 * @param FitsName:图像名称
+	 * @param Timing:各阶段时间
 	 * describe: Send the message that the picture is ready to the client
 	 * 描述：将图片准备就绪的消息传给客户端
-	 * calls: send()
+	 * calls: SendTimed()
      * calls: imread()
+     * calls: FrameLatencySend()
 	 */
-    void WSSERVER::newJPGReadySend()
+    void WSSERVER::newJPGReadySend(std::string FitsName,const FRAMETIMING &Timing)
     {
         /*读取JPG文件并转化为Mat格式*/
-        const char* JPGName = strtok(const_cast<char *>(Image_Name.c_str()),".");
-		strcat(const_cast<char *>(JPGName), ".jpg");
+        std::string JPGName = FitsName.substr(0,FitsName.find('.')) + ".jpg";
         cv::Mat ImageData = cv::imread(JPGName);
         /*组合即将发送的json信息*/
         Json::Value Root;
@@ -1227,11 +2232,59 @@ namespace AstroAir
         Root["StarIndex"] = Json::Value(5);
         Root["HFD"] = Json::Value(1);
         Root["Expo"] = Json::Value(5);
-        Root["TimeInfo"] = Json::Value(100);
+        /*曝光开始的UTC时间(秒)，未知时使用下载完成时间*/
+        const int64_t shot = Timing.ExposureStartNs > 0 ? Timing.ExposureStartNs : Timing.DownloadNs;
+        Root["TimeInfo"] = Json::Value((shot + Timing.UtcOffsetNs) / 1e9);
         Root["Filter"] = Json::Value("** BayerMatrix **");
-        json_messenge = Root.toStyledString();
-        /*发送信息*/
-		send(json_messenge);
+        /*在驱动的预览线程中调用，不使用共享的json_messenge*/
+        std::string message = Root.toStyledString();
+        /*发送信息，并记录交给每个客户端的时间*/
+        std::vector<int64_t> sent;
+		SendTimed(message,&sent);
+        FrameLatencySend(FitsName,Timing,sent);
+    }
+
+    /*
+     * name: FrameLatencySend(std::string FitsName,const FRAMETIMING &Timing,const std::vector<int64_t> &Sent)
+     * @param FitsName:图像名称
+     * @param Timing:各阶段时间
+     * @param Sent:预览消息交给各客户端的时间
+     * describe: Tell the client where the time from command to screen went
+     * 描述：向客户端发送一帧从命令到显示各阶段的耗时
+     * note: Stages are in ms after the first known stage,normally the command,-1 when unknown
+     */
+    void WSSERVER::FrameLatencySend(std::string FitsName,const FRAMETIMING &Timing,const std::vector<int64_t> &Sent)
+    {
+        int64_t base = 0;
+        for(int64_t stage : {Timing.CommandNs,Timing.ExposureStartNs,Timing.DownloadNs})
+        {
+            if(stage > 0)
+            {
+                base = stage;
+                break;
+            }
+        }
+        auto ms = [base](int64_t Stage) { return Stage > 0 && base > 0 ? (Stage - base) / 1e6 : -1.0; };
+        Json::Value Root;
+        Root["Event"] = Json::Value("FrameLatency");
+        Root["File"] = Json::Value(FitsName);
+        Root["UtcNs"] = Json::Value((Json::Int64)(base + Timing.UtcOffsetNs));
+        Root["Command"] = Json::Value(ms(Timing.CommandNs));
+        Root["ExposureStart"] = Json::Value(ms(Timing.ExposureStartNs));
+        Root["ExposureEnd"] = Json::Value(ms(Timing.ExposureEndNs));
+        Root["Download"] = Json::Value(ms(Timing.DownloadNs));
+        Root["FitsWritten"] = Json::Value(ms(Timing.FitsNs));
+        Root["Preview"] = Json::Value(ms(Timing.PreviewNs));
+        Root["Sent"] = Json::Value(Json::arrayValue);
+        for(int64_t ns : Sent)
+            Root["Sent"].append(ms(ns));
+        if(Timing.ExposureEndNs > 0 && Timing.DownloadNs > 0)
+            METRICS::Set("latency.download_ms",(Timing.DownloadNs - Timing.ExposureEndNs) / 1e6);
+        if(Timing.DownloadNs > 0 && Timing.PreviewNs > 0)
+            METRICS::Set("latency.preview_ms",(Timing.PreviewNs - Timing.DownloadNs) / 1e6);
+        if(Timing.CommandNs > 0 && !Sent.empty())
+            METRICS::Set("latency.shot_to_screen_ms",ms(Sent.front()));
+        send(Root.toStyledString());
     }
 
     /*
@@ -51,6 +51,12 @@ Description:Main framework of astroair server
 	#include "libastro.h"
 #endif
 
+#include "snapshot.h"
+#include "frame.h"
+#include "sequence.h"
+#include "cooling.h"
+#include "shmring.h"
+
 #include <string>
 #include <set>
 #include <dirent.h>
@@ -58,6 +64,14 @@ Description:Main framework of astroair server
 #include <chrono>
 #include <atomic>
 #include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#define CLIENT_BACKLOG_MAX (4 << 20)		//客户端未发出的数据超过该值(字节)时不再发给它新消息
+#define CLIENT_BACKLOG_PRESSURE (256 << 10)		//内存紧张时的客户端积压上限(字节)
+#define EXPORT_RING_NAME "/airserver-frames"		//对外发布帧的共享内存名称
+#define EXPORT_RING_SLOTS 8		//对外发布帧的共享内存槽数
 
 #ifdef HAS_WEBSOCKET
 	typedef websocketpp::server<websocketpp::config::asio> airserver;
@@ -80,12 +94,19 @@ Description:Main framework of astroair server
 
 namespace AstroAir
 {
+	/*预览图生成后的接收者，参数为FITS文件名与各阶段时间*/
+	typedef std::function<void(std::string FitsName,const FRAMETIMING &Timing)> PREVIEWSINK;
+	/*抽取后的制冷温度数据的接收者*/
+	typedef std::function<void(const COOLINGSAMPLE &Sample)> TELEMETRYSINK;
+	/*设备SDK卡死(Stalled为真)或恢复的接收者，参数为卡住的SDK函数*/
+	typedef std::function<void(std::string Func,bool Stalled)> FAULTSINK;
+
 	class WSSERVER
 	{
 		public:
 			/*WebSocket服务器主体函数*/
 			explicit WSSERVER();
-			~WSSERVER();
+			virtual ~WSSERVER();
 			virtual void on_open(websocketpp::connection_hdl hdl);
 			virtual void on_open_tls(websocketpp::connection_hdl hdl);
 			virtual void on_close(websocketpp::connection_hdl hdl);
@@ -105,8 +126,55 @@ namespace AstroAir
 			virtual bool Disconnect();
 			virtual bool StartExposure(int exp,int bin,bool IsSave,std::string FitsName,int Gain,int Offset);
 			virtual bool AbortExposure();
-			virtual bool Cooling(bool SetPoint,bool CoolDown,bool ASync,bool Warmup,bool CoolerOFF);
+			/*视频采集*/
+			virtual bool StartVideo(int exp,int bin,int Gain,int Offset);
+			virtual bool StopVideo();
+			/*将视频流录制为SER文件，Direct为真时使用O_DIRECT写入*/
+			virtual bool StartRecord(std::string FileName,bool Direct);
+			virtual bool StopRecord();
+			/*高速连拍，Count帧依次保存为FitsName_0001.fits等*/
+			virtual bool StartBurst(int exp,int bin,int Gain,int Offset,int Count,std::string FitsName);
+			/*设置子画面，宽高为0时拍摄全画面*/
+			virtual bool SetROI(int StartX,int StartY,int Width,int Height);
+			/*制冷控制，Ramp为温度变化速度(°C/分钟)*/
+			virtual bool Cooling(bool SetPoint,bool CoolDown,bool ASync,bool Warmup,bool CoolerOFF,double Temperature,double Ramp);
+			/*使用缓存的原始帧重新拉伸预览，Low与High为黑点与白点(ADU)，宽高为0时为整帧*/
+			virtual bool StretchImage(std::string FitsName,int Low,int High,int X,int Y,int Width,int Height);
+			/*缓存的原始帧的统计*/
+			virtual bool ImageStats(std::string FitsName,int X,int Y,int Width,int Height,FRAMESTATS &Stats);
+			/*序列中使用的滤镜与导星接口*/
+			virtual bool MoveFilter(std::string Filter);
+			virtual bool Dither(double Pixels);
+			/*快照恢复相关函数*/
+			virtual bool QuickConnect(const DeviceState &state);
+			virtual bool RestoreState(const DeviceState &state);
+			virtual bool GetState(DeviceState &state);
+			/*设置下载完成的帧的接收者*/
+			void SetFrameSink(FRAMESINK Sink);
+			/*设置预览图生成后的接收者*/
+			void SetPreviewSink(PREVIEWSINK Sink);
+			/*设置制冷温度数据的接收者*/
+			void SetTelemetrySink(TELEMETRYSINK Sink);
+			/*设置设备卡死与恢复的接收者*/
+			void SetFaultSink(FAULTSINK Sink);
+			/*依据品牌创建设备驱动*/
+			static WSSERVER *CreateDriver(std::string Brand);
+			/*启动时加载配置文件中用到的驱动，设备列表在连接前即可用*/
+			static void PreloadDrivers();
+			/*图像统计与Json互相转换*/
+			static void StatsToJson(const FRAMESTATS &Stats,Json::Value &Root);
+			static FRAMESTATS StatsFromJson(const Json::Value &Root);
 		protected:
+			/*驱动下载完成一帧后调用*/
+			void PublishFrame(const FRAMEHEADER &Header,const unsigned char *Data);
+			/*驱动生成预览图后调用*/
+			void PreviewReady(std::string FitsName,const FRAMETIMING &Timing);
+			/*驱动采集到制冷温度数据后调用*/
+			void TelemetryReady(const COOLINGSAMPLE &Sample);
+			/*驱动的SDK卡死或恢复时调用*/
+			void DeviceFault(std::string Func,bool Stalled);
+			/*将帧写入对外的共享内存环，供同一台机器上的分析程序读取*/
+			void ExportFrame(const FRAMEHEADER &Header,const unsigned char *Data);
 			/*转化Json信息*/
 			void readJson(std::string message);
 			/*获取密码*/
@@ -114,12 +182,32 @@ namespace AstroAir
 			/*WebSocket服务器功能性函数*/
 			void SetDashBoardMode();
 			void GetAstroAirProfiles();
+			void GetDeviceList();
+			/*返回运行指标*/
+			void GetMetrics();
 			void SetupConnect(int timeout);
+			WSSERVER *NewDevice(std::string Brand);
+			void WarmStart();
+			void SaveSnapshot();
 			/*处理正确返回信息*/
 			void SetupConnectSuccess();
 			void StartExposureSuccess();
 			void AbortExposureSuccess();
-			void newJPGReadySend();
+			void newJPGReadySend(std::string FitsName,const FRAMETIMING &Timing);
+			void FrameLatencySend(std::string FitsName,const FRAMETIMING &Timing,const std::vector<int64_t> &Sent);
+			/*发送信息并记录交给每个客户端的时间*/
+			void SendTimed(std::string message,std::vector<int64_t> *Sent);
+			void VideoResult(std::string UID,bool Success);
+			void CoolingTelemetrySend(const COOLINGSAMPLE &Sample);
+			/*通知客户端设备卡死，SDK恢复后重新连接相机*/
+			void DeviceErrorSend(WSSERVER *Device,std::string Func,bool Stalled);
+			void RecoverCamera(WSSERVER *Device);
+			/*在服务器端计算并返回缓存帧的统计*/
+			void GetImageStats(std::string FitsName,int X,int Y,int Width,int Height);
+			/*服务器端拍摄序列*/
+			void StartSequence(const SEQUENCEPLAN &Plan);
+			void SequenceProgress(const SEQUENCEFRAME &Frame,std::string Status);
+			void ActionResult(std::string UID,bool Success,std::string Motive = "");
 			/*处理错误信息函数*/
 			void SetupConnectError(int id);
 			void StartExposureError();
@@ -132,7 +220,7 @@ namespace AstroAir
 			Json::Value root;
 			Json::String errs;
 			Json::CharReaderBuilder reader;
-			std::string method,json_messenge,Image_Name;
+			std::string method,json_messenge;
 			std::string Camera,Mount,Focus,Filter,Guide;
 			std::string Camera_name,Mount_name,Focus_name,Filter_name,Guide_name;
 			typedef std::set<websocketpp::connection_hdl, std::owner_less<websocketpp::connection_hdl>> con_list;
@@ -140,10 +228,24 @@ namespace AstroAir
 			con_list m_connections_tls;
 			airserver m_server;
 			airserver_tls m_server_tls;
-			mutex mtx,mtx_action;
+			mutex mtx,mtx_action,mtx_snapshot;
 			condition_variable m_server_cond,m_server_action;
 			/*定义服务器设备参数*/
 			WSSERVER *CCD,*MOUNT,*FOCUS,*FILTER,*GUIDE;
+			/*上次写入的设备快照*/
+			AIRSNAPSHOT LastSnapshot;
+			FRAMESINK FrameSink;
+			PREVIEWSINK PreviewSink;
+			TELEMETRYSINK TelemetrySink;
+			FAULTSINK FaultSink;
+			/*服务器端拍摄序列*/
+			SEQUENCE Sequence;
+			std::atomic<uint64_t> FrameCount{0};
+			/*对外发布帧的共享内存环，槽数为0时不发布*/
+			std::string ExportName = EXPORT_RING_NAME;
+			int ExportSlots = 0;
+			std::mutex ExportLock;
+			std::unique_ptr<SHMRING> ExportRing;
 
 			/*服务器设备连接状态参数*/
 			std::atomic_bool isConnected;
@@ -0,0 +1,98 @@
+/*
+ * bench_ser.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Throughput of the SER writer
+
+**************************************************/
+
+#include <chrono>
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "frame.h"
+#include "serwriter.h"
+
+using namespace AstroAir;
+
+/*
+ * Usage: bench_ser [file] [frames] [direct]
+ * Writes frames of 1920x1080 16 bit to the file and prints the sustained
+ * rate. Run it on the disk used for recordings,with and without O_DIRECT.
+ */
+int main(int argc,char *argv[])
+{
+	std::string file = argc > 1 ? argv[1] : "bench.ser";
+	const int frames = argc > 2 ? atoi(argv[2]) : 500;
+	const bool direct = argc > 3 && atoi(argv[3]) != 0;
+	FRAMEHEADER Header;
+	Header.Width = 1920;
+	Header.Height = 1080;
+	Header.BitDepth = 16;
+	Header.Channels = 1;
+	Header.Size = (uint64_t)Header.Width * Header.Height * 2;
+	/*每帧内容不同，避免文件系统对全零数据的优化*/
+	std::vector<unsigned char> data(Header.Size);
+	for(size_t i = 0;i < data.size();i++)
+		data[i] = (unsigned char)(i * 131 + 7);
+	SERWRITER Writer("bench");
+	if(Writer.Open(file,Header,"","bench_ser",direct) == false)
+	{
+		fprintf(stderr,"Unable to open %s\n",file.c_str());
+		return 1;
+	}
+	auto start = std::chrono::steady_clock::now();
+	for(int i = 0;i < frames;i++)
+	{
+		Header.Sequence = i;
+		Header.MonotonicNs = MonotonicNs();
+		Header.UtcNs = UtcNs();
+		memcpy(data.data(),&i,sizeof(i));
+		if(Writer.Write(Header,data.data()) == false)
+		{
+			fprintf(stderr,"Write failed at frame %d\n",i);
+			return 1;
+		}
+	}
+	bool ok = Writer.Close();
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	struct stat st;
+	const uint64_t expected = SER_HEADER_SIZE + (uint64_t)frames * (Header.Size + 8);
+	if(ok == false || stat(file.c_str(),&st) != 0 || (uint64_t)st.st_size != expected)
+	{
+		fprintf(stderr,"%s is incomplete\n",file.c_str());
+		return 1;
+	}
+	const double mb = (double)frames * Header.Size / (1 << 20);
+	printf("%d frames,%.0f MB in %.2f s: %.0f MB/s,%.1f fps%s\n",frames,mb,elapsed.count(),mb / elapsed.count(),frames / elapsed.count(),direct ? " (O_DIRECT)" : "");
+	return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ * bench_shmring.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Latency of the shared memory frame ring
+
+**************************************************/
+
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "frame.h"
+#include "shmring.h"
+
+using namespace AstroAir;
+
+/*每帧从下载完成到接收者拿到数据的延迟(微秒)*/
+static void Report(const char *Name,std::vector<double> &Latency)
+{
+	std::sort(Latency.begin(),Latency.end());
+	double sum = 0;
+	for(double value : Latency)
+		sum += value;
+	printf("%-8s mean %8.1f us,p50 %8.1f us,p99 %8.1f us,max %8.1f us\n",Name,sum / Latency.size(),
+		   Latency[Latency.size() / 2],Latency[Latency.size() * 99 / 100],Latency.back());
+}
+
+/*
+ * Usage: bench_shmring [frames] [width] [height]
+ * Hands frames of 16 bit to a frame sink twice: once by calling the sink
+ * directly,as an in-process driver does,and once through SHMRING::Publish()
+ * and Read() on two mappings of the ring,as a hosted driver does. The
+ * difference is the cost of running the driver in a child process.
+ */
+int main(int argc,char *argv[])
+{
+	const int frames = argc > 1 ? atoi(argv[1]) : 500;
+	FRAMEHEADER Header;
+	Header.Width = argc > 2 ? atoi(argv[2]) : 1920;
+	Header.Height = argc > 3 ? atoi(argv[3]) : 1080;
+	Header.BitDepth = 16;
+	Header.Channels = 1;
+	Header.Size = (uint64_t)Header.Width * Header.Height * 2;
+	std::vector<unsigned char> data(Header.Size);
+	for(size_t i = 0;i < data.size();i++)
+		data[i] = (unsigned char)(i * 131 + 7);
+	/*接收者读取首尾字节，确保数据确实可以访问*/
+	uint64_t checksum = 0;
+	int64_t received = 0;
+	FRAMESINK Sink = [&](const FRAMEHEADER &Frame,const unsigned char *Data)
+	{
+		checksum += Data[0] + Data[Frame.Size - 1];
+		received = MonotonicNs();
+	};
+	std::vector<double> direct,ring;
+	for(int i = 0;i < frames;i++)
+	{
+		Header.Sequence = i;
+		Header.MonotonicNs = MonotonicNs();
+		Sink(Header,data.data());
+		direct.push_back((received - Header.MonotonicNs) / 1e3);
+	}
+	std::string name = "/bench-shmring-" + std::to_string(getpid());
+	std::unique_ptr<SHMRING> Writer = SHMRING::Create(name,4,Header.Size);
+	std::unique_ptr<SHMRING> Reader = Writer != nullptr ? SHMRING::Open(name) : nullptr;
+	if(Reader == nullptr)
+	{
+		fprintf(stderr,"Unable to map the frame ring %s\n",name.c_str());
+		return 1;
+	}
+	for(int i = 0;i < frames;i++)
+	{
+		Header.Sequence = i;
+		Header.MonotonicNs = MonotonicNs();
+		memcpy(data.data(),&i,sizeof(i));
+		FRAMEHEADER Frame;
+		const unsigned char *Data;
+		if(Writer->Publish(Header,data.data()) == false || Reader->Read(Writer->Written() - 1,Frame,Data) == false)
+		{
+			fprintf(stderr,"Frame %d was lost\n",i);
+			return 1;
+		}
+		Sink(Frame,Data);
+		if(Reader->Valid(Writer->Written() - 1) == false || Frame.Sequence != (uint64_t)i)
+		{
+			fprintf(stderr,"Frame %d was overwritten while reading\n",i);
+			return 1;
+		}
+		ring.push_back((received - Header.MonotonicNs) / 1e3);
+	}
+	Writer->Unlink();
+	printf("%d frames of %dx%d 16 bit (%.1f MB),checksum %llu\n",frames,Header.Width,Header.Height,
+		   Header.Size / 1048576.0,(unsigned long long)checksum);
+	Report("direct",direct);
+	Report("shmring",ring);
+	return 0;
+}
@@ -0,0 +1,54 @@
+/*
+ * test.h
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Minimal checks shared by the tests
+
+**************************************************/
+
+#pragma once
+
+#ifndef _TEST_H_
+#define _TEST_H_
+
+#include <stdio.h>
+
+/*测试失败的数量，由main()返回*/
+static int TestFailed = 0;
+
+/*检查条件，失败时输出位置但继续运行*/
+#define CHECK(cond) \
+	do { \
+		if(!(cond)) \
+		{ \
+			fprintf(stderr,"%s:%d: CHECK(%s) failed\n",__FILE__,__LINE__,#cond); \
+			TestFailed++; \
+		} \
+	} while(0)
+
+#endif
@@ -0,0 +1,89 @@
+/*
+ * test_abort.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Abort latency of the simulated camera
+
+**************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "test.h"
+#include "metrics.h"
+#include "air-sim/sim_ccd.h"
+
+using namespace AstroAir;
+
+typedef std::chrono::steady_clock Clock;
+
+static double Ms(Clock::time_point Start,Clock::time_point End)
+{
+	return std::chrono::duration<double,std::milli>(End - Start).count();
+}
+
+/*开始Exposure秒的曝光，Delay毫秒后停止，检查停止在CAPTURE_ABORT_WAIT内完成*/
+static void AbortAfter(SIMULATORCCD &Camera,int Exposure,int Delay)
+{
+	std::atomic<bool> result{true};
+	Clock::time_point returned;
+	std::thread capture([&]()
+	{
+		result = Camera.StartExposure(Exposure,1,false,"",0,0);
+		returned = Clock::now();
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(Delay));
+	auto start = Clock::now();
+	bool ok = Camera.AbortExposure();
+	auto acknowledged = Clock::now();
+	capture.join();
+	fprintf(stderr,"%d s exposure: abort acknowledged in %.1f ms,capture returned after %.1f ms\n",Exposure,Ms(start,acknowledged),Ms(start,returned));
+	CHECK(ok == true);
+	CHECK(result == false);
+	CHECK(Ms(start,acknowledged) < CAPTURE_ABORT_WAIT);
+	CHECK(Ms(start,returned) < CAPTURE_ABORT_WAIT);
+	CHECK(METRICS::Get("exposure.abort_ms." SIM_BRAND) < CAPTURE_ABORT_WAIT);
+}
+
+int main()
+{
+	SIMULATORCCD Camera;
+	CHECK(Camera.Connect(SIM_DEVICE_NAME) == true);
+	/*停止延迟与曝光时间无关*/
+	AbortAfter(Camera,2,200);
+	AbortAfter(Camera,60,500);
+	AbortAfter(Camera,3600,50);
+	CHECK(METRICS::Get("exposure.aborted") == 3);
+	CHECK(METRICS::Get("exposure.abort_slow") == 0);
+	/*停止后相机可以继续拍摄*/
+	CHECK(Camera.StartExposure(1,1,false,"",0,0) == true);
+	CHECK(Camera.AbortExposure() == true);
+	Camera.Disconnect();
+	return TestFailed == 0 ? 0 : 1;
+}
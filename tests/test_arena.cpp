@@ -0,0 +1,101 @@
+/*
+ * test_arena.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Scratch arenas in the processing pipeline
+
+**************************************************/
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <string.h>
+
+#include "test.h"
+#include "metrics.h"
+#include "arena.h"
+#include "pipeline.h"
+
+using namespace AstroAir;
+
+#define FRAMES 50
+#define WIDTH 1024
+#define HEIGHT 768
+
+/*第一帧之后所有阶段的暂存内存都应来自暂存池*/
+static std::atomic<int> Spills(0);
+static std::atomic<int> Misaligned(0);
+
+/*模拟一个阶段，从暂存区取Bytes字节并写满*/
+static void Stage(std::shared_ptr<FRAMEJOB> Job,size_t Bytes)
+{
+	unsigned char *scratch = static_cast<unsigned char *>(Job->Arena.Allocate(Bytes));
+	if(scratch == nullptr)
+	{
+		if(Job->Header.Sequence > 0)
+			Spills++;
+		return;
+	}
+	if((uintptr_t)scratch % ARENA_ALIGN != 0)
+		Misaligned++;
+	memset(scratch,(int)Job->Header.Sequence,Bytes);
+}
+
+int main()
+{
+	ARENAPOOL Scratch("test");
+	{
+		PIPELINE Pipeline("test");
+		/*与相机相同的三个阶段：FITS、预览与分析*/
+		Pipeline.AddStage("fits",[](std::shared_ptr<FRAMEJOB> Job) { Stage(Job,WIDTH * HEIGHT * 2); });
+		Pipeline.AddStage("preview",[](std::shared_ptr<FRAMEJOB> Job)
+		{
+			Stage(Job,WIDTH * HEIGHT);
+			Stage(Job,WIDTH * HEIGHT * 3);
+		});
+		Pipeline.AddStage("analyse",[](std::shared_ptr<FRAMEJOB> Job) { Stage(Job,256 * sizeof(uint64_t)); });
+		for(int i = 0;i < FRAMES;i++)
+		{
+			auto job = std::make_shared<FRAMEJOB>();
+			job->Header.Sequence = i;
+			job->Arena.Bind(Scratch);
+			Pipeline.Submit(job);
+			/*第一帧归还后暂存池才知道每帧需要多少内存*/
+			if(i == 0)
+				Pipeline.Drain();
+		}
+		Pipeline.Drain();
+	}
+	/*只有第一帧超出暂存区，暂存区的数量取决于同时处理的帧数，不随帧数增长*/
+	fprintf(stderr,"%g overflows,%g pool allocations for %d frames\n",METRICS::Get("arena.overflows"),METRICS::Get("framepool.allocations"),FRAMES);
+	CHECK(Spills == 0);
+	CHECK(Misaligned == 0);
+	CHECK(METRICS::Get("arena.overflows") <= 4);
+	CHECK(METRICS::Get("framepool.allocations") < FRAMES / 2);
+	return TestFailed == 0 ? 0 : 1;
+}
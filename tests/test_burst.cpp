@@ -0,0 +1,106 @@
+/*
+ * test_burst.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Burst capture of the simulated camera
+
+**************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "metrics.h"
+#include "air-sim/sim_ccd.h"
+
+using namespace AstroAir;
+
+typedef std::chrono::steady_clock Clock;
+
+#define BURST_EXPOSURE 10		//单帧曝光(毫秒)，子画面很小，帧率由曝光决定
+#define BURST_FRAMES 20
+
+static double Ms(Clock::time_point Start,Clock::time_point End)
+{
+	return std::chrono::duration<double,std::milli>(End - Start).count();
+}
+
+int main()
+{
+	char dir[] = "/tmp/test_burst_XXXXXX";
+	CHECK(mkdtemp(dir) != nullptr);
+	const std::string name = std::string(dir) + "/Burst.fits";
+	SIMULATORCCD Camera;
+	CHECK(Camera.Connect(SIM_DEVICE_NAME) == true);
+	CHECK(Camera.SetROI(0,0,320,240) == true);
+	/*全部帧按曝光时间连续拍完*/
+	double frames = METRICS::Get("burst.frames");
+	CHECK(Camera.StartBurst(BURST_EXPOSURE,1,0,0,BURST_FRAMES,name) == true);
+	const double fps = METRICS::Get("burst.fps");
+	fprintf(stderr,"burst of %d frames at %.1f fps\n",BURST_FRAMES,fps);
+	CHECK(METRICS::Get("burst.frames") - frames == BURST_FRAMES);
+	CHECK(fps > 1000.0 / BURST_EXPOSURE * 0.7 && fps < 1000.0 / BURST_EXPOSURE * 1.1);
+	/*帧数超出范围或相机忙时拒绝*/
+	CHECK(Camera.StartBurst(BURST_EXPOSURE,1,0,0,0,name) == false);
+	CHECK(Camera.StartBurst(BURST_EXPOSURE,1,0,0,SIM_BURST_MAX_FRAMES + 1,name) == false);
+	/*停止曝光结束连拍，已拍到的帧保留*/
+	frames = METRICS::Get("burst.frames");
+	const double dropped = METRICS::Get("burst.dropped");
+	std::atomic<bool> result{true};
+	Clock::time_point returned;
+	std::thread burst([&]()
+	{
+		result = Camera.StartBurst(50,1,0,0,200,std::string(dir) + "/Aborted.fits");
+		returned = Clock::now();
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(300));
+	auto start = Clock::now();
+	CHECK(Camera.AbortExposure() == true);
+	burst.join();
+	const double taken = METRICS::Get("burst.frames") - frames;
+	fprintf(stderr,"aborted burst returned after %.1f ms with %.0f frames\n",Ms(start,returned),taken);
+	CHECK(result == false);
+	CHECK(Ms(start,returned) < CAPTURE_ABORT_WAIT);
+	CHECK(taken >= 3 && taken <= 7);
+	CHECK(METRICS::Get("burst.dropped") - dropped == 200 - taken);
+	/*断开时等待流水线写完全部文件*/
+	CHECK(Camera.Disconnect() == true);
+	for(int i = 1;i <= BURST_FRAMES;i++)
+	{
+		char file[64];
+		snprintf(file,sizeof(file),"/Burst_%04d.fits",i);
+		CHECK(access((std::string(dir) + file).c_str(),F_OK) == 0);
+	}
+	std::string command = std::string("rm -rf ") + dir;
+	system(command.c_str());
+	return TestFailed == 0 ? 0 : 1;
+}
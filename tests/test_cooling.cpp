@@ -0,0 +1,97 @@
+/*
+ * test_cooling.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Cooling controller against a fake cooler
+
+**************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <thread>
+
+#include "test.h"
+#include "cooling.h"
+
+using namespace AstroAir;
+
+/*模拟的制冷相机，传感器温度立即跟上设定温度*/
+static std::mutex Lock;
+static double Temperature = 20;
+static double SetPoint = NAN;
+static std::atomic<int> Reads(0);
+
+static bool FakeRead(double &Value,double &Power)
+{
+	std::lock_guard<std::mutex> guard(Lock);
+	Reads++;
+	Value = Temperature;
+	Power = std::isnan(SetPoint) ? 0 : 50;
+	return true;
+}
+
+static bool FakeWrite(bool Enable,double Value)
+{
+	std::lock_guard<std::mutex> guard(Lock);
+	SetPoint = Enable ? Value : NAN;
+	if(Enable == true)
+		Temperature = Value;
+	return true;
+}
+
+int main()
+{
+	int Id = COOLING::Register("FAKE",FakeRead,FakeWrite,nullptr);
+	CHECK(Id > 0);
+	auto start = std::chrono::steady_clock::now();
+	/*每°C/秒，重复的命令不能让采样变快，也不能让温度变化变快*/
+	for(int i = 0;i < 5;i++)
+	{
+		CHECK(COOLING::SetTarget(Id,0,60) == true);
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+	std::this_thread::sleep_until(start + std::chrono::milliseconds(3500));
+	const int reads = Reads;
+	double setpoint;
+	{
+		std::lock_guard<std::mutex> guard(Lock);
+		setpoint = SetPoint;
+	}
+	COOLING::Unregister(Id);
+	/*注册与5次命令各执行一次，之后每秒一次*/
+	fprintf(stderr,"%d samples,setpoint %.2f after 3.5 s\n",reads,setpoint);
+	CHECK(reads >= 7 && reads <= 11);
+	/*设定温度从20°C开始，3.5秒内最多下降3.5°C*/
+	CHECK(setpoint >= 16.4 && setpoint <= 17.2);
+	/*注销后不再采样*/
+	std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+	CHECK(Reads == reads);
+	return TestFailed == 0 ? 0 : 1;
+}
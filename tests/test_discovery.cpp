@@ -0,0 +1,89 @@
+/*
+ * test_discovery.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Discovery service against a simulated backend
+
+**************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "test.h"
+#include "discovery.h"
+
+using namespace AstroAir;
+
+/*模拟的扫描后端，记录被调用的次数*/
+static std::atomic<int> Scans(0);
+
+static std::vector<DeviceInfo> FakeScan()
+{
+	Scans++;
+	DeviceInfo info;
+	info.Brand = "FAKE";
+	info.Name = "Fake Camera";
+	info.Index = 0;
+	info.MaxWidth = 640;
+	info.MaxHeight = 480;
+	return {info};
+}
+
+/*等待扫描次数达到Count，超时返回false*/
+static bool WaitScans(int Count,int Ms)
+{
+	auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(Ms);
+	while(Scans < Count && std::chrono::steady_clock::now() < end)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	return Scans >= Count;
+}
+
+int main()
+{
+	DISCOVERY::RegisterBackend("FAKE",FakeScan);
+	/*设备打开时后台不应扫描*/
+	DISCOVERY::Hold("FAKE");
+	DISCOVERY::Start(1);
+	std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+	CHECK(Scans == 0);
+	CHECK(DISCOVERY::List().empty());
+	/*驱动自己仍然可以扫描*/
+	DISCOVERY::ScanNow("FAKE");
+	CHECK(Scans == 1);
+	DeviceInfo info;
+	CHECK(DISCOVERY::Find("FAKE","Fake Camera",info) == true);
+	CHECK(info.MaxWidth == 640);
+	/*关闭设备后执行推迟的定时扫描*/
+	std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+	CHECK(Scans == 1);
+	DISCOVERY::Release("FAKE");
+	CHECK(WaitScans(2,1000) == true);
+	DISCOVERY::Stop();
+	return TestFailed == 0 ? 0 : 1;
+}
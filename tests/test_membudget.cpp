@@ -0,0 +1,101 @@
+/*
+ * test_membudget.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Degrading under the memory budget
+
+**************************************************/
+
+#include <chrono>
+#include <thread>
+
+#include "test.h"
+#include "metrics.h"
+#include "membudget.h"
+#include "framepool.h"
+
+using namespace AstroAir;
+
+typedef std::chrono::steady_clock Clock;
+
+#define MB ((size_t)1 << 20)
+#define LIMIT (10 * MB)
+#define FRAME (3 * MB)
+
+int main()
+{
+	MEMBUDGET::SetLimit(LIMIT);
+	/*可选用途只能使用预算的MEMBUDGET_OPTIONAL，帧缓冲区可以用满*/
+	CHECK(MEMBUDGET::Reserve(7 * MB,true) == true);
+	CHECK(MEMBUDGET::Reserve(2 * MB,true) == false);
+	CHECK(MEMBUDGET::Pressure() == false);
+	CHECK(MEMBUDGET::Reserve(1 * MB,true) == true);
+	CHECK(MEMBUDGET::Pressure() == true);
+	CHECK(MEMBUDGET::Reserve(2 * MB) == true);
+	CHECK(MEMBUDGET::Reserve(1) == false);
+	MEMBUDGET::Release(10 * MB);
+	CHECK(MEMBUDGET::Used() == 0);
+	{
+		/*预算只够三个缓冲区时少保留一个*/
+		FRAMEPOOL Pool("test");
+		Pool.Reserve(FRAME,4);
+		CHECK(Pool.Available() == 3);
+		CHECK(MEMBUDGET::Used() == 3 * FRAME);
+		/*预算用完时先丢弃缓存的旧帧，缓冲区回到缓冲池*/
+		FRAMEBUFFER cached = Pool.Acquire(FRAME);
+		FRAMEBUFFER first = Pool.Acquire(FRAME);
+		FRAMEBUFFER second = Pool.Acquire(FRAME);
+		int id = MEMBUDGET::AddReclaimer([&cached]() { cached = nullptr; });
+		const double reclaims = METRICS::Get("membudget.reclaims");
+		FRAMEBUFFER third = Pool.Acquire(FRAME);
+		CHECK(third != nullptr);
+		CHECK(cached == nullptr);
+		CHECK(METRICS::Get("membudget.reclaims") - reclaims == 1);
+		CHECK(MEMBUDGET::Used() <= LIMIT);
+		/*没有可丢弃的缓存时等待其他帧处理完归还，不超出预算*/
+		const double waits = METRICS::Get("framepool.budget_waits");
+		std::thread done([&first]()
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(300));
+			first = nullptr;
+		});
+		auto start = Clock::now();
+		FRAMEBUFFER fourth = Pool.Acquire(FRAME);
+		double waited = std::chrono::duration<double,std::milli>(Clock::now() - start).count();
+		done.join();
+		fprintf(stderr,"waited %.0f ms for a buffer,%.0f MB of %zu MB used\n",waited,MEMBUDGET::Used() / (double)MB,LIMIT / MB);
+		CHECK(fourth != nullptr);
+		CHECK(waited >= 250 && waited < FRAMEPOOL_WAIT);
+		CHECK(METRICS::Get("framepool.budget_waits") > waits);
+		CHECK(MEMBUDGET::Used() <= LIMIT);
+		MEMBUDGET::RemoveReclaimer(id);
+	}
+	/*缓冲池与缓冲区都释放后预算全部归还*/
+	CHECK(MEMBUDGET::Used() == 0);
+	return TestFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+/*
+ * test_threads.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Thread roles and wakeup jitter
+
+**************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "metrics.h"
+#include "threads.h"
+
+using namespace AstroAir;
+
+#define WAKEUPS 500
+#define PERIOD_US 1000
+
+/*线程是否只运行在Cpu上*/
+static bool PinnedTo(int Cpu)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if(pthread_getaffinity_np(pthread_self(),sizeof(set),&set) != 0)
+		return false;
+	return CPU_COUNT(&set) == 1 && CPU_ISSET(Cpu,&set);
+}
+
+static int Policy()
+{
+	int policy;
+	sched_param param;
+	pthread_getschedparam(pthread_self(),&policy,&param);
+	return policy;
+}
+
+int main()
+{
+	/*进程允许使用的第一个CPU*/
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	sched_getaffinity(0,sizeof(allowed),&allowed);
+	int cpu = 0;
+	while(cpu < CPU_SETSIZE && CPU_ISSET(cpu,&allowed) == 0)
+		cpu++;
+	/*采集与处理线程放在同一个CPU上，处理线程占满CPU*/
+	char dir[] = "/tmp/test_threads_XXXXXX";
+	CHECK(mkdtemp(dir) != nullptr);
+	CHECK(chdir(dir) == 0);
+	std::ofstream("config.air") << "{\"threads\":{"
+		"\"capture\":{\"cpus\":[" << cpu << "],\"policy\":\"fifo\",\"priority\":50},"
+		"\"processing\":{\"cpus\":[" << cpu << "]},"
+		"\"network\":{\"policy\":\"fifo\"}}}";
+	/*网络线程不允许实时调度*/
+	std::thread([]()
+	{
+		THREADS::Enter(THREADS::ROLE_NETWORK,"test-network");
+		CHECK(Policy() == SCHED_OTHER);
+	}).join();
+	CHECK(METRICS::Get("thread.sched_denied") == 0);
+	std::atomic<bool> running{true};
+	std::thread load([&running,cpu]()
+	{
+		THREADS::Enter(THREADS::ROLE_PROCESSING,"test-processing");
+		CHECK(PinnedTo(cpu));
+		CHECK(Policy() == SCHED_OTHER);
+		while(running == true)
+			;
+	});
+	std::thread capture([cpu]()
+	{
+		THREADS::Enter(THREADS::ROLE_CAPTURE,"test-capture-thread");
+		char name[16];
+		pthread_getname_np(pthread_self(),name,sizeof(name));
+		CHECK(strcmp(name,"test-capture-th") == 0);
+		CHECK(PinnedTo(cpu));
+		/*没有CAP_SYS_NICE时保持默认调度并计数*/
+		const bool realtime = Policy() == SCHED_FIFO;
+		CHECK(realtime == true || METRICS::Get("thread.sched_denied") == 1);
+		auto due = std::chrono::steady_clock::now();
+		for(int i = 0;i < WAKEUPS;i++)
+		{
+			due += std::chrono::microseconds(PERIOD_US);
+			std::this_thread::sleep_until(due);
+			THREADS::Wakeup(THREADS::ROLE_CAPTURE,due);
+		}
+		fprintf(stderr,"capture thread %s real-time priority\n",realtime ? "has" : "does not have");
+	});
+	capture.join();
+	running = false;
+	load.join();
+	/*与同一CPU上的处理线程竞争时，采集线程的唤醒延迟*/
+	auto metrics = METRICS::All();
+	fprintf(stderr,"wakeup jitter over the last %d of %d wakeups: p50 %.0f us,p95 %.0f us,max %.0f us\n",METRICS_WINDOW,WAKEUPS,
+			metrics["thread.jitter_us.capture.p50"],metrics["thread.jitter_us.capture.p95"],metrics["thread.jitter_us.capture.max"]);
+	CHECK(metrics["thread.jitter_us.capture.count"] == WAKEUPS);
+	CHECK(metrics["thread.jitter_us.capture.p50"] < PERIOD_US);
+	std::string command = std::string("rm -rf ") + dir;
+	system(command.c_str());
+	return TestFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+/*
+ * test_video.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:Video streaming of the simulated camera
+
+**************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "test.h"
+#include "metrics.h"
+#include "air-sim/sim_ccd.h"
+
+using namespace AstroAir;
+
+#define VIDEO_EXPOSURE 10		//单帧曝光(毫秒)，子画面很小，帧率由曝光决定
+#define VIDEO_SECONDS 2		//每次采集的时间(秒)
+
+/*
+ * Stream for VIDEO_SECONDS with a sink that takes Delay milliseconds per
+ * frame. Fps() and Dropped() of the capture are exported as the metrics
+ * video.fps.Simulator and video.dropped.Simulator.
+ */
+static void Stream(SIMULATORCCD &Camera,int Delay,std::atomic<int> &Received,double &Fps,double &Dropped)
+{
+	Received = 0;
+	Camera.SetFrameSink([&Received,Delay](const FRAMEHEADER &Header,const unsigned char *Data)
+	{
+		Received++;
+		std::this_thread::sleep_for(std::chrono::milliseconds(Delay));
+	});
+	const double before = METRICS::Get("video.dropped." SIM_BRAND);
+	CHECK(Camera.StartVideo(VIDEO_EXPOSURE,1,0,0) == true);
+	std::this_thread::sleep_for(std::chrono::seconds(VIDEO_SECONDS));
+	Fps = METRICS::Get("video.fps." SIM_BRAND);
+	Dropped = METRICS::Get("video.dropped." SIM_BRAND) - before;
+	fprintf(stderr,"sink delay %d ms: %.1f fps,%d frames received,%.0f dropped\n",Delay,Fps,Received.load(),Dropped);
+}
+
+int main()
+{
+	SIMULATORCCD Camera;
+	CHECK(Camera.Connect(SIM_DEVICE_NAME) == true);
+	CHECK(Camera.SetROI(0,0,320,240) == true);
+	const double expected = 1000.0 / VIDEO_EXPOSURE;
+	std::atomic<int> received{0};
+	double fps,dropped;
+	/*接收者跟得上时按曝光时间出帧，几乎不丢帧*/
+	Stream(Camera,0,received,fps,dropped);
+	CHECK(fps > expected * 0.7 && fps < expected * 1.1);
+	CHECK(received > expected * VIDEO_SECONDS * 0.7);
+	CHECK(dropped < received * 0.05);
+	CHECK(Camera.StopVideo() == true);
+	/*接收者太慢时丢弃旧帧，采集不被拖慢*/
+	Stream(Camera,50,received,fps,dropped);
+	CHECK(fps > expected * 0.7);
+	CHECK(received <= 20 * VIDEO_SECONDS + 1);
+	CHECK(dropped > received);
+	/*采集中断开连接，视频随之停止*/
+	CHECK(Camera.Disconnect() == true);
+	const int stopped = received;
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	CHECK(received == stopped);
+	CHECK(Camera.StartVideo(VIDEO_EXPOSURE,1,0,0) == false);
+	return TestFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+/*
+ * test_watchdog.cpp
+ *
+ * Copyright (C) 2020-2021 Max Qian
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*************************************************
+
+Copyright: 2020-2021 Max Qian. All rights reserved
+
+Author:Max Qian
+
+E-mail:astro_air@126.com
+
+Date:2026-10-18
+
+Description:SDK watchdog against a fault injecting fake SDK
+
+**************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <stop_token>
+#include <thread>
+
+#include "test.h"
+#include "watchdog.h"
+
+using namespace AstroAir;
+
+/*模拟的SDK，Hang为真时调用一直阻塞，直到Unblock()*/
+class FAKESDK
+{
+	public:
+		void Hang(bool Value)
+		{
+			std::lock_guard<std::mutex> guard(Lock);
+			Stuck = Value;
+			Cond.notify_all();
+		}
+		void Call()
+		{
+			std::unique_lock<std::mutex> lock(Lock);
+			Cond.wait(lock,[this]() { return Stuck == false; });
+		}
+	private:
+		std::mutex Lock;
+		std::condition_variable Cond;
+		bool Stuck = false;
+};
+
+static std::atomic<int> Stalls(0);
+static std::atomic<int> Recoveries(0);
+
+static bool WaitFor(std::atomic<int> &Count,int Value,int Ms)
+{
+	auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(Ms);
+	while(Count < Value && std::chrono::steady_clock::now() < end)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	return Count >= Value;
+}
+
+static int64_t Elapsed(std::chrono::steady_clock::time_point Start)
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - Start).count();
+}
+
+int main()
+{
+	FAKESDK Sdk;
+	SDKEXECUTOR Executor("FAKE");
+	Executor.SetStallHandler([](std::string Func,bool Stalled)
+	{
+		if(Stalled == true)
+			Stalls++;
+		else
+			Recoveries++;
+	});
+	/*正常调用*/
+	CHECK(Executor.Run("Call",200,[&Sdk]() { Sdk.Call(); }) == true);
+	CHECK(Executor.IsStalled() == false);
+	/*调用超时，调用者立即得到false并通知处理者*/
+	Sdk.Hang(true);
+	auto start = std::chrono::steady_clock::now();
+	CHECK(Executor.Run("Call",200,[&Sdk]() { Sdk.Call(); }) == false);
+	CHECK(Elapsed(start) < 1000);
+	CHECK(Executor.IsStalled() == true);
+	CHECK(Stalls == 1);
+	/*卡死期间的调用直接失败，不再排队*/
+	start = std::chrono::steady_clock::now();
+	CHECK(Executor.Run("Call",200,[&Sdk]() { Sdk.Call(); }) == false);
+	CHECK(Elapsed(start) < 50);
+	CHECK(Stalls == 1);
+	/*SDK返回后恢复*/
+	Sdk.Hang(false);
+	CHECK(WaitFor(Recoveries,1,1000) == true);
+	CHECK(Executor.IsStalled() == false);
+	CHECK(Executor.Run("Call",200,[&Sdk]() { Sdk.Call(); }) == true);
+	/*调用者不再等待的调用由看门狗发现*/
+	Sdk.Hang(true);
+	std::stop_source stop;
+	std::thread cancel([&stop]()
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		stop.request_stop();
+	});
+	CHECK(Executor.Run("Call",300,[&Sdk]() { Sdk.Call(); },stop.get_token()) == false);
+	cancel.join();
+	CHECK(Executor.IsStalled() == false);
+	CHECK(WaitFor(Stalls,2,300 + 2 * SDK_WATCH_INTERVAL) == true);
+	CHECK(Executor.IsStalled() == true);
+	Sdk.Hang(false);
+	CHECK(WaitFor(Recoveries,2,1000) == true);
+	return TestFailed == 0 ? 0 : 1;
+}